@@ -65,6 +65,7 @@
 #include "src/main/cpp/util/numbers.h"
 #include "src/main/cpp/util/port.h"
 #include "src/main/cpp/util/strings.h"
+#include "src/main/cpp/util/trace.h"
 #include "src/main/cpp/workspace_layout.h"
 #include "third_party/ijar/zip.h"
 
@@ -354,6 +355,7 @@ class GetInstallKeyFileProcessor : public PureZipExtractorProcessor {
 // Populates globals->install_md5 and globals->extracted_binaries by reading the
 // ZIP entries in the Blaze binary.
 static void ComputeInstallMd5AndNoteAllFiles(const string &self_path) {
+  blaze_util::ScopedTraceSpan span("Scan embedded zip");
   NoteAllFilesZipProcessor note_all_files_processor(
       &globals->extracted_binaries);
   GetInstallKeyFileProcessor install_key_processor(&globals->install_md5);
@@ -643,10 +645,109 @@ static void GoToWorkspace(const WorkspaceLayout *workspace_layout) {
   }
 }
 
-// Check the java version if a java version specification is bundled. On
-// success, returns the executable path of the java command.
-static void VerifyJavaVersionAndSetJvm() {
-  string exe = globals->options->GetJvm();
+// Returns the version of the given java executable. Forking a JVM just for
+// "java -version" is slow, so the result is cached in the output user root and
+// reused as long as the executable's size, mtime and ctime stay the same.
+static string GetCachedJvmVersion(const string &java_exe) {
+  blaze_util::FileStamp stamp;
+  if (!blaze_util::StatFile(java_exe, &stamp)) {
+    return GetJvmVersion(java_exe);
+  }
+
+  string cache_dir = blaze_util::JoinPath(
+      globals->options->output_user_root, "java_version_cache");
+  string cache_file = GetHashedBaseDir(cache_dir, java_exe);
+  string key = ToString(stamp.size) + " " + ToString(stamp.mtime_ns) + " " +
+               ToString(stamp.ctime_ns) + "\n";
+  string data;
+  if (blaze_util::ReadFile(cache_file, &data) && data.size() > key.size() &&
+      data.compare(0, key.size(), key) == 0) {
+    return data.substr(key.size());
+  }
+
+  string jvm_version = GetJvmVersion(java_exe);
+  // A failure to write the cache only costs another probe next time.
+  if (!jvm_version.empty() &&
+      (!blaze_util::MakeDirectories(cache_dir, 0755) ||
+       !blaze_util::WriteFile(key + jvm_version, cache_file, 0644))) {
+    BAZEL_LOG(WARNING) << "Failed to cache the version of " << java_exe
+                       << " in " << cache_file;
+  }
+  return jvm_version;
+}
+
+// Probes the version of the JVM on a separate thread, so that it overlaps
+// with ExtractData().
+class JvmVersionProbe {
+ public:
+  JvmVersionProbe() : probed_(false) {}
+
+  // Starts probing, unless no version specification is bundled or the JVM is
+  // the bundled one that ExtractData() is about to extract. Sets
+  // globals->jvm_path when probing.
+  void Start() {
+    if (!BundlesVersionSpec() || !CanFindJvmBeforeExtraction()) {
+      return;
+    }
+    globals->jvm_path = globals->options->GetJvm();
+    probed_ = true;
+    thread_ = std::thread([this]() {
+      blaze_util::ScopedTraceSpan span("Probe Java version");
+      jvm_version_ = GetCachedJvmVersion(globals->jvm_path);
+    });
+  }
+
+  // Waits for the probe, if any, and sets globals->jvm_path.
+  void Finish() {
+    if (thread_.joinable()) {
+      thread_.join();
+    } else {
+      globals->jvm_path = globals->options->GetJvm();
+    }
+  }
+
+  // Returns the version of globals->jvm_path. Must be called after Finish().
+  string GetVersion() {
+    if (!probed_) {
+      jvm_version_ = GetCachedJvmVersion(globals->jvm_path);
+      probed_ = true;
+    }
+    return jvm_version_;
+  }
+
+ private:
+  static bool BundlesVersionSpec() {
+    return std::find(globals->extracted_binaries.begin(),
+                     globals->extracted_binaries.end(),
+                     "java.version") != globals->extracted_binaries.end();
+  }
+
+  // Returns whether GetJvm() returns the same before and after ExtractData().
+  static bool CanFindJvmBeforeExtraction() {
+    if (!globals->options->GetExplicitHostJavabase().empty() ||
+        blaze_util::PathExists(globals->options->install_base)) {
+      return true;
+    }
+    static const char kBundledJdkPrefix[] = "embedded_tools/jdk/";
+    for (const auto &it : globals->extracted_binaries) {
+      if (it.compare(0, sizeof(kBundledJdkPrefix) - 1, kBundledJdkPrefix) ==
+          0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool probed_;
+  std::thread thread_;
+  string jvm_version_;
+};
+
+// Check the java version if a java version specification is bundled. Sets
+// globals->jvm_path to the executable path of the java command.
+static void VerifyJavaVersionAndSetJvm(JvmVersionProbe *probe) {
+  blaze_util::ScopedTraceSpan span("Verify Java version");
+  probe->Finish();
 
   string version_spec_file = blaze_util::JoinPath(
       GetEmbeddedBinariesRoot(globals->options->install_base), "java.version");
@@ -654,7 +755,7 @@ static void VerifyJavaVersionAndSetJvm() {
   if (blaze_util::ReadFile(version_spec_file, &version_spec)) {
     blaze_util::StripWhitespace(&version_spec);
     // A version specification is given, get version of java.
-    string jvm_version = GetJvmVersion(exe);
+    string jvm_version = probe->GetVersion();
 
     // Compare that jvm_version is found and at least the one specified.
     if (jvm_version.empty()) {
@@ -669,13 +770,12 @@ static void VerifyJavaVersionAndSetJvm() {
           jvm_version.c_str(), version_spec.c_str());
     }
   }
-
-  globals->jvm_path = exe;
 }
 
 // Starts the Blaze server.
 static int StartServer(const WorkspaceLayout *workspace_layout,
                         BlazeServerStartup **server_startup) {
+  blaze_util::ScopedTraceSpan span("Start server");
   vector<string> jvm_args_vector = GetArgumentArray(workspace_layout);
   string argument_string = GetArgumentString(jvm_args_vector);
   string server_dir =
@@ -704,6 +804,28 @@ static int StartServer(const WorkspaceLayout *workspace_layout,
                        server_startup);
 }
 
+// Writes everything the client traced so far to the file requested with
+// --experimental_client_trace_file, if any. The client stops tracing once it
+// hands over to the server, so this is called at most once.
+static void WriteClientTrace() {
+  if (globals->options->client_trace_file.empty()) {
+    return;
+  }
+  uint64_t now = blaze_util::GetTraceTimestamp();
+  blaze_util::RecordTraceSpan("Client startup",
+                              now - GetMillisecondsSinceProcessStart() * 1000,
+                              now);
+  int pid = 0;
+  blaze_util::safe_strto32(GetProcessIdAsString(), &pid);
+  if (!blaze_util::WriteFile(
+          blaze_util::GetTraceJson(pid,
+                                   globals->options->product_name + " client"),
+          globals->options->client_trace_file)) {
+    BAZEL_LOG(WARNING) << "Failed to write client trace to "
+                       << globals->options->client_trace_file;
+  }
+}
+
 // Replace this process with blaze in standalone/batch mode.
 // The batch mode blaze process handles the command and exits.
 //
@@ -749,6 +871,7 @@ static void StartStandalone(const WorkspaceLayout *workspace_layout,
 
   string exe =
       globals->options->GetExe(globals->jvm_path, globals->ServerJarPath());
+  WriteClientTrace();
   ExecuteProgram(exe, jvm_args_vector);
   pdie(blaze_exit_code::INTERNAL_ERROR, "execv of '%s' failed", exe.c_str());
 }
@@ -793,6 +916,268 @@ static void SetRestartReasonIfNotSet(RestartReason restart_reason) {
   }
 }
 
+static bool ServerNeedsToBeKilled(const vector<string> &args1,
+                                  const vector<string> &args2);
+
+// With --experimental_standby_server, the client keeps up to two more server
+// processes per output base in reserve, so that a server restart does not have
+// to wait for a JVM to boot. One is for the current startup options, for when
+// the server dies or idles out. The other one is for the startup options of the
+// server that the current one replaced, for when the user switches back to
+// them. "shutdown" kills the standbys as well.
+//
+// Standbys live in <output_base>/standby/<slot>, which is laid out like an
+// output base (server/server.pid.txt, server/cmdline, ...) so that the usual
+// process verification works on it. A standby is started exactly like a server,
+// plus the environment variable below, which makes the JVM block before it
+// touches the output base until a "promote" file appears in its server
+// directory. A standby that finds its PID file gone without having been
+// promoted exits.
+static const char kStandbyDirEnvVar[] = "BAZEL_STANDBY_DIR";
+static const int kMaxStandbyServers = 2;
+
+static string GetStandbyBase(int slot) {
+  return blaze_util::JoinPath(
+      blaze_util::JoinPath(globals->options->output_base, "standby"),
+      ToString(slot));
+}
+
+// Returns the PID of the standby server in standby_base, or -1 if there is
+// none.
+static int GetStandbyServerPid(const string &standby_base) {
+  int pid = GetServerPid(blaze_util::JoinPath(standby_base, "server"));
+  if (pid > 0 && VerifyServerProcess(pid, standby_base)) {
+    return pid;
+  }
+  return -1;
+}
+
+static vector<string> GetStandbyServerArgs(const string &standby_base) {
+  string cmdline;
+  blaze_util::ReadFile(blaze_util::JoinPath(standby_base, "server/cmdline"),
+                       &cmdline);
+  return blaze_util::Split(cmdline, '\0');
+}
+
+static void KillStandbyServers() {
+  for (int slot = 0; slot < kMaxStandbyServers; slot++) {
+    string standby_base = GetStandbyBase(slot);
+    int pid = GetStandbyServerPid(standby_base);
+    if (pid > 0) {
+      BAZEL_LOG(INFO) << "Killing standby server (pid=" << pid << ")";
+      KillServerProcess(pid, standby_base);
+    }
+  }
+}
+
+// Starts a standby server for the given arguments in standby_base, after
+// killing the standby that is there already, if any. It runs in working_dir,
+// like the server would. Runs on a helper thread while the command runs, so it
+// must neither die nor change process-wide state such as the environment.
+static void StartStandbyServerIn(const string &standby_base,
+                                 const vector<string> &jvm_args_vector,
+                                 const string &working_dir) {
+  blaze_util::ScopedTraceSpan span("Start standby server");
+  int old_pid = GetStandbyServerPid(standby_base);
+  if (old_pid > 0) {
+    BAZEL_LOG(INFO) << "Killing standby server (pid=" << old_pid
+                    << ") to make room for a new one";
+    KillServerProcess(old_pid, standby_base);
+  }
+
+  string standby_server_dir = blaze_util::JoinPath(standby_base, "server");
+  if (!blaze_util::MakeDirectories(standby_server_dir, 0700)) {
+    BAZEL_LOG(WARNING) << "Couldn't create standby server directory "
+                       << standby_server_dir;
+    return;
+  }
+  if (!blaze_util::WriteFile(
+          GetArgumentString(jvm_args_vector),
+          blaze_util::JoinPath(standby_server_dir, "cmdline"))) {
+    BAZEL_LOG(WARNING) << "Couldn't write standby server command line to "
+                       << standby_server_dir;
+    return;
+  }
+  string exe =
+      globals->options->GetExe(globals->jvm_path, globals->ServerJarPath());
+
+  // With --server_jvm_out, all servers append to the same file anyway.
+  // Otherwise the log is moved to the usual place upon promotion.
+  string jvm_log_file =
+      globals->jvm_log_file_append
+          ? globals->jvm_log_file
+          : blaze_util::JoinPath(standby_server_dir, "jvm.out");
+  BlazeServerStartup *standby_startup;
+  string error;
+  int pid = TryExecuteDaemon(
+      exe, jvm_args_vector, {string(kStandbyDirEnvVar) + "=" + standby_base},
+      working_dir, jvm_log_file, globals->jvm_log_file_append,
+      standby_server_dir, &error, &standby_startup);
+  if (pid < 0) {
+    BAZEL_LOG(WARNING) << "Couldn't start standby server: " << error;
+    return;
+  }
+  delete standby_startup;
+  BAZEL_LOG(INFO) << "Started standby server (pid=" << pid << ")";
+}
+
+// Returns the slot for a standby server with the given arguments, or -1 if one
+// is waiting already. If all slots are taken, the standby for the startup
+// options of the replaced server, if any, is not evicted.
+static int ChooseStandbySlot(const vector<string> &jvm_args_vector) {
+  int free_slot = -1;
+  int evicted_slot = -1;
+  for (int slot = 0; slot < kMaxStandbyServers; slot++) {
+    string standby_base = GetStandbyBase(slot);
+    if (GetStandbyServerPid(standby_base) < 0) {
+      if (free_slot < 0) {
+        free_slot = slot;
+      }
+      continue;
+    }
+    vector<string> standby_args = GetStandbyServerArgs(standby_base);
+    if (!ServerNeedsToBeKilled(standby_args, jvm_args_vector)) {
+      return -1;
+    }
+    if (evicted_slot < 0 &&
+        (globals->replaced_server_args.empty() ||
+         ServerNeedsToBeKilled(standby_args, globals->replaced_server_args))) {
+      evicted_slot = slot;
+    }
+  }
+  if (free_slot >= 0) {
+    return free_slot;
+  }
+  return evicted_slot >= 0 ? evicted_slot : 0;
+}
+
+// Starts a standby server for the current startup options in the background
+// while the command runs, so that the client does not take longer to exit.
+// Failures are not fatal, we just start the next server the slow way.
+class StandbyServerStarter {
+ public:
+  void Start(const WorkspaceLayout *workspace_layout) {
+    vector<string> jvm_args_vector = GetArgumentArray(workspace_layout);
+    int slot = ChooseStandbySlot(jvm_args_vector);
+    if (slot < 0) {
+      return;
+    }
+    // gRPC threads are running by now, so the working directory and the
+    // environment variable are only set for the standby itself.
+    string standby_base = GetStandbyBase(slot);
+    string working_dir = workspace_layout->InWorkspace(globals->workspace)
+                             ? globals->workspace
+                             : "";
+    thread_ = std::thread([standby_base, jvm_args_vector, working_dir]() {
+      StartStandbyServerIn(standby_base, jvm_args_vector, working_dir);
+    });
+  }
+
+  // Waits until the standby server is started, if one is being started.
+  void Finish() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+ private:
+  std::thread thread_;
+};
+
+// A BlazeServerStartup for a server that was started by an earlier client
+// invocation, so there is no startup pipe to watch.
+class ProcessBlazeServerStartup : public BlazeServerStartup {
+ public:
+  ProcessBlazeServerStartup(int pid, const string &output_base)
+      : pid_(pid), output_base_(output_base) {}
+
+  bool IsStillAlive() override {
+    return VerifyServerProcess(pid_, output_base_);
+  }
+
+ private:
+  const int pid_;
+  const string output_base_;
+};
+
+// Hands the output base over to a standby server with compatible startup
+// options, if there is one. Returns its PID, or -1 if a new server has to be
+// started.
+static int PromoteStandbyServer(const WorkspaceLayout *workspace_layout,
+                                BlazeServerStartup **server_startup) {
+  vector<string> jvm_args_vector = GetArgumentArray(workspace_layout);
+  string standby_base;
+  int pid = -1;
+  for (int slot = 0; slot < kMaxStandbyServers && pid < 0; slot++) {
+    standby_base = GetStandbyBase(slot);
+    pid = GetStandbyServerPid(standby_base);
+    if (pid > 0 && ServerNeedsToBeKilled(GetStandbyServerArgs(standby_base),
+                                         jvm_args_vector)) {
+      // Kept for when the user switches back to its startup options.
+      pid = -1;
+    }
+  }
+  if (pid < 0) {
+    return -1;
+  }
+
+  blaze_util::ScopedTraceSpan span("Promote standby server");
+  string standby_server_dir = blaze_util::JoinPath(standby_base, "server");
+  string standby_cmdline;
+  blaze_util::ReadFile(blaze_util::JoinPath(standby_server_dir, "cmdline"),
+                       &standby_cmdline);
+
+  // Register the standby as the server of the output base, the way
+  // ExecuteDaemon() does for a fresh one. The standby's own command line is
+  // recorded, because volatile options may differ from ours.
+  string server_dir =
+      blaze_util::JoinPath(globals->options->output_base, "server");
+  string standby_starttime;
+  bool has_starttime = blaze_util::ReadFile(
+      blaze_util::JoinPath(standby_server_dir, "server.starttime"),
+      &standby_starttime);
+  string promote_file = blaze_util::JoinPath(standby_server_dir, "promote");
+  if ((has_starttime &&
+       !blaze_util::WriteFile(
+           standby_starttime,
+           blaze_util::JoinPath(server_dir, "server.starttime"))) ||
+      !blaze_util::WriteFile(standby_cmdline,
+                             blaze_util::JoinPath(server_dir, "cmdline")) ||
+      !blaze_util::WriteFile(
+          ToString(pid), blaze_util::JoinPath(server_dir, kServerPidFile)) ||
+      !blaze_util::WriteFile("", promote_file)) {
+    BAZEL_LOG(WARNING) << "Couldn't promote standby server (pid=" << pid
+                       << "), killing it.";
+    KillServerProcess(pid, standby_base);
+    return -1;
+  }
+
+  // The standby server now belongs to the output base; forget about it so
+  // that the next standby can be started in its slot.
+  blaze_util::UnlinkPath(
+      blaze_util::JoinPath(standby_server_dir, kServerPidFile));
+  blaze_util::UnlinkPath(
+      blaze_util::JoinPath(standby_server_dir, "server.starttime"));
+  // Its log goes where the log of a fresh server would, before the next
+  // standby in this slot truncates it.
+  if (!globals->jvm_log_file_append &&
+      blaze_util::RenameDirectory(
+          blaze_util::JoinPath(standby_server_dir, "jvm.out"),
+          globals->jvm_log_file) != blaze_util::kRenameDirectorySuccess) {
+    BAZEL_LOG(WARNING) << "Couldn't move the log of the standby server to "
+                       << globals->jvm_log_file;
+  }
+
+  if (globals->restart_reason == NO_RESTART) {
+    globals->restart_reason = NO_DAEMON;
+  }
+
+  *server_startup =
+      new ProcessBlazeServerStartup(pid, globals->options->output_base);
+  BAZEL_LOG(INFO) << "Promoted standby server (pid=" << pid << ")";
+  return pid;
+}
+
 // Starts up a new server and connects to it. Exits if it didn't work out.
 static void StartServerAndConnect(const WorkspaceLayout *workspace_layout,
                                   BlazeServer *server) {
@@ -830,10 +1215,18 @@ static void StartServerAndConnect(const WorkspaceLayout *workspace_layout,
                 globals->options->io_nice_level);
 
   BlazeServerStartup *server_startup;
-  server_pid = StartServer(workspace_layout, &server_startup);
-
-  BAZEL_LOG(USER) << "Starting local " << globals->options->product_name
-                  << " server and connecting to it...";
+  server_pid = -1;
+  if (globals->options->standby_server) {
+    server_pid = PromoteStandbyServer(workspace_layout, &server_startup);
+  }
+  if (server_pid < 0) {
+    server_pid = StartServer(workspace_layout, &server_startup);
+    BAZEL_LOG(USER) << "Starting local " << globals->options->product_name
+                    << " server and connecting to it...";
+  } else {
+    BAZEL_LOG(USER) << "Connecting to standby "
+                    << globals->options->product_name << " server...";
+  }
 
   // Give the server two minutes to start up. That's enough to connect with a
   // debugger.
@@ -842,7 +1235,12 @@ static void StartServerAndConnect(const WorkspaceLayout *workspace_layout,
   while (std::chrono::system_clock::now() < try_until_time) {
     auto next_attempt_time(std::chrono::system_clock::now() +
                            std::chrono::milliseconds(100));
-    if (server->Connect()) {
+    bool connected;
+    {
+      blaze_util::ScopedTraceSpan span("Connect to new server");
+      connected = server->Connect();
+    }
+    if (connected) {
       fputc('\n', stderr);
       fflush(stderr);
       delete server_startup;
@@ -1011,6 +1409,7 @@ static void ActuallyExtractData(const string &argv0,
 // becomes visible automically at the new path.
 // Populates globals->extracted_binaries with their extracted locations.
 static void ExtractData(const string &self_path) {
+  blaze_util::ScopedTraceSpan span("Extract data");
   // If the install dir doesn't exist, create it, if it does, we know it's good.
   if (!blaze_util::PathExists(globals->options->install_base)) {
     uint64_t st = GetMillisecondsMonotonic();
@@ -1160,6 +1559,7 @@ static void KillRunningServerIfDifferentStartupOptions(
   // mortal coil.
   if (ServerNeedsToBeKilled(arguments, GetArgumentArray(workspace_layout))) {
     globals->restart_reason = NEW_OPTIONS;
+    globals->replaced_server_args = arguments;
     BAZEL_LOG(WARNING) << "Running " << globals->options->product_name
                        << " server needs to be killed, because the startup "
                           "options are different.";
@@ -1255,7 +1655,19 @@ static ATTRIBUTE_NORETURN void SendServerRequest(
   globals->startup_time = GetMillisecondsSinceProcessStart();
 
   SignalHandler::Get().Install(globals, CancelServer);
-  SignalHandler::Get().PropagateSignalOrExit(server->Communicate());
+  StandbyServerStarter standby_starter;
+  bool shutdown = globals->option_processor->GetCommand() == "shutdown";
+  if (globals->options->standby_server && !shutdown) {
+    // Prepare for the next server restart while this command runs.
+    standby_starter.Start(workspace_layout);
+  }
+  unsigned int exit_code = server->Communicate();
+
+  standby_starter.Finish();
+  if (globals->options->standby_server && shutdown) {
+    KillStandbyServers();
+  }
+  SignalHandler::Get().PropagateSignalOrExit(exit_code);
 }
 
 // Parse the options, storing parsed values in globals.
@@ -1471,7 +1883,10 @@ int Main(int argc, const char *argv[], WorkspaceLayout *workspace_layout,
   DetectBashOrDie();
 
   globals->binary_path = CheckAndGetBinaryPath(argv[0]);
-  ParseOptions(argc, argv);
+  {
+    blaze_util::ScopedTraceSpan span("Parse options");
+    ParseOptions(argc, argv);
+  }
 
   SetDebugLog(globals->options->client_debug);
   // If client_debug was false, this is ignored, so it's accurate.
@@ -1487,14 +1902,22 @@ int Main(int argc, const char *argv[], WorkspaceLayout *workspace_layout,
   blaze_server = static_cast<BlazeServer *>(
       new GrpcBlazeServer(globals->options->connect_timeout_secs));
 
-  globals->command_wait_time = blaze_server->AcquireLock();
+  {
+    blaze_util::ScopedTraceSpan span("Acquire lock");
+    globals->command_wait_time = blaze_server->AcquireLock();
+  }
 
   WarnFilesystemType(globals->options->output_base);
 
+  JvmVersionProbe jvm_version_probe;
+  jvm_version_probe.Start();
   ExtractData(self_path);
-  VerifyJavaVersionAndSetJvm();
+  VerifyJavaVersionAndSetJvm(&jvm_version_probe);
 
-  blaze_server->Connect();
+  {
+    blaze_util::ScopedTraceSpan span("Connect to running server");
+    blaze_server->Connect();
+  }
   EnsureCorrectRunningVersion(blaze_server);
   KillRunningServerIfDifferentStartupOptions(workspace_layout, blaze_server);
 
@@ -1770,6 +2193,7 @@ unsigned int GrpcBlazeServer::Communicate() {
 
   grpc::ClientContext context;
   command_server::RunResponse response;
+  const uint64_t request_time = blaze_util::GetTraceTimestamp();
   std::unique_ptr<grpc::ClientReader<command_server::RunResponse>> reader(
       client_->Run(&context, request));
 
@@ -1784,8 +2208,17 @@ unsigned int GrpcBlazeServer::Communicate() {
   command_server::RunResponse final_response;
   bool finished = false;
   bool finished_warning_emitted = false;
+  bool first_response = true;
 
   while (reader->Read(&response)) {
+    if (first_response) {
+      blaze_util::RecordTraceSpan("Wait for first response", request_time,
+                                  blaze_util::GetTraceTimestamp());
+      blaze_util::RecordTraceInstant("First response");
+      WriteClientTrace();
+      first_response = false;
+    }
+
     if (finished && !finished_warning_emitted) {
       BAZEL_LOG(USER) << "\nServer returned messages after reporting exit code";
       finished_warning_emitted = true;
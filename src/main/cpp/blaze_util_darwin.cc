@@ -192,8 +192,9 @@ string GetDefaultHostJavabase() {
   return javabase.substr(0, javabase.length()-1);
 }
 
-void WriteSystemSpecificProcessIdentifier(
+bool WriteSystemSpecificProcessIdentifier(
     const string& server_dir, pid_t server_pid) {
+  return true;
 }
 
 bool VerifyServerProcess(int pid, const string &output_base) {
@@ -147,8 +147,9 @@ string GetDefaultHostJavabase() {
   return !javahome.empty() ? javahome : "/usr/local/openjdk8";
 }
 
-void WriteSystemSpecificProcessIdentifier(
+bool WriteSystemSpecificProcessIdentifier(
     const string& server_dir, pid_t server_pid) {
+  return true;
 }
 
 bool VerifyServerProcess(int pid, const string &output_base) {
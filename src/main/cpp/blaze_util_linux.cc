@@ -213,21 +213,14 @@ static bool GetStartTime(const string& pid, string* start_time) {
   return true;
 }
 
-void WriteSystemSpecificProcessIdentifier(
+bool WriteSystemSpecificProcessIdentifier(
     const string& server_dir, pid_t server_pid) {
-  string pid_string = ToString(server_pid);
-
   string start_time;
-  if (!GetStartTime(pid_string, &start_time)) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "Cannot get start time of process %s", pid_string.c_str());
+  if (!GetStartTime(ToString(server_pid), &start_time)) {
+    return false;
   }
-
   string start_time_file = blaze_util::JoinPath(server_dir, "server.starttime");
-  if (!blaze_util::WriteFile(start_time, start_time_file)) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "Cannot write start time in server dir %s", server_dir.c_str());
-  }
+  return blaze_util::WriteFile(start_time, start_time_file);
 }
 
 // On Linux we use a combination of PID and start time to identify the server
@@ -114,6 +114,20 @@ int ExecuteDaemon(const std::string& exe,
                   const std::string& server_dir,
                   BlazeServerStartup** server_startup);
 
+// Like ExecuteDaemon, but returns -1 and sets error instead of dying if the
+// daemon cannot be started. The daemon runs in working_dir unless it is empty,
+// and gets the "NAME=value" entries of extra_env on top of our environment;
+// neither changes the working directory or the environment of the caller.
+int TryExecuteDaemon(const std::string& exe,
+                     const std::vector<std::string>& args_vector,
+                     const std::vector<std::string>& extra_env,
+                     const std::string& working_dir,
+                     const std::string& daemon_output,
+                     const bool daemon_output_append,
+                     const std::string& server_dir,
+                     std::string* error,
+                     BlazeServerStartup** server_startup);
+
 // Get the version string from the given java executable. The java executable
 // is supposed to output a string in the form '.*version ".*".*'. This method
 // will return the part in between the two quote or the empty string on failure
@@ -153,6 +167,8 @@ struct BlazeLock {
 };
 
 // Acquires a lock on the output base. Exits if the lock cannot be acquired.
+// If ``block`` is true, waits until the lock is released by its current owner;
+// concurrent waiters are granted the lock in the order they started waiting.
 // Sets ``lock`` to a value that can subsequently be passed to ReleaseLock().
 // Returns the number of milliseconds spent with waiting for the lock.
 uint64_t AcquireLock(const std::string& output_base, bool batch_mode,
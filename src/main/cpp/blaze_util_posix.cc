@@ -22,6 +22,7 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/resource.h>
@@ -33,7 +34,11 @@
 #include <unistd.h>
 
 #include <cassert>
+#include <chrono>  // NOLINT (for std::chrono::milliseconds)
 #include <cinttypes>
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
 
 #include "src/main/cpp/blaze_util.h"
 #include "src/main/cpp/blaze_util_platform.h"
@@ -45,6 +50,10 @@
 #include "src/main/cpp/util/logging.h"
 #include "src/main/cpp/util/md5.h"
 #include "src/main/cpp/util/numbers.h"
+#include "src/main/cpp/util/strings.h"
+
+// Not declared by <unistd.h> everywhere.
+extern char **environ;
 
 namespace blaze {
 
@@ -271,33 +280,28 @@ static void DieAfterFork(const char* message) {
 
 // NB: There should only be system calls in this function. See the comment
 // before ExecuteDaemon() to understand why.
-static void ReadFromFdWithRetryEintr(
-    int fd, void *buf, size_t count, const char* error_message) {
+static bool ReadFromFdWithRetryEintr(int fd, void *buf, size_t count) {
   ssize_t result;
   do {
     result = read(fd, buf, count);
   } while (result < 0 && errno == EINTR);
-  if (result < 0 || static_cast<size_t>(result) != count) {
-    DieAfterFork(error_message);
-  }
+  return result >= 0 && static_cast<size_t>(result) == count;
 }
 
 // NB: There should only be system calls in this function. See the comment
 // before ExecuteDaemon() to understand why.
-static void WriteToFdWithRetryEintr(
-    int fd, void *buf, size_t count, const char* error_message) {
+static bool WriteToFdWithRetryEintr(int fd, void *buf, size_t count) {
   ssize_t result;
   do {
     // Ideally, we'd use send(..., MSG_NOSIGNAL), but that's not available on
     // Darwin.
     result = write(fd, buf, count);
   } while (result < 0 && errno == EINTR);
-  if (result < 0 || static_cast<size_t>(result) != count) {
-    DieAfterFork(error_message);
-  }
+  return result >= 0 && static_cast<size_t>(result) == count;
 }
 
-void WriteSystemSpecificProcessIdentifier(
+// Returns false if the identifier could not be written.
+bool WriteSystemSpecificProcessIdentifier(
     const string& server_dir, pid_t server_pid);
 
 // We do a lot of seemingly-needless complications to avoid doing anything
@@ -331,44 +335,83 @@ void WriteSystemSpecificProcessIdentifier(
 // daemonizes then exec()s the actual JVM, which is also non-trivial. So I hope
 // this will be good enough because for all its flaws, this solution is at least
 // localized here.
-int ExecuteDaemon(const string& exe,
-                  const std::vector<string>& args_vector,
-                  const string& daemon_output,
-                  const bool daemon_output_append,
-                  const string& server_dir,
-                  BlazeServerStartup** server_startup) {
+int TryExecuteDaemon(const string& exe,
+                     const std::vector<string>& args_vector,
+                     const std::vector<string>& extra_env,
+                     const string& working_dir,
+                     const string& daemon_output,
+                     const bool daemon_output_append,
+                     const string& server_dir,
+                     string* error,
+                     BlazeServerStartup** server_startup) {
   int fds[2];
 
   if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
-    pdie(blaze_exit_code::INTERNAL_ERROR, "socket creation failed");
+    blaze_util::StringPrintf(error, "socket creation failed: %s",
+                             strerror(errno));
+    return -1;
   }
 
+  // The environment of the daemon is put together before forking, rather than
+  // with setenv() in the child, which might allocate.
+  std::vector<string> env;
+  for (char** var = environ; *var != NULL; var++) {
+    env.push_back(*var);
+  }
+  env.insert(env.end(), extra_env.begin(), extra_env.end());
+
   const char* daemon_output_chars = daemon_output.c_str();
+  const char* working_dir_chars = working_dir.c_str();
   const char** argv = ConvertStringVectorToArgv(args_vector);
+  const char** envp = ConvertStringVectorToArgv(env);
   const char* exe_chars = exe.c_str();
 
   int child = fork();
   if (child == -1) {
-    pdie(blaze_exit_code::INTERNAL_ERROR, "fork() failed");
+    blaze_util::StringPrintf(error, "fork() failed: %s", strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    delete[] argv;
+    delete[] envp;
     return -1;
   } else if (child > 0) {
     // Parent process (i.e. the client)
     close(fds[1]);  // parent keeps one side...
+    delete[] argv;
+    delete[] envp;
     int unused_status;
     waitpid(child, &unused_status, 0);  // child double-forks
     pid_t server_pid = 0;
-    ReadFromFdWithRetryEintr(fds[0], &server_pid, sizeof server_pid,
-                        "cannot read server PID from server");
+    if (!ReadFromFdWithRetryEintr(fds[0], &server_pid, sizeof server_pid)) {
+      *error = "cannot read server PID from server";
+      close(fds[0]);
+      return -1;
+    }
+    // Closing our side of the socket upon failure makes the server exit before
+    // it executes the JVM.
     string pid_file = blaze_util::JoinPath(server_dir, kServerPidFile);
     if (!blaze_util::WriteFile(ToString(server_pid), pid_file)) {
-      pdie(blaze_exit_code::INTERNAL_ERROR, "cannot write PID file");
+      blaze_util::StringPrintf(error, "cannot write PID file %s: %s",
+                               pid_file.c_str(), strerror(errno));
+      close(fds[0]);
+      return -1;
+    }
+    if (!WriteSystemSpecificProcessIdentifier(server_dir, server_pid)) {
+      blaze_util::StringPrintf(
+          error, "cannot write the start time of server process %d to %s",
+          server_pid, server_dir.c_str());
+      close(fds[0]);
       return -1;
     }
 
-    WriteSystemSpecificProcessIdentifier(server_dir, server_pid);
     char dummy = 'a';
-    WriteToFdWithRetryEintr(fds[0], &dummy, 1,
-                       "cannot notify server about having written PID file");
+    if (!WriteToFdWithRetryEintr(fds[0], &dummy, 1)) {
+      blaze_util::StringPrintf(
+          error, "cannot notify server about having written PID file: %s",
+          strerror(errno));
+      close(fds[0]);
+      return -1;
+    }
     *server_startup = new SocketBlazeServerStartup(fds[0]);
     return server_pid;
   } else {
@@ -377,27 +420,47 @@ int ExecuteDaemon(const string& exe,
     // before ExecuteDaemon() to understand why.
     close(fds[0]);  // ...child keeps the other.
 
+    if (working_dir_chars[0] != '\0' && chdir(working_dir_chars) < 0) {
+      DieAfterFork("Cannot change to the working directory of the daemon");
+    }
     Daemonize(daemon_output_chars, daemon_output_append);
 
     pid_t server_pid = getpid();
-    WriteToFdWithRetryEintr(fds[1], &server_pid, sizeof server_pid,
-                            "cannot communicate server PID to client");
+    if (!WriteToFdWithRetryEintr(fds[1], &server_pid, sizeof server_pid)) {
+      DieAfterFork("cannot communicate server PID to client");
+    }
     // We wait until the client writes the PID file so that there is no race
     // condition; the server expects the PID file to already be there so that
     // it can read it and know its own PID (see the ctor GrpcServerImpl) and so
     // that it can kill itself if the PID file is deleted (see
     // GrpcServerImpl.PidFileWatcherThread)
     char dummy;
-    ReadFromFdWithRetryEintr(
-        fds[1], &dummy, 1,
-        "cannot get PID file write acknowledgement from client");
+    if (!ReadFromFdWithRetryEintr(fds[1], &dummy, 1)) {
+      DieAfterFork("cannot get PID file write acknowledgement from client");
+    }
 
-    execv(exe_chars, const_cast<char**>(argv));
+    execve(exe_chars, const_cast<char**>(argv), const_cast<char**>(envp));
     DieAfterFork("Cannot execute daemon");
     return -1;
   }
 }
 
+int ExecuteDaemon(const string& exe,
+                  const std::vector<string>& args_vector,
+                  const string& daemon_output,
+                  const bool daemon_output_append,
+                  const string& server_dir,
+                  BlazeServerStartup** server_startup) {
+  string error;
+  int pid = TryExecuteDaemon(exe, args_vector, {}, "", daemon_output,
+                             daemon_output_append, server_dir, &error,
+                             server_startup);
+  if (pid < 0) {
+    die(blaze_exit_code::INTERNAL_ERROR, "%s", error.c_str());
+  }
+  return pid;
+}
+
 static string RunProgram(const string& exe,
                          const std::vector<string>& args_vector) {
   int fds[2];
@@ -552,15 +615,19 @@ void SigPrintf(const char *format, ...) {
   }
 }
 
-static int setlk(int fd, struct flock *lock) {
+// If we're building with glibc <2.20, or another libc which predates OFD
+// locks, define the constants ourselves.  This assumes that the libc and
+// kernel definitions for struct flock are identical.
 #ifdef __linux__
-// If we're building with glibc <2.20, or another libc which predates
-// OFD locks, define the constant ourselves.  This assumes that the libc
-// and kernel definitions for struct flock are identical.
 #ifndef F_OFD_SETLK
 #define F_OFD_SETLK 37
 #endif
+#ifndef F_OFD_SETLKW
+#define F_OFD_SETLKW 38
+#endif
 #endif
+
+static int setlk(int fd, struct flock *lock) {
 #ifdef F_OFD_SETLK
   // Prefer OFD locks if available.  POSIX locks can be lost "accidentally"
   // due to any close() on the lock file, and are not reliably preserved
@@ -584,6 +651,119 @@ static int setlk(int fd, struct flock *lock) {
   return -1;
 }
 
+// Blocking counterpart of setlk(): waits until ``lock`` can be taken.
+static void setlkw(int fd, struct flock *lock) {
+#ifdef F_OFD_SETLKW
+  while (true) {
+    if (fcntl(fd, F_OFD_SETLKW, lock) == 0) return;
+    if (errno == EINVAL) break;  // Pre-3.15 kernel, see setlk().
+    if (errno != EINTR) {
+      pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+           "unexpected result from F_OFD_SETLKW");
+    }
+  }
+#endif
+  unsigned int seed = static_cast<unsigned int>(getpid());
+  while (fcntl(fd, F_SETLKW, lock) == -1) {
+    // EDEADLK is a false positive here: the kernel's deadlock detection for
+    // POSIX locks does not know that the other party is not waiting on us.
+    if (errno != EINTR && errno != EDEADLK) {
+      pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+           "unexpected result from F_SETLKW");
+    }
+    if (errno == EDEADLK) {
+      // Clients that see each other in a cycle would otherwise retry in a
+      // busy loop; a random delay also lets one of them get ahead.
+      TrySleep(10 + rand_r(&seed) % 90);
+    }
+  }
+}
+
+static void unlk(int fd, off_t start, off_t len) {
+  struct flock lock = {};
+  lock.l_type = F_UNLCK;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = start;
+  lock.l_len = len;
+  if (setlk(fd, &lock) == -1) {
+    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR, "cannot release lock");
+  }
+}
+
+// Clients waiting for the output base lock line up in a FIFO queue kept in
+// $OUTPUT_BASE/lock.queue, so that the lock is handed over in arrival order
+// instead of to whichever waiter the kernel happens to wake up first.
+//
+// The first 8 bytes of the queue file hold the next ticket number.  A client
+// draws a ticket, write-locks the slot byte belonging to that ticket and keeps
+// it until it owns the output base lock.  Before going for the output base
+// lock it waits for the slot of its predecessor to become free, i.e. for the
+// predecessor to either own the output base lock or die.  Everything is kept in
+// fcntl() locks, so a crashed client never wedges the queue.
+static const off_t kLockQueueTicketLength = 8;
+static const off_t kLockQueueSlotBase = 4096;
+static const uint64_t kLockQueueSlots = 1 << 20;
+
+static off_t LockQueueSlot(uint64_t ticket) {
+  return kLockQueueSlotBase + static_cast<off_t>(ticket % kLockQueueSlots);
+}
+
+// Enters the queue and blocks until all clients that entered it earlier have
+// gone through.  Returns the fd of the queue file, which holds the slot of the
+// caller until it is closed.
+static int WaitForLockQueueTurn(const string& output_base) {
+  string queuefile = blaze_util::JoinPath(output_base, "lock.queue");
+  int queuefd = open(queuefile.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+  if (queuefd < 0) {
+    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+         "cannot open lock queue file '%s' for writing", queuefile.c_str());
+  }
+
+  struct flock lock = {};
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = 0;
+  lock.l_len = kLockQueueTicketLength;
+  setlkw(queuefd, &lock);
+  uint64_t ticket = 0;
+  if (pread(queuefd, &ticket, sizeof(ticket), 0) != sizeof(ticket)) {
+    ticket = 0;  // Fresh (or truncated) queue file.
+  }
+  uint64_t next_ticket = ticket + 1;
+  if (pwrite(queuefd, &next_ticket, sizeof(next_ticket), 0) !=
+      sizeof(next_ticket)) {
+    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+         "cannot write lock queue file '%s'", queuefile.c_str());
+  }
+
+  // Claim our own slot before letting the next client draw its ticket, so that
+  // our successor always finds it taken.
+  lock.l_start = LockQueueSlot(ticket);
+  lock.l_len = 1;
+  setlkw(queuefd, &lock);
+  unlk(queuefd, 0, kLockQueueTicketLength);
+
+  if (ticket > 0) {
+    lock.l_type = F_RDLCK;
+    lock.l_start = LockQueueSlot(ticket - 1);
+    setlkw(queuefd, &lock);
+    unlk(queuefd, lock.l_start, 1);
+  }
+  return queuefd;
+}
+
+// Reads the owner description the current lock holder left in the lock file.
+static string ReadLockOwner(int lockfd) {
+  string buffer(4096, 0);
+  ssize_t r = pread(lockfd, &buffer[0], buffer.size(), 0);
+  if (r < 0) {
+    fprintf(stderr, "warning: pread() lock file: %s\n", strerror(errno));
+    r = 0;
+  }
+  buffer.resize(r);
+  return buffer;
+}
+
 uint64_t AcquireLock(const string& output_base, bool batch_mode, bool block,
                      BlazeLock* blaze_lock) {
   string lockfile = blaze_util::JoinPath(output_base, "lock");
@@ -610,52 +790,69 @@ uint64_t AcquireLock(const string& output_base, bool batch_mode, bool block,
   // later if that becomes meaningful.  (Ranges beyond EOF can be locked.)
   lock.l_len = 4096;
 
-  // Take the exclusive server lock.  If we fail, we busy-wait until the lock
-  // becomes available.
-  //
-  // We used to rely on fcntl(F_SETLKW) to lazy-wait for the lock to become
-  // available, which is theoretically fine, but doing so prevents us from
-  // determining if the PID of the server holding the lock has changed under the
-  // hood.  There have been multiple bug reports where users (especially macOS
-  // ones) mention that the Blaze invocation hangs on a non-existent PID.  This
-  // should help troubleshoot those scenarios in case there really is a bug
-  // somewhere.
-  bool multiple_attempts = false;
-  string owner;
   const uint64_t start_time = GetMillisecondsMonotonic();
-  while (setlk(lockfd, &lock) == -1) {
-    string buffer(4096, 0);
-    ssize_t r = pread(lockfd, &buffer[0], buffer.size(), 0);
-    if (r < 0) {
-      fprintf(stderr, "warning: pread() lock file: %s\n", strerror(errno));
-      r = 0;
-    }
-    buffer.resize(r);
-    if (owner != buffer) {
-      // Each time we learn a new lock owner, print it out.
-      owner = buffer;
+  bool multiple_attempts = false;
+  if (!block) {
+    if (setlk(lockfd, &lock) == -1) {
       fprintf(stderr, "Another command holds the client lock: \n%s\n",
-              owner.c_str());
-      if (block) {
+              ReadLockOwner(lockfd).c_str());
+      die(blaze_exit_code::BAD_ARGV,
+          "Exiting because the lock is held and --noblock_for_lock was given.");
+    }
+  } else {
+    // Take the exclusive server lock, waiting for our turn in the queue first.
+    //
+    // The blocking happens on a helper thread so that this thread can keep
+    // checking whether the owner recorded in the lock file changed while we
+    // wait.  There have been multiple bug reports where users (especially macOS
+    // ones) mention that the Blaze invocation hangs on a non-existent PID, and
+    // printing every new owner helps troubleshoot those scenarios.  Unlike the
+    // polling loop this replaces, the kernel wakes the helper up as soon as the
+    // lock is released.
+    std::mutex mutex;
+    std::condition_variable acquired_cv;
+    bool acquired = false;
+    std::thread waiter([&output_base, lockfd, &lock, &mutex, &acquired_cv,
+                        &acquired]() {
+      int queuefd = WaitForLockQueueTurn(output_base);
+      setlkw(lockfd, &lock);
+      // Leaving the queue lets our successor start waiting for us.
+      close(queuefd);
+      std::lock_guard<std::mutex> guard(mutex);
+      acquired = true;
+      acquired_cv.notify_one();
+    });
+
+    string owner;
+    std::unique_lock<std::mutex> guard(mutex);
+    // Give an uncontended lock a moment before reporting anything.
+    const std::chrono::milliseconds first_report_delay(50);
+    const std::chrono::milliseconds owner_poll_interval(500);
+    std::chrono::milliseconds timeout = first_report_delay;
+    while (!acquired_cv.wait_for(guard, timeout, [&acquired] {
+      return acquired;
+    })) {
+      timeout = owner_poll_interval;
+      multiple_attempts = true;
+      string buffer = ReadLockOwner(lockfd);
+      if (owner != buffer) {
+        // Each time we learn a new lock owner, print it out.
+        owner = buffer;
+        fprintf(stderr, "Another command holds the client lock: \n%s\n",
+                owner.c_str());
         fprintf(stderr, "Waiting for it to complete...\n");
         fflush(stderr);
       }
     }
-
-    if (!block) {
-      die(blaze_exit_code::BAD_ARGV,
-          "Exiting because the lock is held and --noblock_for_lock was given.");
-    }
-
-    TrySleep(500);
-    multiple_attempts = true;
+    guard.unlock();
+    waiter.join();
   }
   const uint64_t end_time = GetMillisecondsMonotonic();
 
-  // If we took the lock on the first try, force the reported wait time to 0 to
-  // avoid unnecessary noise in the logs.  In this metric, we are only
-  // interested in knowing how long it took for other commands to complete, not
-  // how fast acquiring a lock is.
+  // If we took the lock right away, force the reported wait time to 0 to avoid
+  // unnecessary noise in the logs.  In this metric, we are only interested in
+  // knowing how long it took for other commands to complete, not how fast
+  // acquiring a lock is.
   const uint64_t wait_time = !multiple_attempts ? 0 : end_time - start_time;
 
   // Identify ourselves in the lockfile.
@@ -389,8 +389,9 @@ string GetJvmVersion(const string& java_exe) {
       /* lpThreadAttributes */ NULL,
       /* bInheritHandles */ TRUE,
       /* dwCreationFlags */ 0,
-      /* lpEnvironment */ NULL,
-      /* lpCurrentDirectory */ NULL,
+      /* lpEnvironment */ env_block.empty() ? NULL : &env_block[0],
+      /* lpCurrentDirectory */
+      current_directory.empty() ? NULL : current_directory.c_str(),
       /* lpStartupInfo */ &startupInfo,
       /* lpProcessInformation */ &processInfo);
 
@@ -433,20 +434,14 @@ static bool GetProcessStartupTime(HANDLE process, uint64_t* result) {
   return true;
 }
 
-static void WriteProcessStartupTime(const string& server_dir, HANDLE process) {
+// Returns false if the start time could not be determined or written.
+static bool WriteProcessStartupTime(const string& server_dir, HANDLE process) {
   uint64_t start_time = 0;
   if (!GetProcessStartupTime(process, &start_time)) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "WriteProcessStartupTime(%s): GetProcessStartupTime",
-         server_dir.c_str());
+    return false;
   }
-
   string start_time_file = blaze_util::JoinPath(server_dir, "server.starttime");
-  if (!blaze_util::WriteFile(ToString(start_time), start_time_file)) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "WriteProcessStartupTime(%s): WriteFile(%s)", server_dir.c_str(),
-         start_time_file.c_str());
-  }
+  return blaze_util::WriteFile(ToString(start_time), start_time_file);
 }
 
 static HANDLE CreateJvmOutputFile(const wstring& path,
@@ -510,15 +505,17 @@ class ProcessHandleBlazeServerStartup : public BlazeServerStartup {
 };
 
 
-int ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
-                  const string& daemon_output, const bool daemon_out_append,
-                  const string& server_dir,
-                  BlazeServerStartup** server_startup) {
+int TryExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
+                     const std::vector<string>& extra_env,
+                     const string& working_dir, const string& daemon_output,
+                     const bool daemon_out_append, const string& server_dir,
+                     string* error, BlazeServerStartup** server_startup) {
   wstring wdaemon_output;
   if (!blaze_util::AsAbsoluteWindowsPath(daemon_output, &wdaemon_output)) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "ExecuteDaemon(%s): AsAbsoluteWindowsPath(%s)", exe.c_str(),
-         daemon_output.c_str());
+    blaze_util::StringPrintf(
+        error, "ExecuteDaemon(%s): AsAbsoluteWindowsPath(%s): %s", exe.c_str(),
+        daemon_output.c_str(), blaze_util::GetLastErrorString().c_str());
+    return -1;
   }
 
   SECURITY_ATTRIBUTES sa;
@@ -532,16 +529,19 @@ int ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
   AutoHandle devnull(::CreateFileA("NUL", GENERIC_READ, FILE_SHARE_READ, NULL,
                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
   if (!devnull.IsValid()) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "ExecuteDaemon(%s): CreateFileA(NUL)", exe.c_str());
+    blaze_util::StringPrintf(error, "ExecuteDaemon(%s): CreateFileA(NUL): %s",
+                             exe.c_str(),
+                             blaze_util::GetLastErrorString().c_str());
+    return -1;
   }
 
   AutoHandle stdout_file(CreateJvmOutputFile(wdaemon_output.c_str(), &sa,
                                              daemon_out_append));
   if (!stdout_file.IsValid()) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "ExecuteDaemon(%s): CreateJvmOutputFile(%ls)", exe.c_str(),
-         wdaemon_output.c_str());
+    blaze_util::StringPrintf(
+        error, "ExecuteDaemon(%s): CreateJvmOutputFile(%ls): %s", exe.c_str(),
+        wdaemon_output.c_str(), blaze_util::GetLastErrorString().c_str());
+    return -1;
   }
   HANDLE stderr_handle;
   // We must duplicate the handle to stdout, otherwise "bazel clean --expunge"
@@ -556,9 +556,10 @@ int ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
           /* dwDesiredAccess */ 0,
           /* bInheritHandle */ TRUE,
           /* dwOptions */ DUPLICATE_SAME_ACCESS)) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "ExecuteDaemon(%s): DuplicateHandle(%ls)", exe.c_str(),
-         wdaemon_output.c_str());
+    blaze_util::StringPrintf(
+        error, "ExecuteDaemon(%s): DuplicateHandle(%ls): %s", exe.c_str(),
+        wdaemon_output.c_str(), blaze_util::GetLastErrorString().c_str());
+    return -1;
   }
   AutoHandle stderr_file(stderr_handle);
 
@@ -569,8 +570,10 @@ int ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
   if (!UpdateProcThreadAttribute(
           lpAttributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
           handlesToInherit, 2 * sizeof(HANDLE), NULL, NULL)) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "ExecuteDaemon(%s): UpdateProcThreadAttribute", exe.c_str());
+    blaze_util::StringPrintf(
+        error, "ExecuteDaemon(%s): UpdateProcThreadAttribute: %s", exe.c_str(),
+        blaze_util::GetLastErrorString().c_str());
+    return -1;
   }
 
   PROCESS_INFORMATION processInfo = {0};
@@ -586,6 +589,29 @@ int ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
   CmdLine cmdline;
   CreateCommandLine(&cmdline, exe, args_vector);
 
+  // The daemon gets a copy of our environment block with extra_env appended,
+  // so that our own environment stays as it is.
+  string env_block;
+  if (!extra_env.empty()) {
+    char* env = GetEnvironmentStringsA();
+    if (env == NULL) {
+      blaze_util::StringPrintf(
+          error, "ExecuteDaemon(%s): GetEnvironmentStringsA: %s", exe.c_str(),
+          blaze_util::GetLastErrorString().c_str());
+      return -1;
+    }
+    for (const char* var = env; *var != '\0'; var += strlen(var) + 1) {
+      env_block.append(var, strlen(var) + 1);
+    }
+    FreeEnvironmentStringsA(env);
+    for (const string& var : extra_env) {
+      env_block.append(var.c_str(), var.size() + 1);
+    }
+    env_block.push_back('\0');
+  }
+  string current_directory =
+      working_dir.empty() ? string() : ConvertPath(working_dir);
+
   BOOL ok = CreateProcessA(
       /* lpApplicationName */ NULL,
       /* lpCommandLine */ cmdline.cmdline,
@@ -600,11 +626,22 @@ int ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
       /* lpProcessInformation */ &processInfo);
 
   if (!ok) {
-    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-         "ExecuteDaemon(%s): CreateProcess(%s)", exe.c_str(), cmdline.cmdline);
+    blaze_util::StringPrintf(error, "ExecuteDaemon(%s): CreateProcess(%s): %s",
+                             exe.c_str(), cmdline.cmdline,
+                             blaze_util::GetLastErrorString().c_str());
+    return -1;
   }
 
-  WriteProcessStartupTime(server_dir, processInfo.hProcess);
+  if (!WriteProcessStartupTime(server_dir, processInfo.hProcess)) {
+    blaze_util::StringPrintf(
+        error, "ExecuteDaemon(%s): cannot write the start time to %s: %s",
+        exe.c_str(), server_dir.c_str(),
+        blaze_util::GetLastErrorString().c_str());
+    TerminateProcess(processInfo.hProcess, 1);
+    CloseHandle(processInfo.hProcess);
+    CloseHandle(processInfo.hThread);
+    return -1;
+  }
 
   // Pass ownership of processInfo.hProcess
   *server_startup = new ProcessHandleBlazeServerStartup(processInfo.hProcess);
@@ -623,6 +660,20 @@ int ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
   return processInfo.dwProcessId;
 }
 
+int ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
+                  const string& daemon_output, const bool daemon_out_append,
+                  const string& server_dir,
+                  BlazeServerStartup** server_startup) {
+  string error;
+  int pid = TryExecuteDaemon(exe, args_vector, {}, "", daemon_output,
+                             daemon_out_append, server_dir, &error,
+                             server_startup);
+  if (pid < 0) {
+    die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR, "%s", error.c_str());
+  }
+  return pid;
+}
+
 // Returns whether nested jobs are not available on the current system.
 static bool NestedJobsSupported() {
   // Nested jobs are supported from Windows 8
@@ -100,6 +100,10 @@ struct GlobalVariables {
   // The reason for the server restart.
   RestartReason restart_reason;
 
+  // The command line of the server that was killed because it had different
+  // startup options, if any.
+  std::vector<std::string> replaced_server_args;
+
   // The absolute path of the blaze binary.
   std::string binary_path;
 
@@ -28,6 +28,7 @@
 #include "src/main/cpp/util/file.h"
 #include "src/main/cpp/util/logging.h"
 #include "src/main/cpp/util/strings.h"
+#include "src/main/cpp/util/trace.h"
 #include "src/main/cpp/workspace_layout.h"
 
 // On OSX, there apparently is no header that defines this.
@@ -210,6 +211,44 @@ blaze_exit_code::ExitCode ParseErrorToExitCode(RcFile::ParseError parse_error) {
 
 }  // namespace internal
 
+// Parses the rc file at `path`. If `cache_dir` is not empty, the result is
+// looked up in and stored into a cache there; a cached result is reused as long
+// as none of the files it was parsed from changed.
+static std::unique_ptr<RcFile> ParseRcFileWithCache(
+    const string& cache_dir, const string& path,
+    const WorkspaceLayout* workspace_layout, const string& workspace,
+    RcFile::ParseError* parse_error, string* error) {
+  string cache_file;
+  if (!cache_dir.empty()) {
+    // The workspace is part of the key because %workspace% imports depend on
+    // it.
+    cache_file = GetHashedBaseDir(cache_dir, workspace + '\0' + path);
+    string data;
+    if (blaze_util::ReadFile(cache_file, &data)) {
+      std::unique_ptr<RcFile> rcfile =
+          RcFile::Deserialize(data, path, workspace_layout, workspace);
+      if (rcfile != nullptr) {
+        BAZEL_LOG(INFO) << "Using cached RcFile " << path;
+        *parse_error = RcFile::ParseError::NONE;
+        return rcfile;
+      }
+    }
+  }
+
+  std::unique_ptr<RcFile> rcfile =
+      RcFile::Parse(path, workspace_layout, workspace, parse_error, error);
+  string data;
+  if (rcfile != nullptr && !cache_file.empty() && rcfile->Serialize(&data)) {
+    // A failure to write the cache only costs a reparse next time.
+    if (!blaze_util::MakeDirectories(cache_dir, 0755) ||
+        !blaze_util::WriteFile(data, cache_file, 0644)) {
+      BAZEL_LOG(WARNING) << "Failed to cache RcFile " << path << " in "
+                         << cache_file;
+    }
+  }
+  return rcfile;
+}
+
 // Parses the arguments provided in args using the workspace path and the
 // current working directory (cwd) and stores the results.
 blaze_exit_code::ExitCode OptionProcessor::ParseOptions(
@@ -257,11 +296,28 @@ blaze_exit_code::ExitCode OptionProcessor::ParseOptions(
   // (e.g. user rc coming from process substitution).
   deduped_blazerc_paths.push_back(user_blazerc_path);
 
+  // Parsed rc files are cached under the output user root instead of the
+  // output base because the rc files themselves may change the output base.
+  // Likewise, only an --output_user_root from the command line is honored.
+  string rc_file_cache_dir;
+  if (SearchNullaryOption(cmd_line_->startup_args, "experimental_rc_file_cache",
+                          false)) {
+    const char* output_user_root =
+        SearchUnaryOption(cmd_line_->startup_args, "--output_user_root");
+    rc_file_cache_dir = blaze_util::JoinPath(
+        output_user_root != NULL ? MakeAbsolute(output_user_root)
+                                 : parsed_startup_options_->output_user_root,
+        "rc_cache");
+  }
+
   for (const auto& blazerc_path : deduped_blazerc_paths) {
     if (!blazerc_path.empty()) {
+      blaze_util::ScopedTraceSpan span("Parse rc file " + blazerc_path);
       RcFile::ParseError parse_error;
-      auto rcfile = RcFile::Parse(blazerc_path, workspace_layout_, workspace,
-                                  &parse_error, error);
+      auto rcfile =
+          ParseRcFileWithCache(rc_file_cache_dir, blazerc_path,
+                               workspace_layout_, workspace, &parse_error,
+                               error);
       if (rcfile == nullptr) {
         return internal::ParseErrorToExitCode(parse_error);
       }
@@ -269,6 +325,7 @@ blaze_exit_code::ExitCode OptionProcessor::ParseOptions(
     }
   }
 
+  blaze_util::ScopedTraceSpan span("Process startup options");
   blaze_exit_code::ExitCode parse_startup_options_exit_code =
       ParseStartupOptions(error);
   if (parse_startup_options_exit_code != blaze_exit_code::SUCCESS) {
@@ -14,6 +14,8 @@
 
 #include "src/main/cpp/rc_file.h"
 
+#include <string.h>  // memcpy
+
 #include <algorithm>
 #include <utility>
 
@@ -34,7 +36,8 @@ RcFile::RcFile(string filename, const WorkspaceLayout* workspace_layout,
                string workspace)
     : filename_(std::move(filename)),
       workspace_layout_(workspace_layout),
-      workspace_(std::move(workspace)) {}
+      workspace_(std::move(workspace)),
+      cacheable_(true) {}
 
 /*static*/ std::unique_ptr<RcFile> RcFile::Parse(
     std::string filename, const WorkspaceLayout* workspace_layout,
@@ -51,6 +54,13 @@ RcFile::ParseError RcFile::ParseFile(const string& filename,
                                      deque<string>* import_stack,
                                      string* error_text) {
   BAZEL_LOG(INFO) << "Parsing the RcFile " << filename;
+  // Stamp the file before reading it, so that a concurrent modification is
+  // never attributed to the old contents.
+  blaze_util::FileStamp stamp = {};
+  if (!blaze_util::IsAbsolute(filename) ||
+      !blaze_util::StatFile(filename, &stamp)) {
+    cacheable_ = false;
+  }
   string contents;
   if (!blaze_util::ReadFile(filename, &contents)) {
     blaze_util::StringPrintf(error_text,
@@ -59,6 +69,7 @@ RcFile::ParseError RcFile::ParseFile(const string& filename,
   }
 
   rcfile_paths_.push_back(filename);
+  rcfile_stamps_.push_back(stamp);
   // Keep a pointer to the filename string in rcfile_paths_ for the RcOptions.
   string* filename_ptr = &rcfile_paths_.back();
 
@@ -134,4 +145,148 @@ RcFile::ParseError RcFile::ParseFile(const string& filename,
   return ParseError::NONE;
 }
 
+// Serialized rc files are only ever read back by the same client binary on the
+// same machine, so integers are written in native byte order.
+static const char kSerializedMagic[] = "rcfile-v1";
+
+static void AppendInt(int64_t value, string* data) {
+  data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void AppendString(const string& value, string* data) {
+  AppendInt(value.size(), data);
+  data->append(value);
+}
+
+namespace {
+
+// Reads back the values written by AppendInt and AppendString. Reads fail
+// instead of going past the end of the data.
+class SerializedReader {
+ public:
+  explicit SerializedReader(const string& data) : data_(data), pos_(0) {}
+
+  bool ReadInt(int64_t* value) {
+    if (data_.size() - pos_ < sizeof(*value)) {
+      return false;
+    }
+    memcpy(value, data_.data() + pos_, sizeof(*value));
+    pos_ += sizeof(*value);
+    return true;
+  }
+
+  bool ReadString(string* value) {
+    int64_t size;
+    if (!ReadInt(&size) || size < 0 ||
+        static_cast<uint64_t>(size) > data_.size() - pos_) {
+      return false;
+    }
+    value->assign(data_, pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  bool AtEnd() const { return pos_ == data_.size(); }
+
+ private:
+  const string& data_;
+  size_t pos_;
+};
+
+}  // namespace
+
+bool RcFile::Serialize(string* data) const {
+  if (!cacheable_) {
+    return false;
+  }
+  data->clear();
+  AppendString(kSerializedMagic, data);
+  AppendString(filename_, data);
+  AppendString(workspace_, data);
+  AppendInt(rcfile_paths_.size(), data);
+  for (size_t i = 0; i < rcfile_paths_.size(); i++) {
+    AppendString(rcfile_paths_[i], data);
+    AppendInt(rcfile_stamps_[i].size, data);
+    AppendInt(rcfile_stamps_[i].mtime_ns, data);
+    AppendInt(rcfile_stamps_[i].ctime_ns, data);
+  }
+  AppendInt(options_.size(), data);
+  for (const auto& command_options : options_) {
+    AppendString(command_options.first, data);
+    AppendInt(command_options.second.size(), data);
+    for (const RcOption& option : command_options.second) {
+      // Store the source as an index into rcfile_paths_.
+      int64_t source = 0;
+      while (&rcfile_paths_[source] != option.source_path) {
+        source++;
+      }
+      AppendInt(source, data);
+      AppendString(option.option, data);
+    }
+  }
+  return true;
+}
+
+/*static*/ std::unique_ptr<RcFile> RcFile::Deserialize(
+    const string& data, string filename,
+    const WorkspaceLayout* workspace_layout, string workspace) {
+  std::unique_ptr<RcFile> rcfile(new RcFile(
+      std::move(filename), workspace_layout, std::move(workspace)));
+  SerializedReader reader(data);
+  string magic, serialized_filename, serialized_workspace;
+  if (!reader.ReadString(&magic) || magic != kSerializedMagic ||
+      !reader.ReadString(&serialized_filename) ||
+      serialized_filename != rcfile->filename_ ||
+      !reader.ReadString(&serialized_workspace) ||
+      serialized_workspace != rcfile->workspace_) {
+    return nullptr;
+  }
+
+  int64_t num_sources;
+  if (!reader.ReadInt(&num_sources) || num_sources <= 0) {
+    return nullptr;
+  }
+  for (int64_t i = 0; i < num_sources; i++) {
+    string path;
+    blaze_util::FileStamp stamp;
+    if (!reader.ReadString(&path) || !reader.ReadInt(&stamp.size) ||
+        !reader.ReadInt(&stamp.mtime_ns) || !reader.ReadInt(&stamp.ctime_ns)) {
+      return nullptr;
+    }
+    // This is the only place that touches the sources themselves.
+    blaze_util::FileStamp current;
+    if (!blaze_util::StatFile(path, &current) || current != stamp) {
+      BAZEL_LOG(INFO) << "Cached RcFile " << rcfile->filename_
+                      << " is out of date because " << path << " changed";
+      return nullptr;
+    }
+    rcfile->rcfile_paths_.push_back(std::move(path));
+    rcfile->rcfile_stamps_.push_back(stamp);
+  }
+
+  int64_t num_commands;
+  if (!reader.ReadInt(&num_commands) || num_commands < 0) {
+    return nullptr;
+  }
+  for (int64_t i = 0; i < num_commands; i++) {
+    string command;
+    int64_t num_options;
+    if (!reader.ReadString(&command) || !reader.ReadInt(&num_options) ||
+        num_options < 0) {
+      return nullptr;
+    }
+    std::vector<RcOption>& options = rcfile->options_[command];
+    for (int64_t j = 0; j < num_options; j++) {
+      int64_t source;
+      string option;
+      if (!reader.ReadInt(&source) || source < 0 || source >= num_sources ||
+          !reader.ReadString(&option)) {
+        return nullptr;
+      }
+      options.push_back({&rcfile->rcfile_paths_[source], std::move(option)});
+    }
+  }
+  return reader.AtEnd() ? std::move(rcfile) : nullptr;
+}
+
 }  // namespace blaze
@@ -20,6 +20,7 @@
 #include <string>
 #include <vector>
 
+#include "src/main/cpp/util/file_platform.h"
 #include "src/main/cpp/workspace_layout.h"
 
 namespace blaze {
@@ -48,6 +49,19 @@ class RcFile {
   using OptionMap = std::unordered_map<std::string, std::vector<RcOption>>;
   const OptionMap& options() const { return options_; }
 
+  // Serializes the parsed options together with the stamps of all sources into
+  // `data`, so that Deserialize() can recreate this object without reading the
+  // sources again. Returns false if some source cannot be stamped (e.g. it is
+  // a pipe or a relative path), in which case the file must not be cached.
+  bool Serialize(std::string* data) const;
+
+  // Recreates a parsed rc file from the output of Serialize(). Returns nullptr
+  // if `data` is malformed, was produced for a different file or workspace, or
+  // if any of the sources changed since it was produced.
+  static std::unique_ptr<RcFile> Deserialize(
+      const std::string& data, std::string filename,
+      const WorkspaceLayout* workspace_layout, std::string workspace);
+
  private:
   RcFile(std::string filename, const WorkspaceLayout* workspace_layout,
          std::string workspace);
@@ -71,6 +85,10 @@ class RcFile {
   // The RcOption structs point to the strings in here so they need to be stored
   // in a container that offers stable pointers, like a deque (and not vector).
   std::deque<std::string> rcfile_paths_;
+  // Stamps of the files in rcfile_paths_ taken before reading them, in the same
+  // order. False in `cacheable_` means that some file could not be stamped.
+  std::vector<blaze_util::FileStamp> rcfile_stamps_;
+  bool cacheable_;
   // All options parsed from the file.
   OptionMap options_;
 };
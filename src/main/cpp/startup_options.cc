@@ -89,6 +89,7 @@ StartupOptions::StartupOptions(const string &product_name,
       connect_timeout_secs(30),
       invocation_policy(NULL),
       client_debug(false),
+      standby_server(false),
       java_logging_formatter(
           "com.google.devtools.build.lib.util.SingleLineFormatter"),
       expand_configs_in_place(true),
@@ -129,6 +130,8 @@ StartupOptions::StartupOptions(const string &product_name,
   RegisterNullaryStartupFlag("client_debug");
   RegisterNullaryStartupFlag("deep_execroot");
   RegisterNullaryStartupFlag("experimental_oom_more_eagerly");
+  RegisterNullaryStartupFlag("experimental_rc_file_cache");
+  RegisterNullaryStartupFlag("experimental_standby_server");
   RegisterNullaryStartupFlag("fatal_event_bus_exceptions");
   RegisterNullaryStartupFlag("host_jvm_debug");
   RegisterNullaryStartupFlag("master_bazelrc");
@@ -140,6 +143,7 @@ StartupOptions::StartupOptions(const string &product_name,
   RegisterUnaryStartupFlag("blazerc");
   RegisterUnaryStartupFlag("command_port");
   RegisterUnaryStartupFlag("connect_timeout_secs");
+  RegisterUnaryStartupFlag("experimental_client_trace_file");
   RegisterUnaryStartupFlag("experimental_oom_more_eagerly_threshold");
   RegisterUnaryStartupFlag("host_javabase");
   RegisterUnaryStartupFlag("host_jvm_args");
@@ -206,6 +210,11 @@ blaze_exit_code::ExitCode StartupOptions::ProcessArg(
                                      "--server_jvm_out")) != NULL) {
     server_jvm_out = MakeAbsolute(value);
     option_sources["server_jvm_out"] = rcfile;
+  } else if ((value = GetUnaryOption(arg, next_arg,
+                                     "--experimental_client_trace_file")) !=
+             NULL) {
+    client_trace_file = MakeAbsolute(value);
+    option_sources["experimental_client_trace_file"] = rcfile;
   } else if (GetNullaryOption(arg, "--deep_execroot")) {
     deep_execroot = true;
     option_sources["deep_execroot"] = rcfile;
@@ -256,6 +265,14 @@ blaze_exit_code::ExitCode StartupOptions::ProcessArg(
       return blaze_exit_code::BAD_ARGV;
     }
     option_sources["blazerc"] = rcfile;
+  } else if (GetNullaryOption(arg, "--noexperimental_rc_file_cache") ||
+             GetNullaryOption(arg, "--experimental_rc_file_cache")) {
+    if (!rcfile.empty()) {
+      *error = "Can't specify --[no]experimental_rc_file_cache in .bazelrc "
+               "file.";
+      return blaze_exit_code::BAD_ARGV;
+    }
+    option_sources["experimental_rc_file_cache"] = rcfile;
   } else if (GetNullaryOption(arg, "--batch")) {
     batch = true;
     option_sources["batch"] = rcfile;
@@ -299,6 +316,12 @@ blaze_exit_code::ExitCode StartupOptions::ProcessArg(
       return blaze_exit_code::BAD_ARGV;
     }
     option_sources["max_idle_secs"] = rcfile;
+  } else if (GetNullaryOption(arg, "--experimental_standby_server")) {
+    standby_server = true;
+    option_sources["experimental_standby_server"] = rcfile;
+  } else if (GetNullaryOption(arg, "--noexperimental_standby_server")) {
+    standby_server = false;
+    option_sources["experimental_standby_server"] = rcfile;
   } else if (GetNullaryOption(arg, "--experimental_oom_more_eagerly")) {
     oom_more_eagerly = true;
     option_sources["experimental_oom_more_eagerly"] = rcfile;
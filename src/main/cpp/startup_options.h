@@ -283,6 +283,13 @@ class StartupOptions {
   // Whether to output addition debugging information in the client.
   bool client_debug;
 
+  // If supplied, the client writes a trace of its own startup to this file.
+  std::string client_trace_file;
+
+  // If true, the client keeps a second, idle server process per output base
+  // that takes over when the running server has to be (re)started.
+  bool standby_server;
+
   // Value of the java.util.logging.FileHandler.formatter Java property.
   std::string java_logging_formatter;
 
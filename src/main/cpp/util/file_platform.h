@@ -164,6 +164,27 @@ bool CanAccessDirectory(const std::string &path);
 
 bool IsDevNull(const char *path);
 
+// Metadata that changes whenever the contents of a file change, so that a
+// result derived from the file can be reused as long as it stays the same.
+struct FileStamp {
+  int64_t size;
+  // Last modification and status change times, in nanoseconds since the epoch.
+  // On Windows the creation time takes the place of the status change time.
+  int64_t mtime_ns;
+  int64_t ctime_ns;
+
+  bool operator==(const FileStamp &other) const {
+    return size == other.size && mtime_ns == other.mtime_ns &&
+           ctime_ns == other.ctime_ns;
+  }
+  bool operator!=(const FileStamp &other) const { return !(*this == other); }
+};
+
+// Returns true and fills `stamp` if `path` is a regular file or a symlink to
+// one. Returns false otherwise, e.g. for pipes like /dev/fd/N.
+// Follows symlinks.
+bool StatFile(const std::string &path, FileStamp *stamp);
+
 // Returns true if `path` refers to a directory or a symlink/junction to one.
 bool IsDirectory(const std::string& path);
 
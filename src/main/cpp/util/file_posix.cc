@@ -301,6 +301,26 @@ bool IsDevNull(const char *path) {
   return path != NULL && *path != 0 && strncmp("/dev/null\0", path, 10) == 0;
 }
 
+bool StatFile(const std::string &path, FileStamp *stamp) {
+  struct stat buf;
+  if (stat(path.c_str(), &buf) != 0 || !S_ISREG(buf.st_mode)) {
+    return false;
+  }
+  stamp->size = buf.st_size;
+#if defined(__APPLE__)
+  stamp->mtime_ns = static_cast<int64_t>(buf.st_mtimespec.tv_sec) * 1000000000 +
+                    buf.st_mtimespec.tv_nsec;
+  stamp->ctime_ns = static_cast<int64_t>(buf.st_ctimespec.tv_sec) * 1000000000 +
+                    buf.st_ctimespec.tv_nsec;
+#else
+  stamp->mtime_ns =
+      static_cast<int64_t>(buf.st_mtim.tv_sec) * 1000000000 + buf.st_mtim.tv_nsec;
+  stamp->ctime_ns =
+      static_cast<int64_t>(buf.st_ctim.tv_sec) * 1000000000 + buf.st_ctim.tv_nsec;
+#endif
+  return true;
+}
+
 bool CanReadFile(const std::string &path) {
   return !IsDirectory(path) && CanAccess(path, true, false, false);
 }
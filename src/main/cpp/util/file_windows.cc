@@ -1049,6 +1049,43 @@ static bool CanReadFileW(const wstring& path) {
   return handle.IsValid();
 }
 
+static int64_t FileTimeToNanos(const FILETIME& time) {
+  // FILETIME counts 100 nanosecond intervals; the epoch doesn't matter here
+  // because stamps are only ever compared with each other.
+  return ((static_cast<int64_t>(time.dwHighDateTime) << 32) |
+          time.dwLowDateTime) *
+         100;
+}
+
+bool StatFile(const std::string& path, FileStamp* stamp) {
+  wstring wpath;
+  if (!AsAbsoluteWindowsPath(path, &wpath)) {
+    pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+         "StatFile(%s): AsAbsoluteWindowsPath", path.c_str());
+    return false;
+  }
+  // Open the file (following symlinks) to read its metadata.
+  AutoHandle handle(::CreateFileW(
+      /* lpFileName */ wpath.c_str(),
+      /* dwDesiredAccess */ 0,
+      /* dwShareMode */ FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      /* lpSecurityAttributes */ NULL,
+      /* dwCreationDisposition */ OPEN_EXISTING,
+      /* dwFlagsAndAttributes */ FILE_ATTRIBUTE_NORMAL,
+      /* hTemplateFile */ NULL));
+  BY_HANDLE_FILE_INFORMATION info;
+  if (!handle.IsValid() ||
+      !::GetFileInformationByHandle(handle, &info) ||
+      (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+    return false;
+  }
+  stamp->size = (static_cast<int64_t>(info.nFileSizeHigh) << 32) |
+                info.nFileSizeLow;
+  stamp->mtime_ns = FileTimeToNanos(info.ftLastWriteTime);
+  stamp->ctime_ns = FileTimeToNanos(info.ftCreationTime);
+  return true;
+}
+
 bool CanReadFile(const std::string& path) {
   wstring wpath;
   if (!AsAbsoluteWindowsPath(path, &wpath)) {
@@ -0,0 +1,170 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/cpp/util/sha1.h"
+
+#include <string.h>  // for memcpy
+
+namespace blaze_util {
+
+using std::string;
+
+static const unsigned int k8Bytes = 64;
+
+static inline uint32_t RotateLeft(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t LoadBigEndian32(const unsigned char* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static inline void StoreBigEndian32(uint32_t x, unsigned char* p) {
+  p[0] = static_cast<unsigned char>(x >> 24);
+  p[1] = static_cast<unsigned char>(x >> 16);
+  p[2] = static_cast<unsigned char>(x >> 8);
+  p[3] = static_cast<unsigned char>(x);
+}
+
+Sha1Digest::Sha1Digest() {
+  Reset();
+}
+
+Sha1Digest::Sha1Digest(const Sha1Digest& original) {
+  memcpy(state, original.state, sizeof(original.state));
+  count = original.count;
+  memcpy(ctx_buffer, original.ctx_buffer, original.ctx_buffer_len);
+  ctx_buffer_len = original.ctx_buffer_len;
+}
+
+void Sha1Digest::Reset() {
+  count = 0;
+  ctx_buffer_len = 0;
+  state[0] = 0x67452301;
+  state[1] = 0xefcdab89;
+  state[2] = 0x98badcfe;
+  state[3] = 0x10325476;
+  state[4] = 0xc3d2e1f0;
+}
+
+void Sha1Digest::Update(const void *buf, unsigned int length) {
+  const unsigned char *input = reinterpret_cast<const unsigned char*>(buf);
+
+  if (ctx_buffer_len != 0) {
+    unsigned int buffer_space_len = k8Bytes - ctx_buffer_len;
+    if (length < buffer_space_len) {
+      memcpy(ctx_buffer + ctx_buffer_len, input, length);
+      ctx_buffer_len += length;
+      return;
+    }
+    memcpy(ctx_buffer + ctx_buffer_len, input, buffer_space_len);
+    Transform(ctx_buffer, 1);
+    input += buffer_space_len;
+    length -= buffer_space_len;
+    ctx_buffer_len = 0;
+  }
+
+  // Transform reads the input byte by byte, so whole blocks need not be
+  // copied.
+  if (length >= k8Bytes) {
+    Transform(input, length / k8Bytes);
+    input += length - length % k8Bytes;
+    length %= k8Bytes;
+  }
+
+  memcpy(ctx_buffer, input, length);
+  ctx_buffer_len = length;
+}
+
+void Sha1Digest::Finish(unsigned char digest[20]) {
+  uint64_t bits = (count + ctx_buffer_len) << 3;
+
+  // Append the 0x80 terminator, pad with zeros and put the 64-bit message
+  // length in *bits*, big-endian, at the end of the last block.
+  unsigned int size = (ctx_buffer_len < 56 ? 64 : 128);
+  unsigned char padding[128];
+  memcpy(padding, ctx_buffer, ctx_buffer_len);
+  padding[ctx_buffer_len] = 0x80;
+  memset(padding + ctx_buffer_len + 1, 0, size - 8 - ctx_buffer_len - 1);
+  StoreBigEndian32(static_cast<uint32_t>(bits >> 32), padding + size - 8);
+  StoreBigEndian32(static_cast<uint32_t>(bits), padding + size - 4);
+  Transform(padding, size / k8Bytes);
+  ctx_buffer_len = 0;
+
+  for (int i = 0; i < 5; ++i) {
+    StoreBigEndian32(state[i], digest + 4 * i);
+  }
+}
+
+string Sha1Digest::String() const {
+  static const char hex_char[] = "0123456789abcdef";
+  string result;
+  result.reserve(2 * kDigestLength);
+  for (int i = 0; i < 5; ++i) {
+    for (int shift = 28; shift >= 0; shift -= 4) {
+      result.push_back(hex_char[(state[i] >> shift) & 0xf]);
+    }
+  }
+  return result;
+}
+
+void Sha1Digest::Transform(const unsigned char* data, size_t blocks) {
+  count += blocks * k8Bytes;
+  uint32_t w[80];
+  for (; blocks > 0; --blocks, data += k8Bytes) {
+    for (int i = 0; i < 16; ++i) {
+      w[i] = LoadBigEndian32(data + 4 * i);
+    }
+    for (int i = 16; i < 80; ++i) {
+      w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    for (int i = 0; i < 80; ++i) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = d ^ (b & (c ^ d));
+        k = 0x5a827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1;
+      } else if (i < 60) {
+        f = (b & c) | (d & (b | c));
+        k = 0x8f1bbcdc;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6;
+      }
+      uint32_t t = RotateLeft(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = RotateLeft(b, 30);
+      b = a;
+      a = t;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+  }
+}
+
+}  // namespace blaze_util
@@ -0,0 +1,286 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/cpp/util/sha256.h"
+
+#include <string.h>  // for memcpy
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define BLAZE_SHA256_X86_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace blaze_util {
+
+using std::string;
+
+static const unsigned int k8Bytes = 64;
+
+static const uint32_t kRoundConstants[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t RotateRight(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t LoadBigEndian32(const unsigned char* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static inline void StoreBigEndian32(uint32_t x, unsigned char* p) {
+  p[0] = static_cast<unsigned char>(x >> 24);
+  p[1] = static_cast<unsigned char>(x >> 16);
+  p[2] = static_cast<unsigned char>(x >> 8);
+  p[3] = static_cast<unsigned char>(x);
+}
+
+static void TransformPortable(uint32_t state[8], const unsigned char* data,
+                              size_t blocks) {
+  uint32_t w[64];
+  for (; blocks > 0; --blocks, data += k8Bytes) {
+    for (int i = 0; i < 16; ++i) {
+      w[i] = LoadBigEndian32(data + 4 * i);
+    }
+    for (int i = 16; i < 64; ++i) {
+      uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^
+                    (w[i - 15] >> 3);
+      uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^
+                    (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    uint32_t f = state[5];
+    uint32_t g = state[6];
+    uint32_t h = state[7];
+    for (int i = 0; i < 64; ++i) {
+      uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+      uint32_t ch = g ^ (e & (f ^ g));
+      uint32_t t1 = h + s1 + ch + kRoundConstants[i] + w[i];
+      uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+      uint32_t maj = (a & b) | (c & (a | b));
+      uint32_t t2 = s0 + maj;
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#ifdef BLAZE_SHA256_X86_SHA_NI
+
+// The SHA-NI instructions keep the state as the two vectors ABEF and CDGH,
+// and each _mm_sha256rnds2_epu32 performs two rounds.
+__attribute__((target("sha,sse4.1,ssse3")))
+static void TransformShaNi(uint32_t state[8], const unsigned char* data,
+                           size_t blocks) {
+  const __m128i kByteSwap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+  __m128i state1 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);                // CDAB
+  state1 = _mm_shuffle_epi32(state1, 0x1B);          // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);       // CDGH
+
+  for (; blocks > 0; --blocks, data += k8Bytes) {
+    __m128i abef_save = state0;
+    __m128i cdgh_save = state1;
+    // msg[i % 4] holds the message schedule words 4i .. 4i+3.
+    __m128i msg[4];
+    for (int i = 0; i < 16; ++i) {
+      if (i < 4) {
+        msg[i] = _mm_shuffle_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)),
+            kByteSwap);
+      } else {
+        __m128i w = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+        w = _mm_add_epi32(
+            w, _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+        msg[i & 3] = _mm_sha256msg2_epu32(w, msg[(i + 3) & 3]);
+      }
+      __m128i k = _mm_add_epi32(
+          msg[i & 3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                          &kRoundConstants[4 * i])));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, k);
+      k = _mm_shuffle_epi32(k, 0x0E);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, k);
+    }
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1B);        // FEBA
+  state1 = _mm_shuffle_epi32(state1, 0xB1);     // DCHG
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);  // DCBA
+  state1 = _mm_alignr_epi8(state1, tmp, 8);     // HGFE
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+static bool DetectShaNi() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  bool has_ssse3 = (ecx & (1 << 9)) != 0;
+  bool has_sse41 = (ecx & (1 << 19)) != 0;
+  if (!has_ssse3 || !has_sse41 || __get_cpuid_max(0, NULL) < 7) {
+    return false;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return (ebx & (1 << 29)) != 0;
+}
+
+#endif  // BLAZE_SHA256_X86_SHA_NI
+
+bool Sha256Digest::HasHardwareSupport() {
+#ifdef BLAZE_SHA256_X86_SHA_NI
+  static const bool has_sha_ni = DetectShaNi();
+  return has_sha_ni;
+#else
+  return false;
+#endif
+}
+
+Sha256Digest::Sha256Digest() {
+  Reset();
+}
+
+Sha256Digest::Sha256Digest(const Sha256Digest& original) {
+  memcpy(state, original.state, sizeof(original.state));
+  count = original.count;
+  memcpy(ctx_buffer, original.ctx_buffer, original.ctx_buffer_len);
+  ctx_buffer_len = original.ctx_buffer_len;
+}
+
+void Sha256Digest::Reset() {
+  count = 0;
+  ctx_buffer_len = 0;
+  state[0] = 0x6a09e667;
+  state[1] = 0xbb67ae85;
+  state[2] = 0x3c6ef372;
+  state[3] = 0xa54ff53a;
+  state[4] = 0x510e527f;
+  state[5] = 0x9b05688c;
+  state[6] = 0x1f83d9ab;
+  state[7] = 0x5be0cd19;
+}
+
+void Sha256Digest::Update(const void *buf, unsigned int length) {
+  const unsigned char *input = reinterpret_cast<const unsigned char*>(buf);
+
+  if (ctx_buffer_len != 0) {
+    unsigned int buffer_space_len = k8Bytes - ctx_buffer_len;
+    if (length < buffer_space_len) {
+      memcpy(ctx_buffer + ctx_buffer_len, input, length);
+      ctx_buffer_len += length;
+      return;
+    }
+    memcpy(ctx_buffer + ctx_buffer_len, input, buffer_space_len);
+    Transform(ctx_buffer, 1);
+    input += buffer_space_len;
+    length -= buffer_space_len;
+    ctx_buffer_len = 0;
+  }
+
+  // Both transforms read the input byte by byte or with unaligned loads, so
+  // whole blocks need not be copied.
+  if (length >= k8Bytes) {
+    Transform(input, length / k8Bytes);
+    input += length - length % k8Bytes;
+    length %= k8Bytes;
+  }
+
+  memcpy(ctx_buffer, input, length);
+  ctx_buffer_len = length;
+}
+
+void Sha256Digest::Finish(unsigned char digest[32]) {
+  uint64_t bits = (count + ctx_buffer_len) << 3;
+
+  // Append the 0x80 terminator, pad with zeros and put the 64-bit message
+  // length in *bits*, big-endian, at the end of the last block.
+  unsigned int size = (ctx_buffer_len < 56 ? 64 : 128);
+  unsigned char padding[128];
+  memcpy(padding, ctx_buffer, ctx_buffer_len);
+  padding[ctx_buffer_len] = 0x80;
+  memset(padding + ctx_buffer_len + 1, 0, size - 8 - ctx_buffer_len - 1);
+  StoreBigEndian32(static_cast<uint32_t>(bits >> 32), padding + size - 8);
+  StoreBigEndian32(static_cast<uint32_t>(bits), padding + size - 4);
+  Transform(padding, size / k8Bytes);
+  ctx_buffer_len = 0;
+
+  for (int i = 0; i < 8; ++i) {
+    StoreBigEndian32(state[i], digest + 4 * i);
+  }
+}
+
+string Sha256Digest::String() const {
+  static const char hex_char[] = "0123456789abcdef";
+  string result;
+  result.reserve(2 * kDigestLength);
+  for (int i = 0; i < 8; ++i) {
+    for (int shift = 28; shift >= 0; shift -= 4) {
+      result.push_back(hex_char[(state[i] >> shift) & 0xf]);
+    }
+  }
+  return result;
+}
+
+void Sha256Digest::Transform(const unsigned char* data, size_t blocks) {
+  count += blocks * k8Bytes;
+#ifdef BLAZE_SHA256_X86_SHA_NI
+  if (HasHardwareSupport()) {
+    TransformShaNi(state, data, blocks);
+    return;
+  }
+#endif
+  TransformPortable(state, data, blocks);
+}
+
+}  // namespace blaze_util
@@ -0,0 +1,141 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/cpp/util/trace.h"
+
+#include <stdio.h>
+
+#include <chrono>  // NOLINT (for std::chrono::system_clock)
+#include <map>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace blaze_util {
+
+using std::string;
+
+namespace {
+
+struct TraceEvent {
+  string name;
+  // 'X' for spans, 'i' for instants, as in the trace event format.
+  char phase;
+  uint64_t start_us;
+  uint64_t duration_us;
+  int tid;
+};
+
+// The recorded events, guarded by a mutex because the client records from the
+// gRPC threads too.
+struct TraceLog {
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+  // Small, stable numbers for the threads that recorded events, in the order
+  // they first did so.
+  std::map<std::thread::id, int> thread_ids;
+
+  int GetThreadId() {
+    auto it = thread_ids.find(std::this_thread::get_id());
+    if (it != thread_ids.end()) {
+      return it->second;
+    }
+    int tid = static_cast<int>(thread_ids.size()) + 1;
+    thread_ids[std::this_thread::get_id()] = tid;
+    return tid;
+  }
+};
+
+TraceLog* GetTraceLog() {
+  // Leaked on purpose, so that events can be recorded during exit.
+  static TraceLog* log = new TraceLog();
+  return log;
+}
+
+void AppendJsonString(const string& value, string* json) {
+  json->push_back('"');
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+      json->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      json->append(escaped);
+    } else {
+      json->push_back(c);
+    }
+  }
+  json->push_back('"');
+}
+
+void AddEvent(const string& name, char phase, uint64_t start_us,
+              uint64_t duration_us) {
+  TraceLog* log = GetTraceLog();
+  std::lock_guard<std::mutex> guard(log->mutex);
+  log->events.push_back(
+      {name, phase, start_us, duration_us, log->GetThreadId()});
+}
+
+}  // namespace
+
+uint64_t GetTraceTimestamp() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+void RecordTraceSpan(const string& name, uint64_t start_us, uint64_t end_us) {
+  AddEvent(name, 'X', start_us, end_us > start_us ? end_us - start_us : 0);
+}
+
+void RecordTraceInstant(const string& name) {
+  AddEvent(name, 'i', GetTraceTimestamp(), 0);
+}
+
+string GetTraceJson(int pid, const string& process_name) {
+  TraceLog* log = GetTraceLog();
+  std::lock_guard<std::mutex> guard(log->mutex);
+  string json = "{\"traceEvents\":[\n";
+  json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" +
+          std::to_string(pid) + ",\"tid\":0,\"args\":{\"name\":";
+  AppendJsonString(process_name, &json);
+  json += "}}";
+  for (const TraceEvent& event : log->events) {
+    json += ",\n{\"name\":";
+    AppendJsonString(event.name, &json);
+    json += ",\"cat\":\"client\",\"ph\":\"";
+    json.push_back(event.phase);
+    json += "\",\"ts\":" + std::to_string(event.start_us);
+    if (event.phase == 'X') {
+      json += ",\"dur\":" + std::to_string(event.duration_us);
+    } else {
+      // Instant events are scoped to their thread.
+      json += ",\"s\":\"t\"";
+    }
+    json += ",\"pid\":" + std::to_string(pid) +
+            ",\"tid\":" + std::to_string(event.tid) + "}";
+  }
+  json += "\n]}\n";
+  return json;
+}
+
+void ClearTrace() {
+  TraceLog* log = GetTraceLog();
+  std::lock_guard<std::mutex> guard(log->mutex);
+  log->events.clear();
+  log->thread_ids.clear();
+}
+
+}  // namespace blaze_util
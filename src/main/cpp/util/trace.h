@@ -0,0 +1,66 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef BAZEL_SRC_MAIN_CPP_UTIL_TRACE_H_
+#define BAZEL_SRC_MAIN_CPP_UTIL_TRACE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+// A process-wide recorder of timed spans, exported in the Chrome trace event
+// format (as understood by chrome://tracing). Timestamps are microseconds since
+// the Unix epoch, so traces of different processes can be merged by
+// concatenating their event lists.
+//
+// Recording is cheap and always on; nothing is written unless the recorded
+// events are explicitly exported with GetTraceJson().
+namespace blaze_util {
+
+// Returns the current time in microseconds since the Unix epoch.
+uint64_t GetTraceTimestamp();
+
+// Records a span named `name` that lasted from `start_us` to `end_us` on the
+// calling thread.
+void RecordTraceSpan(const std::string& name, uint64_t start_us,
+                     uint64_t end_us);
+
+// Records a point in time named `name` on the calling thread.
+void RecordTraceInstant(const std::string& name);
+
+// Records a span covering the lifetime of this object. Nested objects on the
+// same thread show up as nested spans.
+class ScopedTraceSpan {
+ public:
+  explicit ScopedTraceSpan(const std::string& name)
+      : name_(name), start_us_(GetTraceTimestamp()) {}
+  ~ScopedTraceSpan() { RecordTraceSpan(name_, start_us_, GetTraceTimestamp()); }
+
+ private:
+  ScopedTraceSpan(const ScopedTraceSpan&) = delete;
+  ScopedTraceSpan& operator=(const ScopedTraceSpan&) = delete;
+
+  const std::string name_;
+  const uint64_t start_us_;
+};
+
+// Returns every event recorded so far as a JSON trace file, attributed to the
+// process `pid` which is labeled `process_name`.
+std::string GetTraceJson(int pid, const std::string& process_name);
+
+// Forgets every event recorded so far.
+void ClearTrace();
+
+}  // namespace blaze_util
+
+#endif  // BAZEL_SRC_MAIN_CPP_UTIL_TRACE_H_
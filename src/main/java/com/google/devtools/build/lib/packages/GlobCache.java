@@ -17,6 +17,7 @@ import com.google.common.annotations.VisibleForTesting;
 import com.google.common.base.Preconditions;
 import com.google.common.base.Predicate;
 import com.google.common.base.Throwables;
+import com.google.common.collect.ImmutableList;
 import com.google.common.collect.Iterables;
 import com.google.common.collect.Lists;
 import com.google.common.util.concurrent.SettableFuture;
@@ -47,6 +48,15 @@ import java.util.concurrent.atomic.AtomicReference;
   // Used outside of Bazel!
 @ThreadSafety.ThreadCompatible
 public class GlobCache {
+  /**
+   * The files whose presence usually makes a directory a subpackage, and so excluded from globs.
+   * Only a hint for the file system; the package locator decides.
+   */
+  private static final ImmutableList<String> SUBPACKAGE_MARKERS =
+      ImmutableList.of(
+          BuildFileName.BUILD_DOT_BAZEL.getFilenameFragment().getPathString(),
+          BuildFileName.BUILD.getFilenameFragment().getPathString());
+
   /**
    * A mapping from glob expressions (e.g. "*.java") to the list of files it
    * matched (in the order returned by VFS) at the time the package was
@@ -204,6 +214,7 @@ public class GlobCache {
         .addPattern(pattern)
         .setExcludeDirectories(excludeDirs)
         .setDirectoryFilter(childDirectoryPredicate)
+        .allowBulkTraversal(SUBPACKAGE_MARKERS)
         .setThreadPool(globExecutor)
         .setFilesystemCalls(syscalls)
         .globAsync(true);
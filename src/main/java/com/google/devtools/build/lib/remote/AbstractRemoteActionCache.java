@@ -281,6 +281,7 @@ public abstract class AbstractRemoteActionCache implements AutoCloseable {
      * non-directory descendant files.
      */
     public void addFiles(Collection<Path> files) throws IOException, InterruptedException {
+      List<Path> regularFiles = new ArrayList<>();
       for (Path file : files) {
         // TODO(ulfjack): Maybe pass in a SpawnResult here, add a list of output files to that, and
         // rely on the local spawn runner to stat the files, instead of statting here.
@@ -291,10 +292,14 @@ public abstract class AbstractRemoteActionCache implements AutoCloseable {
         if (file.isDirectory()) {
           addDirectory(file);
         } else {
-          Digest digest = digestUtil.compute(file);
-          addFile(digest, file);
+          regularFiles.add(file);
         }
       }
+      // Hash all the files at once, so that large outputs are hashed concurrently.
+      List<Digest> digests = digestUtil.compute(regularFiles);
+      for (int i = 0; i < regularFiles.size(); i++) {
+        addFile(digests.get(i), regularFiles.get(i));
+      }
     }
 
     /** Map of digests to file paths to upload. */
@@ -346,6 +351,7 @@ public abstract class AbstractRemoteActionCache implements AutoCloseable {
       List<Dirent> sortedDirent = new ArrayList<>(path.readdir(TreeNodeRepository.SYMLINK_POLICY));
       sortedDirent.sort(Comparator.comparing(Dirent::getName));
 
+      List<Path> files = new ArrayList<>();
       for (Dirent dirent : sortedDirent) {
         String name = dirent.getName();
         Path child = path.getRelative(name);
@@ -354,11 +360,19 @@ public abstract class AbstractRemoteActionCache implements AutoCloseable {
           b.addDirectoriesBuilder().setName(name).setDigest(digestUtil.compute(dir));
           tree.addChildren(dir);
         } else {
-          Digest digest = digestUtil.compute(child);
-          b.addFilesBuilder().setName(name).setDigest(digest).setIsExecutable(child.isExecutable());
-          digestToFile.put(digest, child);
+          files.add(child);
         }
       }
+      List<Digest> digests = digestUtil.compute(files);
+      for (int i = 0; i < files.size(); i++) {
+        Path child = files.get(i);
+        Digest digest = digests.get(i);
+        b.addFilesBuilder()
+            .setName(child.getBaseName())
+            .setDigest(digest)
+            .setIsExecutable(child.isExecutable());
+        digestToFile.put(digest, child);
+      }
 
       return b.build();
     }
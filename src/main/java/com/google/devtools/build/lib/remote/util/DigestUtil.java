@@ -23,12 +23,16 @@ import com.google.devtools.build.lib.actions.cache.DigestUtils;
 import com.google.devtools.build.lib.actions.cache.Metadata;
 import com.google.devtools.build.lib.actions.cache.VirtualActionInput;
 import com.google.devtools.build.lib.vfs.FileSystem.HashFunction;
+import com.google.devtools.build.lib.vfs.FileSystemUtils;
 import com.google.devtools.build.lib.vfs.Path;
 import com.google.devtools.remoteexecution.v1test.Action;
 import com.google.devtools.remoteexecution.v1test.Digest;
 import com.google.protobuf.Message;
 import java.io.ByteArrayOutputStream;
 import java.io.IOException;
+import java.util.ArrayList;
+import java.util.Iterator;
+import java.util.List;
 
 /** Utility methods to work with {@link Digest}. */
 public class DigestUtil {
@@ -65,6 +69,32 @@ public class DigestUtil {
     return buildDigest(digest, fileSize);
   }
 
+  /**
+   * Computes the digests of many files at once, in the order given. The files that have no fast
+   * digest are hashed in a single bulk operation, which may hash them concurrently; see {@link
+   * FileSystemUtils#getDigests}.
+   */
+  public List<Digest> compute(List<Path> files) throws IOException {
+    byte[][] digests = new byte[files.size()][];
+    List<Path> toHash = new ArrayList<>();
+    for (int i = 0; i < digests.length; i++) {
+      Path file = files.get(i);
+      byte[] digest = file.getFastDigest();
+      if (digest != null && file.isValidDigest(digest)) {
+        digests[i] = digest;
+      } else {
+        toHash.add(file);
+      }
+    }
+    Iterator<byte[]> hashed = FileSystemUtils.getDigests(toHash).iterator();
+    List<Digest> result = new ArrayList<>(digests.length);
+    for (int i = 0; i < digests.length; i++) {
+      byte[] digest = digests[i] != null ? digests[i] : hashed.next();
+      result.add(buildDigest(digest, files.get(i).getFileSize()));
+    }
+    return result;
+  }
+
   public Digest compute(VirtualActionInput input) throws IOException {
     ByteArrayOutputStream buffer = new ByteArrayOutputStream();
     input.writeTo(buffer);
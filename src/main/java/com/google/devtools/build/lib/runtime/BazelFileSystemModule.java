@@ -28,6 +28,11 @@ import com.google.devtools.common.options.OptionsProvider;
  * Module to provide a {@link FileSystem} instance that uses {@code SHA256} as the default hash
  * function, or else what's specified by {@code -Dbazel.DigestFunction}.
  *
+ * <p>With {@code -Dbazel.XattrDigestCache=1}, digests are also cached in extended attributes of the
+ * files, so that a restarted server need not hash unchanged files again. Like the in-memory cache
+ * of {@link com.google.devtools.build.lib.actions.cache.DigestUtils}, this trusts the file metadata
+ * to reflect changes to the contents.
+ *
  * <p>For legacy reasons we can't make the {@link FileSystem} class use {@code SHA256} by default.
  */
 public class BazelFileSystemModule extends BlazeModule {
@@ -54,6 +59,7 @@ public class BazelFileSystemModule extends BlazeModule {
     // The JNI-based UnixFileSystem is faster, but on Windows it is not available.
     return OS.getCurrent() == OS.WINDOWS
         ? new WindowsFileSystem(hashFunction)
-        : new UnixFileSystem(hashFunction);
+        : new UnixFileSystem(
+            hashFunction, "1".equals(System.getProperty("bazel.XattrDigestCache")));
   }
 }
@@ -129,6 +129,9 @@ public final class BlazeRuntime {
 
   private static final Logger logger = Logger.getLogger(BlazeRuntime.class.getName());
 
+  /** Set by the client when it starts a standby server; names the directory it is tracked in. */
+  private static final String STANDBY_DIRECTORY_ENV_VAR = "BAZEL_STANDBY_DIR";
+
   private final FileSystem fileSystem;
   private final Iterable<BlazeModule> blazeModules;
   private final Map<String, BlazeCommand> commandMap = new LinkedHashMap<>();
@@ -603,6 +606,10 @@ public final class BlazeRuntime {
       // Run Blaze in batch mode.
       System.exit(batchMain(modules, args));
     }
+    String standbyDirectory = System.getenv(STANDBY_DIRECTORY_ENV_VAR);
+    if (standbyDirectory != null) {
+      awaitStandbyPromotion(modules, args, standbyDirectory);
+    }
     logger.info(
         "Starting Blaze server with "
             + maybeGetPidString()
@@ -619,6 +626,51 @@ public final class BlazeRuntime {
     }
   }
 
+  /**
+   * Blocks a standby server until the client hands the output base over to it, or exits the
+   * process if that does not happen.
+   *
+   * <p>The client starts standby servers with the same arguments as real ones so that a server
+   * restart does not have to wait for the JVM to boot (see {@code blaze.cc}). A standby must not
+   * touch the output base before its promotion, because the server it replaces may still be
+   * running. Meanwhile it parses its startup options, which loads most of the classes the
+   * server needs first.
+   */
+  private static void awaitStandbyPromotion(
+      Iterable<BlazeModule> modules, String[] args, String standbyDirectory) {
+    int maxIdleSeconds;
+    try {
+      maxIdleSeconds =
+          parseOptions(modules, Arrays.asList(args))
+              .getOptions(BlazeServerStartupOptions.class)
+              .maxIdleSeconds;
+    } catch (OptionsParsingException e) {
+      // Let the regular startup report the error once we are promoted.
+      maxIdleSeconds = 0;
+    }
+
+    File serverDirectory = new File(standbyDirectory, "server");
+    File promoteFile = new File(serverDirectory, "promote");
+    File pidFile = new File(serverDirectory, "server.pid.txt");
+    // A standby lives twice as long as an idle server: it replaces a server that may have
+    // idled that long.
+    long deadline = BlazeClock.nanoTime() + TimeUnit.SECONDS.toNanos(2L * maxIdleSeconds);
+    while (true) {
+      if (promoteFile.delete()) {
+        logger.info("Standby server promoted");
+        return;
+      }
+      // The client deletes our PID file right after creating the promote file, so check again.
+      if (!pidFile.exists() && !promoteFile.exists()) {
+        System.exit(ExitCode.SUCCESS.getNumericExitCode());
+      }
+      if (maxIdleSeconds > 0 && BlazeClock.nanoTime() > deadline) {
+        System.exit(ExitCode.SUCCESS.getNumericExitCode());
+      }
+      Uninterruptibles.sleepUninterruptibly(50, TimeUnit.MILLISECONDS);
+    }
+  }
+
   @VisibleForTesting
   public static List<BlazeModule> createModules(
       Iterable<Class<? extends BlazeModule>> moduleClasses) {
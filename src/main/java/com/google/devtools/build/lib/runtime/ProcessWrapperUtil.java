@@ -17,6 +17,7 @@ package com.google.devtools.build.lib.runtime;
 import com.google.devtools.build.lib.util.OsUtils;
 import com.google.devtools.build.lib.vfs.Path;
 import com.google.devtools.build.lib.vfs.PathFragment;
+import java.math.BigDecimal;
 import java.time.Duration;
 import java.util.ArrayList;
 import java.util.List;
@@ -35,6 +36,14 @@ public final class ProcessWrapperUtil {
     return getProcessWrapper(cmdEnv) != null;
   }
 
+  /**
+   * Formats a duration as the number of seconds, keeping millisecond precision, for the timeout
+   * flags of the process wrapper and the {@code linux-sandbox}.
+   */
+  public static String formatSeconds(Duration duration) {
+    return BigDecimal.valueOf(duration.toMillis(), 3).stripTrailingZeros().toPlainString();
+  }
+
   /** Returns the {@link Path} of the process wrapper binary, or null if it doesn't exist. */
   public static Path getProcessWrapper(CommandEnvironment cmdEnv) {
     PathFragment execPath = cmdEnv.getBlazeWorkspace().getBinTools().getExecPath(PROCESS_WRAPPER);
@@ -104,10 +113,10 @@ public final class ProcessWrapperUtil {
       fullCommandLine.add(processWrapperPath);
 
       if (timeout != null) {
-        fullCommandLine.add("--timeout=" + timeout.getSeconds());
+        fullCommandLine.add("--timeout=" + formatSeconds(timeout));
       }
       if (killDelay != null) {
-        fullCommandLine.add("--kill_delay=" + killDelay.getSeconds());
+        fullCommandLine.add("--kill_delay=" + formatSeconds(killDelay));
       }
       if (stdoutPath != null) {
         fullCommandLine.add("--stdout=" + stdoutPath);
@@ -54,9 +54,12 @@ abstract class AbstractSandboxSpawnRunner implements SpawnRunner {
   private final SandboxOptions sandboxOptions;
   private final boolean verboseFailures;
   private final ImmutableSet<Path> inaccessiblePaths;
+  private final TreeDeleter treeDeleter;
 
-  public AbstractSandboxSpawnRunner(CommandEnvironment cmdEnv, Path sandboxBase) {
+  public AbstractSandboxSpawnRunner(
+      CommandEnvironment cmdEnv, Path sandboxBase, TreeDeleter treeDeleter) {
     this.sandboxBase = sandboxBase;
+    this.treeDeleter = treeDeleter;
     this.sandboxOptions = cmdEnv.getOptions().getOptions(SandboxOptions.class);
     this.verboseFailures = cmdEnv.getOptions().getOptions(ExecutionOptions.class).verboseFailures;
     this.inaccessiblePaths =
@@ -293,4 +296,9 @@ abstract class AbstractSandboxSpawnRunner implements SpawnRunner {
   protected SandboxOptions getSandboxOptions() {
     return sandboxOptions;
   }
+
+  /** Returns the deleter to use for the sandbox directories of spawns. */
+  protected TreeDeleter getTreeDeleter() {
+    return treeDeleter;
+  }
 }
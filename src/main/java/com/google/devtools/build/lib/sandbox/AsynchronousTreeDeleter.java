@@ -0,0 +1,102 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.google.devtools.build.lib.sandbox;
+
+import com.google.common.util.concurrent.ThreadFactoryBuilder;
+import com.google.devtools.build.lib.concurrent.ExecutorUtil;
+import com.google.devtools.build.lib.vfs.FileSystemUtils;
+import com.google.devtools.build.lib.vfs.Path;
+import java.io.IOException;
+import java.util.Collection;
+import java.util.UUID;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.logging.Logger;
+
+/**
+ * A {@link TreeDeleter} that renames each tree into a trash directory, which is cheap, and deletes
+ * it there on a background thread, so that spawns don't wait for their sandboxes to be deleted.
+ *
+ * <p>Trees that cannot be renamed, e.g. because the trash directory is on another file system,
+ * are deleted synchronously instead.
+ */
+class AsynchronousTreeDeleter implements TreeDeleter {
+
+  private static final Logger logger = Logger.getLogger(AsynchronousTreeDeleter.class.getName());
+
+  private final Path trashBase;
+  // Trash names are unique to this deleter, so that they never collide with trees that an earlier
+  // deleter left behind, e.g. because its server was killed.
+  private final String trashPrefix = UUID.randomUUID() + "-";
+  private final AtomicInteger trashCount = new AtomicInteger();
+  private final ExecutorService service;
+
+  /**
+   * Creates a deleter that moves trees to be deleted into {@code trashBase}, which must be an
+   * existing directory used for nothing else. Anything already in there is deleted in the
+   * background.
+   */
+  AsynchronousTreeDeleter(Path trashBase) {
+    this.trashBase = trashBase;
+    this.service =
+        Executors.newSingleThreadExecutor(
+            new ThreadFactoryBuilder()
+                .setNameFormat("sandbox-tree-deleter")
+                .setDaemon(true)
+                .setPriority(Thread.MIN_PRIORITY)
+                .build());
+    Collection<Path> leftovers;
+    try {
+      leftovers = trashBase.getDirectoryEntries();
+    } catch (IOException e) {
+      logger.warning("Failed to list " + trashBase + ": " + e);
+      return;
+    }
+    for (Path leftover : leftovers) {
+      deleteInBackground(leftover);
+    }
+  }
+
+  @Override
+  public void deleteTree(Path path) throws IOException {
+    Path trashPath = trashBase.getRelative(trashPrefix + trashCount.getAndIncrement());
+    try {
+      path.renameTo(trashPath);
+    } catch (IOException e) {
+      FileSystemUtils.deleteTree(path);
+      return;
+    }
+    deleteInBackground(trashPath);
+  }
+
+  private void deleteInBackground(Path trashPath) {
+    service.execute(
+        () -> {
+          try {
+            FileSystemUtils.deleteTree(trashPath);
+          } catch (IOException e) {
+            logger.warning("Failed to delete " + trashPath + ": " + e);
+          }
+        });
+  }
+
+  @Override
+  public void shutdown() {
+    if (ExecutorUtil.uninterruptibleShutdown(service)) {
+      Thread.currentThread().interrupt();
+    }
+  }
+}
@@ -116,14 +116,16 @@ final class DarwinSandboxedSpawnRunner extends AbstractSandboxSpawnRunner {
    * @param timeoutKillDelay additional grace period before killing timing out commands
    * @param sandboxfsProcess instance of the sandboxfs process to use; may be null for none, in
    *     which case the runner uses a symlinked sandbox
+   * @param treeDeleter deleter for the sandbox directories of spawns
    */
   DarwinSandboxedSpawnRunner(
       CommandEnvironment cmdEnv,
       Path sandboxBase,
       Duration timeoutKillDelay,
-      @Nullable SandboxfsProcess sandboxfsProcess)
+      @Nullable SandboxfsProcess sandboxfsProcess,
+      TreeDeleter treeDeleter)
       throws IOException {
-    super(cmdEnv, sandboxBase);
+    super(cmdEnv, sandboxBase, treeDeleter);
     this.execRoot = cmdEnv.getExecRoot();
     this.allowNetwork = SandboxHelpers.shouldAllowNetwork(cmdEnv.getOptions());
     this.alwaysWritableDirs = getAlwaysWritableDirs(cmdEnv.getRuntime().getFileSystem());
@@ -275,7 +277,8 @@ final class DarwinSandboxedSpawnRunner extends AbstractSandboxSpawnRunner {
               environment,
               inputs,
               outputs,
-              writableDirs) {
+              writableDirs,
+              getTreeDeleter()) {
             @Override
             public void createFileSystem() throws IOException {
               super.createFileSystem();
@@ -0,0 +1,148 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.google.devtools.build.lib.sandbox;
+
+import static java.nio.charset.StandardCharsets.UTF_8;
+
+import com.google.common.collect.ImmutableList;
+import com.google.common.collect.ImmutableMap;
+import com.google.devtools.build.lib.shell.Subprocess;
+import com.google.devtools.build.lib.shell.SubprocessBuilder;
+import com.google.devtools.build.lib.vfs.Path;
+import java.io.BufferedReader;
+import java.io.IOException;
+import java.io.InputStreamReader;
+import java.util.logging.Logger;
+import javax.annotation.Nullable;
+
+/**
+ * A {@code linux-sandbox} running in server mode ({@code -Z}).
+ *
+ * <p>The server sets up the user namespace and the read-only view of the filesystem once. Spawns
+ * run with {@code linux-sandbox -z} then only pay for their own mounts and namespaces.
+ */
+final class LinuxSandboxServer {
+  private static final Logger log = Logger.getLogger(LinuxSandboxServer.class.getName());
+
+  /** Unix socket on which the server accepts requests. */
+  private final Path socketPath;
+
+  /** Whether the server was started with {@code -U}, which all its requests must match. */
+  private final boolean useFakeUsername;
+
+  /** Process handle to the server. Null only after {@link #destroy()} has been invoked. */
+  private @Nullable Subprocess process;
+
+  private LinuxSandboxServer(Path socketPath, boolean useFakeUsername, Subprocess process) {
+    this.socketPath = socketPath;
+    this.useFakeUsername = useFakeUsername;
+    this.process = process;
+  }
+
+  /**
+   * Starts a new server and waits until it accepts requests.
+   *
+   * @param linuxSandbox path to the {@code linux-sandbox} binary
+   * @param socketPath Unix socket on which to serve requests; replaced if it exists
+   * @param useFakeUsername whether sandboxed processes run as 'nobody'
+   * @param netnsPoolSize number of network namespaces to keep ready for spawns without network
+   *     access, or 0 to create them on demand
+   * @param logFile path to the file that will receive the server's stderr
+   * @return a new handle that represents the running server
+   * @throws IOException if the server failed to start
+   */
+  static LinuxSandboxServer start(
+      Path linuxSandbox,
+      Path socketPath,
+      boolean useFakeUsername,
+      int netnsPoolSize,
+      Path logFile)
+      throws IOException {
+    ImmutableList.Builder<String> argvBuilder = ImmutableList.builder();
+    argvBuilder.add(linuxSandbox.getPathString(), "-Z", socketPath.getPathString());
+    if (useFakeUsername) {
+      argvBuilder.add("-U");
+    }
+    if (netnsPoolSize > 0) {
+      argvBuilder.add("--netns_pool", Integer.toString(netnsPoolSize));
+    }
+
+    SubprocessBuilder processBuilder = new SubprocessBuilder();
+    processBuilder.setArgv(argvBuilder.build());
+    processBuilder.setStderr(logFile.getPathFile());
+    processBuilder.setEnv(ImmutableMap.of());
+
+    log.info("Starting linux-sandbox server on " + socketPath);
+    Subprocess process = processBuilder.start();
+    process.getOutputStream().close();
+    BufferedReader stdout =
+        new BufferedReader(new InputStreamReader(process.getInputStream(), UTF_8));
+    String line = stdout.readLine();
+    if (!"ready".equals(line)) {
+      destroyProcess(process);
+      throw new IOException("linux-sandbox server failed to start; see " + logFile);
+    }
+    return new LinuxSandboxServer(socketPath, useFakeUsername, process);
+  }
+
+  /** Returns the socket to pass to {@code linux-sandbox -z}. */
+  Path getSocketPath() {
+    return socketPath;
+  }
+
+  /**
+   * Returns whether a spawn with the given identity can go through this server. The uid and gid
+   * mappings are set up once by the server, so they cannot change per spawn.
+   */
+  synchronized boolean canRun(boolean useFakeRoot, boolean useFakeUsername) {
+    return process != null
+        && !process.finished()
+        && !useFakeRoot
+        && useFakeUsername == this.useFakeUsername;
+  }
+
+  /**
+   * Destroys a process and waits for it to exit.
+   *
+   * @param process the process to destroy.
+   */
+  private static void destroyProcess(Subprocess process) {
+    process.destroy();
+
+    boolean interrupted = false;
+    try {
+      while (true) {
+        try {
+          process.waitFor();
+          return;
+        } catch (InterruptedException ie) {
+          interrupted = true;
+        }
+      }
+    } finally {
+      if (interrupted) {
+        Thread.currentThread().interrupt();
+      }
+    }
+  }
+
+  /** Stops the server. Spawns that are still running through it are killed. */
+  synchronized void destroy() {
+    if (process != null) {
+      destroyProcess(process);
+      process = null;
+    }
+  }
+}
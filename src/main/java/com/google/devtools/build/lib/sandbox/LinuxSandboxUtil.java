@@ -19,6 +19,7 @@ import com.google.common.collect.ImmutableList;
 import com.google.common.collect.ImmutableMap;
 import com.google.common.collect.ImmutableSet;
 import com.google.devtools.build.lib.runtime.CommandEnvironment;
+import com.google.devtools.build.lib.runtime.ProcessWrapperUtil;
 import com.google.devtools.build.lib.util.OsUtils;
 import com.google.devtools.build.lib.vfs.Path;
 import com.google.devtools.build.lib.vfs.PathFragment;
@@ -58,6 +59,7 @@ public final class LinuxSandboxUtil {
    */
   public static class CommandLineBuilder {
     private Path linuxSandboxPath;
+    private Path serverSocketPath;
     private Path workingDirectory;
     private Duration timeout;
     private Duration killDelay;
@@ -67,6 +69,9 @@ public final class LinuxSandboxUtil {
     private Set<Path> tmpfsDirectories = ImmutableSet.of();
     private Map<Path, Path> bindMounts = ImmutableMap.of();
     private Path statisticsPath;
+    private Path overlayLowerDirectory;
+    private Path overlayScratchDirectory;
+    private Path inputsManifestPath;
     private boolean useFakeHostname = false;
     private boolean createNetworkNamespace = false;
     private boolean useFakeRoot = false;
@@ -84,6 +89,14 @@ public final class LinuxSandboxUtil {
       return this;
     }
 
+    /**
+     * Sets the socket of a {@code linux-sandbox} server through which to run the command, if any.
+     */
+    public CommandLineBuilder setServerSocketPath(Path serverSocketPath) {
+      this.serverSocketPath = serverSocketPath;
+      return this;
+    }
+
     /** Sets the working directory to use, if any. */
     public CommandLineBuilder setWorkingDirectory(Path workingDirectory) {
       this.workingDirectory = workingDirectory;
@@ -145,6 +158,26 @@ public final class LinuxSandboxUtil {
       return this;
     }
 
+    /**
+     * Sets up an overlayfs on the working directory instead of using it as is. The sandboxed
+     * process sees a read-only view of {@code lowerDirectory}, and everything it writes ends up in
+     * {@code scratchDirectory/upper}.
+     */
+    public CommandLineBuilder setOverlay(Path lowerDirectory, Path scratchDirectory) {
+      this.overlayLowerDirectory = lowerDirectory;
+      this.overlayScratchDirectory = scratchDirectory;
+      return this;
+    }
+
+    /**
+     * Sets the manifest of inputs to add to the overlayfs, if any. Each line maps a path relative
+     * to the working directory to its target, separated by a space.
+     */
+    public CommandLineBuilder setInputsManifestPath(Path inputsManifestPath) {
+      this.inputsManifestPath = inputsManifestPath;
+      return this;
+    }
+
     /** Sets whether to use a fake 'localhost' hostname inside the sandbox. */
     public CommandLineBuilder setUseFakeHostname(boolean useFakeHostname) {
       this.useFakeHostname = useFakeHostname;
@@ -190,18 +223,24 @@ public final class LinuxSandboxUtil {
       Preconditions.checkState(
           !(this.useFakeUsername && this.useFakeRoot),
           "useFakeUsername and useFakeRoot are exclusive");
+      Preconditions.checkState(
+          this.inputsManifestPath == null || this.overlayLowerDirectory != null,
+          "inputsManifestPath requires an overlay");
 
       ImmutableList.Builder<String> commandLineBuilder = ImmutableList.builder();
 
       commandLineBuilder.add(linuxSandboxPath.getPathString());
+      if (serverSocketPath != null) {
+        commandLineBuilder.add("-z", serverSocketPath.getPathString());
+      }
       if (workingDirectory != null) {
         commandLineBuilder.add("-W", workingDirectory.getPathString());
       }
       if (timeout != null) {
-        commandLineBuilder.add("-T", Long.toString(timeout.getSeconds()));
+        commandLineBuilder.add("-T", ProcessWrapperUtil.formatSeconds(timeout));
       }
       if (killDelay != null) {
-        commandLineBuilder.add("-t", Long.toString(killDelay.getSeconds()));
+        commandLineBuilder.add("-t", ProcessWrapperUtil.formatSeconds(killDelay));
       }
       if (stdoutPath != null) {
         commandLineBuilder.add("-l", stdoutPath.getPathString());
@@ -226,6 +265,13 @@ public final class LinuxSandboxUtil {
       if (statisticsPath != null) {
         commandLineBuilder.add("-S", statisticsPath.getPathString());
       }
+      if (overlayLowerDirectory != null) {
+        commandLineBuilder.add("--overlay_lower", overlayLowerDirectory.getPathString());
+        commandLineBuilder.add("--overlay_scratch", overlayScratchDirectory.getPathString());
+      }
+      if (inputsManifestPath != null) {
+        commandLineBuilder.add("--inputs_manifest", inputsManifestPath.getPathString());
+      }
       if (useFakeHostname) {
         commandLineBuilder.add("-H");
       }
@@ -41,6 +41,7 @@ import java.io.IOException;
 import java.time.Duration;
 import java.util.Map;
 import java.util.SortedMap;
+import javax.annotation.Nullable;
 
 /** Spawn runner that uses linux sandboxing APIs to execute a local subprocess. */
 final class LinuxSandboxedSpawnRunner extends AbstractSandboxSpawnRunner {
@@ -80,6 +81,7 @@ final class LinuxSandboxedSpawnRunner extends AbstractSandboxSpawnRunner {
   private final Path inaccessibleHelperDir;
   private final LocalEnvProvider localEnvProvider;
   private final Duration timeoutKillDelay;
+  private final @Nullable LinuxSandboxServer server;
 
   /**
    * Creates a sandboxed spawn runner that uses the {@code linux-sandbox} tool.
@@ -89,14 +91,18 @@ final class LinuxSandboxedSpawnRunner extends AbstractSandboxSpawnRunner {
    * @param inaccessibleHelperFile path to a file that is (already) inaccessible
    * @param inaccessibleHelperDir path to a directory that is (already) inaccessible
    * @param timeoutKillDelay an additional grace period before killing timing out commands
+   * @param server the {@code linux-sandbox} server to run spawns through, if any
+   * @param treeDeleter deleter for the sandbox directories of spawns
    */
   LinuxSandboxedSpawnRunner(
       CommandEnvironment cmdEnv,
       Path sandboxBase,
       Path inaccessibleHelperFile,
       Path inaccessibleHelperDir,
-      Duration timeoutKillDelay) {
-    super(cmdEnv, sandboxBase);
+      Duration timeoutKillDelay,
+      @Nullable LinuxSandboxServer server,
+      TreeDeleter treeDeleter) {
+    super(cmdEnv, sandboxBase, treeDeleter);
     this.fileSystem = cmdEnv.getRuntime().getFileSystem();
     this.blazeDirs = cmdEnv.getDirectories();
     this.execRoot = cmdEnv.getExecRoot();
@@ -105,6 +111,7 @@ final class LinuxSandboxedSpawnRunner extends AbstractSandboxSpawnRunner {
     this.inaccessibleHelperFile = inaccessibleHelperFile;
     this.inaccessibleHelperDir = inaccessibleHelperDir;
     this.timeoutKillDelay = timeoutKillDelay;
+    this.server = server;
     this.localEnvProvider = new PosixLocalEnvProvider(cmdEnv.getClientEnv());
   }
 
@@ -139,10 +146,12 @@ final class LinuxSandboxedSpawnRunner extends AbstractSandboxSpawnRunner {
       commandLineBuilder.setTimeout(timeout);
     }
     commandLineBuilder.setKillDelay(timeoutKillDelay);
-    if (spawn.getExecutionInfo().containsKey(ExecutionRequirements.REQUIRES_FAKEROOT)) {
-      commandLineBuilder.setUseFakeRoot(true);
-    } else if (getSandboxOptions().sandboxFakeUsername) {
-      commandLineBuilder.setUseFakeUsername(true);
+    boolean useFakeRoot =
+        spawn.getExecutionInfo().containsKey(ExecutionRequirements.REQUIRES_FAKEROOT);
+    boolean useFakeUsername = !useFakeRoot && getSandboxOptions().sandboxFakeUsername;
+    commandLineBuilder.setUseFakeRoot(useFakeRoot).setUseFakeUsername(useFakeUsername);
+    if (server != null && server.canRun(useFakeRoot, useFakeUsername)) {
+      commandLineBuilder.setServerSocketPath(server.getSocketPath());
     }
 
     Path statisticsPath = null;
@@ -159,7 +168,8 @@ final class LinuxSandboxedSpawnRunner extends AbstractSandboxSpawnRunner {
             environment,
             SandboxHelpers.getInputFiles(spawn, policy, execRoot),
             outputs,
-            writableDirs);
+            writableDirs,
+            getTreeDeleter());
 
     return runSpawn(spawn, sandbox, policy, execRoot, tmpDir, timeout, statisticsPath);
   }
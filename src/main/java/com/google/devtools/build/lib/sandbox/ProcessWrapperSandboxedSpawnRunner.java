@@ -47,10 +47,15 @@ final class ProcessWrapperSandboxedSpawnRunner extends AbstractSandboxSpawnRunne
    * @param sandboxBase path to the sandbox base directory
    * @param productName the product name to use
    * @param timeoutKillDelay additional grace period before killing timing out commands
+   * @param treeDeleter deleter for the sandbox directories of spawns
    */
   ProcessWrapperSandboxedSpawnRunner(
-      CommandEnvironment cmdEnv, Path sandboxBase, String productName, Duration timeoutKillDelay) {
-    super(cmdEnv, sandboxBase);
+      CommandEnvironment cmdEnv,
+      Path sandboxBase,
+      String productName,
+      Duration timeoutKillDelay,
+      TreeDeleter treeDeleter) {
+    super(cmdEnv, sandboxBase, treeDeleter);
     this.execRoot = cmdEnv.getExecRoot();
     this.timeoutKillDelay = timeoutKillDelay;
     this.processWrapper = ProcessWrapperUtil.getProcessWrapper(cmdEnv);
@@ -95,7 +100,8 @@ final class ProcessWrapperSandboxedSpawnRunner extends AbstractSandboxSpawnRunne
             environment,
             SandboxHelpers.getInputFiles(spawn, policy, execRoot),
             SandboxHelpers.getOutputFiles(spawn),
-            getWritableDirs(sandboxExecRoot, environment));
+            getWritableDirs(sandboxExecRoot, environment),
+            getTreeDeleter());
 
     return runSpawn(spawn, sandbox, policy, execRoot, tmpDir, timeout, statisticsPath);
   }
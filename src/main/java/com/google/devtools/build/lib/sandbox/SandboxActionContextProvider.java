@@ -47,7 +47,8 @@ final class SandboxActionContextProvider extends ActionContextProvider {
   }
 
   public static SandboxActionContextProvider create(CommandEnvironment cmdEnv, Path sandboxBase,
-      @Nullable SandboxfsProcess process)
+      @Nullable SandboxfsProcess process, @Nullable LinuxSandboxServer linuxSandboxServer,
+      TreeDeleter treeDeleter)
       throws IOException {
     ImmutableList.Builder<ActionContext> contexts = ImmutableList.builder();
 
@@ -63,7 +64,11 @@ final class SandboxActionContextProvider extends ActionContextProvider {
           withFallback(
               cmdEnv,
               new ProcessWrapperSandboxedSpawnRunner(
-                  cmdEnv, sandboxBase, cmdEnv.getRuntime().getProductName(), timeoutKillDelay));
+                  cmdEnv,
+                  sandboxBase,
+                  cmdEnv.getRuntime().getProductName(),
+                  timeoutKillDelay,
+                  treeDeleter));
       contexts.add(new ProcessWrapperSandboxedStrategy(cmdEnv.getExecRoot(), spawnRunner));
     }
 
@@ -73,7 +78,8 @@ final class SandboxActionContextProvider extends ActionContextProvider {
       SpawnRunner spawnRunner =
           withFallback(
               cmdEnv,
-              LinuxSandboxedStrategy.create(cmdEnv, sandboxBase, timeoutKillDelay));
+              LinuxSandboxedStrategy.create(
+                  cmdEnv, sandboxBase, timeoutKillDelay, linuxSandboxServer, treeDeleter));
       contexts.add(new LinuxSandboxedStrategy(cmdEnv.getExecRoot(), spawnRunner));
     }
 
@@ -82,7 +88,8 @@ final class SandboxActionContextProvider extends ActionContextProvider {
       SpawnRunner spawnRunner =
           withFallback(
               cmdEnv,
-              new DarwinSandboxedSpawnRunner(cmdEnv, sandboxBase, timeoutKillDelay, process));
+              new DarwinSandboxedSpawnRunner(
+                  cmdEnv, sandboxBase, timeoutKillDelay, process, treeDeleter));
       contexts.add(new DarwinSandboxedStrategy(cmdEnv.getExecRoot(), spawnRunner));
     }
 
@@ -31,6 +31,7 @@ import com.google.devtools.build.lib.runtime.CommandEnvironment;
 import com.google.devtools.build.lib.util.AbruptExitException;
 import com.google.devtools.build.lib.util.ExitCode;
 import com.google.devtools.build.lib.util.Fingerprint;
+import com.google.devtools.build.lib.util.OS;
 import com.google.devtools.build.lib.vfs.FileSystem;
 import com.google.devtools.build.lib.vfs.FileSystemUtils;
 import com.google.devtools.build.lib.vfs.Path;
@@ -53,6 +54,12 @@ public final class SandboxModule extends BlazeModule {
   /** Instance of the sandboxfs process in use, if enabled. */
   private @Nullable SandboxfsProcess sandboxfsProcess;
 
+  /** Instance of the linux-sandbox server in use, if enabled. */
+  private @Nullable LinuxSandboxServer linuxSandboxServer;
+
+  /** Deleter for the sandbox directories of spawns, if the executor was initialized. */
+  private @Nullable TreeDeleter treeDeleter;
+
   /**
    * Whether to remove the sandbox worker directories after a build or not. Useful for debugging
    * to inspect the state of files on failures.
@@ -87,6 +94,8 @@ public final class SandboxModule extends BlazeModule {
 
     // Don't attempt cleanup unless the executor is initialized.
     sandboxfsProcess = null;
+    linuxSandboxServer = null;
+    treeDeleter = null;
     shouldCleanupSandboxBase = false;
   }
 
@@ -104,6 +113,28 @@ public final class SandboxModule extends BlazeModule {
     ActionContextProvider provider;
     try {
       sandboxBase.createDirectoryAndParents();
+      if (options.asyncTreeDelete) {
+        Path trashBase = sandboxBase.getRelative("_trash");
+        trashBase.createDirectory();
+        treeDeleter = new AsynchronousTreeDeleter(trashBase);
+      } else {
+        treeDeleter = new SynchronousTreeDeleter();
+      }
+      if (options.linuxSandboxServer
+          && OS.getCurrent() == OS.LINUX
+          && LinuxSandboxUtil.isSupported(cmdEnv)) {
+        try {
+          linuxSandboxServer =
+              LinuxSandboxServer.start(
+                  LinuxSandboxUtil.getLinuxSandbox(cmdEnv),
+                  sandboxBase.getRelative("linux-sandbox.sock"),
+                  options.sandboxFakeUsername,
+                  options.linuxSandboxNetnsPool,
+                  sandboxBase.getRelative("linux-sandbox-server.log"));
+        } catch (IOException e) {
+          env.getReporter().handle(Event.warn(e.getMessage()));
+        }
+      }
       if (options.useSandboxfs) {
         Path mountPoint = sandboxBase.getRelative("sandboxfs");
         mountPoint.createDirectory();
@@ -112,9 +143,11 @@ public final class SandboxModule extends BlazeModule {
         env.getReporter().handle(Event.info("Mounting sandboxfs instance on " + mountPoint));
         sandboxfsProcess = RealSandboxfsProcess.mount(
             PathFragment.create(options.sandboxfsPath), mountPoint, logFile);
-        provider = SandboxActionContextProvider.create(cmdEnv, sandboxBase, sandboxfsProcess);
+        provider = SandboxActionContextProvider.create(
+            cmdEnv, sandboxBase, sandboxfsProcess, linuxSandboxServer, treeDeleter);
       } else {
-        provider = SandboxActionContextProvider.create(cmdEnv, sandboxBase, null);
+        provider = SandboxActionContextProvider.create(
+            cmdEnv, sandboxBase, null, linuxSandboxServer, treeDeleter);
       }
     } catch (IOException e) {
       env.getBlazeModuleEnvironment().exit(
@@ -155,6 +188,16 @@ public final class SandboxModule extends BlazeModule {
   public void afterCommand() {
     checkNotNull(env, "env not initialized; was beforeCommand called?");
 
+    if (linuxSandboxServer != null) {
+      linuxSandboxServer.destroy();
+      linuxSandboxServer = null;
+    }
+
+    if (treeDeleter != null) {
+      treeDeleter.shutdown();
+      treeDeleter = null;
+    }
+
     if (shouldCleanupSandboxBase) {
       try {
         FileSystemUtils.deleteTree(sandboxBase);
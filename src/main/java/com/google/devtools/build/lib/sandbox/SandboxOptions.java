@@ -228,4 +228,39 @@ public class SandboxOptions extends OptionsBase {
             + "locally executed actions which use sandboxing"
   )
   public boolean collectLocalSandboxExecutionStatistics;
+
+  @Option(
+    name = "experimental_sandbox_async_tree_delete",
+    defaultValue = "false",
+    documentationCategory = OptionDocumentationCategory.EXECUTION_STRATEGY,
+    effectTags = {OptionEffectTag.EXECUTION},
+    help =
+        "If enabled, the sandbox of each action is moved out of the way when the action finishes "
+            + "and deleted in the background, instead of before the next action can start."
+  )
+  public boolean asyncTreeDelete;
+
+  @Option(
+    name = "experimental_linux_sandbox_server",
+    defaultValue = "false",
+    documentationCategory = OptionDocumentationCategory.EXECUTION_STRATEGY,
+    effectTags = {OptionEffectTag.EXECUTION},
+    help =
+        "If enabled, a linux-sandbox server is started for each build that sets up the user "
+            + "namespace and the read-only root once, so that each sandboxed action only sets up "
+            + "its own mounts."
+  )
+  public boolean linuxSandboxServer;
+
+  @Option(
+    name = "experimental_linux_sandbox_netns_pool",
+    defaultValue = "0",
+    documentationCategory = OptionDocumentationCategory.EXECUTION_STRATEGY,
+    effectTags = {OptionEffectTag.EXECUTION},
+    help =
+        "If positive and --experimental_linux_sandbox_server is enabled, the server keeps this "
+            + "many network namespaces with the loopback interface up ready for actions that do "
+            + "not have network access, and replaces each one after it was used."
+  )
+  public int linuxSandboxNetnsPool;
 }
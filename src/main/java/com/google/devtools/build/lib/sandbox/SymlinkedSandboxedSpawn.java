@@ -25,7 +25,6 @@ import java.util.Collection;
 import java.util.HashSet;
 import java.util.List;
 import java.util.Map;
-import java.util.Map.Entry;
 import java.util.Set;
 
 /**
@@ -40,6 +39,7 @@ public class SymlinkedSandboxedSpawn implements SandboxedSpawn {
   private final Map<PathFragment, Path> inputs;
   private final Collection<PathFragment> outputs;
   private final Set<Path> writableDirs;
+  private final TreeDeleter treeDeleter;
 
   public SymlinkedSandboxedSpawn(
       Path sandboxPath,
@@ -49,6 +49,26 @@ public class SymlinkedSandboxedSpawn implements SandboxedSpawn {
       Map<PathFragment, Path> inputs,
       Collection<PathFragment> outputs,
       Set<Path> writableDirs) {
+    this(
+        sandboxPath,
+        sandboxExecRoot,
+        arguments,
+        environment,
+        inputs,
+        outputs,
+        writableDirs,
+        new SynchronousTreeDeleter());
+  }
+
+  public SymlinkedSandboxedSpawn(
+      Path sandboxPath,
+      Path sandboxExecRoot,
+      List<String> arguments,
+      Map<String, String> environment,
+      Map<PathFragment, Path> inputs,
+      Collection<PathFragment> outputs,
+      Set<Path> writableDirs,
+      TreeDeleter treeDeleter) {
     this.sandboxPath = sandboxPath;
     this.sandboxExecRoot = sandboxExecRoot;
     this.arguments = arguments;
@@ -56,6 +76,7 @@ public class SymlinkedSandboxedSpawn implements SandboxedSpawn {
     this.inputs = inputs;
     this.outputs = outputs;
     this.writableDirs = writableDirs;
+    this.treeDeleter = treeDeleter;
   }
 
   @Override
@@ -78,8 +99,8 @@ public class SymlinkedSandboxedSpawn implements SandboxedSpawn {
     Set<Path> createdDirs = new HashSet<>();
     cleanFileSystem(inputs.keySet());
     createDirectoryAndParentsWithCache(createdDirs, sandboxExecRoot);
-    createParentDirectoriesForInputs(createdDirs, inputs.keySet());
-    createInputs(inputs);
+    checkInputPaths(inputs.keySet());
+    FileSystemUtils.createSymlinkForest(sandboxExecRoot, inputs);
     createWritableDirectories(createdDirs, writableDirs);
     createDirectoriesForOutputs(createdDirs, outputs);
   }
@@ -107,47 +128,12 @@ public class SymlinkedSandboxedSpawn implements SandboxedSpawn {
     }
   }
 
-  /**
-   * No input can be a child of another input, because otherwise we might try to create a symlink
-   * below another symlink we created earlier - which means we'd actually end up writing somewhere
-   * in the workspace.
-   *
-   * <p>If all inputs were regular files, this situation could naturally not happen - but
-   * unfortunately, we might get the occasional action that has directories in its inputs.
-   *
-   * <p>Creating all parent directories first ensures that we can safely create symlinks to
-   * directories, too, because we'll get an IOException with EEXIST if inputs happen to be nested
-   * once we start creating the symlinks for all inputs.
-   */
-  private void createParentDirectoriesForInputs(Set<Path> createdDirs, Set<PathFragment> inputs)
-      throws IOException {
+  private void checkInputPaths(Set<PathFragment> inputs) {
     for (PathFragment inputPath : inputs) {
-      Path dir = sandboxExecRoot.getRelative(inputPath).getParentDirectory();
       Preconditions.checkArgument(
-          dir.startsWith(sandboxExecRoot), "Bad relative path: '%s'", inputPath);
-      createDirectoryAndParentsWithCache(createdDirs, dir);
-    }
-  }
-
-  private void createInputs(Map<PathFragment, Path> inputs) throws IOException {
-    // All input files are relative to the execroot.
-    for (Entry<PathFragment, Path> entry : inputs.entrySet()) {
-      Path key = sandboxExecRoot.getRelative(entry.getKey());
-      FileStatus keyStat = key.statNullable(Symlinks.NOFOLLOW);
-      if (keyStat != null) {
-        if (keyStat.isSymbolicLink()
-            && entry.getValue() != null
-            && key.readSymbolicLink().equals(entry.getValue().asFragment())) {
-          continue;
-        }
-        key.delete();
-      }
-      // A null value means that we're supposed to create an empty file as the input.
-      if (entry.getValue() != null) {
-        key.createSymbolicLink(entry.getValue());
-      } else {
-        FileSystemUtils.createEmptyFile(key);
-      }
+          sandboxExecRoot.getRelative(inputPath).startsWith(sandboxExecRoot),
+          "Bad relative path: '%s'",
+          inputPath);
     }
   }
 
@@ -177,7 +163,7 @@ public class SymlinkedSandboxedSpawn implements SandboxedSpawn {
   @Override
   public void delete() {
     try {
-      FileSystemUtils.deleteTree(sandboxPath);
+      treeDeleter.deleteTree(sandboxPath);
     } catch (IOException e) {
       // This usually means that the Spawn itself exited, but still has children running that
       // we couldn't wait for, which now block deletion of the sandbox directory. On Linux this
@@ -0,0 +1,33 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.google.devtools.build.lib.sandbox;
+
+import com.google.devtools.build.lib.vfs.Path;
+import java.io.IOException;
+
+/** Deletes the directory trees of sandboxes once they are no longer needed. */
+interface TreeDeleter {
+
+  /**
+   * Deletes {@code path} and everything below it. Once this returns, {@code path} is gone, but
+   * its contents may still be deleted afterwards.
+   *
+   * @throws IOException if the tree could not be deleted
+   */
+  void deleteTree(Path path) throws IOException;
+
+  /** Waits for the trees passed to {@link #deleteTree} to be deleted. */
+  void shutdown();
+}
@@ -0,0 +1,150 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.google.devtools.build.lib.skyframe;
+
+import com.google.common.base.Preconditions;
+import com.google.common.collect.ImmutableSet;
+import com.google.common.util.concurrent.Uninterruptibles;
+import com.google.devtools.build.lib.UnixJniLoader;
+import com.google.devtools.common.options.OptionsClassProvider;
+import java.io.IOException;
+import java.nio.file.Path;
+
+/**
+ * A {@link DiffAwareness} that uses inotify directly, through JNI, to watch the filesystem.
+ *
+ * <p>Unlike {@link WatchServiceDiffAwareness}, events are read and coalesced natively by a
+ * dedicated thread, so that a large change between two builds neither overflows the kernel queue
+ * nor creates an object per event. If too much changed to track, or a directory was moved, the
+ * next view reports everything as modified but the watches stay in place.
+ */
+public final class LinuxInotifyDiffAwareness extends LocalDiffAwareness {
+  // Keep a pointer to a native structure in the JNI code.
+  private long nativePointer;
+
+  private Thread eventThread;
+
+  private boolean opened;
+
+  private boolean closed;
+
+  LinuxInotifyDiffAwareness(String watchRoot) {
+    super(watchRoot);
+  }
+
+  /** Starts watching the tree below {@code root}, called by {@link #init}. */
+  private native void create(String root) throws IOException;
+
+  /** Reads and coalesces events until {@link #stop} is called. */
+  private native void run();
+
+  /**
+   * Returns the paths, relative to the watch root, modified since the last call, or null if
+   * everything must be considered modified.
+   */
+  private native String[] poll() throws IOException;
+
+  /** Makes {@link #run} return. */
+  private native void stop();
+
+  /** Frees the native structure. */
+  private native void destroy();
+
+  private void init() throws BrokenDiffAwarenessException {
+    Preconditions.checkState(!opened);
+    opened = true;
+    try {
+      create(watchRootPath.toAbsolutePath().toString());
+    } catch (IOException e) {
+      closed = true;
+      throw new BrokenDiffAwarenessException(
+          "Error encountered with local file system watcher " + e);
+    }
+    eventThread =
+        new Thread(
+            new Runnable() {
+              @Override
+              public void run() {
+                LinuxInotifyDiffAwareness.this.run();
+              }
+            },
+            "inotify-diff-awareness");
+    eventThread.setDaemon(true);
+    eventThread.start();
+  }
+
+  /**
+   * Close this watch service, this service should not be used any longer after closing.
+   */
+  @Override
+  public void close() {
+    if (opened && !closed) {
+      closed = true;
+      stop();
+      Uninterruptibles.joinUninterruptibly(eventThread);
+      destroy();
+    }
+  }
+
+  private static final boolean JNI_AVAILABLE;
+
+  static {
+    boolean loadJniWorked = false;
+    try {
+      UnixJniLoader.loadJni();
+      loadJniWorked = true;
+    } catch (UnsatisfiedLinkError ignored) {
+      // See MacOSXFsEventsDiffAwareness: the bootstrap binary has no JNI code.
+    }
+    JNI_AVAILABLE = loadJniWorked;
+  }
+
+  /** Returns whether the JNI code is loaded; if not, use {@link WatchServiceDiffAwareness}. */
+  static boolean isAvailable() {
+    return JNI_AVAILABLE;
+  }
+
+  @Override
+  public View getCurrentView(OptionsClassProvider options)
+      throws BrokenDiffAwarenessException {
+    // See WatchServiceDiffAwareness#getCurrentView for an explanation of this logic.
+    boolean watchFs = options.getOptions(Options.class).watchFS;
+    if (watchFs && !opened) {
+      init();
+    } else if (!watchFs && opened) {
+      close();
+      throw new BrokenDiffAwarenessException("Switched off --watchfs again");
+    } else if (!opened) {
+      return EVERYTHING_MODIFIED;
+    }
+    Preconditions.checkState(!closed);
+    String[] modified;
+    try {
+      modified = poll();
+    } catch (IOException e) {
+      close();
+      throw new BrokenDiffAwarenessException(
+          "Error encountered with local file system watcher " + e);
+    }
+    if (modified == null) {
+      return newEverythingModifiedView();
+    }
+    ImmutableSet.Builder<Path> paths = ImmutableSet.builder();
+    for (String path : modified) {
+      paths.add(watchRootPath.resolve(path));
+    }
+    return newView(paths.build());
+  }
+}
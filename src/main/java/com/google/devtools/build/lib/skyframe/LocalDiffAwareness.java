@@ -32,15 +32,17 @@ import java.io.IOException;
 import java.nio.file.FileSystems;
 import java.nio.file.Path;
 import java.util.Set;
+import javax.annotation.Nullable;
 
 /**
  * File system watcher for local filesystems. It's able to provide a list of changed files between
- * two consecutive calls. On Linux, uses the standard Java WatchService, which uses 'inotify' and,
- * on OS X, uses {@link MacOSXFsEventsDiffAwareness}, which use FSEvents.
+ * two consecutive calls. On Linux, uses {@link LinuxInotifyDiffAwareness}, which uses 'inotify'
+ * through JNI, or else the standard Java WatchService, which also uses 'inotify' and, on OS X,
+ * uses {@link MacOSXFsEventsDiffAwareness}, which use FSEvents.
  *
  * <p>
- * This is an abstract class, specialized by {@link MacOSXFsEventsDiffAwareness} and
- * {@link WatchServiceDiffAwareness}.
+ * This is an abstract class, specialized by {@link LinuxInotifyDiffAwareness}, {@link
+ * MacOSXFsEventsDiffAwareness} and {@link WatchServiceDiffAwareness}.
  */
 public abstract class LocalDiffAwareness implements DiffAwareness {
   /**
@@ -93,6 +95,9 @@ public abstract class LocalDiffAwareness implements DiffAwareness {
       if (OS.getCurrent() == OS.DARWIN) {
         return new MacOSXFsEventsDiffAwareness(resolvedPathEntryFragment.toString());
       }
+      if (OS.getCurrent() == OS.LINUX && LinuxInotifyDiffAwareness.isAvailable()) {
+        return new LinuxInotifyDiffAwareness(resolvedPathEntryFragment.toString());
+      }
 
       return new WatchServiceDiffAwareness(resolvedPathEntryFragment.toString());
     }
@@ -131,9 +136,11 @@ public abstract class LocalDiffAwareness implements DiffAwareness {
   static class SequentialView implements DiffAwareness.View {
     private final LocalDiffAwareness owner;
     private final int position;
-    private final Set<Path> modifiedAbsolutePaths;
+    /** Null if everything must be considered modified. */
+    @Nullable private final Set<Path> modifiedAbsolutePaths;
 
-    public SequentialView(LocalDiffAwareness owner, int position, Set<Path> modifiedAbsolutePaths) {
+    public SequentialView(
+        LocalDiffAwareness owner, int position, @Nullable Set<Path> modifiedAbsolutePaths) {
       this.owner = owner;
       this.position = position;
       this.modifiedAbsolutePaths = modifiedAbsolutePaths;
@@ -162,6 +169,15 @@ public abstract class LocalDiffAwareness implements DiffAwareness {
     return new SequentialView(this, numGetCurrentViewCalls, modifiedAbsolutePaths);
   }
 
+  /**
+   * Like {@link #newView}, but for when the watcher lost track of what changed. Unlike {@link
+   * #EVERYTHING_MODIFIED}, the next view can again be diffed against this one.
+   */
+  protected SequentialView newEverythingModifiedView() {
+    numGetCurrentViewCalls++;
+    return new SequentialView(this, numGetCurrentViewCalls, null);
+  }
+
   @Override
   public ModifiedFileSet getDiff(View oldView, View newView)
       throws IncompatibleViewException, BrokenDiffAwarenessException {
@@ -173,7 +189,8 @@ public abstract class LocalDiffAwareness implements DiffAwareness {
     } catch (ClassCastException e) {
       throw new IncompatibleViewException("Given views are not from LocalDiffAwareness");
     }
-    if (!areInSequence(oldSequentialView, newSequentialView)) {
+    if (!areInSequence(oldSequentialView, newSequentialView)
+        || newSequentialView.modifiedAbsolutePaths == null) {
       return ModifiedFileSet.EVERYTHING_MODIFIED;
     }
     return ModifiedFileSet.builder()
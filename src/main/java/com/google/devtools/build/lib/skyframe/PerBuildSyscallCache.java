@@ -13,6 +13,7 @@
 // limitations under the License.
 package com.google.devtools.build.lib.skyframe;
 
+import com.google.common.base.Predicate;
 import com.google.common.cache.CacheBuilder;
 import com.google.common.cache.CacheLoader;
 import com.google.common.cache.LoadingCache;
@@ -24,6 +25,7 @@ import com.google.devtools.build.lib.vfs.Symlinks;
 import com.google.devtools.build.lib.vfs.UnixGlob;
 import java.io.IOException;
 import java.util.Collection;
+import java.util.Map;
 
 /**
  * A per-build cache of filesystem operations for Skyframe invocations of legacy package loading.
@@ -113,6 +115,36 @@ public class PerBuildSyscallCache implements UnixGlob.FilesystemCalls {
     throw status.getSecond();
   }
 
+  /**
+   * Expands the glob in bulk and records the stats of the matches, so that the rest of the build
+   * sees the same files. Falls back to visiting directories one by one if this cache already knows
+   * a match as missing.
+   */
+  @Override
+  public Map<Path, FileStatus> globTree(
+      Path base,
+      Collection<String> patterns,
+      boolean excludeDirectories,
+      Predicate<Path> dirPred,
+      Collection<String> dirPredHint)
+      throws IOException {
+    Map<Path, FileStatus> matches =
+        UnixGlob.DEFAULT_SYSCALLS.globTree(
+            base, patterns, excludeDirectories, dirPred, dirPredHint);
+    if (matches == null) {
+      return null;
+    }
+    for (Map.Entry<Path, FileStatus> match : matches.entrySet()) {
+      Pair<Path, Symlinks> key = Pair.of(match.getKey(), Symlinks.FOLLOW);
+      Pair<FileStatus, IOException> cached =
+          statCache.asMap().putIfAbsent(key, Pair.of(match.getValue(), null));
+      if (cached != null && (cached.getFirst() == null || cached.getFirst() == NO_STATUS)) {
+        return null;
+      }
+    }
+    return matches;
+  }
+
   public void clear() {
     statCache.invalidateAll();
     readdirCache.invalidateAll();
@@ -131,6 +131,7 @@ import com.google.devtools.build.lib.skyframe.ToolchainUtil.ToolchainContextExce
 import com.google.devtools.build.lib.util.AbruptExitException;
 import com.google.devtools.build.lib.util.ResourceUsage;
 import com.google.devtools.build.lib.util.io.TimestampGranularityMonitor;
+import com.google.devtools.build.lib.vfs.BatchStat;
 import com.google.devtools.build.lib.vfs.Dirent;
 import com.google.devtools.build.lib.vfs.FileSystem;
 import com.google.devtools.build.lib.vfs.ModifiedFileSet;
@@ -2055,6 +2056,20 @@ public abstract class SkyframeExecutor implements WalkableGraphFactory {
     this.statusReporterRef.set(statusReporter);
   }
 
+  /**
+   * Returns the {@link BatchStat} to check output files with: the output service's if it has one,
+   * otherwise the one of the file system of the execution root, if any.
+   */
+  @Nullable
+  protected BatchStat getBatchStatter() {
+    BatchStat batchStatter = outputService == null ? null : outputService.getBatchStatter();
+    if (batchStatter == null) {
+      Path execRoot = directories.getExecRoot();
+      batchStatter = execRoot.getFileSystem().getBatchStatter(execRoot);
+    }
+    return batchStatter;
+  }
+
   public abstract void detectModifiedOutputFiles(
       ModifiedFileSet modifiedOutputFiles, @Nullable Range<Long> lastExecutionTimeRange)
       throws AbruptExitException, InterruptedException;
@@ -14,6 +14,8 @@
 
 package com.google.devtools.build.lib.unix;
 
+import static java.nio.charset.StandardCharsets.ISO_8859_1;
+
 import com.google.common.annotations.VisibleForTesting;
 import com.google.common.hash.HashCode;
 import com.google.devtools.build.lib.UnixJniLoader;
@@ -145,6 +147,12 @@ public final class NativePosixFiles {
    */
   public static native String readlink(String path) throws IOException;
 
+  /**
+   * Like {@link #readlink}, but takes and returns Latin1-encoded paths, which are cheaper to pass
+   * across JNI than Strings.
+   */
+  public static native byte[] readlinkBytes(byte[] path) throws IOException;
+
   /**
    * Native wrapper around POSIX chmod(2) syscall: Changes the file access
    * permissions of 'path' to 'mode'.
@@ -212,6 +220,109 @@ public final class NativePosixFiles {
    */
   public static native ErrnoFileStatus errnoLstat(String path);
 
+  /** Like {@link #stat}, but takes a Latin1-encoded path, which is cheaper to pass across JNI. */
+  public static native FileStatus statBytes(byte[] path) throws IOException;
+
+  /** Like {@link #lstat}, but takes a Latin1-encoded path, which is cheaper to pass across JNI. */
+  public static native FileStatus lstatBytes(byte[] path) throws IOException;
+
+  /**
+   * Like {@link #errnoStat}, but takes a Latin1-encoded path, which is cheaper to pass across JNI.
+   */
+  public static native ErrnoFileStatus errnoStatBytes(byte[] path);
+
+  /**
+   * Like {@link #errnoLstat}, but takes a Latin1-encoded path, which is cheaper to pass across
+   * JNI.
+   */
+  public static native ErrnoFileStatus errnoLstatBytes(byte[] path);
+
+  /**
+   * A compound return type for {@link #batchStat}: the stat() results for many files as parallel
+   * primitive arrays, rather than one object per file.
+   */
+  public static final class StatBatch {
+    private final int[] errnos;
+    private final int[] modes;
+    private final long[] sizes;
+    private final long[] lastModifiedTimesNanos;
+    private final long[] lastChangeTimesNanos;
+    private final long[] inodeNumbers;
+    private final long[] deviceNumbers;
+
+    /** called from JNI */
+    public StatBatch(
+        int[] errnos,
+        int[] modes,
+        long[] sizes,
+        long[] lastModifiedTimesNanos,
+        long[] lastChangeTimesNanos,
+        long[] inodeNumbers,
+        long[] deviceNumbers) {
+      this.errnos = errnos;
+      this.modes = modes;
+      this.sizes = sizes;
+      this.lastModifiedTimesNanos = lastModifiedTimesNanos;
+      this.lastChangeTimesNanos = lastChangeTimesNanos;
+      this.inodeNumbers = inodeNumbers;
+      this.deviceNumbers = deviceNumbers;
+    }
+
+    public int size() {
+      return errnos.length;
+    }
+
+    /**
+     * Returns the errno of the stat() call for the i-th file, or 0 if it succeeded. The other
+     * fields are undefined for files with an error.
+     */
+    public int getErrno(int i) {
+      return errnos[i];
+    }
+
+    /** Returns st_mode of the i-th file. */
+    public int getMode(int i) {
+      return modes[i];
+    }
+
+    public long getSize(int i) {
+      return sizes[i];
+    }
+
+    /** Returns the modification time of the i-th file in nanoseconds since the epoch. */
+    public long getLastModifiedTimeNanos(int i) {
+      return lastModifiedTimesNanos[i];
+    }
+
+    /** Returns the status change time of the i-th file in nanoseconds since the epoch. */
+    public long getLastChangeTimeNanos(int i) {
+      return lastChangeTimesNanos[i];
+    }
+
+    public long getInodeNumber(int i) {
+      return inodeNumbers[i];
+    }
+
+    public long getDeviceNumber(int i) {
+      return deviceNumbers[i];
+    }
+  }
+
+  /**
+   * Native wrapper around POSIX stat(2) or lstat(2) for many files at once. The files are stat()ed
+   * by up to {@code parallelism} native threads, and a single JNI call returns all the results.
+   * The threads other than the calling one come from a pool with one thread per CPU that all calls
+   * share, so concurrent calls from many Java threads do not multiply their parallelism.
+   *
+   * @param paths the files to stat.
+   * @param followSymlinks whether to call stat() rather than lstat().
+   * @param parallelism the maximum number of threads to use, including the calling one.
+   * @return a StatBatch whose i-th entry describes {@code paths[i]}. Failures are reported per
+   *     file through {@link StatBatch#getErrno}.
+   */
+  public static native StatBatch batchStat(
+      String[] paths, boolean followSymlinks, int parallelism);
+
   /**
    * Native wrapper around POSIX utime(2) syscall.
    *
@@ -370,6 +481,180 @@ public final class NativePosixFiles {
   private static native Dirents readdir(String path, char typeCode)
       throws IOException;
 
+  /**
+   * The result of {@link #readdirBytes}: like {@link Dirents}, but with the names packed into a
+   * single Latin1 byte array rather than one String each.
+   */
+  public static final class PackedDirents {
+    private final byte[] names;
+    /** Name i is {@code names[nameOffsets[i]..nameOffsets[i + 1]]}. */
+    private final int[] nameOffsets;
+    /** As in {@link Dirents}. */
+    private final byte[] types;
+
+    /** called from JNI */
+    public PackedDirents(byte[] names, int[] nameOffsets, byte[] types) {
+      this.names = names;
+      this.nameOffsets = nameOffsets;
+      this.types = types;
+    }
+
+    public int size() {
+      return nameOffsets.length - 1;
+    }
+
+    public boolean hasTypes() {
+      return types != null;
+    }
+
+    public String getName(int i) {
+      return new String(names, nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i], ISO_8859_1);
+    }
+
+    public Dirents.Type getType(int i) {
+      return Dirents.Type.forChar((char) types[i]);
+    }
+  }
+
+  /**
+   * Like {@link #readdir(String, ReadTypes)}, but takes a Latin1-encoded path and returns the
+   * names packed into a single array, which is cheaper to pass across JNI than Strings.
+   */
+  public static PackedDirents readdirBytes(byte[] path, ReadTypes readTypes) throws IOException {
+    return readdirBytes(path, readTypes.getCode());
+  }
+
+  private static native PackedDirents readdirBytes(byte[] path, char typeCode)
+      throws IOException;
+
+  /**
+   * A compound return type for {@link #readdirWithStats}: the names of the entries of a directory,
+   * packed into a single Latin1 byte array, and their stat() results.
+   */
+  public static final class StatDirents {
+    private final byte[] names;
+    /** Name i is {@code names[nameOffsets[i]..nameOffsets[i + 1]]}. */
+    private final int[] nameOffsets;
+    private final StatBatch stats;
+
+    /** called from JNI */
+    public StatDirents(byte[] names, int[] nameOffsets, StatBatch stats) {
+      this.names = names;
+      this.nameOffsets = nameOffsets;
+      this.stats = stats;
+    }
+
+    public int size() {
+      return stats.size();
+    }
+
+    public String getName(int i) {
+      return new String(names, nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i], ISO_8859_1);
+    }
+
+    /** Returns the stat() results; entry i describes {@link #getName getName(i)}. */
+    public StatBatch getStats() {
+      return stats;
+    }
+  }
+
+  /**
+   * Reads a directory and stat()s all its entries in a single JNI call, using fstatat(2) relative
+   * to the open directory where available.
+   *
+   * @param path the directory to read.
+   * @param followSymlinks whether to stat() rather than lstat() the entries.
+   * @return the entries (excluding "." and "..") in the order they were returned by the system.
+   *     Entries that could not be stat()ed, e.g. because they were deleted concurrently, have a
+   *     non-zero {@link StatBatch#getErrno}.
+   * @throws IOException if the directory could not be read.
+   */
+  public static native StatDirents readdirWithStats(String path, boolean followSymlinks)
+      throws IOException;
+
+  /**
+   * The result of {@link #walkTree}: the matching paths, relative to the root of the walk, and the
+   * directories that were entered or skipped to find them.
+   */
+  public static final class TreeWalk {
+    private final StatDirents matches;
+    private final byte[] directoryNames;
+    private final int[] directoryNameOffsets;
+    private final int visitedDirectoryCount;
+
+    /** called from JNI */
+    public TreeWalk(
+        StatDirents matches,
+        byte[] directoryNames,
+        int[] directoryNameOffsets,
+        int visitedDirectoryCount) {
+      this.matches = matches;
+      this.directoryNames = directoryNames;
+      this.directoryNameOffsets = directoryNameOffsets;
+      this.visitedDirectoryCount = visitedDirectoryCount;
+    }
+
+    /** Returns the matches, in no particular order; "" stands for the root itself. */
+    public StatDirents getMatches() {
+      return matches;
+    }
+
+    /** Returns the number of directories below the root that were matched or traversed. */
+    public int getVisitedDirectoryCount() {
+      return visitedDirectoryCount;
+    }
+
+    public String getVisitedDirectory(int i) {
+      return getDirectory(i);
+    }
+
+    /** Returns the number of directories that were skipped because they contain a prune marker. */
+    public int getPrunedDirectoryCount() {
+      return directoryNameOffsets.length - 1 - visitedDirectoryCount;
+    }
+
+    public String getPrunedDirectory(int i) {
+      return getDirectory(visitedDirectoryCount + i);
+    }
+
+    private String getDirectory(int i) {
+      return new String(
+          directoryNames,
+          directoryNameOffsets[i],
+          directoryNameOffsets[i + 1] - directoryNameOffsets[i],
+          ISO_8859_1);
+    }
+  }
+
+  /**
+   * Expands glob patterns over the tree below a directory in a single JNI call, traversing the
+   * tree with a pool of native threads.
+   *
+   * <p>The patterns have the syntax and semantics of {@link
+   * com.google.devtools.build.lib.vfs.UnixGlob} and must be valid according to {@link
+   * com.google.devtools.build.lib.vfs.UnixGlob#checkPatternForError}. A path is returned iff it
+   * matches one of {@code includes} and none of {@code excludes}.
+   *
+   * @param root the directory to expand the patterns in.
+   * @param includes the patterns to match.
+   * @param excludes the patterns whose matches are removed from the result.
+   * @param pruneMarkers names of files; a directory below the root containing any of them as a
+   *     regular file is neither returned nor traversed.
+   * @param excludeDirectories whether to leave directories out of the result.
+   * @param followSymlinks whether symlinks are followed; if not, they are matched like files.
+   * @param parallelism the maximum number of threads to use.
+   * @throws IOException if a directory could not be read.
+   */
+  public static native TreeWalk walkTree(
+      String root,
+      String[] includes,
+      String[] excludes,
+      String[] pruneMarkers,
+      boolean excludeDirectories,
+      boolean followSymlinks,
+      int parallelism)
+      throws IOException;
+
   /**
    * Native wrapper around POSIX rename(2) syscall.
    *
@@ -380,6 +665,33 @@ public final class NativePosixFiles {
   public static native void rename(String oldpath, String newpath)
       throws IOException;
 
+  /** {@link #copyFile} made the copy share the data of the source, e.g. with FICLONE. */
+  public static final int COPY_CLONE = 0;
+
+  /** {@link #copyFile} copied the data within the kernel with copy_file_range(2). */
+  public static final int COPY_FILE_RANGE = 1;
+
+  /** {@link #copyFile} copied the data within the kernel with sendfile(2). */
+  public static final int COPY_SENDFILE = 2;
+
+  /** {@link #copyFile} copied the data through a buffer with read(2) and write(2). */
+  public static final int COPY_READ_WRITE = 3;
+
+  /**
+   * Copies the contents of the file {@code src} to {@code dst}, which is created with permissions
+   * {@code mode} (minus the umask) if it does not exist and truncated otherwise. The copy is made
+   * in the cheapest way that works for the two files, trying each of the {@code COPY_*} strategies
+   * in turn; on copy-on-write file systems such as btrfs and XFS, the copy takes no time and no
+   * space.
+   *
+   * @param src the file to copy.
+   * @param dst the file to copy to.
+   * @param mode the permissions of the file if it is created.
+   * @return the {@code COPY_*} constant for the strategy that was used.
+   * @throws IOException if the copy failed for any reason.
+   */
+  public static native int copyFile(String src, String dst, int mode) throws IOException;
+
   /**
    * Native wrapper around POSIX remove(3) C library call.
    *
@@ -389,6 +701,35 @@ public final class NativePosixFiles {
    */
   public static native boolean remove(String path) throws IOException;
 
+  /**
+   * Deletes each of {@code roots} and, if it is a directory, everything below it, without
+   * following symbolic links. Directories are deleted by up to {@code parallelism} threads using
+   * unlinkat(2) relative to open directories, and are made accessible to their owner first if
+   * needed. Roots that do not exist are ignored.
+   *
+   * @param roots the files or directories to delete.
+   * @param parallelism the maximum number of threads to use.
+   * @return an array whose i-th element is null if {@code roots[i]} was deleted, or else describes
+   *     the first failure to delete something below it.
+   */
+  public static native String[] deleteTreesBatch(String[] roots, int parallelism);
+
+  /**
+   * Creates a symlink below the existing directory {@code root} for each path in {@code
+   * packedPaths}, pointing to the corresponding target in {@code packedTargets}, or an empty file
+   * where that target is empty. Missing parent directories are each created once, before any
+   * link, and the links are then created by up to {@code parallelism} threads. Symlinks that
+   * already point to their target are kept; any other file in the way is replaced.
+   *
+   * @param root the directory that the paths are relative to.
+   * @param packedPaths the relative paths of the links, each terminated by a nul byte.
+   * @param packedTargets the targets of the links, each terminated by a nul byte.
+   * @param parallelism the maximum number of threads to use.
+   * @throws IOException if a directory or link could not be created.
+   */
+  public static native void createSymlinkForest(
+      String root, byte[] packedPaths, byte[] packedTargets, int parallelism) throws IOException;
+
   /**
    * Native wrapper around POSIX mkfifo(3) C library call.
    *
@@ -450,6 +791,62 @@ public final class NativePosixFiles {
     return HashCode.fromBytes(md5sumAsBytes(path));
   }
 
+  /** Algorithm numbers for {@link #digest} and {@link #batchDigest}. */
+  public static final int DIGEST_MD5 = 0;
+  public static final int DIGEST_SHA1 = 1;
+  public static final int DIGEST_SHA256 = 2;
+
+  static native byte[] digestAsBytes(String path, int algorithm) throws IOException;
+
+  /**
+   * Returns the digest of the specified file, following symbolic links. The file is read with
+   * large sequential reads; SHA-256 uses the SHA instructions of the CPU if it has them.
+   *
+   * @param path the file whose digest is required.
+   * @param algorithm one of the {@code DIGEST_*} constants.
+   * @return the digest, as a {@link HashCode}
+   * @throws IOException if the call failed for any reason.
+   */
+  public static HashCode digest(String path, int algorithm) throws IOException {
+    return HashCode.fromBytes(digestAsBytes(path, algorithm));
+  }
+
+  /**
+   * Like {@link #digestAsBytes}, but reuses the digest cached in an extended attribute of the file
+   * ({@code user.bazel.sha256} and so on) if the inode number, size and modification time of the
+   * file still match those recorded with it. Otherwise the digest is computed and cached there,
+   * if the file system supports extended attributes and the file is writable by its owner.
+   *
+   * @param path the file whose digest is required.
+   * @param algorithm one of the {@code DIGEST_*} constants.
+   * @return the digest, as a byte array.
+   * @throws IOException if the call failed for any reason.
+   */
+  public static native byte[] getOrComputeDigest(String path, int algorithm) throws IOException;
+
+  /**
+   * Returns the digest that {@link #getOrComputeDigest} cached for the file if it is still valid,
+   * or null, without ever hashing the file.
+   *
+   * @param path the file whose digest is required.
+   * @param algorithm one of the {@code DIGEST_*} constants.
+   */
+  public static native byte[] getCachedDigest(String path, int algorithm);
+
+  /**
+   * Returns the digests of many files at once, following symbolic links. The files are hashed by
+   * up to {@code parallelism} native threads, and a single JNI call returns all the results.
+   *
+   * @param paths the files whose digests are required.
+   * @param algorithm one of the {@code DIGEST_*} constants.
+   * @param useXattrCache whether to reuse and cache digests like {@link #getOrComputeDigest}.
+   * @param parallelism the maximum number of threads to use, including the calling one.
+   * @return an array whose i-th element is the digest of {@code paths[i]}, or null if it could not
+   *     be computed; call {@link #digest} for that file to get the error.
+   */
+  public static native byte[][] batchDigest(
+      String[] paths, int algorithm, boolean useXattrCache, int parallelism);
+
   /**
    * Removes entire directory tree. Doesn't follow symlinks.
    *
@@ -0,0 +1,132 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.google.devtools.build.lib.unix;
+
+import com.google.devtools.build.lib.unix.NativePosixFiles.StatBatch;
+import com.google.devtools.build.lib.vfs.BatchStat;
+import com.google.devtools.build.lib.vfs.FileStatusWithDigest;
+import com.google.devtools.build.lib.vfs.Path;
+import com.google.devtools.build.lib.vfs.PathFragment;
+import java.io.IOException;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * A {@link BatchStat} that stat()s all files of a batch with a single call to {@link
+ * NativePosixFiles#batchStat}, on native threads and without allocating a {@link FileStatus} per
+ * file.
+ */
+final class UnixBatchStat implements BatchStat {
+  /** Batches smaller than this are stat()ed on the calling thread only. */
+  private static final int MIN_FILES_PER_THREAD = 1024;
+
+  /**
+   * The native threads beyond the calling one are shared by all batches, e.g. those that {@code
+   * FilesystemValueChecker} stats from many threads at once.
+   */
+  private static final int MAX_PARALLELISM = Runtime.getRuntime().availableProcessors();
+
+  private final Path root;
+
+  UnixBatchStat(Path root) {
+    this.root = root;
+  }
+
+  @Override
+  public List<FileStatusWithDigest> batchStat(
+      boolean includeDigest, boolean includeLinks, Iterable<PathFragment> paths)
+      throws IOException, InterruptedException {
+    List<String> pathStrings = new ArrayList<>();
+    for (PathFragment path : paths) {
+      pathStrings.add(root.getRelative(path).getPathString());
+    }
+    int parallelism =
+        Math.min(pathStrings.size() / MIN_FILES_PER_THREAD + 1, MAX_PARALLELISM);
+    StatBatch batch =
+        NativePosixFiles.batchStat(
+            pathStrings.toArray(new String[0]), /*followSymlinks=*/ !includeLinks, parallelism);
+    if (Thread.interrupted()) {
+      throw new InterruptedException();
+    }
+
+    // Digests are never included: a null digest tells the caller to compute it if needed.
+    List<FileStatusWithDigest> result = new ArrayList<>(batch.size());
+    for (int i = 0; i < batch.size(); i++) {
+      // Null means "unknown", so the caller stat()s failed files again and sees the error itself.
+      result.add(batch.getErrno(i) == 0 ? new BatchFileStatus(batch, i) : null);
+    }
+    return result;
+  }
+
+  /** One entry of a {@link StatBatch}, viewed as a {@link FileStatusWithDigest}. */
+  static final class BatchFileStatus implements FileStatusWithDigest {
+    private final StatBatch batch;
+    private final int index;
+
+    BatchFileStatus(StatBatch batch, int index) {
+      this.batch = batch;
+      this.index = index;
+    }
+
+    private int getType() {
+      return batch.getMode(index) & FileStatus.S_IFMT;
+    }
+
+    @Override
+    public byte[] getDigest() {
+      return null;
+    }
+
+    @Override
+    public boolean isFile() {
+      return !isDirectory() && !isSymbolicLink();
+    }
+
+    @Override
+    public boolean isSpecialFile() {
+      return isFile() && getType() != FileStatus.S_IFREG;
+    }
+
+    @Override
+    public boolean isDirectory() {
+      return getType() == FileStatus.S_IFDIR;
+    }
+
+    @Override
+    public boolean isSymbolicLink() {
+      return getType() == FileStatus.S_IFLNK;
+    }
+
+    @Override
+    public long getSize() {
+      return batch.getSize(index);
+    }
+
+    @Override
+    public long getLastModifiedTime() {
+      return batch.getLastModifiedTimeNanos(index) / 1000000;
+    }
+
+    @Override
+    public long getLastChangeTime() {
+      return batch.getLastChangeTimeNanos(index) / 1000000;
+    }
+
+    @Override
+    public long getNodeId() {
+      return batch.getInodeNumber(index);
+    }
+  }
+}
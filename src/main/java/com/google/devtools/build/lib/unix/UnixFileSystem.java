@@ -13,15 +13,25 @@
 // limitations under the License.
 package com.google.devtools.build.lib.unix;
 
+import static java.nio.charset.StandardCharsets.ISO_8859_1;
+
 import com.google.common.annotations.VisibleForTesting;
+import com.google.common.base.Joiner;
 import com.google.common.base.Preconditions;
+import com.google.common.base.Predicate;
 import com.google.common.collect.Lists;
+import com.google.common.collect.Maps;
 import com.google.devtools.build.lib.concurrent.ThreadSafety.ThreadSafe;
 import com.google.devtools.build.lib.profiler.Profiler;
 import com.google.devtools.build.lib.profiler.ProfilerTask;
 import com.google.devtools.build.lib.unix.NativePosixFiles.Dirents;
+import com.google.devtools.build.lib.unix.NativePosixFiles.PackedDirents;
 import com.google.devtools.build.lib.unix.NativePosixFiles.ReadTypes;
+import com.google.devtools.build.lib.unix.NativePosixFiles.StatBatch;
+import com.google.devtools.build.lib.unix.NativePosixFiles.StatDirents;
+import com.google.devtools.build.lib.unix.NativePosixFiles.TreeWalk;
 import com.google.devtools.build.lib.vfs.AbstractFileSystemWithCustomStat;
+import com.google.devtools.build.lib.vfs.BatchStat;
 import com.google.devtools.build.lib.vfs.Dirent;
 import com.google.devtools.build.lib.vfs.FileStatus;
 import com.google.devtools.build.lib.vfs.Path;
@@ -29,7 +39,10 @@ import com.google.devtools.build.lib.vfs.PathFragment;
 import java.io.IOException;
 import java.util.ArrayList;
 import java.util.Collection;
+import java.util.HashSet;
 import java.util.List;
+import java.util.Map;
+import java.util.Set;
 
 /**
  * This class implements the FileSystem interface using direct calls to the UNIX filesystem.
@@ -37,11 +50,41 @@ import java.util.List;
 @ThreadSafe
 public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
 
+  /**
+   * The maximum number of native threads a single {@link #globTree} call uses. They come from a
+   * pool with one thread per CPU that all calls share, so concurrent globs do not multiply it.
+   */
+  private static final int GLOB_PARALLELISM = Runtime.getRuntime().availableProcessors();
+
+  /** The maximum number of native threads a single {@link #deleteTrees} call uses. */
+  private static final int DELETE_PARALLELISM = Runtime.getRuntime().availableProcessors();
+
+  /** The maximum number of native threads a single {@link #getDigests} call uses. */
+  private static final int DIGEST_PARALLELISM = Runtime.getRuntime().availableProcessors();
+
+  /**
+   * The maximum number of native threads a single {@link #createSymlinkForest} call uses. This is
+   * small because sandboxed spawns, the main callers, already set up their sandboxes concurrently.
+   */
+  private static final int SYMLINK_FOREST_PARALLELISM = 4;
+
+  private final boolean cacheDigestsInXattrs;
+
   public UnixFileSystem() {
+    this.cacheDigestsInXattrs = false;
   }
 
   public UnixFileSystem(HashFunction hashFunction) {
+    this(hashFunction, false);
+  }
+
+  /**
+   * @param cacheDigestsInXattrs whether to keep file digests in extended attributes of the files,
+   *     so that they survive server restarts; see {@link NativePosixFiles#getOrComputeDigest}
+   */
+  public UnixFileSystem(HashFunction hashFunction, boolean cacheDigestsInXattrs) {
     super(hashFunction);
+    this.cacheDigestsInXattrs = cacheDigestsInXattrs;
   }
 
   /**
@@ -99,19 +142,24 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     public String toString() { return status.toString(); }
   }
 
+  @Override
+  public BatchStat getBatchStatter(Path root) {
+    return new UnixBatchStat(root);
+  }
+
   @Override
   protected Collection<String> getDirectoryEntries(Path path) throws IOException {
     String name = path.getPathString();
-    String[] entries;
+    PackedDirents entries;
     long startTime = Profiler.nanoTimeMaybe();
     try {
-      entries = NativePosixFiles.readdir(name);
+      entries = NativePosixFiles.readdirBytes(encode(name), ReadTypes.NONE);
     } finally {
       profiler.logSimpleTask(startTime, ProfilerTask.VFS_DIR, name);
     }
-    Collection<String> result = new ArrayList<>(entries.length);
-    for (String entry : entries) {
-      result.add(entry);
+    Collection<String> result = new ArrayList<>(entries.size());
+    for (int i = 0; i < entries.size(); i++) {
+      result.add(entries.getName(i));
     }
     return result;
   }
@@ -149,8 +197,9 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     String name = path.getPathString();
     long startTime = Profiler.nanoTimeMaybe();
     try {
-      Dirents unixDirents = NativePosixFiles.readdir(name,
-          followSymlinks ? ReadTypes.FOLLOW : ReadTypes.NOFOLLOW);
+      PackedDirents unixDirents =
+          NativePosixFiles.readdirBytes(
+              encode(name), followSymlinks ? ReadTypes.FOLLOW : ReadTypes.NOFOLLOW);
       Preconditions.checkState(unixDirents.hasTypes());
       List<Dirent> dirents = Lists.newArrayListWithCapacity(unixDirents.size());
       for (int i = 0; i < unixDirents.size(); i++) {
@@ -163,6 +212,153 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     }
   }
 
+  @Override
+  protected Map<String, FileStatus> readdirWithStats(Path path, boolean followSymlinks)
+      throws IOException {
+    String name = path.getPathString();
+    long startTime = Profiler.nanoTimeMaybe();
+    try {
+      StatDirents unixDirents = NativePosixFiles.readdirWithStats(name, followSymlinks);
+      StatBatch stats = unixDirents.getStats();
+      Map<String, FileStatus> result = Maps.newLinkedHashMapWithExpectedSize(unixDirents.size());
+      for (int i = 0; i < unixDirents.size(); i++) {
+        result.put(
+            unixDirents.getName(i),
+            stats.getErrno(i) == 0 ? new UnixBatchStat.BatchFileStatus(stats, i) : null);
+      }
+      return result;
+    } finally {
+      profiler.logSimpleTask(startTime, ProfilerTask.VFS_DIR, name);
+    }
+  }
+
+  @Override
+  protected Map<Path, FileStatus> globTree(
+      Path base,
+      Collection<String> patterns,
+      boolean excludeDirectories,
+      Predicate<Path> dirPred,
+      Collection<String> dirPredHint)
+      throws IOException {
+    String name = base.getPathString();
+    long startTime = Profiler.nanoTimeMaybe();
+    TreeWalk walk;
+    try {
+      walk =
+          NativePosixFiles.walkTree(
+              name,
+              patterns.toArray(new String[0]),
+              new String[0],
+              dirPredHint.toArray(new String[0]),
+              excludeDirectories,
+              /*followSymlinks=*/ true,
+              GLOB_PARALLELISM);
+    } finally {
+      profiler.logSimpleTask(startTime, ProfilerTask.VFS_GLOB, name);
+    }
+
+    // The hint only decides which directories the walk skipped; dirPred has the final say.
+    for (int i = 0; i < walk.getPrunedDirectoryCount(); i++) {
+      if (dirPred.apply(base.getRelative(walk.getPrunedDirectory(i)))) {
+        return null;
+      }
+    }
+    Set<String> rejected = new HashSet<>();
+    for (int i = 0; i < walk.getVisitedDirectoryCount(); i++) {
+      String directory = walk.getVisitedDirectory(i);
+      if (!dirPred.apply(base.getRelative(directory))) {
+        rejected.add(directory);
+      }
+    }
+
+    StatDirents matches = walk.getMatches();
+    StatBatch stats = matches.getStats();
+    Map<Path, FileStatus> result = Maps.newHashMapWithExpectedSize(matches.size());
+    for (int i = 0; i < matches.size(); i++) {
+      String match = matches.getName(i);
+      if (!rejected.isEmpty() && isBelowAny(match, rejected)) {
+        continue;
+      }
+      result.put(
+          match.isEmpty() ? base : base.getRelative(match),
+          new UnixBatchStat.BatchFileStatus(stats, i));
+    }
+    return result;
+  }
+
+  @Override
+  protected boolean deleteTrees(Collection<Path> roots) throws IOException {
+    String[] names = new String[roots.size()];
+    int i = 0;
+    for (Path root : roots) {
+      names[i++] = root.getPathString();
+    }
+    if (names.length == 0) {
+      return true;
+    }
+    long startTime = Profiler.nanoTimeMaybe();
+    String[] errors;
+    try {
+      errors = NativePosixFiles.deleteTreesBatch(names, DELETE_PARALLELISM);
+    } finally {
+      profiler.logSimpleTask(startTime, ProfilerTask.VFS_DELETE, names[0]);
+    }
+    List<String> failures = new ArrayList<>();
+    for (String error : errors) {
+      if (error != null) {
+        failures.add(error);
+      }
+    }
+    if (!failures.isEmpty()) {
+      throw new IOException("Cannot delete " + Joiner.on(", ").join(failures));
+    }
+    return true;
+  }
+
+  @Override
+  protected boolean copyFile(Path source, Path target) throws IOException {
+    NativePosixFiles.copyFile(source.getPathString(), target.getPathString(), 0666);
+    return true;
+  }
+
+  @Override
+  protected boolean createSymlinkForest(Path root, Map<PathFragment, Path> links)
+      throws IOException {
+    StringBuilder paths = new StringBuilder();
+    StringBuilder targets = new StringBuilder();
+    for (Map.Entry<PathFragment, Path> link : links.entrySet()) {
+      paths.append(link.getKey().getPathString()).append('\0');
+      if (link.getValue() != null) {
+        targets.append(link.getValue().getPathString());
+      }
+      targets.append('\0');
+    }
+    NativePosixFiles.createSymlinkForest(
+        root.getPathString(),
+        paths.toString().getBytes(ISO_8859_1),
+        targets.toString().getBytes(ISO_8859_1),
+        SYMLINK_FOREST_PARALLELISM);
+    return true;
+  }
+
+  /** Returns whether the relative path {@code path} is or is below one of {@code directories}. */
+  private static boolean isBelowAny(String path, Set<String> directories) {
+    for (int end = path.indexOf('/'); end != -1; end = path.indexOf('/', end + 1)) {
+      if (directories.contains(path.substring(0, end))) {
+        return true;
+      }
+    }
+    return directories.contains(path);
+  }
+
+  /**
+   * Encodes a path for the {@code *Bytes} methods of {@link NativePosixFiles}, which are cheaper to
+   * call than those taking Strings; see {@link NativePosixFiles#statBytes}.
+   */
+  private static byte[] encode(String path) {
+    return path.getBytes(ISO_8859_1);
+  }
+
   @Override
   protected FileStatus stat(Path path, boolean followSymlinks) throws IOException {
     return statInternal(path, followSymlinks);
@@ -174,8 +370,8 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     long startTime = Profiler.nanoTimeMaybe();
     try {
       return new UnixFileStatus(followSymlinks
-                                      ? NativePosixFiles.stat(name)
-                                      : NativePosixFiles.lstat(name));
+                                      ? NativePosixFiles.statBytes(encode(name))
+                                      : NativePosixFiles.lstatBytes(encode(name)));
     } finally {
       profiler.logSimpleTask(startTime, ProfilerTask.VFS_STAT, name);
     }
@@ -190,8 +386,8 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     long startTime = Profiler.nanoTimeMaybe();
     try {
       ErrnoFileStatus stat = followSymlinks
-          ? NativePosixFiles.errnoStat(name)
-          : NativePosixFiles.errnoLstat(name);
+          ? NativePosixFiles.errnoStatBytes(encode(name))
+          : NativePosixFiles.errnoLstatBytes(encode(name));
       return stat.hasError() ? null : new UnixFileStatus(stat);
     } finally {
       profiler.logSimpleTask(startTime, ProfilerTask.VFS_STAT, name);
@@ -213,8 +409,8 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     long startTime = Profiler.nanoTimeMaybe();
     try {
       ErrnoFileStatus stat = followSymlinks
-          ? NativePosixFiles.errnoStat(name)
-          : NativePosixFiles.errnoLstat(name);
+          ? NativePosixFiles.errnoStatBytes(encode(name))
+          : NativePosixFiles.errnoLstatBytes(encode(name));
       if (!stat.hasError()) {
         return new UnixFileStatus(stat);
       }
@@ -336,7 +532,8 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     String name = path.toString();
     long startTime = Profiler.nanoTimeMaybe();
     try {
-      return PathFragment.create(NativePosixFiles.readlink(name));
+      return PathFragment.create(
+          new String(NativePosixFiles.readlinkBytes(encode(name)), ISO_8859_1));
     } catch (IOException e) {
       // EINVAL => not a symbolic link.  Anything else is a real error.
       throw e.getMessage().endsWith("(Invalid argument)") ? new NotASymlinkException(path) : e;
@@ -397,20 +594,57 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     }
   }
 
+  @Override
+  protected byte[] getFastDigest(Path path, HashFunction hashFunction) throws IOException {
+    // A cached digest lets file values hold the digest instead of the change time, which setting
+    // the attribute has changed.
+    return cacheDigestsInXattrs
+        ? NativePosixFiles.getCachedDigest(path.toString(), toNativeDigest(hashFunction))
+        : super.getFastDigest(path, hashFunction);
+  }
+
   @Override
   protected byte[] getDigest(Path path, HashFunction hashFunction) throws IOException {
     String name = path.toString();
     long startTime = Profiler.nanoTimeMaybe();
     try {
-      if (hashFunction == HashFunction.MD5) {
-        return NativePosixFiles.md5sum(name).asBytes();
-      }
-      return super.getDigest(path, hashFunction);
+      int algorithm = toNativeDigest(hashFunction);
+      return cacheDigestsInXattrs
+          ? NativePosixFiles.getOrComputeDigest(name, algorithm)
+          : NativePosixFiles.digestAsBytes(name, algorithm);
     } finally {
       profiler.logSimpleTask(startTime, ProfilerTask.VFS_MD5, name);
     }
   }
 
+  @Override
+  protected byte[][] getDigests(List<Path> paths) throws IOException {
+    String[] names = new String[paths.size()];
+    for (int i = 0; i < names.length; i++) {
+      names[i] = paths.get(i).getPathString();
+    }
+    long startTime = Profiler.nanoTimeMaybe();
+    try {
+      return NativePosixFiles.batchDigest(
+          names, toNativeDigest(getDigestFunction()), cacheDigestsInXattrs, DIGEST_PARALLELISM);
+    } finally {
+      profiler.logSimpleTask(startTime, ProfilerTask.VFS_MD5, names.length + " files");
+    }
+  }
+
+  /** Returns the {@code NativePosixFiles.DIGEST_*} constant for {@code hashFunction}. */
+  static int toNativeDigest(HashFunction hashFunction) {
+    switch (hashFunction) {
+      case MD5:
+        return NativePosixFiles.DIGEST_MD5;
+      case SHA1:
+        return NativePosixFiles.DIGEST_SHA1;
+      case SHA256:
+        return NativePosixFiles.DIGEST_SHA256;
+    }
+    throw new IllegalArgumentException(hashFunction.toString());
+  }
+
   @Override
   protected void createFSDependentHardLink(Path linkPath, Path originalPath)
       throws IOException {
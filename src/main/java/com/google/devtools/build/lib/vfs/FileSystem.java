@@ -17,7 +17,9 @@ package com.google.devtools.build.lib.vfs;
 import static java.nio.charset.StandardCharsets.ISO_8859_1;
 
 import com.google.common.base.Preconditions;
+import com.google.common.base.Predicate;
 import com.google.common.collect.Lists;
+import com.google.common.collect.Maps;
 import com.google.common.hash.Hashing;
 import com.google.common.io.ByteSource;
 import com.google.common.io.CharStreams;
@@ -32,6 +34,8 @@ import java.io.OutputStream;
 import java.nio.file.FileAlreadyExistsException;
 import java.util.Collection;
 import java.util.List;
+import java.util.Map;
+import javax.annotation.Nullable;
 
 /**
  * This interface models a file system using UNIX the naming scheme.
@@ -266,6 +270,71 @@ public abstract class FileSystem {
     return null;
   }
 
+  /**
+   * Returns a {@link BatchStat} for paths relative to {@code root} that is faster than stat()ing
+   * them one by one, or {@code null} if this file system has none.
+   */
+  public BatchStat getBatchStatter(Path root) {
+    return null;
+  }
+
+  /**
+   * Expands the {@link UnixGlob} patterns {@code patterns} below the directory {@code base} in a
+   * single bulk operation, or returns {@code null} if this file system cannot do that, in which
+   * case {@link UnixGlob} visits the directories one by one.
+   *
+   * <p>Directories for which {@code dirPred} is false are neither returned nor traversed, as with
+   * {@link UnixGlob.Builder#setDirectoryFilter}. {@code dirPredHint} names files that make {@code
+   * dirPred} reject the directory containing them; implementations may use the hint to decide
+   * which directories to skip without calling back, but must still get the same result as if they
+   * called {@code dirPred} for every directory, e.g. by returning {@code null} if it disagrees.
+   *
+   * @return the matching paths with their stat() (following symlinks), in no particular order
+   * @throws IOException if a directory below {@code base} could not be read
+   */
+  @Nullable
+  protected Map<Path, FileStatus> globTree(
+      Path base,
+      Collection<String> patterns,
+      boolean excludeDirectories,
+      Predicate<Path> dirPred,
+      Collection<String> dirPredHint)
+      throws IOException {
+    return null;
+  }
+
+  /**
+   * Deletes each of {@code roots} and everything below it, like {@link FileSystemUtils#deleteTree},
+   * in a single bulk operation, or returns false without deleting anything if this file system
+   * cannot do that.
+   *
+   * @throws IOException if some files could not be deleted; the message names the first failure
+   *     below each root for which that happened
+   */
+  protected boolean deleteTrees(Collection<Path> roots) throws IOException {
+    return false;
+  }
+
+  /**
+   * Copies the contents of the file {@code source} to the new file {@code target} faster than
+   * through streams, or returns false without creating {@code target} if this file system cannot
+   * do that. Only the contents are copied, not the metadata.
+   *
+   * @throws IOException if the copy failed
+   */
+  protected boolean copyFile(Path source, Path target) throws IOException {
+    return false;
+  }
+
+  /**
+   * Creates the links of {@link FileSystemUtils#createSymlinkForest} in a single bulk operation,
+   * or returns false without creating anything if this file system cannot do that.
+   */
+  protected boolean createSymlinkForest(Path root, Map<PathFragment, Path> links)
+      throws IOException {
+    return false;
+  }
+
   /**
    * Gets a fast digest for the given path and hash function type, or {@code null} if there
    * isn't one available or the filesystem doesn't support them. This digest should be
@@ -319,6 +388,16 @@ public abstract class FileSystem {
     return getDigest(path, digestFunction);
   }
 
+  /**
+   * Returns the digests of many files at once, in the order given, or null if this file system
+   * cannot do that. An element is null if the digest of that file could not be computed. See
+   * {@link FileSystemUtils#getDigests}.
+   */
+  @Nullable
+  protected byte[][] getDigests(List<Path> paths) throws IOException {
+    return null;
+  }
+
   /**
    * Returns true if "path" denotes an existing symbolic link. See
    * {@link Path#isSymbolicLink} for specification.
@@ -618,6 +697,23 @@ public abstract class FileSystem {
     return dirents;
   }
 
+  /**
+   * Returns the names of all entries within the directory {@code path}, mapped to their status, or
+   * to null if they could not be stat()ed (e.g. because they were deleted concurrently).
+   *
+   * @param followSymlinks whether to follow symlinks when stat()ing the individual entries.
+   * @throws IOException if there was an error reading the directory entries
+   */
+  protected Map<String, FileStatus> readdirWithStats(Path path, boolean followSymlinks)
+      throws IOException {
+    Collection<String> children = getDirectoryEntries(path);
+    Map<String, FileStatus> result = Maps.newLinkedHashMapWithExpectedSize(children.size());
+    for (String child : children) {
+      result.put(child, statNullable(path.getChild(child), followSymlinks));
+    }
+    return result;
+  }
+
   /**
    * Returns true iff the file represented by {@code path} is readable.
    *
@@ -17,11 +17,13 @@ import static java.nio.charset.StandardCharsets.ISO_8859_1;
 
 import com.google.common.base.Preconditions;
 import com.google.common.base.Predicate;
+import com.google.common.collect.ImmutableList;
 import com.google.common.io.ByteSink;
 import com.google.common.io.ByteSource;
 import com.google.common.io.ByteStreams;
 import com.google.devtools.build.lib.concurrent.ThreadSafety.ConditionallyThreadSafe;
 import com.google.devtools.build.lib.concurrent.ThreadSafety.ThreadSafe;
+import java.io.FileNotFoundException;
 import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
@@ -29,7 +31,10 @@ import java.nio.charset.Charset;
 import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.Collection;
+import java.util.HashSet;
 import java.util.List;
+import java.util.Map;
+import java.util.Set;
 
 /**
  * Helper functions that implement often-used complex operations on file
@@ -400,7 +405,7 @@ public class FileSystemUtils {
       throw new IOException("error copying file: "
           + "couldn't delete destination: " + e.getMessage());
     }
-    asByteSource(from).copyTo(asByteSink(to));
+    copyContents(from, to);
     to.setLastModifiedTime(from.getLastModifiedTime()); // Preserve mtime.
     if (!from.isWritable()) {
       to.setWritable(false); // Make file read-only if original was read-only.
@@ -408,6 +413,17 @@ public class FileSystemUtils {
     to.setExecutable(from.isExecutable()); // Copy executable bit.
   }
 
+  /**
+   * Copies the contents of "from" to the new file "to", without going through streams if the file
+   * system can do better, e.g. by sharing the data on a copy-on-write file system.
+   */
+  private static void copyContents(Path from, Path to) throws IOException {
+    FileSystem fileSystem = from.getFileSystem();
+    if (fileSystem != to.getFileSystem() || !fileSystem.copyFile(from, to)) {
+      asByteSource(from).copyTo(asByteSink(to));
+    }
+  }
+
   /**
    * Moves the file from location "from" to location "to", while overwriting a
    * potentially existing "to". File's last modified time, executable and
@@ -428,7 +444,7 @@ public class FileSystemUtils {
     try {
       from.renameTo(to);
     } catch (IOException e) {
-      asByteSource(from).copyTo(asByteSink(to));
+      copyContents(from, to);
       if (!from.delete()) {
         if (!to.delete()) {
           throw new IOException("Unable to delete " + to);
@@ -515,6 +531,9 @@ public class FileSystemUtils {
    */
   @ThreadSafe
   public static void deleteTree(Path p) throws IOException {
+    if (p.getFileSystem().deleteTrees(ImmutableList.of(p))) {
+      return;
+    }
     deleteTreesBelow(p);
     p.delete();
   }
@@ -531,12 +550,81 @@ public class FileSystemUtils {
       dir.setReadable(true);
       dir.setWritable(true);
       dir.setExecutable(true);
-      for (Path child : dir.getDirectoryEntries()) {
+      Collection<Path> children = dir.getDirectoryEntries();
+      if (dir.getFileSystem().deleteTrees(children)) {
+        return;
+      }
+      for (Path child : children) {
         deleteTree(child);
       }
     }
   }
 
+  /**
+   * Returns the digests of the given files, in the same order, following symbolic links. The
+   * files must all be on the same file system, which may hash them concurrently.
+   *
+   * @throws IOException if the digest of any file could not be computed
+   */
+  @ThreadSafe
+  public static List<byte[]> getDigests(List<Path> paths) throws IOException {
+    if (paths.isEmpty()) {
+      return ImmutableList.of();
+    }
+    byte[][] digests = paths.get(0).getFileSystem().getDigests(paths);
+    List<byte[]> result = new ArrayList<>(paths.size());
+    for (int i = 0; i < paths.size(); i++) {
+      // Hash the file again on its own to get the error, or if there was no bulk operation.
+      result.add(digests != null && digests[i] != null ? digests[i] : paths.get(i).getDigest());
+    }
+    return result;
+  }
+
+  /**
+   * Creates a symlink at {@code root.getRelative(key)} for each key of {@code links}, pointing to
+   * the corresponding value, or an empty file where the value is null, along with all missing
+   * parent directories. Symlinks that already point to their target are kept; any other file in
+   * the way is replaced. Does not follow symlinks below {@code root} other than those in the way
+   * of parent directories.
+   *
+   * <p>All parent directories are created before any of the links, so that if one link happens to
+   * be nested below another link to a directory, creating it fails with EEXIST rather than
+   * writing through the other link into its target.
+   *
+   * @throws IOException if a directory or link could not be created
+   */
+  @ThreadSafe
+  public static void createSymlinkForest(Path root, Map<PathFragment, Path> links)
+      throws IOException {
+    if (root.getFileSystem().createSymlinkForest(root, links)) {
+      return;
+    }
+    Set<Path> createdDirs = new HashSet<>();
+    for (PathFragment link : links.keySet()) {
+      Path dir = root.getRelative(link).getParentDirectory();
+      if (createdDirs.add(dir)) {
+        dir.createDirectoryAndParents();
+      }
+    }
+    for (Map.Entry<PathFragment, Path> entry : links.entrySet()) {
+      Path link = root.getRelative(entry.getKey());
+      FileStatus linkStat = link.statNullable(Symlinks.NOFOLLOW);
+      if (linkStat != null) {
+        if (linkStat.isSymbolicLink()
+            && entry.getValue() != null
+            && link.readSymbolicLink().equals(entry.getValue().asFragment())) {
+          continue;
+        }
+        link.delete();
+      }
+      if (entry.getValue() != null) {
+        link.createSymbolicLink(entry.getValue());
+      } else {
+        createEmptyFile(link);
+      }
+    }
+  }
+
   /**
    * Copies all dir trees under a given 'from' dir to location 'to', while overwriting all files in
    * the potentially existing 'to'. Resolves symbolic links if {@code followSymlinks ==
@@ -557,12 +645,15 @@ public class FileSystemUtils {
       throw new IllegalArgumentException(to + " is a subdirectory of " + from);
     }
 
-    Collection<Path> entries = from.getDirectoryEntries();
-    for (Path entry : entries) {
-      Path toPath = to.getChild(entry.getBaseName());
-      if (!followSymlinks.toBoolean() && entry.isSymbolicLink()) {
+    for (Map.Entry<String, FileStatus> child : from.readdirWithStats(followSymlinks).entrySet()) {
+      Path entry = from.getChild(child.getKey());
+      Path toPath = to.getChild(child.getKey());
+      FileStatus stat = child.getValue();
+      if (stat == null) {
+        throw new FileNotFoundException(entry + " (No such file or directory)");
+      } else if (stat.isSymbolicLink()) {
         FileSystemUtils.ensureSymbolicLink(toPath, entry.readSymbolicLink());
-      } else if (entry.isFile()) {
+      } else if (stat.isFile()) {
         copyFile(entry, toPath);
       } else {
         toPath.createDirectory();
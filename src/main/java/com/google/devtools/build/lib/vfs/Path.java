@@ -30,6 +30,7 @@ import java.io.OutputStream;
 import java.io.Serializable;
 import java.util.ArrayList;
 import java.util.Collection;
+import java.util.Map;
 import javax.annotation.Nullable;
 
 /**
@@ -393,6 +394,19 @@ public class Path
     return fileSystem.readdir(this, followSymlinks.toBoolean());
   }
 
+  /**
+   * Returns the names of all entries within the directory denoted by the current path, mapped to
+   * their status, or to null if they could not be stat()ed. Follows symbolic links when stat()ing
+   * the entries if {@code followSymlinks} is true. Cheaper than stat()ing the results of {@link
+   * #getDirectoryEntries} one by one on some file systems.
+   *
+   * @throws FileNotFoundException If the directory is not found
+   * @throws IOException If the path does not denote a directory
+   */
+  public Map<String, FileStatus> readdirWithStats(Symlinks followSymlinks) throws IOException {
+    return fileSystem.readdirWithStats(this, followSymlinks.toBoolean());
+  }
+
   /**
    * Returns the status of a file, following symbolic links.
    *
@@ -39,6 +39,7 @@ import java.io.IOException;
 import java.util.Collection;
 import java.util.Collections;
 import java.util.List;
+import java.util.Map;
 import java.util.Objects;
 import java.util.Set;
 import java.util.concurrent.ExecutionException;
@@ -47,6 +48,7 @@ import java.util.concurrent.ThreadPoolExecutor;
 import java.util.concurrent.atomic.AtomicLong;
 import java.util.concurrent.atomic.AtomicReference;
 import java.util.regex.Pattern;
+import javax.annotation.Nullable;
 
 /**
  * Implementation of a subset of UNIX-style file globbing, expanding "*" and "?" as wildcards, but
@@ -63,6 +65,7 @@ public final class UnixGlob {
   private static List<Path> globInternal(Path base, Collection<String> patterns,
                                          boolean excludeDirectories,
                                          Predicate<Path> dirPred,
+                                         Collection<String> dirPredHint,
                                          boolean checkForInterruption,
                                          FilesystemCalls syscalls,
                                          ThreadPoolExecutor threadPool)
@@ -71,13 +74,14 @@ public final class UnixGlob {
         (threadPool == null)
             ? new GlobVisitor(checkForInterruption)
             : new GlobVisitor(threadPool, checkForInterruption);
-    return visitor.glob(base, patterns, excludeDirectories, dirPred, syscalls);
+    return visitor.glob(base, patterns, excludeDirectories, dirPred, dirPredHint, syscalls);
   }
 
   private static long globInternalAndReturnNumGlobTasksForTesting(
       Path base, Collection<String> patterns,
       boolean excludeDirectories,
       Predicate<Path> dirPred,
+      Collection<String> dirPredHint,
       boolean checkForInterruption,
       FilesystemCalls syscalls,
       ThreadPoolExecutor threadPool) throws IOException, InterruptedException {
@@ -85,7 +89,7 @@ public final class UnixGlob {
         (threadPool == null)
             ? new GlobVisitor(checkForInterruption)
             : new GlobVisitor(threadPool, checkForInterruption);
-    visitor.glob(base, patterns, excludeDirectories, dirPred, syscalls);
+    visitor.glob(base, patterns, excludeDirectories, dirPred, dirPredHint, syscalls);
     return visitor.getNumGlobTasksForTesting();
   }
 
@@ -94,12 +98,13 @@ public final class UnixGlob {
       Collection<String> patterns,
       boolean excludeDirectories,
       Predicate<Path> dirPred,
+      Collection<String> dirPredHint,
       FilesystemCalls syscalls,
       boolean checkForInterruption,
       ThreadPoolExecutor threadPool) {
     Preconditions.checkNotNull(threadPool, "%s %s", base, patterns);
     return new GlobVisitor(threadPool, checkForInterruption)
-        .globAsync(base, patterns, excludeDirectories, dirPred, syscalls);
+        .globAsync(base, patterns, excludeDirectories, dirPred, dirPredHint, syscalls);
   }
 
   /**
@@ -264,6 +269,23 @@ public final class UnixGlob {
      * Return the stat() for the given path, or null.
      */
     FileStatus statIfFound(Path path, Symlinks symlinks) throws IOException;
+
+    /**
+     * Expands the patterns below {@code base} in a single bulk operation, like {@link
+     * FileSystem#globTree}, or returns null to have the glob visit the directories one by one
+     * through {@link #readdir} and {@link #statIfFound}. Implementations that cache those calls
+     * should make the stats returned here visible to them.
+     */
+    @Nullable
+    default Map<Path, FileStatus> globTree(
+        Path base,
+        Collection<String> patterns,
+        boolean excludeDirectories,
+        Predicate<Path> dirPred,
+        Collection<String> dirPredHint)
+        throws IOException {
+      return null;
+    }
   }
 
   public static FilesystemCalls DEFAULT_SYSCALLS = new FilesystemCalls() {
@@ -276,6 +298,18 @@ public final class UnixGlob {
     public FileStatus statIfFound(Path path, Symlinks symlinks) throws IOException {
       return path.statIfFound(symlinks);
     }
+
+    @Override
+    public Map<Path, FileStatus> globTree(
+        Path base,
+        Collection<String> patterns,
+        boolean excludeDirectories,
+        Predicate<Path> dirPred,
+        Collection<String> dirPredHint)
+        throws IOException {
+      return base.getFileSystem()
+          .globTree(base, patterns, excludeDirectories, dirPred, dirPredHint);
+    }
   };
 
   public static final AtomicReference<FilesystemCalls> DEFAULT_SYSCALLS_REF =
@@ -295,6 +329,7 @@ public final class UnixGlob {
     private List<String> patterns;
     private boolean excludeDirectories;
     private Predicate<Path> pathFilter;
+    private Collection<String> pathFilterHint;
     private ThreadPoolExecutor threadPool;
     private AtomicReference<? extends FilesystemCalls> syscalls =
         new AtomicReference<>(DEFAULT_SYSCALLS);
@@ -378,13 +413,23 @@ public final class UnixGlob {
       return this;
     }
 
+    /**
+     * Allows the glob to be expanded in a single bulk operation, see {@link
+     * FilesystemCalls#globTree}. {@code pathFilterHint} names the files whose presence makes the
+     * directory filter reject the directory containing them.
+     */
+    public Builder allowBulkTraversal(Collection<String> pathFilterHint) {
+      this.pathFilterHint = pathFilterHint;
+      return this;
+    }
+
     /**
      * Executes the glob.
      */
     public List<Path> glob() throws IOException {
       try {
-        return globInternal(base, patterns, excludeDirectories, pathFilter, false, syscalls.get(),
-            threadPool);
+        return globInternal(base, patterns, excludeDirectories, pathFilter, pathFilterHint, false,
+            syscalls.get(), threadPool);
       } catch (InterruptedException e) {
         // cannot happen, since we told globInternal not to throw
         throw new IllegalStateException(e);
@@ -397,15 +442,15 @@ public final class UnixGlob {
      * @throws InterruptedException if the thread is interrupted.
      */
     public List<Path> globInterruptible() throws IOException, InterruptedException {
-      return globInternal(base, patterns, excludeDirectories, pathFilter, true, syscalls.get(),
-          threadPool);
+      return globInternal(base, patterns, excludeDirectories, pathFilter, pathFilterHint, true,
+          syscalls.get(), threadPool);
     }
 
     @VisibleForTesting
     public long globInterruptibleAndReturnNumGlobTasksForTesting()
         throws IOException, InterruptedException {
       return globInternalAndReturnNumGlobTasksForTesting(base, patterns, excludeDirectories,
-          pathFilter, true, syscalls.get(), threadPool);
+          pathFilter, pathFilterHint, true, syscalls.get(), threadPool);
     }
 
     /**
@@ -420,6 +465,7 @@ public final class UnixGlob {
           patterns,
           excludeDirectories,
           pathFilter,
+          pathFilterHint,
           syscalls.get(),
           checkForInterrupt,
           threadPool);
@@ -516,16 +562,19 @@ public final class UnixGlob {
      * used as a complete path segment it matches the filenames in
      * subdirectories recursively.
      *
+     * <p>If {@code dirPredHint} is non-null, the file system may evaluate the glob in bulk, see
+     * {@link FileSystem#globTree}.
+     *
      * @throws IllegalArgumentException if any glob pattern
      *         {@linkplain #checkPatternForError(String) contains errors} or if any include pattern
      *         segment contains <code>**</code> but not equal to it.
      */
     public List<Path> glob(Path base, Collection<String> patterns,
                            boolean excludeDirectories, Predicate<Path> dirPred,
-                           FilesystemCalls syscalls)
+                           Collection<String> dirPredHint, FilesystemCalls syscalls)
         throws IOException, InterruptedException {
       try {
-        return globAsync(base, patterns, excludeDirectories, dirPred, syscalls).get();
+        return globAsync(base, patterns, excludeDirectories, dirPred, dirPredHint, syscalls).get();
       } catch (ExecutionException e) {
         Throwable cause = e.getCause();
         Throwables.propagateIfPossible(cause, IOException.class);
@@ -546,6 +595,7 @@ public final class UnixGlob {
         Collection<String> patterns,
         boolean excludeDirectories,
         Predicate<Path> dirPred,
+        Collection<String> dirPredHint,
         FilesystemCalls syscalls) {
 
       FileStatus baseStat;
@@ -560,24 +610,14 @@ public final class UnixGlob {
 
       List<String[]> splitPatterns = checkAndSplitPatterns(patterns);
 
-      // We do a dumb loop, even though it will likely duplicate logical work (note that the
-      // physical filesystem operations are cached). In order to optimize, we would need to keep
-      // track of which patterns shared sub-patterns and which did not (for example consider the
-      // glob [*/*.java, sub/*.java, */*.txt]).
       pendingOps.incrementAndGet();
       try {
-        for (String[] splitPattern : splitPatterns) {
-          boolean containsRecursivePattern = false;
-          for (String pattern : splitPattern) {
-            if (isRecursivePattern(pattern)) {
-              containsRecursivePattern = true;
-              break;
-            }
-          }
-          GlobTaskContext context = containsRecursivePattern
-              ? new RecursiveGlobTaskContext(splitPattern, excludeDirectories, dirPred, syscalls)
-              : new GlobTaskContext(splitPattern, excludeDirectories, dirPred, syscalls);
-          context.queueGlob(base, baseStat.isDirectory(), 0);
+        if (dirPredHint != null && baseStat.isDirectory()) {
+          queueBulkGlob(
+              base, patterns, splitPatterns, excludeDirectories, dirPred, dirPredHint, syscalls);
+        } else {
+          queueGlobs(base, baseStat.isDirectory(), splitPatterns, excludeDirectories, dirPred,
+              syscalls);
         }
       } finally {
         decrementAndCheckDone();
@@ -586,6 +626,69 @@ public final class UnixGlob {
       return result;
     }
 
+    private void queueGlobs(Path base, boolean baseIsDir, List<String[]> splitPatterns,
+        boolean excludeDirectories, Predicate<Path> dirPred, FilesystemCalls syscalls) {
+      // We do a dumb loop, even though it will likely duplicate logical work (note that the
+      // physical filesystem operations are cached). In order to optimize, we would need to keep
+      // track of which patterns shared sub-patterns and which did not (for example consider the
+      // glob [*/*.java, sub/*.java, */*.txt]).
+      for (String[] splitPattern : splitPatterns) {
+        boolean containsRecursivePattern = false;
+        for (String pattern : splitPattern) {
+          if (isRecursivePattern(pattern)) {
+            containsRecursivePattern = true;
+            break;
+          }
+        }
+        GlobTaskContext context = containsRecursivePattern
+            ? new RecursiveGlobTaskContext(splitPattern, excludeDirectories, dirPred, syscalls)
+            : new GlobTaskContext(splitPattern, excludeDirectories, dirPred, syscalls);
+        context.queueGlob(base, baseIsDir, 0);
+      }
+    }
+
+    /**
+     * Queues a task that has the file system expand all patterns at once, falling back to {@link
+     * #queueGlobs} if it cannot.
+     */
+    private void queueBulkGlob(final Path base, final Collection<String> patterns,
+        final List<String[]> splitPatterns, final boolean excludeDirectories,
+        final Predicate<Path> dirPred, final Collection<String> dirPredHint,
+        final FilesystemCalls syscalls) {
+      enqueue(new Runnable() {
+        @Override
+        public void run() {
+          try {
+            if (!dirPred.apply(base)) {
+              return;
+            }
+            Map<Path, FileStatus> matches =
+                syscalls.globTree(base, patterns, excludeDirectories, dirPred, dirPredHint);
+            if (matches != null) {
+              results.addAll(matches.keySet());
+            } else {
+              queueGlobs(base, true, splitPatterns, excludeDirectories, dirPred, syscalls);
+            }
+          } catch (IOException e) {
+            ioException.set(e);
+          } catch (RuntimeException e) {
+            runtimeException.set(e);
+          } catch (Error e) {
+            error.set(e);
+          }
+        }
+
+        @Override
+        public String toString() {
+          return String.format(
+              "%s bulk glob(include=[%s], exclude_directories=%s)",
+              base.getPathString(),
+              "\"" + Joiner.on("\", \"").join(patterns) + "\"",
+              excludeDirectories);
+        }
+      });
+    }
+
     private Throwable getMostSeriousThrowableSoFar() {
       if (error.get() != null) {
         return error.get();
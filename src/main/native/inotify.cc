@@ -0,0 +1,401 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <jni.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "src/main/native/unix_jni.h"
+
+namespace {
+
+const uint32_t kWatchMask = IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE |
+                            IN_DELETE | IN_DELETE_SELF | IN_MODIFY |
+                            IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO |
+                            IN_DONT_FOLLOW | IN_EXCL_UNLINK | IN_ONLYDIR;
+
+// The maximum number of changed paths kept between two polls. Past that, the
+// next poll reports everything as modified, which is cheaper for the build
+// than looking at that many paths one by one anyway.
+const size_t kMaxChangedPaths = 1 << 18;
+
+// Watches a directory tree with one inotify watch per directory.
+//
+// Events are read by a dedicated thread (see Run), so that the kernel queue
+// does not overflow between builds, and are coalesced into the set of paths
+// that changed since the last poll.
+class InotifyWatcher {
+ public:
+  explicit InotifyWatcher(const std::string &root)
+      : root_(root), fd_(-1), overflow_(false), error_(0) {
+    wake_fds_[0] = wake_fds_[1] = -1;
+  }
+
+  ~InotifyWatcher() {
+    for (int fd : {fd_, wake_fds_[0], wake_fds_[1]}) {
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+  }
+
+  // Watches the whole tree. Returns 0 on success, or an errno value.
+  int Start() {
+    if ((fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1 ||
+        pipe2(wake_fds_, O_CLOEXEC) == -1) {
+      return errno;
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    return Watch("", false);
+  }
+
+  // Reads events until Stop() is called.
+  void Run() {
+    struct pollfd fds[2];
+    fds[0].fd = fd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fds_[0];
+    fds[1].events = POLLIN;
+    for (;;) {
+      if (poll(fds, 2, -1) == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        std::lock_guard<std::mutex> lock(mu_);
+        SetError(errno);
+        return;
+      }
+      if (fds[1].revents != 0) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(mu_);
+      Drain();
+    }
+  }
+
+  // Makes Run() return. May be called before Run() starts.
+  void Stop() {
+    char c = 0;
+    while (write(wake_fds_[1], &c, 1) == -1 && errno == EINTR) { }
+  }
+
+  // Moves the paths (relative to the root) that changed since the last call
+  // to "paths", or sets "everything" if too much changed to say what. Returns
+  // 0, or an errno value if the watcher stopped working.
+  int Poll(std::vector<std::string> *paths, bool *everything) {
+    std::lock_guard<std::mutex> lock(mu_);
+    // Whatever happened before this call must be part of its result.
+    Drain();
+    if (error_ != 0) {
+      return error_;
+    }
+    *everything = overflow_;
+    paths->assign(changed_.begin(), changed_.end());
+    changed_.clear();
+    overflow_ = false;
+    return 0;
+  }
+
+ private:
+  std::string Join(const std::string &dir, const char *name) const {
+    return dir.empty() ? name : dir + "/" + name;
+  }
+
+  std::string Absolute(const std::string &path) const {
+    return path.empty() ? root_ : root_ + "/" + path;
+  }
+
+  void SetError(int error_number) {
+    if (error_ == 0) {
+      error_ = error_number;
+    }
+  }
+
+  void AddChanged(const std::string &path) {
+    if (overflow_) {
+      return;
+    }
+    changed_.insert(path);
+    if (changed_.size() > kMaxChangedPaths) {
+      overflow_ = true;
+      changed_.clear();
+    }
+  }
+
+  // Watches the directory "dir" and all directories below it. If
+  // "report_contents" is set, also records everything below "dir" as changed,
+  // since it was not watched before. Returns 0 on success, or an errno value.
+  int Watch(const std::string &dir, bool report_contents) {
+    std::vector<std::string> pending(1, dir);
+    while (!pending.empty()) {
+      std::string current;
+      current.swap(pending.back());
+      pending.pop_back();
+      std::string path = Absolute(current);
+      // The watch must be in place before the directory is listed, so that
+      // entries created concurrently are either listed or reported.
+      int wd = inotify_add_watch(fd_, path.c_str(), kWatchMask);
+      if (wd == -1) {
+        if (errno == ENOENT || errno == ENOTDIR) {
+          continue;  // Deleted (or replaced) since we heard of it.
+        }
+        return errno;
+      }
+      watched_[wd] = current;
+
+      DIR *dirh = opendir(path.c_str());
+      if (dirh == NULL) {
+        if (errno == ENOENT || errno == ENOTDIR) {
+          continue;
+        }
+        return errno;
+      }
+      struct dirent *entry;
+      while ((entry = readdir(dirh)) != NULL) {
+        if (entry->d_name[0] == '.' &&
+            (entry->d_name[1] == '\0' ||
+             (entry->d_name[1] == '.' && entry->d_name[2] == '\0'))) {
+          continue;
+        }
+        std::string child = Join(current, entry->d_name);
+        if (report_contents) {
+          AddChanged(child);
+        }
+        bool is_directory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+          portable_stat_struct statbuf;
+          is_directory = portable_lstat(Absolute(child).c_str(), &statbuf) ==
+                             0 &&
+                         S_ISDIR(statbuf.st_mode);
+        }
+        if (is_directory) {
+          pending.push_back(child);
+        }
+      }
+      closedir(dirh);
+    }
+    return 0;
+  }
+
+  // Stops watching "dir" and the directories below it.
+  void Unwatch(const std::string &dir) {
+    std::string prefix = dir + "/";
+    for (auto it = watched_.begin(); it != watched_.end();) {
+      if (it->second == dir || it->second.compare(0, prefix.size(), prefix) ==
+                                   0) {
+        inotify_rm_watch(fd_, it->first);
+        it = watched_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Processes all events that can be read without blocking.
+  void Drain() {
+    alignas(struct inotify_event) char buf[64 * 1024];
+    for (;;) {
+      ssize_t len = read(fd_, buf, sizeof(buf));
+      if (len == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno != EAGAIN) {
+          SetError(errno);
+        }
+        return;
+      }
+      for (char *p = buf; p < buf + len;) {
+        const struct inotify_event *event =
+            reinterpret_cast<const struct inotify_event *>(p);
+        HandleEvent(*event);
+        p += sizeof(struct inotify_event) + event->len;
+      }
+    }
+  }
+
+  void HandleEvent(const struct inotify_event &event) {
+    if (event.mask & IN_Q_OVERFLOW) {
+      overflow_ = true;
+      changed_.clear();
+      return;
+    }
+    auto it = watched_.find(event.wd);
+    if (it == watched_.end()) {
+      return;  // An event for a watch we already gave up on.
+    }
+    const std::string dir = it->second;
+    if (event.mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+      if (dir.empty()) {
+        SetError(ENOENT);  // The root went away.
+      }
+      if (event.mask & IN_IGNORED) {
+        watched_.erase(it);
+      }
+      return;
+    }
+    if (event.len == 0) {
+      AddChanged(dir);
+      return;
+    }
+
+    std::string path = Join(dir, event.name);
+    AddChanged(path);
+    if (!(event.mask & IN_ISDIR)) {
+      return;
+    }
+    if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+      int error_number = Watch(path, true);
+      if (error_number != 0) {
+        // The new directory is not watched, so we would miss changes to it.
+        SetError(error_number);
+      }
+    } else if (event.mask & IN_MOVED_FROM) {
+      // Nothing is reported for the entries below a directory that moved,
+      // and we do not know what they are.
+      Unwatch(path);
+      overflow_ = true;
+      changed_.clear();
+    }
+  }
+
+  const std::string root_;
+  int fd_;
+  int wake_fds_[2];
+
+  std::mutex mu_;
+  // The rest is guarded by mu_.
+  std::unordered_map<int, std::string> watched_;  // watch -> relative path
+  std::unordered_set<std::string> changed_;
+  bool overflow_;
+  int error_;
+};
+
+InotifyWatcher *GetWatcher(JNIEnv *env, jobject diff_awareness) {
+  jclass clazz = env->GetObjectClass(diff_awareness);
+  jfieldID fid = env->GetFieldID(clazz, "nativePointer", "J");
+  return reinterpret_cast<InotifyWatcher *>(
+      env->GetLongField(diff_awareness, fid));
+}
+
+}  // namespace
+
+/*
+ * Class:     com.google.devtools.build.lib.skyframe.LinuxInotifyDiffAwareness
+ * Method:    create
+ * Signature: (Ljava/lang/String;)V
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_skyframe_LinuxInotifyDiffAwareness_create(
+    JNIEnv *env, jobject diff_awareness, jstring root) {
+  const char *root_chars = GetStringLatin1Chars(env, root);
+  if (root_chars == NULL) {
+    return;
+  }
+  InotifyWatcher *watcher = new InotifyWatcher(root_chars);
+  int error_number = watcher->Start();
+  if (error_number != 0) {
+    delete watcher;
+    ::PostFileException(env, error_number, root_chars);
+    ReleaseStringLatin1Chars(root_chars);
+    return;
+  }
+  ReleaseStringLatin1Chars(root_chars);
+
+  jclass clazz = env->GetObjectClass(diff_awareness);
+  jfieldID fid = env->GetFieldID(clazz, "nativePointer", "J");
+  env->SetLongField(diff_awareness, fid, reinterpret_cast<jlong>(watcher));
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.skyframe.LinuxInotifyDiffAwareness
+ * Method:    run
+ * Signature: ()V
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_skyframe_LinuxInotifyDiffAwareness_run(
+    JNIEnv *env, jobject diff_awareness) {
+  GetWatcher(env, diff_awareness)->Run();
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.skyframe.LinuxInotifyDiffAwareness
+ * Method:    poll
+ * Signature: ()[Ljava/lang/String;
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_google_devtools_build_lib_skyframe_LinuxInotifyDiffAwareness_poll(
+    JNIEnv *env, jobject diff_awareness) {
+  std::vector<std::string> paths;
+  bool everything;
+  int error_number =
+      GetWatcher(env, diff_awareness)->Poll(&paths, &everything);
+  if (error_number != 0) {
+    ::PostException(env, error_number,
+                    "local file system watcher: " + ErrorMessage(error_number));
+    return NULL;
+  }
+  if (everything) {
+    return NULL;
+  }
+
+  jclass string_class = env->FindClass("java/lang/String");
+  jobjectArray result = env->NewObjectArray(paths.size(), string_class, NULL);
+  if (result == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < paths.size(); i++) {
+    jstring path = NewStringLatin1(env, paths[i].c_str());
+    if (path == NULL) {
+      return NULL;
+    }
+    env->SetObjectArrayElement(result, i, path);
+    env->DeleteLocalRef(path);
+  }
+  return result;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.skyframe.LinuxInotifyDiffAwareness
+ * Method:    stop
+ * Signature: ()V
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_skyframe_LinuxInotifyDiffAwareness_stop(
+    JNIEnv *env, jobject diff_awareness) {
+  GetWatcher(env, diff_awareness)->Stop();
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.skyframe.LinuxInotifyDiffAwareness
+ * Method:    destroy
+ * Signature: ()V
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_skyframe_LinuxInotifyDiffAwareness_destroy(
+    JNIEnv *env, jobject diff_awareness) {
+  delete GetWatcher(env, diff_awareness);
+}
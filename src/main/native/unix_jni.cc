@@ -26,17 +26,33 @@
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include <utime.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <set>
 #include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
 #include <vector>
 
 #include "src/main/native/macros.h"
 #include "src/main/cpp/util/md5.h"
 #include "src/main/cpp/util/port.h"
+#include "src/main/cpp/util/sha1.h"
+#include "src/main/cpp/util/sha256.h"
 
 using blaze_util::Md5Digest;
+using blaze_util::Sha1Digest;
+using blaze_util::Sha256Digest;
 
 ////////////////////////////////////////////////////////////////////////
 // Latin1 <--> java.lang.String conversion functions.
@@ -50,17 +66,19 @@ using blaze_util::Md5Digest;
 /**
  * Returns a new Java String for the specified Latin1 characters.
  */
-static jstring NewStringLatin1(JNIEnv *env, const char *str) {
+jstring NewStringLatin1(JNIEnv *env, const char *str) {
     int len = strlen(str);
     jchar buf[512];
     jchar *str1;
 
     if (len > 512) {
-      str1 = reinterpret_cast<jchar *>(malloc(len * sizeof(jchar)));
-      if (str1 == 0) {
-        ::PostException(env, ENOMEM, "Out of memory in NewStringLatin1");
-        return NULL;
+      // Reuse one buffer per thread for unusually long strings rather than
+      // allocating one for each.
+      static thread_local std::vector<jchar> long_buf;
+      if (long_buf.size() < static_cast<size_t>(len)) {
+        long_buf.resize(len);
       }
+      str1 = &long_buf[0];
     } else {
       str1 = buf;
     }
@@ -68,11 +86,7 @@ static jstring NewStringLatin1(JNIEnv *env, const char *str) {
     for (int i = 0; i < len ; i++) {
       str1[i] = (unsigned char) str[i];
     }
-    jstring result = env->NewString(str1, len);
-    if (str1 != buf) {
-      free(str1);
-    }
-    return result;
+    return env->NewString(str1, len);
 }
 
 /**
@@ -81,7 +95,7 @@ static jstring NewStringLatin1(JNIEnv *env, const char *str) {
  * are replaced by '?'.  Must be followed by a call to
  * ReleaseStringLatin1Chars.
  */
-static char *GetStringLatin1Chars(JNIEnv *env, jstring jstr) {
+char *GetStringLatin1Chars(JNIEnv *env, jstring jstr) {
   jint len = env->GetStringLength(jstr);
   const jchar *str = env->GetStringCritical(jstr, NULL);
   if (str == NULL) {
@@ -109,12 +123,51 @@ static char *GetStringLatin1Chars(JNIEnv *env, jstring jstr) {
  * Release the Latin1 chars returned by a prior call to
  * GetStringLatin1Chars.
  */
-static void ReleaseStringLatin1Chars(const char *s) {
+void ReleaseStringLatin1Chars(const char *s) {
   if (s != NULL) {
     free(const_cast<char *>(s));
   }
 }
 
+// The contents of a byte[] holding a Latin1-encoded path, as a nul-terminated
+// string. Unlike GetStringLatin1Chars, this copies the bytes as they are,
+// into a buffer on the stack unless the path is longer than PATH_MAX (in
+// which case the system call will fail anyway).
+class BytePath {
+ public:
+  BytePath(JNIEnv *env, jbyteArray path) : chars_(buffer_) {
+    jsize length = env->GetArrayLength(path);
+    if (static_cast<size_t>(length) >= sizeof(buffer_)) {
+      heap_buffer_.reset(new char[length + 1]);
+      chars_ = heap_buffer_.get();
+    }
+    env->GetByteArrayRegion(path, 0, length, reinterpret_cast<jbyte *>(chars_));
+    chars_[length] = '\0';
+  }
+
+  const char *c_str() const { return chars_; }
+
+ private:
+  char buffer_[PATH_MAX];
+  std::unique_ptr<char[]> heap_buffer_;
+  char *chars_;
+
+  BytePath(const BytePath &) = delete;
+  BytePath &operator=(const BytePath &) = delete;
+};
+
+// Returns a new byte[] holding the "length" bytes at "chars", or NULL if an
+// exception is pending.
+static jbyteArray NewByteArrayFromChars(JNIEnv *env, const char *chars,
+                                        size_t length) {
+  jbyteArray result = env->NewByteArray(length);
+  if (result != NULL && length > 0) {
+    env->SetByteArrayRegion(result, 0, length,
+                            reinterpret_cast<const jbyte *>(chars));
+  }
+  return result;
+}
+
 ////////////////////////////////////////////////////////////////////////
 
 // See unix_jni.h.
@@ -261,6 +314,25 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_readlink(JNIEnv *env,
   return r;
 }
 
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    readlinkBytes
+ * Signature: ([B)[B
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_readlinkBytes(
+    JNIEnv *env, jclass clazz, jbyteArray path) {
+  BytePath path_chars(env, path);
+  char target[PATH_MAX];
+  ssize_t len = readlink(path_chars.c_str(), target, arraysize(target));
+  if (len == -1) {
+    ::PostFileException(env, errno, path_chars.c_str());
+    return NULL;
+  }
+  return NewByteArrayFromChars(env, target, len);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_devtools_build_lib_unix_NativePosixFiles_chmod(JNIEnv *env,
                                                   jclass clazz,
@@ -383,11 +455,10 @@ Java_com_google_devtools_build_lib_unix_ErrnoFileStatus_00024ErrnoConstants_init
 }
 
 static jobject StatCommon(JNIEnv *env,
-                          jstring path,
+                          const char *path_chars,
                           int (*stat_function)(const char *, portable_stat_struct *),
                           bool should_throw) {
   portable_stat_struct statbuf;
-  const char *path_chars = GetStringLatin1Chars(env, path);
   int r;
   int saved_errno = 0;
   while ((r = stat_function(path_chars, &statbuf)) == -1 && errno == EINTR) { }
@@ -400,21 +471,28 @@ static jobject StatCommon(JNIEnv *env,
     // ENOMEM                      -> OutOfMemoryError
 
     if (PostRuntimeException(env, saved_errno, path_chars)) {
-      ::ReleaseStringLatin1Chars(path_chars);
       return NULL;
     } else if (should_throw) {
       ::PostFileException(env, saved_errno, path_chars);
-      ::ReleaseStringLatin1Chars(path_chars);
       return NULL;
     }
   }
-  ::ReleaseStringLatin1Chars(path_chars);
 
   return should_throw
     ? NewFileStatus(env, statbuf)
     : NewErrnoFileStatus(env, saved_errno, statbuf);
 }
 
+static jobject StatCommon(JNIEnv *env,
+                          jstring path,
+                          int (*stat_function)(const char *, portable_stat_struct *),
+                          bool should_throw) {
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  jobject result = ::StatCommon(env, path_chars, stat_function, should_throw);
+  ::ReleaseStringLatin1Chars(path_chars);
+  return result;
+}
+
 /*
  * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
  * Method:    stat
@@ -465,6 +543,308 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_errnoLstat(JNIEnv *env,
   return ::StatCommon(env, path, portable_lstat, false);
 }
 
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    statBytes
+ * Signature: ([B)Lcom/google/devtools/build/lib/unix/FileStatus;
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_statBytes(
+    JNIEnv *env, jclass clazz, jbyteArray path) {
+  return ::StatCommon(env, BytePath(env, path).c_str(), portable_stat, true);
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    lstatBytes
+ * Signature: ([B)Lcom/google/devtools/build/lib/unix/FileStatus;
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_lstatBytes(
+    JNIEnv *env, jclass clazz, jbyteArray path) {
+  return ::StatCommon(env, BytePath(env, path).c_str(), portable_lstat, true);
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    errnoStatBytes
+ * Signature: ([B)Lcom/google/devtools/build/lib/unix/ErrnoFileStatus;
+ */
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_errnoStatBytes(
+    JNIEnv *env, jclass clazz, jbyteArray path) {
+  return ::StatCommon(env, BytePath(env, path).c_str(), portable_stat, false);
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    errnoLstatBytes
+ * Signature: ([B)Lcom/google/devtools/build/lib/unix/ErrnoFileStatus;
+ */
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_errnoLstatBytes(
+    JNIEnv *env, jclass clazz, jbyteArray path) {
+  return ::StatCommon(env, BytePath(env, path).c_str(), portable_lstat, false);
+}
+
+// The threads behind RunInParallel. There is one per CPU for the whole
+// process, so that the bulk operations of many Java threads at once do not
+// each start threads of their own. The threads are started on first use and
+// never exit; they do not call into the JVM, so they need not be attached.
+class SharedThreadPool {
+ public:
+  static SharedThreadPool *Get() {
+    static SharedThreadPool *pool = new SharedThreadPool(
+        std::max(static_cast<int>(std::thread::hardware_concurrency()), 1));
+    return pool;
+  }
+
+  void Run(int parallelism, const std::function<void()> &work) {
+    Job job(&work, parallelism - 1);
+    if (job.unstarted > 0) {
+      std::lock_guard<std::mutex> lock(mu_);
+      jobs_.push_back(&job);
+      for (int i = 0; i < job.unstarted; i++) {
+        cond_.notify_one();
+      }
+    }
+    work();
+    std::unique_lock<std::mutex> lock(mu_);
+    if (job.unstarted > 0) {
+      // The work is done; copies that did not get a thread are not needed.
+      jobs_.erase(std::find(jobs_.begin(), jobs_.end(), &job));
+      job.unstarted = 0;
+    }
+    job.done.wait(lock, [&job]() { return job.running == 0; });
+  }
+
+ private:
+  // A call of Run, and the copies of its work that still have to start.
+  struct Job {
+    Job(const std::function<void()> *work, int unstarted)
+        : work(work), unstarted(unstarted), running(0) {}
+    const std::function<void()> *work;
+    int unstarted;                 // guarded by mu_
+    int running;                   // guarded by mu_
+    std::condition_variable done;  // signaled when running drops to 0
+  };
+
+  explicit SharedThreadPool(int num_threads) {
+    for (int i = 0; i < num_threads; i++) {
+      std::thread(&SharedThreadPool::Loop, this).detach();
+    }
+  }
+
+  void Loop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    for (;;) {
+      cond_.wait(lock, [this]() { return !jobs_.empty(); });
+      Job *job = jobs_.front();
+      if (--job->unstarted == 0) {
+        jobs_.pop_front();
+      }
+      job->running++;
+      lock.unlock();
+      (*job->work)();
+      lock.lock();
+      if (--job->running == 0) {
+        job->done.notify_all();
+      }
+    }
+  }
+
+  std::mutex mu_;
+  std::condition_variable cond_;  // signaled when jobs_ gets a job
+  std::deque<Job *> jobs_;        // guarded by mu_
+};
+
+// See unix_jni.h.
+void RunInParallel(int parallelism, const std::function<void()> &work) {
+  if (parallelism <= 1) {
+    work();
+  } else {
+    SharedThreadPool::Get()->Run(parallelism, work);
+  }
+}
+
+// See unix_jni.h.
+void ParallelFor(size_t count, int parallelism,
+                 const std::function<void(size_t)> &fn) {
+  // Work is handed out in chunks, so that threads neither contend on the
+  // counter nor idle behind a thread that got a run of slow items.
+  const size_t kChunkSize = 64;
+  size_t num_threads = std::min(static_cast<size_t>(std::max(parallelism, 1)),
+                                (count + kChunkSize - 1) / kChunkSize);
+  std::atomic<size_t> next(0);
+  RunInParallel(static_cast<int>(num_threads), [&]() {
+    for (;;) {
+      size_t begin = next.fetch_add(kChunkSize);
+      if (begin >= count) {
+        return;
+      }
+      size_t end = std::min(count, begin + kChunkSize);
+      for (size_t i = begin; i < end; ++i) {
+        fn(i);
+      }
+    }
+  });
+}
+
+// Appends the nul-terminated Latin1 encoding of "jstr" to "out". Unlike
+// GetStringLatin1Chars, this does not allocate per string, so it is suitable
+// for converting many paths into one buffer. Returns false and posts an
+// exception on failure.
+static bool AppendStringLatin1Chars(JNIEnv *env, jstring jstr,
+                                    std::string *out) {
+  if (jstr == NULL) {
+    ::PostException(env, EFAULT, "null path");
+    return false;
+  }
+  jsize len = env->GetStringLength(jstr);
+  size_t start = out->size();
+  out->resize(start + len + 1);
+  const jchar *str = env->GetStringCritical(jstr, NULL);
+  if (str == NULL) {
+    return false;
+  }
+  for (jsize i = 0; i < len; i++) {
+    jchar unicode = str[i];  // (unsigned)
+    (*out)[start + i] = unicode <= 0x00ff ? unicode : '?';
+  }
+  env->ReleaseStringCritical(jstr, str);
+  (*out)[start + len] = '\0';
+  return true;
+}
+
+// The stat results for many files, column by column, as they are handed to
+// the Java side in a NativePosixFiles.StatBatch.
+class StatColumns {
+ public:
+  explicit StatColumns(size_t size)
+      : errnos_(size), modes_(size), sizes_(size), mtimes_(size),
+        ctimes_(size), inodes_(size), devices_(size) {}
+
+  void SetError(size_t i, int error_number) { errnos_[i] = error_number; }
+
+  void Set(size_t i, const portable_stat_struct &statbuf) {
+    errnos_[i] = 0;
+    modes_[i] = statbuf.st_mode;
+    sizes_[i] = statbuf.st_size;
+    mtimes_[i] = Nanos(statbuf, STAT_MTIME);
+    ctimes_[i] = Nanos(statbuf, STAT_CTIME);
+    inodes_[i] = statbuf.st_ino;
+    devices_[i] = statbuf.st_dev;
+  }
+
+  // Returns a new NativePosixFiles.StatBatch, or NULL if an exception is
+  // pending.
+  jobject ToStatBatch(JNIEnv *env) const {
+    static jclass stat_batch_class = NULL;
+    if (stat_batch_class == NULL) {  // note: harmless race condition
+      jclass local = env->FindClass(
+          "com/google/devtools/build/lib/unix/NativePosixFiles$StatBatch");
+      CHECK(local != NULL);
+      stat_batch_class = static_cast<jclass>(env->NewGlobalRef(local));
+    }
+
+    static jmethodID ctor = NULL;
+    if (ctor == NULL) {  // note: harmless race condition
+      ctor = env->GetMethodID(stat_batch_class, "<init>", "([I[I[J[J[J[J[J)V");
+      CHECK(ctor != NULL);
+    }
+
+    jintArray errnos = NewIntArray(env, errnos_);
+    jintArray modes = NewIntArray(env, modes_);
+    jlongArray sizes = NewLongArray(env, sizes_);
+    jlongArray mtimes = NewLongArray(env, mtimes_);
+    jlongArray ctimes = NewLongArray(env, ctimes_);
+    jlongArray inodes = NewLongArray(env, inodes_);
+    jlongArray devices = NewLongArray(env, devices_);
+    if (env->ExceptionCheck()) {
+      return NULL;
+    }
+    return env->NewObject(stat_batch_class, ctor, errnos, modes, sizes, mtimes,
+                          ctimes, inodes, devices);
+  }
+
+ private:
+  static jlong Nanos(const portable_stat_struct &statbuf, StatTimes t) {
+    // StatSeconds() returns the unsigned seconds in an int, like FileStatus.
+    jlong seconds = static_cast<unsigned int>(StatSeconds(statbuf, t));
+    return seconds * 1000000000LL + StatNanoSeconds(statbuf, t);
+  }
+
+  static jintArray NewIntArray(JNIEnv *env, const std::vector<jint> &values) {
+    jintArray result = env->NewIntArray(values.size());
+    if (result != NULL && !values.empty()) {
+      env->SetIntArrayRegion(result, 0, values.size(), &values[0]);
+    }
+    return result;
+  }
+
+  static jlongArray NewLongArray(JNIEnv *env,
+                                 const std::vector<jlong> &values) {
+    jlongArray result = env->NewLongArray(values.size());
+    if (result != NULL && !values.empty()) {
+      env->SetLongArrayRegion(result, 0, values.size(), &values[0]);
+    }
+    return result;
+  }
+
+  std::vector<jint> errnos_;
+  std::vector<jint> modes_;
+  std::vector<jlong> sizes_;
+  std::vector<jlong> mtimes_;
+  std::vector<jlong> ctimes_;
+  std::vector<jlong> inodes_;
+  std::vector<jlong> devices_;
+};
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    batchStat
+ * Signature: ([Ljava/lang/String;ZI)Lcom/google/devtools/build/lib/unix/NativePosixFiles$StatBatch;
+ */
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_batchStat(
+    JNIEnv *env, jclass clazz, jobjectArray paths, jboolean follow_symlinks,
+    jint parallelism) {
+  jsize count = env->GetArrayLength(paths);
+  // All paths go into one buffer; the JNI calls have to happen on this
+  // thread anyway.
+  std::string path_chars;
+  std::vector<size_t> offsets(count);
+  for (jsize i = 0; i < count; i++) {
+    offsets[i] = path_chars.size();
+    jstring path = static_cast<jstring>(env->GetObjectArrayElement(paths, i));
+    bool ok = AppendStringLatin1Chars(env, path, &path_chars);
+    env->DeleteLocalRef(path);
+    if (!ok) {
+      return NULL;
+    }
+  }
+
+  StatColumns columns(count);
+  ParallelFor(count, parallelism, [&](size_t i) {
+    const char *path = path_chars.c_str() + offsets[i];
+    portable_stat_struct statbuf;
+    int r;
+    if (follow_symlinks) {
+      while ((r = portable_stat(path, &statbuf)) == -1 && errno == EINTR) { }
+    } else {
+      while ((r = portable_lstat(path, &statbuf)) == -1 && errno == EINTR) { }
+    }
+    if (r == -1) {
+      columns.SetError(i, errno);
+    } else {
+      columns.Set(i, statbuf);
+    }
+  });
+  return columns.ToStatBatch(env);
+}
+
 /*
  * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
  * Method:    utime
@@ -665,33 +1045,22 @@ static char GetDirentType(struct dirent *entry,
   }
 }
 
-/*
- * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
- * Method:    readdir
- * Signature: (Ljava/lang/String;Z)Lcom/google/devtools/build/lib/unix/Dirents;
- * Throws:    java.io.IOException
- */
-extern "C" JNIEXPORT jobject JNICALL
-Java_com_google_devtools_build_lib_unix_NativePosixFiles_readdir(JNIEnv *env,
-                                                    jclass clazz,
-                                                    jstring path,
-                                                    jchar read_types) {
-  const char *path_chars = GetStringLatin1Chars(env, path);
+// Reads the entries of the directory "path", other than "." and "..", into
+// "names", and unless "read_types" is 'n' their types into "types". Returns
+// false and posts an exception on failure.
+static bool ReaddirCommon(JNIEnv *env, const char *path, jchar read_types,
+                          std::vector<std::string> *names,
+                          std::vector<jbyte> *types) {
   DIR *dirh;
-  while ((dirh = ::opendir(path_chars)) == NULL && errno == EINTR) { }
+  while ((dirh = ::opendir(path)) == NULL && errno == EINTR) { }
   if (dirh == NULL) {
     // EACCES EMFILE ENFILE ENOENT ENOTDIR -> IOException
     // ENOMEM                              -> OutOfMemoryError
-    ::PostFileException(env, errno, path_chars);
-  }
-  ReleaseStringLatin1Chars(path_chars);
-  if (dirh == NULL) {
-    return NULL;
+    ::PostFileException(env, errno, path);
+    return false;
   }
   int fd = dirfd(dirh);
 
-  std::vector<std::string> entries;
-  std::vector<jbyte> types;
   for (;;) {
     // Clear errno beforehand.  Because readdir() is not required to clear it at
     // EOF, this is the only way to reliably distinguish EOF from error.
@@ -704,23 +1073,59 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_readdir(JNIEnv *env,
       if (errno == EINTR) continue;  // interrupted by a signal
       if (errno == EIO) continue;  // glibc returns this on transient errors
       // Otherwise, this is a real error we should report.
-      ::PostFileException(env, errno, path_chars);
+      ::PostFileException(env, errno, path);
       ::closedir(dirh);
-      return NULL;
+      return false;
     }
     // Omit . and .. from results.
     if (entry->d_name[0] == '.') {
       if (entry->d_name[1] == '\0') continue;
       if (entry->d_name[1] == '.' && entry->d_name[2] == '\0') continue;
     }
-    entries.push_back(entry->d_name);
+    names->push_back(entry->d_name);
     if (read_types != 'n') {
-      types.push_back(GetDirentType(entry, fd, read_types == 'f'));
+      types->push_back(GetDirentType(entry, fd, read_types == 'f'));
     }
   }
 
   if (::closedir(dirh) < 0 && errno != EINTR) {
-    ::PostFileException(env, errno, path_chars);
+    ::PostFileException(env, errno, path);
+    return false;
+  }
+  return true;
+}
+
+// Returns a new byte[] holding "types", or NULL if "read_types" is 'n'.
+static jbyteArray NewDirentTypes(JNIEnv *env, jchar read_types,
+                                 const std::vector<jbyte> &types) {
+  if (read_types == 'n') {
+    return NULL;
+  }
+  jbyteArray types_obj = env->NewByteArray(types.size());
+  CHECK(types_obj);
+  if (!types.empty()) {
+    env->SetByteArrayRegion(types_obj, 0, types.size(), &types[0]);
+  }
+  return types_obj;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    readdir
+ * Signature: (Ljava/lang/String;Z)Lcom/google/devtools/build/lib/unix/Dirents;
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_readdir(JNIEnv *env,
+                                                    jclass clazz,
+                                                    jstring path,
+                                                    jchar read_types) {
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  std::vector<std::string> entries;
+  std::vector<jbyte> types;
+  bool ok = ReaddirCommon(env, path_chars, read_types, &entries, &types);
+  ReleaseStringLatin1Chars(path_chars);
+  if (!ok) {
     return NULL;
   }
 
@@ -739,80 +1144,1050 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_readdir(JNIEnv *env,
     env->SetObjectArrayElement(names_obj, ii, s);
   }
 
-  jbyteArray types_obj = NULL;
-  if (read_types != 'n') {
-    CHECK(len == types.size());
-    types_obj = env->NewByteArray(len);
-    CHECK(types_obj);
-    if (len > 0) {
-      env->SetByteArrayRegion(types_obj, 0, len, &types[0]);
-    }
-  }
+  return NewDirents(env, names_obj, NewDirentTypes(env, read_types, types));
+}
 
-  return NewDirents(env, names_obj, types_obj);
+// Packs "names" into a byte array, and sets "offsets" to the array that
+// delimits them: name i spans [offsets[i], offsets[i + 1]). Returns false if
+// an exception is pending.
+static bool PackNames(JNIEnv *env, const std::vector<std::string> &names,
+                      jbyteArray *packed, jintArray *offsets) {
+  std::string chars;
+  std::vector<jint> starts;
+  for (const std::string &name : names) {
+    starts.push_back(chars.size());
+    chars.append(name);
+  }
+  starts.push_back(chars.size());
+  *packed = env->NewByteArray(chars.size());
+  *offsets = env->NewIntArray(starts.size());
+  if (*packed == NULL || *offsets == NULL) {
+    return false;
+  }
+  env->SetByteArrayRegion(*packed, 0, chars.size(),
+                          reinterpret_cast<const jbyte *>(chars.data()));
+  env->SetIntArrayRegion(*offsets, 0, starts.size(), &starts[0]);
+  return true;
 }
 
 /*
  * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
- * Method:    rename
- * Signature: (Ljava/lang/String;Ljava/lang/String;)V
+ * Method:    readdirBytes
+ * Signature: ([BC)Lcom/google/devtools/build/lib/unix/NativePosixFiles$PackedDirents;
  * Throws:    java.io.IOException
  */
-extern "C" JNIEXPORT void JNICALL
-Java_com_google_devtools_build_lib_unix_NativePosixFiles_rename(JNIEnv *env,
-                                                   jclass clazz,
-                                                   jstring oldpath,
-                                                   jstring newpath) {
-  const char *oldpath_chars = GetStringLatin1Chars(env, oldpath);
-  const char *newpath_chars = GetStringLatin1Chars(env, newpath);
-  if (::rename(oldpath_chars, newpath_chars) == -1) {
-    // EISDIR EXDEV ENOTEMPTY EEXIST EBUSY
-    // EINVAL EMLINK ENOTDIR EACCES EPERM
-    // ENOENT EROFS ELOOP ENOSPC           -> IOException
-    // EFAULT ENAMETOOLONG                 -> RuntimeException
-    // ENOMEM                              -> OutOfMemoryError
-    std::string filename(std::string(oldpath_chars) + " -> " + newpath_chars);
-    ::PostFileException(env, errno, filename.c_str());
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_readdirBytes(
+    JNIEnv *env, jclass clazz, jbyteArray path, jchar read_types) {
+  std::vector<std::string> entries;
+  std::vector<jbyte> types;
+  if (!ReaddirCommon(env, BytePath(env, path).c_str(), read_types, &entries,
+                     &types)) {
+    return NULL;
   }
-  ReleaseStringLatin1Chars(oldpath_chars);
-  ReleaseStringLatin1Chars(newpath_chars);
+  jbyteArray names;
+  jintArray name_offsets;
+  if (!PackNames(env, entries, &names, &name_offsets)) {
+    return NULL;
+  }
+
+  static jclass packed_dirents_class = NULL;
+  if (packed_dirents_class == NULL) {  // note: harmless race condition
+    jclass local = env->FindClass(
+        "com/google/devtools/build/lib/unix/NativePosixFiles$PackedDirents");
+    CHECK(local != NULL);
+    packed_dirents_class = static_cast<jclass>(env->NewGlobalRef(local));
+  }
+  static jmethodID ctor = NULL;
+  if (ctor == NULL) {  // note: harmless race condition
+    ctor = env->GetMethodID(packed_dirents_class, "<init>", "([B[I[B)V");
+    CHECK(ctor != NULL);
+  }
+  return env->NewObject(packed_dirents_class, ctor, names, name_offsets,
+                        NewDirentTypes(env, read_types, types));
 }
 
-static bool delete_common(JNIEnv *env,
-                          jstring path,
-                          int (*delete_function)(const char *),
-                          bool (*error_function)(int)) {
-  const char *path_chars = GetStringLatin1Chars(env, path);
-  if (path_chars == NULL) {
-      return false;
+static jobject NewStatDirents(JNIEnv *env,
+                              jbyteArray names,
+                              jintArray name_offsets,
+                              jobject stats) {
+  static jclass stat_dirents_class = NULL;
+  if (stat_dirents_class == NULL) {  // note: harmless race condition
+    jclass local = env->FindClass(
+        "com/google/devtools/build/lib/unix/NativePosixFiles$StatDirents");
+    CHECK(local != NULL);
+    stat_dirents_class = static_cast<jclass>(env->NewGlobalRef(local));
   }
-  bool ok = delete_function(path_chars) != -1;
-  if (!ok) {
-    if (!error_function(errno)) {
-      ::PostFileException(env, errno, path_chars);
-    }
+
+  static jmethodID ctor = NULL;
+  if (ctor == NULL) {  // note: harmless race condition
+    ctor = env->GetMethodID(
+        stat_dirents_class, "<init>",
+        "([B[ILcom/google/devtools/build/lib/unix/NativePosixFiles$StatBatch;)V");
+    CHECK(ctor != NULL);
   }
-  ReleaseStringLatin1Chars(path_chars);
-  return ok;
+
+  return env->NewObject(stat_dirents_class, ctor, names, name_offsets, stats);
 }
 
-static bool unlink_err(int err) { return err == ENOENT; }
-static bool remove_err(int err) { return err == ENOENT || err == ENOTDIR; }
+// Stats the entry "name" of the directory "dir_path", which is open as
+// "dir_fd". Returns 0 on success, or -1 and sets errno.
+static int StatDirectoryEntry(const char *dir_path, int dir_fd, char *name,
+                              bool follow_symlinks,
+                              portable_stat_struct *statbuf) {
+  int r;
+  while ((r = portable_fstatat(dir_fd, name, statbuf,
+                               follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW)) ==
+             -1 &&
+         errno == EINTR) {
+  }
+  if (r == -1 && errno == ENOSYS) {
+    // No (suitable) fstatat on this platform; stat the full path instead.
+    std::string path = std::string(dir_path) + "/" + name;
+    if (follow_symlinks) {
+      while ((r = portable_stat(path.c_str(), statbuf)) == -1 &&
+             errno == EINTR) { }
+    } else {
+      while ((r = portable_lstat(path.c_str(), statbuf)) == -1 &&
+             errno == EINTR) { }
+    }
+  }
+  return r;
+}
 
 /*
  * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
- * Method:    unlink
- * Signature: (Ljava/lang/String;)V
+ * Method:    readdirWithStats
+ * Signature: (Ljava/lang/String;Z)Lcom/google/devtools/build/lib/unix/NativePosixFiles$StatDirents;
  * Throws:    java.io.IOException
  */
-extern "C" JNIEXPORT bool JNICALL
-Java_com_google_devtools_build_lib_unix_NativePosixFiles_unlink(JNIEnv *env,
-                                                   jclass clazz,
-                                                   jstring path) {
-  return ::delete_common(env, path, ::unlink, ::unlink_err);
-}
-
-/*
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_readdirWithStats(
+    JNIEnv *env, jclass clazz, jstring path, jboolean follow_symlinks) {
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  DIR *dirh;
+  while ((dirh = ::opendir(path_chars)) == NULL && errno == EINTR) { }
+  if (dirh == NULL) {
+    ::PostFileException(env, errno, path_chars);
+    ReleaseStringLatin1Chars(path_chars);
+    return NULL;
+  }
+  int fd = dirfd(dirh);
+
+  // The names are packed into a single buffer; name i spans
+  // [offsets[i], offsets[i + 1]).
+  std::string names;
+  std::vector<jint> offsets;
+  std::vector<portable_stat_struct> stats;
+  std::vector<int> errnos;
+  for (;;) {
+    // See readdir above for the error handling.
+    errno = 0;
+    struct dirent *entry = ::readdir(dirh);
+    if (entry == NULL) {
+      if (errno == 0) break;  // EOF
+      if (errno == EINTR) continue;
+      if (errno == EIO) continue;
+      ::PostFileException(env, errno, path_chars);
+      ::closedir(dirh);
+      ReleaseStringLatin1Chars(path_chars);
+      return NULL;
+    }
+    if (entry->d_name[0] == '.') {
+      if (entry->d_name[1] == '\0') continue;
+      if (entry->d_name[1] == '.' && entry->d_name[2] == '\0') continue;
+    }
+    offsets.push_back(names.size());
+    names.append(entry->d_name);
+    stats.push_back(portable_stat_struct());
+    errnos.push_back(StatDirectoryEntry(path_chars, fd, entry->d_name,
+                                        follow_symlinks, &stats.back()) == 0
+                         ? 0
+                         : errno);
+  }
+  offsets.push_back(names.size());
+
+  if (::closedir(dirh) < 0 && errno != EINTR) {
+    ::PostFileException(env, errno, path_chars);
+    ReleaseStringLatin1Chars(path_chars);
+    return NULL;
+  }
+  ReleaseStringLatin1Chars(path_chars);
+
+  StatColumns columns(stats.size());
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (errnos[i] == 0) {
+      columns.Set(i, stats[i]);
+    } else {
+      columns.SetError(i, errnos[i]);
+    }
+  }
+  jobject stats_obj = columns.ToStatBatch(env);
+  jbyteArray names_obj = env->NewByteArray(names.size());
+  jintArray offsets_obj = env->NewIntArray(offsets.size());
+  if (stats_obj == NULL || names_obj == NULL || offsets_obj == NULL) {
+    return NULL;  // async exception!
+  }
+  env->SetByteArrayRegion(names_obj, 0, names.size(),
+                          reinterpret_cast<const jbyte *>(names.data()));
+  env->SetIntArrayRegion(offsets_obj, 0, offsets.size(), &offsets[0]);
+  return NewStatDirents(env, names_obj, offsets_obj, stats_obj);
+}
+
+// Appends the Latin1 encoding of every element of "array" to "out". Returns
+// false and posts an exception on failure.
+static bool GetStringLatin1Array(JNIEnv *env, jobjectArray array,
+                                 std::vector<std::string> *out) {
+  jsize count = env->GetArrayLength(array);
+  std::string chars;
+  for (jsize i = 0; i < count; i++) {
+    jstring str = static_cast<jstring>(env->GetObjectArrayElement(array, i));
+    chars.clear();
+    bool ok = AppendStringLatin1Chars(env, str, &chars);
+    env->DeleteLocalRef(str);
+    if (!ok) {
+      return false;
+    }
+    out->push_back(chars.substr(0, chars.size() - 1));
+  }
+  return true;
+}
+
+// Returns whether "name" matches "pattern", in which '*' matches any sequence
+// of characters and '?' any single character.
+static bool WildcardMatches(const char *pattern, const char *name) {
+  const char *star = NULL;    // the last '*' seen in the pattern
+  const char *resume = NULL;  // where in the name that '*' stopped matching
+  while (*name != '\0') {
+    if (*pattern == '?' || (*pattern != '*' && *pattern == *name)) {
+      ++pattern;
+      ++name;
+    } else if (*pattern == '*') {
+      star = pattern++;
+      resume = name;
+    } else if (star != NULL) {
+      // Let the last '*' match one more character and retry from there.
+      pattern = star + 1;
+      name = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (*pattern == '*') {
+    ++pattern;
+  }
+  return *pattern == '\0';
+}
+
+// Returns whether the file name "name" matches the pattern segment "segment",
+// exactly like UnixGlob.matches() does.
+static bool GlobSegmentMatches(const std::string &segment, const char *name) {
+  if (segment.empty() || name[0] == '\0') {
+    return false;
+  }
+  if (segment == "**" || segment == "*") {
+    return true;
+  }
+  // If a file name starts with '.', this char must be matched explicitly.
+  if (name[0] == '.' && segment[0] != '.') {
+    return false;
+  }
+  return WildcardMatches(segment.c_str(), name);
+}
+
+// Expands glob patterns, with the semantics of UnixGlob, over the directory
+// tree below a root in a single pass.
+//
+// All patterns are matched at once: every directory is visited with the set
+// of (pattern, segment) positions that are still alive in it, so directories
+// shared by several patterns are read only once. Directories are processed by
+// threads of the shared pool (see RunInParallel), each working depth-first on
+// its own queue and stealing the oldest (and so usually largest) subtrees of
+// the others when it runs out of work. Directories are opened relative to the
+// root's file descriptor, so that at most one directory per thread is open at
+// a time.
+class TreeGlobber {
+ public:
+  struct Match {
+    std::string path;  // relative to the root; "" for the root itself
+    portable_stat_struct stat;
+  };
+
+  // "patterns" are the include patterns, followed by the exclude patterns,
+  // all split into segments and valid according to
+  // UnixGlob.checkPatternForError(). Directories containing any of the
+  // regular files "prune_markers" are skipped.
+  TreeGlobber(const std::string &root, int root_fd,
+              const std::vector<std::vector<std::string>> &patterns,
+              size_t num_includes,
+              const std::vector<std::string> &prune_markers,
+              bool exclude_directories, bool follow_symlinks)
+      : root_(root),
+        root_fd_(root_fd),
+        prune_markers_(prune_markers),
+        exclude_directories_(exclude_directories),
+        follow_symlinks_(follow_symlinks),
+        next_worker_(0),
+        pending_(0),
+        queued_(0),
+        num_idle_(0),
+        error_(0) {
+    for (size_t p = 0; p < patterns.size(); p++) {
+      initial_states_.push_back(states_.size());
+      for (size_t s = 0; s <= patterns[p].size(); s++) {
+        State state;
+        state.segment = s < patterns[p].size() ? &patterns[p][s] : NULL;
+        state.include = p < num_includes;
+        states_.push_back(state);
+      }
+    }
+  }
+
+  // Runs the traversal on at most "parallelism" threads, including the calling
+  // one. Returns 0 on success, or the errno of the first failure, in which
+  // case "error_path" is set to the path (relative to the root) that failed.
+  int Run(int parallelism, std::string *error_path) {
+    std::vector<int> root_states;
+    for (int state : initial_states_) {
+      AddState(state, &root_states);
+    }
+    workers_.reset(new Worker[std::max(parallelism, 1)]);
+    num_workers_ = std::max(parallelism, 1);
+
+    bool include, exclude, alive;
+    Classify(root_states, &include, &exclude, &alive);
+    if (include && !exclude && !exclude_directories_) {
+      Match match;
+      if (StatEntry("", root_fd_, ".", true, &match.stat) == 0) {
+        workers_[0].matches.push_back(match);
+      }
+    }
+    if (alive) {
+      DirTask task;
+      task.states.swap(root_states);
+      // Most globs never go below the root, so only ask for other threads
+      // once the root has been read and there is something to do.
+      ProcessDirectory(0, task);
+      if (pending_ > 0) {
+        RunInParallel(num_workers_, [this]() { Work(next_worker_++); });
+      }
+    }
+
+    if (error_ != 0) {
+      *error_path = error_path_;
+    }
+    return error_;
+  }
+
+  // Returns all matches, in no particular order.
+  std::vector<Match> TakeMatches() {
+    std::vector<Match> result;
+    for (int i = 0; i < num_workers_; i++) {
+      std::vector<Match> &matches = workers_[i].matches;
+      std::move(matches.begin(), matches.end(), std::back_inserter(result));
+    }
+    return result;
+  }
+
+  // Returns the directories below the root that were matched or traversed,
+  // followed by those that were skipped because of a prune marker, in no
+  // particular order. Sets "num_visited" to the number of the former.
+  std::vector<std::string> TakeDirectories(size_t *num_visited) {
+    std::vector<std::string> result;
+    for (int i = 0; i < num_workers_; i++) {
+      std::vector<std::string> &visited = workers_[i].visited;
+      std::move(visited.begin(), visited.end(), std::back_inserter(result));
+    }
+    *num_visited = result.size();
+    for (int i = 0; i < num_workers_; i++) {
+      std::vector<std::string> &pruned = workers_[i].pruned;
+      std::move(pruned.begin(), pruned.end(), std::back_inserter(result));
+    }
+    return result;
+  }
+
+ private:
+  // A position in a pattern: the segment that the next path component has to
+  // match, or NULL if the pattern has been matched completely.
+  struct State {
+    const std::string *segment;
+    bool include;
+  };
+
+  struct DirTask {
+    std::string path;  // relative to the root
+    std::vector<int> states;
+  };
+
+  struct Worker {
+    std::mutex mu;
+    std::deque<DirTask> tasks;  // guarded by mu
+    // Results, only touched by the owning thread until the pool has finished.
+    std::vector<Match> matches;
+    std::vector<std::string> visited;
+    std::vector<std::string> pruned;
+  };
+
+  enum EntryType { kUnknown, kFile, kDirectory, kSymlink };
+
+  // An entry of the directory being processed that some pattern can reach.
+  struct Child {
+    Child() : type(kUnknown), have_stat(false) {}
+    EntryType type;
+    std::vector<int> states;
+    bool have_stat;
+    portable_stat_struct stat;
+  };
+
+  // Adds "state" to "states", together with the positions it implies: "**"
+  // can match zero path components.
+  void AddState(int state, std::vector<int> *states) const {
+    if (std::find(states->begin(), states->end(), state) != states->end()) {
+      return;
+    }
+    states->push_back(state);
+    const std::string *segment = states_[state].segment;
+    if (segment != NULL && *segment == "**") {
+      AddState(state + 1, states);
+    }
+  }
+
+  // Advances the positions "from" over the entry "name". Only positions
+  // matching "literal" (if given) are considered.
+  void Step(const std::vector<int> &from, const char *name, bool is_directory,
+            const std::string *literal, std::vector<int> *to) const {
+    for (int state : from) {
+      const std::string *segment = states_[state].segment;
+      if (segment == NULL || IsLiteral(*segment) != (literal != NULL) ||
+          (literal != NULL && *segment != *literal)) {
+        continue;
+      }
+      if (*segment == "**" && is_directory) {
+        // Recurse without consuming the "**".
+        AddState(state, to);
+      }
+      if (GlobSegmentMatches(*segment, name)) {
+        AddState(state + 1, to);
+      }
+    }
+  }
+
+  void Classify(const std::vector<int> &states, bool *include, bool *exclude,
+                bool *alive) const {
+    *include = *exclude = *alive = false;
+    for (int state : states) {
+      const State &s = states_[state];
+      if (s.segment != NULL) {
+        // Exclude patterns alone are no reason to look further.
+        *alive |= s.include;
+      } else if (s.include) {
+        *include = true;
+      } else {
+        *exclude = true;
+      }
+    }
+  }
+
+  static bool IsLiteral(const std::string &segment) {
+    return segment.find_first_of("*?") == std::string::npos;
+  }
+
+  static EntryType TypeOf(const portable_stat_struct &statbuf) {
+    if (S_ISDIR(statbuf.st_mode)) return kDirectory;
+    if (S_ISREG(statbuf.st_mode)) return kFile;
+    if (S_ISLNK(statbuf.st_mode)) return kSymlink;
+    return kUnknown;
+  }
+
+  void Push(int worker, DirTask *task) {
+    pending_++;
+    {
+      std::lock_guard<std::mutex> lock(workers_[worker].mu);
+      workers_[worker].tasks.push_back(DirTask());
+      workers_[worker].tasks.back().path.swap(task->path);
+      workers_[worker].tasks.back().states.swap(task->states);
+    }
+    queued_++;
+    if (num_idle_ > 0) {
+      std::lock_guard<std::mutex> lock(idle_mu_);
+      idle_cond_.notify_one();
+    }
+  }
+
+  // Takes the newest task of "worker", or else the oldest task of any other.
+  bool Take(int worker, DirTask *task) {
+    for (int i = 0; i < num_workers_; i++) {
+      Worker &victim = workers_[(worker + i) % num_workers_];
+      std::lock_guard<std::mutex> lock(victim.mu);
+      if (victim.tasks.empty()) {
+        continue;
+      }
+      DirTask &taken = i == 0 ? victim.tasks.back() : victim.tasks.front();
+      task->path.swap(taken.path);
+      task->states.swap(taken.states);
+      if (i == 0) {
+        victim.tasks.pop_back();
+      } else {
+        victim.tasks.pop_front();
+      }
+      queued_--;
+      return true;
+    }
+    return false;
+  }
+
+  // Processes tasks until there are none left, waiting for the other threads
+  // whenever the queues are empty, since the directories they are reading may
+  // still produce more.
+  void Work(int worker) {
+    DirTask task;
+    for (;;) {
+      if (Take(worker, &task)) {
+        ProcessDirectory(worker, task);
+        if (--pending_ == 0) {
+          std::lock_guard<std::mutex> lock(idle_mu_);
+          idle_cond_.notify_all();
+        }
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(idle_mu_);
+      num_idle_++;
+      idle_cond_.wait(lock,
+                      [this]() { return queued_ > 0 || pending_ == 0; });
+      num_idle_--;
+      if (pending_ == 0) {
+        return;
+      }
+    }
+  }
+
+  void SetError(int error_number, const std::string &path) {
+    std::lock_guard<std::mutex> lock(error_mu_);
+    if (error_ == 0) {
+      error_ = error_number;
+      error_path_ = path;
+    }
+  }
+
+  int StatEntry(const std::string &dir_path, int dir_fd,
+                const std::string &name, bool follow_symlinks,
+                portable_stat_struct *statbuf) const {
+    std::string name_chars(name);
+    return StatDirectoryEntry((root_ + "/" + dir_path).c_str(), dir_fd,
+                              &name_chars[0], follow_symlinks, statbuf);
+  }
+
+  void ProcessDirectory(int worker, const DirTask &task) {
+    if (error_ != 0) {
+      return;  // Just drain the queues.
+    }
+    int fd;
+    while ((fd = ::openat(root_fd_, task.path.empty() ? "." : task.path.c_str(),
+                          O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1 &&
+           errno == EINTR) { }
+    if (fd == -1) {
+      SetError(errno, task.path);
+      return;
+    }
+
+    std::unordered_map<std::string, Child> children;
+    bool need_readdir = false;
+    std::vector<const std::string *> literals;
+    for (int state : task.states) {
+      const std::string *segment = states_[state].segment;
+      if (segment == NULL) {
+        continue;
+      } else if (!IsLiteral(*segment)) {
+        need_readdir = true;
+      } else if (std::find_if(literals.begin(), literals.end(),
+                              [segment](const std::string *literal) {
+                                return *literal == *segment;
+                              }) == literals.end()) {
+        literals.push_back(segment);
+      }
+    }
+
+    DIR *dirh = NULL;
+    if (need_readdir && (dirh = ::fdopendir(fd)) == NULL) {
+      SetError(errno, task.path);
+      ::close(fd);
+      return;
+    }
+    while (dirh != NULL) {
+      // See readdir above for the error handling.
+      errno = 0;
+      struct dirent *entry = ::readdir(dirh);
+      if (entry == NULL) {
+        if (errno == 0) break;  // EOF
+        if (errno == EINTR) continue;
+        if (errno == EIO) continue;
+        SetError(errno, task.path);
+        ::closedir(dirh);
+        return;
+      }
+      if (entry->d_name[0] == '.') {
+        if (entry->d_name[1] == '\0') continue;
+        if (entry->d_name[1] == '.' && entry->d_name[2] == '\0') continue;
+      }
+
+      Child child;
+      switch (entry->d_type) {
+        case DT_DIR:
+          child.type = kDirectory;
+          break;
+        case DT_REG:
+          child.type = kFile;
+          break;
+        case DT_LNK:
+          if (!follow_symlinks_) {
+            child.type = kSymlink;
+            break;
+          }
+          FALLTHROUGH_INTENDED;
+        default:
+          if (StatDirectoryEntry((root_ + "/" + task.path).c_str(), fd,
+                                 entry->d_name, follow_symlinks_,
+                                 &child.stat) == 0) {
+            child.type = TypeOf(child.stat);
+            child.have_stat = true;
+          }
+      }
+      if (child.type == kUnknown) {
+        // A dangling symlink, fifo, etc.
+        continue;
+      }
+      Step(task.states, entry->d_name, child.type == kDirectory, NULL,
+           &child.states);
+      if (!child.states.empty()) {
+        children[entry->d_name] = child;
+      }
+    }
+
+    // Literal segments need no readdir, just a stat. This also makes them
+    // match names that differ only in case on case-insensitive file systems,
+    // like they do in UnixGlob.
+    for (const std::string *literal : literals) {
+      Child &child = children[*literal];
+      if (!child.have_stat) {
+        if (StatEntry(task.path, fd, *literal, follow_symlinks_,
+                      &child.stat) == 0) {
+          child.type = TypeOf(child.stat);
+          child.have_stat = true;
+        } else {
+          child.type = kUnknown;
+        }
+      }
+      if (child.type != kUnknown) {
+        Step(task.states, literal->c_str(), child.type == kDirectory, literal,
+             &child.states);
+      }
+    }
+
+    Worker &results = workers_[worker];
+    for (auto &entry : children) {
+      const std::string &name = entry.first;
+      Child &child = entry.second;
+      bool include, exclude, alive;
+      Classify(child.states, &include, &exclude, &alive);
+      bool is_directory = child.type == kDirectory;
+      bool is_match = include && !exclude;
+      if (!is_match && !(is_directory && alive)) {
+        continue;
+      }
+
+      std::string path = task.path.empty() ? name : task.path + "/" + name;
+      if (is_directory) {
+        bool pruned = false;
+        for (const std::string &marker : prune_markers_) {
+          portable_stat_struct statbuf;
+          if (StatEntry(task.path, fd, name + "/" + marker, true, &statbuf) ==
+                  0 &&
+              S_ISREG(statbuf.st_mode)) {
+            pruned = true;
+            break;
+          }
+        }
+        if (pruned) {
+          results.pruned.push_back(path);
+          continue;
+        }
+        results.visited.push_back(path);
+      }
+
+      if (is_match && !(is_directory && exclude_directories_)) {
+        if (!child.have_stat &&
+            StatEntry(task.path, fd, name, follow_symlinks_, &child.stat) !=
+                0) {
+          continue;  // Deleted concurrently.
+        }
+        Match match;
+        match.path = path;
+        match.stat = child.stat;
+        results.matches.push_back(match);
+      }
+      if (is_directory && alive) {
+        DirTask subtask;
+        subtask.path.swap(path);
+        subtask.states.swap(child.states);
+        Push(worker, &subtask);
+      }
+    }
+
+    if (dirh != NULL) {
+      ::closedir(dirh);
+    } else {
+      ::close(fd);
+    }
+  }
+
+  const std::string root_;
+  const int root_fd_;
+  const std::vector<std::string> prune_markers_;
+  const bool exclude_directories_;
+  const bool follow_symlinks_;
+  std::vector<State> states_;
+  std::vector<int> initial_states_;  // the first state of every pattern
+
+  std::unique_ptr<Worker[]> workers_;
+  int num_workers_;
+  std::atomic<int> next_worker_;  // the index for the next thread to join
+  // The number of tasks queued or being processed.
+  std::atomic<int> pending_;
+  // The number of tasks queued.
+  std::atomic<int> queued_;
+
+  // Threads wait here while all queues are empty but pending_ is not zero.
+  std::mutex idle_mu_;
+  std::condition_variable idle_cond_;
+  std::atomic<int> num_idle_;
+
+  std::mutex error_mu_;
+  std::atomic<int> error_;
+  std::string error_path_;  // guarded by error_mu_
+};
+
+static jobject NewTreeWalk(JNIEnv *env,
+                           jobject matches,
+                           jbyteArray directory_names,
+                           jintArray directory_name_offsets,
+                           jint num_visited) {
+  static jclass tree_walk_class = NULL;
+  if (tree_walk_class == NULL) {  // note: harmless race condition
+    jclass local = env->FindClass(
+        "com/google/devtools/build/lib/unix/NativePosixFiles$TreeWalk");
+    CHECK(local != NULL);
+    tree_walk_class = static_cast<jclass>(env->NewGlobalRef(local));
+  }
+
+  static jmethodID ctor = NULL;
+  if (ctor == NULL) {  // note: harmless race condition
+    ctor = env->GetMethodID(
+        tree_walk_class, "<init>",
+        "(Lcom/google/devtools/build/lib/unix/NativePosixFiles$StatDirents;"
+        "[B[II)V");
+    CHECK(ctor != NULL);
+  }
+
+  return env->NewObject(tree_walk_class, ctor, matches, directory_names,
+                        directory_name_offsets, num_visited);
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    walkTree
+ * Signature: (Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;ZZI)Lcom/google/devtools/build/lib/unix/NativePosixFiles$TreeWalk;
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_walkTree(
+    JNIEnv *env, jclass clazz, jstring root, jobjectArray includes,
+    jobjectArray excludes, jobjectArray prune_markers,
+    jboolean exclude_directories, jboolean follow_symlinks, jint parallelism) {
+  std::vector<std::string> include_patterns;
+  std::vector<std::string> exclude_patterns;
+  std::vector<std::string> markers;
+  if (!GetStringLatin1Array(env, includes, &include_patterns) ||
+      !GetStringLatin1Array(env, excludes, &exclude_patterns) ||
+      !GetStringLatin1Array(env, prune_markers, &markers)) {
+    return NULL;
+  }
+  std::vector<std::vector<std::string>> patterns;
+  for (const std::vector<std::string> *list :
+       {&include_patterns, &exclude_patterns}) {
+    for (const std::string &pattern : *list) {
+      patterns.push_back(std::vector<std::string>());
+      size_t start = 0;
+      for (size_t slash; (slash = pattern.find('/', start)) !=
+                         std::string::npos;
+           start = slash + 1) {
+        patterns.back().push_back(pattern.substr(start, slash - start));
+      }
+      patterns.back().push_back(pattern.substr(start));
+    }
+  }
+
+  const char *root_chars = GetStringLatin1Chars(env, root);
+  std::string root_path(root_chars);
+  int root_fd;
+  while ((root_fd = ::open(root_chars, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) ==
+             -1 &&
+         errno == EINTR) { }
+  if (root_fd == -1) {
+    ::PostFileException(env, errno, root_chars);
+    ReleaseStringLatin1Chars(root_chars);
+    return NULL;
+  }
+  ReleaseStringLatin1Chars(root_chars);
+
+  TreeGlobber globber(root_path, root_fd, patterns, include_patterns.size(),
+                      markers, exclude_directories, follow_symlinks);
+  std::string error_path;
+  int error_number = globber.Run(parallelism, &error_path);
+  ::close(root_fd);
+  if (error_number != 0) {
+    ::PostFileException(env, error_number,
+                        (root_path + "/" + error_path).c_str());
+    return NULL;
+  }
+
+  std::vector<TreeGlobber::Match> matches = globber.TakeMatches();
+  std::vector<std::string> match_paths;
+  StatColumns columns(matches.size());
+  for (size_t i = 0; i < matches.size(); i++) {
+    match_paths.push_back(matches[i].path);
+    columns.Set(i, matches[i].stat);
+  }
+  size_t num_visited;
+  std::vector<std::string> directories = globber.TakeDirectories(&num_visited);
+
+  jbyteArray names_obj, directory_names_obj;
+  jintArray offsets_obj, directory_offsets_obj;
+  jobject stats_obj = columns.ToStatBatch(env);
+  if (stats_obj == NULL ||
+      !PackNames(env, match_paths, &names_obj, &offsets_obj) ||
+      !PackNames(env, directories, &directory_names_obj,
+                 &directory_offsets_obj)) {
+    return NULL;  // async exception!
+  }
+  jobject matches_obj =
+      NewStatDirents(env, names_obj, offsets_obj, stats_obj);
+  if (matches_obj == NULL) {
+    return NULL;
+  }
+  return NewTreeWalk(env, matches_obj, directory_names_obj,
+                     directory_offsets_obj, num_visited);
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    rename
+ * Signature: (Ljava/lang/String;Ljava/lang/String;)V
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_rename(JNIEnv *env,
+                                                   jclass clazz,
+                                                   jstring oldpath,
+                                                   jstring newpath) {
+  const char *oldpath_chars = GetStringLatin1Chars(env, oldpath);
+  const char *newpath_chars = GetStringLatin1Chars(env, newpath);
+  if (::rename(oldpath_chars, newpath_chars) == -1) {
+    // EISDIR EXDEV ENOTEMPTY EEXIST EBUSY
+    // EINVAL EMLINK ENOTDIR EACCES EPERM
+    // ENOENT EROFS ELOOP ENOSPC           -> IOException
+    // EFAULT ENAMETOOLONG                 -> RuntimeException
+    // ENOMEM                              -> OutOfMemoryError
+    std::string filename(std::string(oldpath_chars) + " -> " + newpath_chars);
+    ::PostFileException(env, errno, filename.c_str());
+  }
+  ReleaseStringLatin1Chars(oldpath_chars);
+  ReleaseStringLatin1Chars(newpath_chars);
+}
+
+// The ways in which copyFile can copy data; keep in sync with the COPY_*
+// constants of NativePosixFiles.
+enum CopyStrategy {
+  COPY_CLONE = 0,
+  COPY_FILE_RANGE = 1,
+  COPY_SENDFILE = 2,
+  COPY_READ_WRITE = 3,
+};
+
+// Copies "size" bytes from the file offset of "src_fd" to that of "dst_fd"
+// with "copy", which works like portable_copy_file_range. Returns 1 if the
+// data was copied, 0 if "copy" cannot copy these files and nothing was
+// copied, or -1 and sets errno.
+static int CopyInKernel(ssize_t (*copy)(int, int, size_t), int src_fd,
+                        int dst_fd, off_t size) {
+  // Files in /proc and the like report a size of 0, but have contents that
+  // only read(2) returns.
+  if (size == 0) {
+    return 0;
+  }
+  off_t copied = 0;
+  while (copied < size) {
+    size_t chunk = std::min<off_t>(size - copied, 1 << 30);
+    ssize_t r = copy(src_fd, dst_fd, chunk);
+    if (r == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (copied == 0 &&
+          (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+           errno == ENOTSUP || errno == EOPNOTSUPP || errno == EBADF)) {
+        return 0;
+      }
+      return -1;
+    }
+    if (r == 0) {
+      // The file shrank while we copied it, or this kernel cannot copy it
+      // this way after all.
+      return copied == 0 ? 0 : 1;
+    }
+    copied += r;
+  }
+  return 1;
+}
+
+// Copies the rest of "src_fd" to "dst_fd" through a buffer. Returns 0, or -1
+// and sets errno.
+static int CopyReadWrite(int src_fd, int dst_fd) {
+  const size_t kBufferSize = 128 * 1024;
+  std::unique_ptr<char[]> buffer(new char[kBufferSize]);
+  for (;;) {
+    ssize_t r = read(src_fd, buffer.get(), kBufferSize);
+    if (r == -1 && errno == EINTR) {
+      continue;
+    }
+    if (r <= 0) {
+      return r;
+    }
+    for (ssize_t written = 0; written < r;) {
+      ssize_t w = write(dst_fd, buffer.get() + written, r - written);
+      if (w == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -1;
+      }
+      written += w;
+    }
+  }
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    copyFile
+ * Signature: (Ljava/lang/String;Ljava/lang/String;I)I
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_copyFile(
+    JNIEnv *env, jclass clazz, jstring src, jstring dst, jint mode) {
+  const char *src_chars = GetStringLatin1Chars(env, src);
+  const char *dst_chars = GetStringLatin1Chars(env, dst);
+  int src_fd = -1;
+  int dst_fd = -1;
+  int strategy = -1;
+  portable_stat_struct statbuf;
+  int r;
+
+  src_fd = open(src_chars, O_RDONLY | O_CLOEXEC);
+  if (src_fd == -1) {
+    ::PostFileException(env, errno, src_chars);
+    goto cleanup;
+  }
+  if (portable_fstat(src_fd, &statbuf) == -1) {
+    ::PostFileException(env, errno, src_chars);
+    goto cleanup;
+  }
+  if (S_ISDIR(statbuf.st_mode)) {
+    ::PostFileException(env, EISDIR, src_chars);
+    goto cleanup;
+  }
+  dst_fd = open(dst_chars, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+  if (dst_fd == -1) {
+    ::PostFileException(env, errno, dst_chars);
+    goto cleanup;
+  }
+
+  // Try the cheapest way first: sharing the data costs neither time nor
+  // space, copying within the kernel saves copying through user space, and
+  // only the last way works for every kind of file.
+  if (S_ISREG(statbuf.st_mode) && portable_clone_file(src_fd, dst_fd) == 0) {
+    strategy = COPY_CLONE;
+  } else if ((r = CopyInKernel(portable_copy_file_range, src_fd, dst_fd,
+                               statbuf.st_size)) != 0) {
+    strategy = COPY_FILE_RANGE;
+  } else if ((r = CopyInKernel(portable_sendfile, src_fd, dst_fd,
+                               statbuf.st_size)) != 0) {
+    strategy = COPY_SENDFILE;
+  } else {
+    portable_fadvise_sequential(src_fd);
+    r = CopyReadWrite(src_fd, dst_fd);
+    strategy = COPY_READ_WRITE;
+  }
+  if (strategy != COPY_CLONE && r == -1) {
+    std::string filename(std::string(src_chars) + " -> " + dst_chars);
+    ::PostFileException(env, errno, filename.c_str());
+    strategy = -1;
+    goto cleanup;
+  }
+  if (close(dst_fd) == -1) {
+    dst_fd = -1;
+    ::PostFileException(env, errno, dst_chars);
+    strategy = -1;
+    goto cleanup;
+  }
+  dst_fd = -1;
+
+cleanup:
+  if (src_fd != -1) {
+    close(src_fd);
+  }
+  if (dst_fd != -1) {
+    close(dst_fd);
+  }
+  ReleaseStringLatin1Chars(src_chars);
+  ReleaseStringLatin1Chars(dst_chars);
+  return strategy;
+}
+
+static bool delete_common(JNIEnv *env,
+                          jstring path,
+                          int (*delete_function)(const char *),
+                          bool (*error_function)(int)) {
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  if (path_chars == NULL) {
+      return false;
+  }
+  bool ok = delete_function(path_chars) != -1;
+  if (!ok) {
+    if (!error_function(errno)) {
+      ::PostFileException(env, errno, path_chars);
+    }
+  }
+  ReleaseStringLatin1Chars(path_chars);
+  return ok;
+}
+
+static bool unlink_err(int err) { return err == ENOENT; }
+static bool remove_err(int err) { return err == ENOENT || err == ENOTDIR; }
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    unlink
+ * Signature: (Ljava/lang/String;)V
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT bool JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_unlink(JNIEnv *env,
+                                                   jclass clazz,
+                                                   jstring path) {
+  return ::delete_common(env, path, ::unlink, ::unlink_err);
+}
+
+/*
  * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
  * Method:    remove
  * Signature: (Ljava/lang/String;)V
@@ -825,6 +2200,400 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_remove(JNIEnv *env,
   return ::delete_common(env, path, ::remove, ::remove_err);
 }
 
+// Deletes directory trees on a pool of threads. Every directory is opened
+// relative to the file descriptor of its root, its entries are removed with
+// unlinkat(2), and it is removed itself once it has been read and all its
+// subdirectories are gone. Like build-runfiles' DelTree, directories are made
+// readable, writable and searchable by the owner as they are visited.
+class TreeDeleter {
+ public:
+  explicit TreeDeleter(const std::vector<std::string> &roots)
+      : roots_(roots), root_fds_(roots.size(), -1), busy_(0),
+        errors_(roots.size()) {}
+
+  ~TreeDeleter() {
+    for (int fd : root_fds_) {
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+  }
+
+  // Deletes all roots, using up to "parallelism" threads including the
+  // calling one. Roots that do not exist are not an error.
+  void Run(int parallelism) {
+    for (size_t i = 0; i < roots_.size(); i++) {
+      StartRoot(i);
+    }
+    // Even a single root soon fills the queue with its subdirectories, so the
+    // other threads wait for those instead of being sized by the roots.
+    RunInParallel(parallelism, [this]() { Work(); });
+  }
+
+  // Returns a message describing the first failure to delete something below
+  // the i-th root, or an empty string if it was deleted.
+  const std::string &Error(size_t i) const { return errors_[i]; }
+
+ private:
+  struct Directory {
+    size_t root;
+    Directory *parent;  // NULL for a root
+    std::string path;   // relative to the root's descriptor
+    // One for the scan of this directory, plus one per subdirectory that is
+    // not yet removed.
+    std::atomic<int> pending;
+  };
+
+  void StartRoot(size_t i) {
+    const char *root = roots_[i].c_str();
+    portable_stat_struct statbuf;
+    if (portable_lstat(root, &statbuf) == -1) {
+      if (errno != ENOENT) {
+        SetError(i, errno, roots_[i]);
+      }
+      return;
+    }
+    if (!S_ISDIR(statbuf.st_mode)) {
+      if (unlink(root) == -1 && errno != ENOENT) {
+        SetError(i, errno, roots_[i]);
+      }
+      return;
+    }
+    int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    int fd = open(root, flags);
+    if (fd == -1 && errno == EACCES &&
+        chmod(root, (statbuf.st_mode & 07777) | S_IRWXU) == 0) {
+      fd = open(root, flags);
+    }
+    if (fd == -1) {
+      SetError(i, errno, roots_[i]);
+      return;
+    }
+    root_fds_[i] = fd;
+    Push(new Directory{i, NULL, ".", {1}});
+  }
+
+  void Push(Directory *dir) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(dir);
+    cond_.notify_one();
+  }
+
+  void Work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      while (queue_.empty() && busy_ > 0) {
+        cond_.wait(lock);
+      }
+      if (queue_.empty()) {
+        cond_.notify_all();
+        return;
+      }
+      Directory *dir = queue_.front();
+      queue_.pop_front();
+      busy_++;
+      lock.unlock();
+      Scan(dir);
+      lock.lock();
+      busy_--;
+    }
+  }
+
+  // Removes all entries of "dir" other than subdirectories, which are queued.
+  void Scan(Directory *dir) {
+    int root_fd = root_fds_[dir->root];
+    const char *path = dir->path.c_str();
+    int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    int fd = openat(root_fd, path, flags);
+    portable_stat_struct statbuf;
+    if (fd == -1 && errno == EACCES &&
+        portable_fstatat(root_fd, const_cast<char *>(path), &statbuf,
+                         AT_SYMLINK_NOFOLLOW) == 0 &&
+        fchmodat(root_fd, path, (statbuf.st_mode & 07777) | S_IRWXU, 0) == 0) {
+      fd = openat(root_fd, path, flags);
+    }
+    if (fd == -1) {
+      if (errno != ENOENT) {
+        SetError(dir->root, errno, FullPath(*dir, NULL));
+      }
+      Finish(dir);
+      return;
+    }
+    if (portable_fstat(fd, &statbuf) == 0 &&
+        (statbuf.st_mode & S_IRWXU) != S_IRWXU) {
+      fchmod(fd, (statbuf.st_mode & 07777) | S_IRWXU);
+    }
+
+    DIR *dirp = fdopendir(fd);
+    if (dirp == NULL) {
+      SetError(dir->root, errno, FullPath(*dir, NULL));
+      close(fd);
+      Finish(dir);
+      return;
+    }
+    for (;;) {
+      errno = 0;
+      struct dirent *entry = readdir(dirp);
+      if (entry == NULL) {
+        if (errno != 0) {
+          SetError(dir->root, errno, FullPath(*dir, NULL));
+        }
+        break;
+      }
+      char *name = entry->d_name;
+      if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        continue;
+      }
+      bool is_dir = entry->d_type == DT_DIR;
+      if (entry->d_type == DT_UNKNOWN) {
+        is_dir =
+            portable_fstatat(fd, name, &statbuf, AT_SYMLINK_NOFOLLOW) == 0 &&
+            S_ISDIR(statbuf.st_mode);
+      }
+      if (is_dir) {
+        dir->pending++;
+        std::string child_path =
+            dir->parent == NULL ? name : dir->path + "/" + name;
+        Push(new Directory{dir->root, dir, child_path, {1}});
+      } else if (unlinkat(fd, name, 0) == -1 && errno != ENOENT) {
+        SetError(dir->root, errno, FullPath(*dir, name));
+      }
+    }
+    closedir(dirp);
+    Finish(dir);
+  }
+
+  // Called when the scan of "dir", or the removal of one of its
+  // subdirectories, is done. Removes "dir" if that was the last thing it was
+  // waiting for.
+  void Finish(Directory *dir) {
+    while (dir != NULL && --dir->pending == 0) {
+      int r;
+      if (dir->parent == NULL) {
+        r = rmdir(roots_[dir->root].c_str());
+      } else {
+        r = unlinkat(root_fds_[dir->root], dir->path.c_str(), AT_REMOVEDIR);
+      }
+      if (r == -1 && errno != ENOENT) {
+        SetError(dir->root, errno, FullPath(*dir, NULL));
+      }
+      Directory *parent = dir->parent;
+      delete dir;
+      dir = parent;
+    }
+  }
+
+  std::string FullPath(const Directory &dir, const char *name) const {
+    std::string result = roots_[dir.root];
+    if (dir.parent != NULL) {
+      result += "/" + dir.path;
+    }
+    if (name != NULL) {
+      result += "/";
+      result += name;
+    }
+    return result;
+  }
+
+  void SetError(size_t root, int error_number, const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (errors_[root].empty()) {
+      errors_[root] = path + " (" + ErrorMessage(error_number) + ")";
+    }
+  }
+
+  const std::vector<std::string> roots_;
+  std::vector<int> root_fds_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Directory *> queue_;  // guarded by mutex_
+  int busy_;                       // guarded by mutex_
+  std::vector<std::string> errors_;  // guarded by mutex_
+};
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    deleteTreesBatch
+ * Signature: ([Ljava/lang/String;I)[Ljava/lang/String;
+ */
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_deleteTreesBatch(
+    JNIEnv *env, jclass clazz, jobjectArray roots, jint parallelism) {
+  std::vector<std::string> root_chars;
+  if (!GetStringLatin1Array(env, roots, &root_chars)) {
+    return NULL;
+  }
+  TreeDeleter deleter(root_chars);
+  deleter.Run(parallelism);
+
+  static jclass string_class = NULL;
+  if (string_class == NULL) {  // note: harmless race condition
+    jclass local = env->FindClass("java/lang/String");
+    CHECK(local != NULL);
+    string_class = static_cast<jclass>(env->NewGlobalRef(local));
+  }
+  jobjectArray result =
+      env->NewObjectArray(root_chars.size(), string_class, NULL);
+  if (result == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < root_chars.size(); i++) {
+    if (deleter.Error(i).empty()) {
+      continue;
+    }
+    jstring error = NewStringLatin1(env, deleter.Error(i).c_str());
+    if (error == NULL) {
+      return NULL;
+    }
+    env->SetObjectArrayElement(result, i, error);
+    env->DeleteLocalRef(error);
+  }
+  return result;
+}
+
+// Returns the nul-terminated strings packed one after the other into
+// "packed". They point into "packed", which must outlive them.
+static std::vector<const char *> UnpackStrings(const std::string &packed) {
+  std::vector<const char *> result;
+  for (size_t i = 0; i < packed.size(); i += strlen(&packed[i]) + 1) {
+    result.push_back(&packed[i]);
+  }
+  return result;
+}
+
+// Copies the contents of "array" into "out". Returns false if an exception
+// is pending.
+static bool GetByteArray(JNIEnv *env, jbyteArray array, std::string *out) {
+  jsize length = env->GetArrayLength(array);
+  out->resize(length);
+  if (length > 0) {
+    env->GetByteArrayRegion(array, 0, length,
+                            reinterpret_cast<jbyte *>(&(*out)[0]));
+  }
+  return !env->ExceptionCheck();
+}
+
+// Creates the symlink "path", relative to "root_fd", pointing to "target", or
+// an empty file if "target" is empty. A symlink that already points to
+// "target" is kept, anything else in the way is removed first. Returns 0 or
+// an errno value.
+static int CreateForestEntry(int root_fd, const char *path,
+                             const char *target) {
+  if (*target == '\0') {
+    if (unlinkat(root_fd, path, 0) == -1 && errno != ENOENT) {
+      return errno;
+    }
+    int fd = openat(root_fd, path,
+                    O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                    0666);
+    if (fd == -1) {
+      return errno;
+    }
+    close(fd);
+    return 0;
+  }
+  if (symlinkat(target, root_fd, path) == 0) {
+    return 0;
+  }
+  if (errno != EEXIST) {
+    return errno;
+  }
+  size_t target_len = strlen(target);
+  std::vector<char> existing(target_len + 1);
+  ssize_t len = readlinkat(root_fd, path, &existing[0], existing.size());
+  if (len == static_cast<ssize_t>(target_len) &&
+      memcmp(&existing[0], target, target_len) == 0) {
+    return 0;
+  }
+  if (unlinkat(root_fd, path, 0) == -1 ||
+      symlinkat(target, root_fd, path) == -1) {
+    return errno;
+  }
+  return 0;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    createSymlinkForest
+ * Signature: (Ljava/lang/String;[B[BI)V
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_createSymlinkForest(
+    JNIEnv *env, jclass clazz, jstring root, jbyteArray packed_paths,
+    jbyteArray packed_targets, jint parallelism) {
+  std::string paths_chars;
+  std::string targets_chars;
+  if (!GetByteArray(env, packed_paths, &paths_chars) ||
+      !GetByteArray(env, packed_targets, &targets_chars)) {
+    return;
+  }
+  std::vector<const char *> paths = UnpackStrings(paths_chars);
+  std::vector<const char *> targets = UnpackStrings(targets_chars);
+  if (paths.size() != targets.size()) {
+    ::PostException(env, EINVAL, "createSymlinkForest: " +
+                                     std::to_string(paths.size()) +
+                                     " paths but " +
+                                     std::to_string(targets.size()) +
+                                     " targets");
+    return;
+  }
+
+  const char *root_chars = GetStringLatin1Chars(env, root);
+  if (root_chars == NULL) {
+    return;
+  }
+  std::string root_path(root_chars);
+  ReleaseStringLatin1Chars(root_chars);
+  int root_fd = open(root_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (root_fd == -1) {
+    ::PostFileException(env, errno, root_path.c_str());
+    return;
+  }
+
+  // Create every parent directory once, and before any of the links, so
+  // that a link to a directory can never be followed to create something
+  // outside the root. Sorting puts each directory after its ancestors.
+  std::set<std::string> dirs;
+  for (const char *path : paths) {
+    std::string dir(path);
+    for (size_t slash = dir.rfind('/'); slash != std::string::npos;
+         slash = dir.rfind('/')) {
+      dir.resize(slash);
+      if (!dirs.insert(dir).second) {
+        break;
+      }
+    }
+  }
+  for (const std::string &dir : dirs) {
+    if (mkdirat(root_fd, dir.c_str(), 0777) == -1 && errno != EEXIST) {
+      ::PostFileException(env, errno, (root_path + "/" + dir).c_str());
+      close(root_fd);
+      return;
+    }
+  }
+
+  std::mutex mutex;
+  size_t failed_index = paths.size();
+  int failed_errno = 0;
+  ParallelFor(paths.size(), parallelism, [&](size_t i) {
+    int error = CreateForestEntry(root_fd, paths[i], targets[i]);
+    if (error != 0) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (i < failed_index) {
+        failed_index = i;
+        failed_errno = error;
+      }
+    }
+  });
+  close(root_fd);
+  if (failed_index < paths.size()) {
+    ::PostFileException(env, failed_errno,
+                        (root_path + "/" + paths[failed_index]).c_str());
+  }
+}
+
 /*
  * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
  * Method:    mkfifo
@@ -892,52 +2661,308 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_lgetxattr(JNIEnv *env,
 }
 
 
-// Computes MD5 digest of "file", writes result in "result", which
-// must be of length Md5Digest::kDigestLength.  Returns zero on success, or
-// -1 (and sets errno) otherwise.
-static int md5sumAsBytes(const char *file,
-                         jbyte result[Md5Digest::kDigestLength]) {
-  Md5Digest digest;
-  // OPT: Using a 32k buffer would give marginally better performance,
-  // but what is the stack size here?
-  jbyte buf[8192];
-  int fd;
-  while ((fd = open(file, O_RDONLY)) == -1 && errno == EINTR) { }
-  if (fd == -1) {
-    return -1;
+// Digest algorithms, numbered as NativePosixFiles.DIGEST_*.
+enum DigestAlgorithm {
+  DIGEST_MD5 = 0,
+  DIGEST_SHA1 = 1,
+  DIGEST_SHA256 = 2,
+};
+
+// Returns the length in bytes of a digest computed with "algorithm", or 0 if
+// "algorithm" is unknown.
+static int DigestLength(int algorithm) {
+  switch (algorithm) {
+    case DIGEST_MD5:
+      return Md5Digest::kDigestLength;
+    case DIGEST_SHA1:
+      return Sha1Digest::kDigestLength;
+    case DIGEST_SHA256:
+      return Sha256Digest::kDigestLength;
+    default:
+      return 0;
   }
-  for (ssize_t len = read(fd, buf, arraysize(buf));
+}
+
+// Reads are at most this large. Files are deliberately not mmap()ed: if one
+// were truncated while being hashed, the SIGBUS would take down the JVM.
+static const size_t kMaxDigestReadSize = 1 << 20;
+// Reads are at least this large, since files such as those in procfs report a
+// size of zero whatever they hold.
+static const size_t kMinDigestReadSize = 64 << 10;
+
+// Feeds the contents of "fd", which has "size" bytes according to fstat(),
+// to "digest" and writes the result in "result". Returns zero on success, or
+// -1 (and sets errno) otherwise.
+template <class Digest>
+static int DigestFd(int fd, off_t size, unsigned char *result) {
+  Digest digest;
+  // A buffer one byte larger than the file sees EOF with a single read().
+  size_t buf_size = std::min(
+      std::max(static_cast<size_t>(std::max<off_t>(size, 0)) + 1,
+               kMinDigestReadSize),
+      kMaxDigestReadSize);
+  std::unique_ptr<char[]> buf(new char[buf_size]);
+  for (ssize_t len = read(fd, buf.get(), buf_size);
        len != 0;
-       len = read(fd, buf, arraysize(buf))) {
+       len = read(fd, buf.get(), buf_size)) {
     if (len == -1) {
       if (errno == EINTR) {
         continue;
-      } else {
-        int read_errno = errno;
-        close(fd);  // prefer read() errors over close().
-        errno = read_errno;
-        return -1;
       }
+      return -1;
+    }
+    digest.Update(buf.get(), len);
+  }
+  digest.Finish(result);
+  return 0;
+}
+
+// Like DigestFd, for the digest class that implements "algorithm".
+static int DigestFd(int fd, int algorithm, off_t size, unsigned char *result) {
+  switch (algorithm) {
+    case DIGEST_MD5:
+      return DigestFd<Md5Digest>(fd, size, result);
+    case DIGEST_SHA1:
+      return DigestFd<Sha1Digest>(fd, size, result);
+    case DIGEST_SHA256:
+      return DigestFd<Sha256Digest>(fd, size, result);
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+}
+
+// A digest cached in an extended attribute of the file is only trusted if
+// the file still has the inode number, size and modification time it had
+// when it was hashed. The change time cannot be part of this key, because
+// setting the attribute changes it.
+//
+// The attribute holds kDigestXattrVersion, the inode number, the size, the
+// modification time in nanoseconds, each as 8 little-endian bytes, followed
+// by the digest.
+static const uint64_t kDigestXattrVersion = 1;
+static const size_t kDigestXattrHeaderSize = 4 * 8;
+
+// Modification times are taken from a clock that ticks every few
+// milliseconds, so a file written again right after it was hashed could keep
+// its mtime. Digests of files modified less than this long ago are not
+// cached.
+static const int64_t kRacyMtimeWindowNanos = 100 * 1000 * 1000;
+
+// Returns the name of the attribute, in the user namespace, that caches
+// digests computed with "algorithm".
+static const char *DigestXattrName(int algorithm) {
+  switch (algorithm) {
+    case DIGEST_MD5:
+      return "bazel.md5";
+    case DIGEST_SHA1:
+      return "bazel.sha1";
+    default:
+      return "bazel.sha256";
+  }
+}
+
+static int64_t StatMtimeNanos(const portable_stat_struct &statbuf) {
+  return StatSeconds(statbuf, STAT_MTIME) * 1000000000LL +
+         StatNanoSeconds(statbuf, STAT_MTIME);
+}
+
+static void EncodeDigestXattrHeader(const portable_stat_struct &statbuf,
+                                    unsigned char *out) {
+  uint64_t fields[] = {kDigestXattrVersion,
+                       static_cast<uint64_t>(statbuf.st_ino),
+                       static_cast<uint64_t>(statbuf.st_size),
+                       static_cast<uint64_t>(StatMtimeNanos(statbuf))};
+  for (uint64_t field : fields) {
+    for (int i = 0; i < 8; i++) {
+      *out++ = static_cast<unsigned char>(field >> (8 * i));
+    }
+  }
+}
+
+// Copies the digest cached in an extended attribute of "fd" to "result" and
+// returns true if there is one and it is still valid for "statbuf".
+static bool ReadDigestXattr(int fd, const portable_stat_struct &statbuf,
+                            int algorithm, unsigned char *result) {
+  size_t length = DigestLength(algorithm);
+  unsigned char value[kDigestXattrHeaderSize + Sha256Digest::kDigestLength];
+  bool attr_not_found = false;
+  ssize_t size = portable_fgetxattr_user(fd, DigestXattrName(algorithm), value,
+                                         sizeof(value), &attr_not_found);
+  if (size != static_cast<ssize_t>(kDigestXattrHeaderSize + length)) {
+    return false;
+  }
+  unsigned char expected[kDigestXattrHeaderSize];
+  EncodeDigestXattrHeader(statbuf, expected);
+  if (memcmp(value, expected, kDigestXattrHeaderSize) != 0) {
+    return false;
+  }
+  memcpy(result, value + kDigestXattrHeaderSize, length);
+  return true;
+}
+
+// Caches "digest" in an extended attribute of "fd", whose contents it is as
+// of "statbuf". Failures are ignored, since the cache is only an
+// optimization.
+//
+// Setting the attribute changes the change time of the file, which Bazel
+// compares to notice modified files that have no fast digest. Files that are
+// not writable by their owner, such as outputs once Bazel has recorded their
+// metadata, are therefore left alone, even if we could write them anyway.
+static void WriteDigestXattr(int fd, const portable_stat_struct &statbuf,
+                             int algorithm, const unsigned char *digest) {
+  if ((statbuf.st_mode & S_IWUSR) == 0) {
+    return;
+  }
+  struct timespec now;
+  if (clock_gettime(CLOCK_REALTIME, &now) == -1 ||
+      now.tv_sec * 1000000000LL + now.tv_nsec - StatMtimeNanos(statbuf) <
+          kRacyMtimeWindowNanos) {
+    return;
+  }
+  size_t length = DigestLength(algorithm);
+  unsigned char value[kDigestXattrHeaderSize + Sha256Digest::kDigestLength];
+  EncodeDigestXattrHeader(statbuf, value);
+  memcpy(value + kDigestXattrHeaderSize, digest, length);
+  portable_fsetxattr_user(fd, DigestXattrName(algorithm), value,
+                          kDigestXattrHeaderSize + length);
+}
+
+// Copies the digest of "file" with "algorithm" cached in an extended
+// attribute to "result" and returns true if there is a valid one, without
+// hashing the file.
+static bool GetCachedDigest(const char *file, int algorithm,
+                            unsigned char *result) {
+  int fd;
+  while ((fd = open(file, O_RDONLY | O_CLOEXEC)) == -1 && errno == EINTR) { }
+  if (fd == -1) {
+    return false;
+  }
+  portable_stat_struct statbuf;
+  bool found = portable_fstat(fd, &statbuf) == 0 &&
+               S_ISREG(statbuf.st_mode) &&
+               ReadDigestXattr(fd, statbuf, algorithm, result);
+  close(fd);
+  return found;
+}
+
+// Computes the digest of "file" with "algorithm", writes result in "result",
+// which must be of length DigestLength(algorithm). If "use_xattr_cache", a
+// valid digest cached in an extended attribute of the file is returned
+// instead, and a computed digest is cached there. Returns zero on success, or
+// -1 (and sets errno) otherwise.
+static int DigestFile(const char *file, int algorithm, bool use_xattr_cache,
+                      unsigned char *result) {
+  int fd;
+  while ((fd = open(file, O_RDONLY | O_CLOEXEC)) == -1 && errno == EINTR) { }
+  if (fd == -1) {
+    return -1;
+  }
+  portable_stat_struct statbuf;
+  off_t size = 0;
+  bool is_regular =
+      portable_fstat(fd, &statbuf) == 0 && S_ISREG(statbuf.st_mode);
+  if (is_regular) {
+    size = statbuf.st_size;
+    if (use_xattr_cache && ReadDigestXattr(fd, statbuf, algorithm, result)) {
+      close(fd);
+      return 0;
+    }
+    if (size > static_cast<off_t>(kMaxDigestReadSize)) {
+      portable_fadvise_sequential(fd);
+    }
+  }
+  if (DigestFd(fd, algorithm, size, result) == -1) {
+    int read_errno = errno;
+    close(fd);  // prefer read() errors over close().
+    errno = read_errno;
+    return -1;
+  }
+  if (is_regular && use_xattr_cache) {
+    // Only cache the digest if the file did not change while being hashed.
+    portable_stat_struct after;
+    if (portable_fstat(fd, &after) == 0 && after.st_ino == statbuf.st_ino &&
+        after.st_size == statbuf.st_size &&
+        StatMtimeNanos(after) == StatMtimeNanos(statbuf)) {
+      WriteDigestXattr(fd, after, algorithm, result);
     }
-    digest.Update(buf, len);
   }
   if (close(fd) < 0 && errno != EINTR) {
     return -1;
   }
-  digest.Finish(reinterpret_cast<unsigned char*>(result));
   return 0;
 }
 
+// Returns a new byte[] holding "digest", of length DigestLength(algorithm).
+static jbyteArray NewDigestArray(JNIEnv *env, int algorithm,
+                                 const unsigned char *digest) {
+  jsize length = DigestLength(algorithm);
+  jbyteArray result = env->NewByteArray(length);
+  if (result != NULL) {
+    env->SetByteArrayRegion(result, 0, length,
+                            reinterpret_cast<const jbyte *>(digest));
+  }
+  return result;
+}
 
 extern "C" JNIEXPORT jbyteArray JNICALL
 Java_com_google_devtools_build_lib_unix_NativePosixFiles_md5sumAsBytes(
     JNIEnv *env, jclass clazz, jstring path) {
   const char *path_chars = GetStringLatin1Chars(env, path);
-  jbyte value[Md5Digest::kDigestLength];
+  unsigned char value[Md5Digest::kDigestLength];
+  jbyteArray result = NULL;
+  if (DigestFile(path_chars, DIGEST_MD5, false, value) == 0) {
+    result = NewDigestArray(env, DIGEST_MD5, value);
+  } else {
+    ::PostFileException(env, errno, path_chars);
+  }
+  ReleaseStringLatin1Chars(path_chars);
+  return result;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    digestAsBytes
+ * Signature: (Ljava/lang/String;I)[B
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_digestAsBytes(
+    JNIEnv *env, jclass clazz, jstring path, jint algorithm) {
+  if (DigestLength(algorithm) == 0) {
+    ::PostException(env, EINVAL, "unknown digest algorithm");
+    return NULL;
+  }
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  unsigned char value[Sha256Digest::kDigestLength];
+  jbyteArray result = NULL;
+  if (DigestFile(path_chars, algorithm, false, value) == 0) {
+    result = NewDigestArray(env, algorithm, value);
+  } else {
+    ::PostFileException(env, errno, path_chars);
+  }
+  ReleaseStringLatin1Chars(path_chars);
+  return result;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    getOrComputeDigest
+ * Signature: (Ljava/lang/String;I)[B
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_getOrComputeDigest(
+    JNIEnv *env, jclass clazz, jstring path, jint algorithm) {
+  if (DigestLength(algorithm) == 0) {
+    ::PostException(env, EINVAL, "unknown digest algorithm");
+    return NULL;
+  }
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  unsigned char value[Sha256Digest::kDigestLength];
   jbyteArray result = NULL;
-  if (md5sumAsBytes(path_chars, value) == 0) {
-    result = env->NewByteArray(Md5Digest::kDigestLength);
-    env->SetByteArrayRegion(result, 0, Md5Digest::kDigestLength, value);
+  if (DigestFile(path_chars, algorithm, true, value) == 0) {
+    result = NewDigestArray(env, algorithm, value);
   } else {
     ::PostFileException(env, errno, path_chars);
   }
@@ -945,6 +2970,79 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_md5sumAsBytes(
   return result;
 }
 
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    getCachedDigest
+ * Signature: (Ljava/lang/String;I)[B
+ */
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_getCachedDigest(
+    JNIEnv *env, jclass clazz, jstring path, jint algorithm) {
+  if (DigestLength(algorithm) == 0) {
+    ::PostException(env, EINVAL, "unknown digest algorithm");
+    return NULL;
+  }
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  unsigned char value[Sha256Digest::kDigestLength];
+  jbyteArray result = NULL;
+  if (GetCachedDigest(path_chars, algorithm, value)) {
+    result = NewDigestArray(env, algorithm, value);
+  }
+  ReleaseStringLatin1Chars(path_chars);
+  return result;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    batchDigest
+ * Signature: ([Ljava/lang/String;IZI)[[B
+ */
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_batchDigest(
+    JNIEnv *env, jclass clazz, jobjectArray paths, jint algorithm,
+    jboolean use_xattr_cache, jint parallelism) {
+  int length = DigestLength(algorithm);
+  if (length == 0) {
+    ::PostException(env, EINVAL, "unknown digest algorithm");
+    return NULL;
+  }
+  std::vector<std::string> path_chars;
+  if (!GetStringLatin1Array(env, paths, &path_chars)) {
+    return NULL;
+  }
+
+  size_t count = path_chars.size();
+  std::vector<unsigned char> digests(count * length);
+  std::unique_ptr<bool[]> ok(new bool[count]);
+  ParallelFor(count, parallelism, [&](size_t i) {
+    ok[i] = DigestFile(path_chars[i].c_str(), algorithm, use_xattr_cache,
+                       &digests[i * length]) == 0;
+  });
+
+  static jclass byte_array_class = NULL;
+  if (byte_array_class == NULL) {  // note: harmless race condition
+    jclass local = env->FindClass("[B");
+    CHECK(local != NULL);
+    byte_array_class = static_cast<jclass>(env->NewGlobalRef(local));
+  }
+  jobjectArray result = env->NewObjectArray(count, byte_array_class, NULL);
+  if (result == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (!ok[i]) {
+      continue;
+    }
+    jbyteArray digest = NewDigestArray(env, algorithm, &digests[i * length]);
+    if (digest == NULL) {
+      return NULL;
+    }
+    env->SetObjectArrayElement(result, i, digest);
+    env->DeleteLocalRef(digest);
+  }
+  return result;
+}
+
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_google_devtools_build_lib_unix_NativePosixSystem_sysctlbynameGetLong(
     JNIEnv *env, jclass clazz, jstring name) {
@@ -20,6 +20,7 @@
 #include <jni.h>
 #include <sys/stat.h>
 
+#include <functional>
 #include <string>
 
 #define CHECK(condition) \
@@ -36,16 +37,28 @@
 typedef struct stat portable_stat_struct;
 #define portable_stat ::stat
 #define portable_lstat ::lstat
+#define portable_fstat ::fstat
 #else
 typedef struct stat64 portable_stat_struct;
 #define portable_stat ::stat64
 #define portable_lstat ::lstat64
+#define portable_fstat ::fstat64
 #endif
 
 #if defined(__FreeBSD__)
 #define ENODATA ENOATTR
 #endif
 
+// Returns a new Java String for the specified Latin1 characters.
+jstring NewStringLatin1(JNIEnv *env, const char *str);
+
+// Returns a nul-terminated Latin1-encoded copy of the specified Java string,
+// or NULL on failure. Must be freed with ReleaseStringLatin1Chars.
+char *GetStringLatin1Chars(JNIEnv *env, jstring jstr);
+
+// Releases the chars returned by a prior call to GetStringLatin1Chars.
+void ReleaseStringLatin1Chars(const char *s);
+
 // Posts a JNI exception to the current thread with the specified
 // message; the exception's class is determined by the specified UNIX
 // error number.  See package-info.html for details.
@@ -66,6 +79,21 @@ extern void PostSystemException(JNIEnv *env, int error_number,
 // Returns the standard error message for a given UNIX error number.
 extern std::string ErrorMessage(int error_number);
 
+// Runs "work" on the calling thread and, at the same time, on up to
+// "parallelism" - 1 threads of a pool that has one thread per CPU and is
+// shared by all callers in the process. Copies that find no free thread
+// before the calling thread's copy returns are dropped, so every copy must
+// take work until none is left. Returns when all started copies have
+// returned. "work" must not call into the JVM.
+void RunInParallel(int parallelism, const std::function<void()> &work);
+
+// Calls fn(i) for every i in [0, count), spread over at most "parallelism"
+// threads including the calling one, the others taken from the pool of
+// RunInParallel. Returns when all calls have returned. "fn" must not call
+// into the JVM.
+void ParallelFor(size_t count, int parallelism,
+                 const std::function<void(size_t)> &fn);
+
 // Runs fstatat(2), if available, or sets errno to ENOSYS if not.
 int portable_fstatat(int dirfd, char *name, portable_stat_struct *statbuf,
                      int flags);
@@ -95,7 +123,39 @@ ssize_t portable_getxattr(const char *path, const char *name, void *value,
 ssize_t portable_lgetxattr(const char *path, const char *name, void *value,
                            size_t size, bool *attr_not_found);
 
+// Runs fgetxattr(2) for the attribute "name" among the user's attributes
+// (prefixed with "user." on Linux). Reports a missing attribute like
+// portable_getxattr.
+ssize_t portable_fgetxattr_user(int fd, const char *name, void *value,
+                                size_t size, bool *attr_not_found);
+
+// Runs fsetxattr(2) for the attribute "name" among the user's attributes.
+// Returns 0 on success, or -1 and sets errno.
+int portable_fsetxattr_user(int fd, const char *name, const void *value,
+                            size_t size);
+
 // Run sysctlbyname(3), only available on darwin
 int portable_sysctlbyname(const char *name_chars, long *mibp, size_t *sizep);
 
+// Hints that all of "fd" is about to be read sequentially, so that the kernel
+// reads ahead aggressively. Errors are ignored.
+void portable_fadvise_sequential(int fd);
+
+// Makes the file "dst_fd" share the data of "src_fd" without copying it (a
+// reflink), if the file system supports that. Returns 0 on success, or -1 and
+// sets errno.
+int portable_clone_file(int src_fd, int dst_fd);
+
+// Copies up to "len" bytes from the file offset of "src_fd" to that of
+// "dst_fd" within the kernel, advancing both offsets, as copy_file_range(2).
+// Returns the number of bytes copied, or -1 and sets errno (to ENOSYS if not
+// supported at all).
+ssize_t portable_copy_file_range(int src_fd, int dst_fd, size_t len);
+
+// Copies up to "len" bytes from the file offset of the regular file "src_fd"
+// to that of "dst_fd" within the kernel, like sendfile(2) on Linux. Returns
+// the number of bytes copied, or -1 and sets errno (to ENOSYS if not
+// supported for regular files).
+ssize_t portable_sendfile(int src_fd, int dst_fd, size_t len);
+
 #endif  // BAZEL_SRC_MAIN_NATIVE_UNIX_JNI_H__
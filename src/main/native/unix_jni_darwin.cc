@@ -117,6 +117,41 @@ ssize_t portable_lgetxattr(const char *path, const char *name, void *value,
   return result;
 }
 
+ssize_t portable_fgetxattr_user(int fd, const char *name, void *value,
+                                size_t size, bool *attr_not_found) {
+  ssize_t result = fgetxattr(fd, name, value, size, 0, 0);
+  *attr_not_found = (result == -1 && errno == ENOATTR);
+  return result;
+}
+
+int portable_fsetxattr_user(int fd, const char *name, const void *value,
+                            size_t size) {
+  return fsetxattr(fd, name, value, size, 0, 0);
+}
+
 int portable_sysctlbyname(const char *name_chars, long *mibp, size_t *sizep) {
   return sysctlbyname(name_chars, mibp, sizep, NULL, 0);
 }
+
+void portable_fadvise_sequential(int fd) {
+  // There is no posix_fadvise(2); read-ahead is on by default, but make sure.
+  fcntl(fd, F_RDAHEAD, 1);
+}
+
+int portable_clone_file(int src_fd, int dst_fd) {
+  // APFS clones are only created by clonefile(2) and friends, which create
+  // the destination themselves and so don't fit an open file descriptor.
+  errno = ENOTSUP;
+  return -1;
+}
+
+ssize_t portable_copy_file_range(int src_fd, int dst_fd, size_t len) {
+  errno = ENOSYS;
+  return -1;
+}
+
+ssize_t portable_sendfile(int src_fd, int dst_fd, size_t len) {
+  // sendfile(2) only writes to sockets here.
+  errno = ENOSYS;
+  return -1;
+}
@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 #include <sys/sysctl.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <string>
 
@@ -86,6 +87,44 @@ ssize_t portable_lgetxattr(const char *path, const char *name, void *value,
   return result;
 }
 
+ssize_t portable_fgetxattr_user(int fd, const char *name, void *value,
+                                size_t size, bool *attr_not_found) {
+  ssize_t result =
+      extattr_get_fd(fd, EXTATTR_NAMESPACE_USER, name, value, size);
+  *attr_not_found = (result == -1 && errno == ENOATTR);
+  return result;
+}
+
+int portable_fsetxattr_user(int fd, const char *name, const void *value,
+                            size_t size) {
+  return extattr_set_fd(fd, EXTATTR_NAMESPACE_USER, name, value, size) == -1
+      ? -1 : 0;
+}
+
 int portable_sysctlbyname(const char *name_chars, long *mibp, size_t *sizep) {
   return sysctlbyname(name_chars, mibp, sizep, NULL, 0);
 }
+
+void portable_fadvise_sequential(int fd) {
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+int portable_clone_file(int src_fd, int dst_fd) {
+  errno = ENOTSUP;
+  return -1;
+}
+
+ssize_t portable_copy_file_range(int src_fd, int dst_fd, size_t len) {
+#if __FreeBSD_version >= 1300037
+  return copy_file_range(src_fd, NULL, dst_fd, NULL, len, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+ssize_t portable_sendfile(int src_fd, int dst_fd, size_t len) {
+  // sendfile(2) only writes to sockets here.
+  errno = ENOSYS;
+  return -1;
+}
@@ -15,13 +15,24 @@
 #include "src/main/native/unix_jni.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/xattr.h>
+#include <unistd.h>
 
 #include <string>
 
+// Older kernel headers lack FICLONE, which is BTRFS_IOC_CLONE made generic in
+// Linux 4.5.
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
 std::string ErrorMessage(int error_number) {
   char buf[1024] = "";
 
@@ -87,7 +98,43 @@ ssize_t portable_lgetxattr(const char *path, const char *name, void *value,
   return result;
 }
 
+ssize_t portable_fgetxattr_user(int fd, const char *name, void *value,
+                                size_t size, bool *attr_not_found) {
+  std::string user_name = std::string("user.") + name;
+  ssize_t result = ::fgetxattr(fd, user_name.c_str(), value, size);
+  *attr_not_found = (result == -1 && errno == ENODATA);
+  return result;
+}
+
+int portable_fsetxattr_user(int fd, const char *name, const void *value,
+                            size_t size) {
+  std::string user_name = std::string("user.") + name;
+  return ::fsetxattr(fd, user_name.c_str(), value, size, 0);
+}
+
 int portable_sysctlbyname(const char *name_chars, long *mibp, size_t *sizep) {
   errno = ENOSYS;
   return -1;
 }
+
+void portable_fadvise_sequential(int fd) {
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+int portable_clone_file(int src_fd, int dst_fd) {
+  return ioctl(dst_fd, FICLONE, src_fd);
+}
+
+ssize_t portable_copy_file_range(int src_fd, int dst_fd, size_t len) {
+#ifdef __NR_copy_file_range
+  // glibc only has a wrapper since 2.27, so make the system call directly.
+  return syscall(__NR_copy_file_range, src_fd, NULL, dst_fd, NULL, len, 0);
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+ssize_t portable_sendfile(int src_fd, int dst_fd, size_t len) {
+  return sendfile(dst_fd, src_fd, NULL, len);
+}
@@ -17,7 +17,16 @@
 // The command line arguments are an input manifest INPUT and an output
 // directory RUNFILES. First, the files in the RUNFILES directory are scanned
 // and any extraneous ones are removed. Second, any missing files are created.
-// Finally, a copy of the input manifest is written to RUNFILES/MANIFEST.
+// Finally, a copy of the input manifest is written to RUNFILES/MANIFEST, and
+// another one to RUNFILES/MANIFEST.built.
+//
+// MANIFEST.built certifies that the tree was built by us for it. Unlike the
+// MANIFEST, which is the output of the action, Bazel neither deletes it before
+// running us nor writes it when runfiles are disabled. If it exists, the next
+// run does not scan the tree: it leaves the tree alone if INPUT equals
+// MANIFEST.built, and otherwise only removes and creates the entries in which
+// the two manifests differ. Large numbers of files and symlinks are created and
+// removed by several threads.
 //
 // The input manifest consists of lines, each containing a relative path within
 // the runfiles, a space, and an optional absolute path.  If this second path
@@ -47,14 +56,20 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 // program_invocation_short_name is not portable.
 static const char *argv0;
@@ -103,12 +118,55 @@ struct FileInfo {
 
 typedef std::map<std::string, FileInfo> FileInfoMap;
 
+// Below this many entries, creating or removing them is not worth starting
+// threads for.
+static const size_t kMinParallelEntries = 1024;
+// How many consecutive entries a thread takes at once. Entries are sorted, so
+// this keeps most of those in one directory on the same thread.
+static const size_t kParallelChunkSize = 256;
+static const unsigned kMaxThreads = 16;
+
+// Calls fn for each element of items, on several threads if there are many.
+template <typename T, typename Fn>
+static void ParallelForEach(const std::vector<T> &items, Fn fn) {
+  unsigned num_threads = std::min(std::thread::hardware_concurrency(),
+                                  kMaxThreads);
+  if (items.size() < kMinParallelEntries || num_threads < 2) {
+    for (const T &item : items) {
+      fn(item);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next_chunk(0);
+  auto worker = [&]() {
+    while (true) {
+      size_t begin = next_chunk.fetch_add(kParallelChunkSize);
+      if (begin >= items.size()) {
+        return;
+      }
+      size_t end = std::min(begin + kParallelChunkSize, items.size());
+      for (size_t i = begin; i < end; ++i) {
+        fn(items[i]);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
 class RunfilesCreator {
  public:
   explicit RunfilesCreator(const std::string &output_base)
       : output_base_(output_base),
         output_filename_("MANIFEST"),
-        temp_filename_(output_filename_ + ".tmp") {
+        temp_filename_(output_filename_ + ".tmp"),
+        built_filename_(output_filename_ + ".built") {
     SetupOutputBase();
     if (chdir(output_base_.c_str()) != 0) {
       PDIE("chdir '%s'", output_base_.c_str());
@@ -117,97 +175,51 @@ class RunfilesCreator {
 
   void ReadManifest(const std::string &manifest_file, bool allow_relative,
                     bool use_metadata) {
-    FILE *outfile = fopen(temp_filename_.c_str(), "w");
-    if (!outfile) {
-      PDIE("opening '%s/%s' for writing", output_base_.c_str(),
-           temp_filename_.c_str());
-    }
-    FILE *infile = fopen(manifest_file.c_str(), "r");
-    if (!infile) {
+    if (!ReadFile(manifest_file, &input_manifest_)) {
       PDIE("opening '%s' for reading", manifest_file.c_str());
     }
+    std::string previous_manifest;
+    incremental_ = ReadPreviousManifest(&previous_manifest);
+    if (incremental_ && previous_manifest == input_manifest_) {
+      // The tree is already what the input manifest asks for.
+      up_to_date_ = true;
+      return;
+    }
 
-    // read input manifest
-    int lineno = 0;
-    char buf[3 * PATH_MAX];
-    while (fgets(buf, sizeof buf, infile)) {
-      // copy line to output manifest
-      if (fputs(buf, outfile) == EOF) {
-        PDIE("writing to '%s/%s'", output_base_.c_str(),
-             temp_filename_.c_str());
-      }
-
-      // parse line
-      ++lineno;
-      // Skip metadata lines. They are used solely for
-      // dependency checking.
-      if (use_metadata && lineno % 2 == 0) continue;
-
-      int n = strlen(buf)-1;
-      if (!n || buf[n] != '\n') {
-        DIE("missing terminator at line %d: '%s'\n", lineno, buf);
-      }
-      buf[n] = '\0';
-      if (buf[0] ==  '/') {
-        DIE("paths must not be absolute: line %d: '%s'\n", lineno, buf);
-      }
-      const char *s = strchr(buf, ' ');
-      if (!s) {
-        DIE("missing field delimiter at line %d: '%s'\n", lineno, buf);
-      } else if (strchr(s+1, ' ')) {
-        DIE("link or target filename contains space on line %d: '%s'\n",
-            lineno, buf);
-      }
-      std::string link(buf, s-buf);
-      const char *target = s+1;
-      if (!allow_relative && target[0] != '\0' && target[0] != '/'
-          && target[1] != ':') {  // Match Windows paths, e.g. C:\foo or C:/foo.
-        DIE("expected absolute path at line %d: '%s'\n", lineno, buf);
-      }
-
-      FileInfo *info = &manifest_[link];
-      if (target[0] == '\0') {
-        // No target means an empty file.
-        info->type = FILE_TYPE_REGULAR;
-      } else {
-        info->type = FILE_TYPE_SYMLINK;
-        info->symlink_target = target;
-      }
-
-      FileInfo parent_info;
-      parent_info.type = FILE_TYPE_DIRECTORY;
-
-      while (true) {
-        int k = link.rfind('/');
-        if (k < 0) break;
-        link.erase(k, std::string::npos);
-        if (!manifest_.insert(std::make_pair(link, parent_info)).second) break;
-      }
+    int lineno;
+    const char *error = ParseManifest(input_manifest_, allow_relative,
+                                      use_metadata, &manifest_, &lineno);
+    if (error != nullptr) {
+      DIE("%s at line %d: '%s'\n", error, lineno,
+          GetLine(input_manifest_, lineno).c_str());
     }
-    if (fclose(outfile) != 0) {
-      PDIE("writing to '%s/%s'", output_base_.c_str(),
-           temp_filename_.c_str());
+    if (incremental_) {
+      incremental_ = ParseManifest(previous_manifest, true, use_metadata,
+                                   &previous_, &lineno) == nullptr;
     }
-    fclose(infile);
-
-    // Don't delete the temp manifest file.
-    manifest_[temp_filename_].type = FILE_TYPE_REGULAR;
   }
 
   void CreateRunfiles() {
-    if (unlink(output_filename_.c_str()) != 0 && errno != ENOENT) {
-      PDIE("removing previous file at '%s/%s'", output_base_.c_str(),
-           output_filename_.c_str());
+    // Bazel deletes the MANIFEST before it runs us, so even a tree that is up
+    // to date needs it written again.
+    if (!up_to_date_) {
+      // The tree is about to change, so neither manifest describes it until
+      // we are done.
+      RemoveFile(built_filename_);
+      RemoveFile(output_filename_);
+
+      if (incremental_) {
+        UpdateTree(previous_);
+      } else {
+        ScanTreeAndPrune(".");
+        CreateFiles(manifest_);
+      }
     }
 
-    ScanTreeAndPrune(".");
-    CreateFiles();
-
-    // rename output file into place
-    if (rename(temp_filename_.c_str(), output_filename_.c_str()) != 0) {
-      PDIE("renaming '%s/%s' to '%s/%s'",
-           output_base_.c_str(), temp_filename_.c_str(),
-           output_base_.c_str(), output_filename_.c_str());
+    // write and rename output files into place
+    ReplaceFile(output_filename_, input_manifest_);
+    if (!up_to_date_) {
+      ReplaceFile(built_filename_, input_manifest_);
     }
   }
 
@@ -279,48 +291,255 @@ class RunfilesCreator {
     closedir(dh);
   }
 
-  void CreateFiles() {
+  // Parses manifest into entries and all their parent directories. Returns
+  // nullptr on success, and otherwise what is wrong with the line *lineno.
+  static const char *ParseManifest(const std::string &manifest,
+                                   bool allow_relative, bool use_metadata,
+                                   FileInfoMap *entries, int *lineno) {
+    *lineno = 0;
+    size_t pos = 0;
+    while (pos < manifest.size()) {
+      ++*lineno;
+      size_t eol = manifest.find('\n', pos);
+      if (eol == std::string::npos) {
+        return "missing terminator";
+      }
+      std::string line(manifest, pos, eol - pos);
+      pos = eol + 1;
+
+      // Skip metadata lines. They are used solely for
+      // dependency checking.
+      if (use_metadata && *lineno % 2 == 0) continue;
+
+      if (line.empty()) {
+        return "missing terminator";
+      }
+      if (line[0] == '/') {
+        return "paths must not be absolute";
+      }
+      size_t space = line.find(' ');
+      if (space == std::string::npos) {
+        return "missing field delimiter";
+      } else if (line.find(' ', space + 1) != std::string::npos) {
+        return "link or target filename contains space";
+      }
+      std::string link(line, 0, space);
+      const char *target = line.c_str() + space + 1;
+      if (!allow_relative && target[0] != '\0' && target[0] != '/'
+          && target[1] != ':') {  // Match Windows paths, e.g. C:\foo or C:/foo.
+        return "expected absolute path";
+      }
+
+      FileInfo *info = &(*entries)[link];
+      if (target[0] == '\0') {
+        // No target means an empty file.
+        info->type = FILE_TYPE_REGULAR;
+      } else {
+        info->type = FILE_TYPE_SYMLINK;
+        info->symlink_target = target;
+      }
+
+      FileInfo parent_info;
+      parent_info.type = FILE_TYPE_DIRECTORY;
+
+      while (true) {
+        int k = link.rfind('/');
+        if (k < 0) break;
+        link.erase(k, std::string::npos);
+        if (!entries->insert(std::make_pair(link, parent_info)).second) break;
+      }
+    }
+    return nullptr;
+  }
+
+  // Returns line lineno (counting from 1) of text, for error messages.
+  static std::string GetLine(const std::string &text, int lineno) {
+    size_t pos = 0;
+    for (int i = 1; i < lineno && pos != std::string::npos; ++i) {
+      pos = text.find('\n', pos);
+      if (pos != std::string::npos) ++pos;
+    }
+    if (pos == std::string::npos) return "";
+    return text.substr(pos, text.find('\n', pos) - pos);
+  }
+
+  // Reads the manifest that the tree was built for into content. Returns false
+  // if the tree was not built by us or not completely, in which case it has to
+  // be scanned.
+  bool ReadPreviousManifest(std::string *content) {
+    return ReadFile(built_filename_, content);
+  }
+
+  void RemoveFile(const std::string &path) {
+    if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+      PDIE("removing previous file at '%s/%s'", output_base_.c_str(),
+           path.c_str());
+    }
+  }
+
+  // Atomically replaces the file at path with one that holds content.
+  void ReplaceFile(const std::string &path, const std::string &content) {
+    WriteFile(temp_filename_, content);
+    if (rename(temp_filename_.c_str(), path.c_str()) != 0) {
+      PDIE("renaming '%s/%s' to '%s/%s'", output_base_.c_str(),
+           temp_filename_.c_str(), output_base_.c_str(), path.c_str());
+    }
+  }
+
+  // Brings a tree that was built for previous up to date with manifest_, by
+  // removing and creating only the entries in which the two differ.
+  void UpdateTree(const FileInfoMap &previous) {
+    // In reverse order, the contents of a directory come before it.
+    std::vector<std::string> stale_files;
+    std::vector<std::string> stale_dirs;
+    for (FileInfoMap::const_reverse_iterator it = previous.rbegin();
+         it != previous.rend(); ++it) {
+      FileInfoMap::const_iterator expected_it = manifest_.find(it->first);
+      if (expected_it == manifest_.end() || expected_it->second != it->second) {
+        if (it->second.type == FILE_TYPE_DIRECTORY) {
+          stale_dirs.push_back(it->first);
+        } else {
+          stale_files.push_back(it->first);
+        }
+      }
+    }
+    ParallelForEach(stale_files, [](const std::string &path) {
+      if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+        PDIE("unlinking '%s'", path.c_str());
+      }
+    });
+    for (const std::string &path : stale_dirs) {
+      struct stat st;
+      if (lstat(path.c_str(), &st) == 0) {
+        DelTree(path, StatToFileType(st));
+      }
+    }
+
+    FileInfoMap missing;
     for (FileInfoMap::const_iterator it = manifest_.begin();
          it != manifest_.end(); ++it) {
-      const std::string &path = it->first;
-      switch (it->second.type) {
-        case FILE_TYPE_DIRECTORY:
-          if (mkdir(path.c_str(), 0777) != 0) {
-            PDIE("mkdir '%s'", path.c_str());
-          }
-          break;
-        case FILE_TYPE_REGULAR:
-          {
-            int fd = open(path.c_str(), O_CREAT|O_EXCL|O_WRONLY, 0555);
-            if (fd < 0) {
-              PDIE("creating empty file '%s'", path.c_str());
-            }
-            close(fd);
-          }
-          break;
-        case FILE_TYPE_SYMLINK:
-          {
-            const std::string& target = it->second.symlink_target;
-            if (symlink(target.c_str(), path.c_str()) != 0) {
-              PDIE("symlinking '%s' -> '%s'", path.c_str(), target.c_str());
-            }
+      FileInfoMap::const_iterator actual_it = previous.find(it->first);
+      if (actual_it == previous.end() || actual_it->second != it->second) {
+        missing.insert(*it);
+      }
+    }
+    CreateFiles(missing);
+  }
+
+  void CreateFiles(const FileInfoMap &entries) {
+    // Directories come before their contents, so they can be created in
+    // order. Everything else goes into existing directories in parallel.
+    std::vector<FileInfoMap::const_iterator> files;
+    for (FileInfoMap::const_iterator it = entries.begin();
+         it != entries.end(); ++it) {
+      if (it->second.type == FILE_TYPE_DIRECTORY) {
+        CreateFile(it->first, it->second);
+      } else {
+        files.push_back(it);
+      }
+    }
+    ParallelForEach(files, [this](FileInfoMap::const_iterator it) {
+      CreateFile(it->first, it->second);
+    });
+  }
+
+  // Returns whether path was created. Sets errno otherwise.
+  static bool TryCreateFile(const std::string &path, const FileInfo &info) {
+    switch (info.type) {
+      case FILE_TYPE_DIRECTORY:
+        return mkdir(path.c_str(), 0777) == 0;
+      case FILE_TYPE_REGULAR:
+        {
+          int fd = open(path.c_str(), O_CREAT|O_EXCL|O_WRONLY, 0555);
+          if (fd < 0) {
+            return false;
           }
-          break;
+          close(fd);
+        }
+        return true;
+      case FILE_TYPE_SYMLINK:
+        return symlink(info.symlink_target.c_str(), path.c_str()) == 0;
+    }
+    return false;
+  }
+
+  void CreateFile(const std::string &path, const FileInfo &info) {
+    if (TryCreateFile(path, info)) {
+      return;
+    }
+    // Something we did not expect is in the way. This only happens if the
+    // tree was modified behind our back since the previous run.
+    if (errno == EEXIST) {
+      struct stat st;
+      LStatOrDie(path, &st);
+      if (info.type == FILE_TYPE_DIRECTORY && S_ISDIR(st.st_mode)) {
+        return;
+      }
+      DelTree(path, StatToFileType(st));
+      if (TryCreateFile(path, info)) {
+        return;
       }
     }
+    switch (info.type) {
+      case FILE_TYPE_DIRECTORY:
+        PDIE("mkdir '%s'", path.c_str());
+      case FILE_TYPE_REGULAR:
+        PDIE("creating empty file '%s'", path.c_str());
+      case FILE_TYPE_SYMLINK:
+        PDIE("symlinking '%s' -> '%s'", path.c_str(),
+             info.symlink_target.c_str());
+    }
+  }
+
+  // Reads the file at path into content. Returns false if it does not exist.
+  bool ReadFile(const std::string &path, std::string *content) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      if (errno == ENOENT) {
+        return false;
+      }
+      PDIE("opening '%s' for reading", path.c_str());
+    }
+    content->clear();
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        PDIE("reading '%s'", path.c_str());
+      }
+      content->append(buf, n);
+    }
+    close(fd);
+    return true;
+  }
+
+  void WriteFile(const std::string &path, const std::string &content) {
+    FILE *outfile = fopen(path.c_str(), "w");
+    if (!outfile) {
+      PDIE("opening '%s/%s' for writing", output_base_.c_str(), path.c_str());
+    }
+    if (fwrite(content.data(), 1, content.size(), outfile) != content.size() ||
+        fclose(outfile) != 0) {
+      PDIE("writing to '%s/%s'", output_base_.c_str(), path.c_str());
+    }
+  }
+
+  static FileType StatToFileType(const struct stat &st) {
+    if (S_ISDIR(st.st_mode)) {
+      return FILE_TYPE_DIRECTORY;
+    } else if (S_ISLNK(st.st_mode)) {
+      return FILE_TYPE_SYMLINK;
+    } else {
+      return FILE_TYPE_REGULAR;
+    }
   }
 
   FileType DentryToFileType(const std::string &path, char d_type) {
     if (d_type == DT_UNKNOWN) {
       struct stat st;
       LStatOrDie(path, &st);
-      if (S_ISDIR(st.st_mode)) {
-        return FILE_TYPE_DIRECTORY;
-      } else if (S_ISLNK(st.st_mode)) {
-        return FILE_TYPE_SYMLINK;
-      } else {
-        return FILE_TYPE_REGULAR;
-      }
+      return StatToFileType(st);
     } else if (d_type == DT_DIR) {
       return FILE_TYPE_DIRECTORY;
     } else if (d_type == DT_LNK) {
@@ -404,8 +623,16 @@ class RunfilesCreator {
   std::string output_base_;
   std::string output_filename_;
   std::string temp_filename_;
+  std::string built_filename_;
 
+  std::string input_manifest_;
   FileInfoMap manifest_;
+
+  // Whether the tree was built for the previous manifest, whose entries are
+  // then in previous_, and whether that is identical to the input manifest.
+  bool incremental_ = false;
+  bool up_to_date_ = false;
+  FileInfoMap previous_;
 };
 
 int main(int argc, char **argv) {
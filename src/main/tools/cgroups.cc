@@ -0,0 +1,228 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/tools/cgroups.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+
+#include "src/main/protobuf/execution_statistics.pb.h"
+#include "src/main/tools/logging.h"
+
+// The period of cpu.max, in microseconds. This is the kernel's default.
+static const int64_t kCpuPeriodUsec = 100000;
+
+static void WriteCgroupFile(const std::string &cgroup_dir,
+                            const std::string &name, const std::string &value) {
+  std::string path = cgroup_dir + "/" + name;
+  int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    DIE("open(%s); is the controller enabled in the parent's "
+        "cgroup.subtree_control?",
+        path.c_str());
+  }
+  if (write(fd, value.data(), value.size()) < 0) {
+    DIE("write(%s, %s)", path.c_str(), value.c_str());
+  }
+  if (close(fd) < 0) {
+    DIE("close(%s)", path.c_str());
+  }
+}
+
+std::string CreateCgroup(const std::string &parent_dir,
+                         int64_t memory_limit_bytes, double cpu_quota) {
+  // The name can be taken by a cgroup that a process with the same pid left
+  // behind when it was killed, or by a process with our pid in another pid
+  // namespace, so we count up until it is free.
+  std::string base_dir = parent_dir + "/action-" + std::to_string(getpid());
+  std::string cgroup_dir = base_dir;
+  for (int i = 1; mkdir(cgroup_dir.c_str(), 0755) < 0; i++) {
+    if (errno != EEXIST) {
+      DIE("mkdir(%s)", cgroup_dir.c_str());
+    }
+    cgroup_dir = base_dir + "-" + std::to_string(i);
+  }
+
+  if (memory_limit_bytes > 0) {
+    WriteCgroupFile(cgroup_dir, "memory.max",
+                    std::to_string(memory_limit_bytes));
+    // Without this, the limit would only push the memory of the action into
+    // swap instead of stopping it.
+    std::string swap_max = cgroup_dir + "/memory.swap.max";
+    if (access(swap_max.c_str(), F_OK) == 0) {
+      WriteCgroupFile(cgroup_dir, "memory.swap.max", "0");
+    }
+  }
+  if (cpu_quota > 0) {
+    int64_t quota_usec = static_cast<int64_t>(cpu_quota * kCpuPeriodUsec);
+    WriteCgroupFile(cgroup_dir, "cpu.max",
+                    std::to_string(quota_usec > 1000 ? quota_usec : 1000) +
+                        " " + std::to_string(kCpuPeriodUsec));
+  }
+  return cgroup_dir;
+}
+
+int OpenCgroupProcs(const std::string &cgroup_dir) {
+  std::string path = cgroup_dir + "/cgroup.procs";
+  int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    DIE("open(%s)", path.c_str());
+  }
+  return fd;
+}
+
+void JoinCgroup(int procs_fd) {
+  // Writing 0 moves the writing process.
+  if (write(procs_fd, "0", 1) < 0) {
+    DIE("write(cgroup.procs)");
+  }
+  if (close(procs_fd) < 0) {
+    DIE("close(cgroup.procs)");
+  }
+}
+
+// Returns the value of the first field named key in the file, which consists
+// of "key value" pairs separated by whitespace (e.g. cpu.stat or
+// memory.events), or 0 if there is no such field.
+static int64_t ReadKeyedValue(const std::string &path, const std::string &key) {
+  std::ifstream f(path);
+  std::string field;
+  int64_t value;
+  while (f >> field) {
+    if (field == key && f >> value) {
+      return value;
+    }
+  }
+  return 0;
+}
+
+static int64_t ReadSingleValue(const std::string &path) {
+  std::ifstream f(path);
+  int64_t value = 0;
+  f >> value;
+  return value;
+}
+
+// Returns the sum of all fields named key in io.stat, whose lines look like
+// "8:0 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=5 dios=6".
+static int64_t SumIoStat(const std::string &path, const std::string &key) {
+  std::ifstream f(path);
+  std::string prefix = key + "=";
+  std::string field;
+  int64_t sum = 0;
+  while (f >> field) {
+    if (field.compare(0, prefix.size(), prefix) == 0) {
+      sum += strtoll(field.c_str() + prefix.size(), nullptr, 10);
+    }
+  }
+  return sum;
+}
+
+// Returns the total stall time of the "some" or "full" line of a PSI file,
+// e.g. "some avg10=0.00 avg60=0.00 avg300=0.00 total=1234".
+static int64_t ReadPressureTotal(const std::string &path,
+                                 const std::string &kind) {
+  std::ifstream f(path);
+  for (std::string line; std::getline(f, line);) {
+    if (line.compare(0, kind.size() + 1, kind + " ") == 0) {
+      size_t total = line.find("total=");
+      if (total != std::string::npos) {
+        return strtoll(line.c_str() + total + 6, nullptr, 10);
+      }
+    }
+  }
+  return 0;
+}
+
+void ReadCgroupUsage(const std::string &cgroup_dir,
+                     tools::protos::CgroupUsage *usage) {
+  usage->set_memory_peak_bytes(ReadSingleValue(cgroup_dir + "/memory.peak"));
+  usage->set_memory_oom_kills(
+      ReadKeyedValue(cgroup_dir + "/memory.events", "oom_kill"));
+
+  std::string cpu_stat = cgroup_dir + "/cpu.stat";
+  usage->set_cpu_usage_usec(ReadKeyedValue(cpu_stat, "usage_usec"));
+  usage->set_cpu_user_usec(ReadKeyedValue(cpu_stat, "user_usec"));
+  usage->set_cpu_system_usec(ReadKeyedValue(cpu_stat, "system_usec"));
+  usage->set_cpu_throttled_usec(ReadKeyedValue(cpu_stat, "throttled_usec"));
+
+  std::string io_stat = cgroup_dir + "/io.stat";
+  usage->set_io_read_bytes(SumIoStat(io_stat, "rbytes"));
+  usage->set_io_write_bytes(SumIoStat(io_stat, "wbytes"));
+
+  usage->set_cpu_pressure_some_usec(
+      ReadPressureTotal(cgroup_dir + "/cpu.pressure", "some"));
+  usage->set_memory_pressure_some_usec(
+      ReadPressureTotal(cgroup_dir + "/memory.pressure", "some"));
+  usage->set_memory_pressure_full_usec(
+      ReadPressureTotal(cgroup_dir + "/memory.pressure", "full"));
+  usage->set_io_pressure_some_usec(
+      ReadPressureTotal(cgroup_dir + "/io.pressure", "some"));
+  usage->set_io_pressure_full_usec(
+      ReadPressureTotal(cgroup_dir + "/io.pressure", "full"));
+}
+
+void ReadCgroupSample(const std::string &cgroup_dir, int64_t *memory_bytes,
+                      int64_t *cpu_usec) {
+  // Without the memory controller, keep whatever the caller measured.
+  std::ifstream memory_current(cgroup_dir + "/memory.current");
+  int64_t value;
+  if (memory_current >> value) {
+    *memory_bytes = value;
+  }
+  *cpu_usec = ReadKeyedValue(cgroup_dir + "/cpu.stat", "usage_usec");
+}
+
+// Sends SIGKILL to every process in the cgroup, for kernels without
+// cgroup.kill (added in Linux 5.14).
+static void KillCgroupProcs(const std::string &cgroup_dir) {
+  std::ifstream f(cgroup_dir + "/cgroup.procs");
+  pid_t pid;
+  while (f >> pid) {
+    kill(pid, SIGKILL);
+  }
+}
+
+void DestroyCgroup(const std::string &cgroup_dir) {
+  std::string kill_path = cgroup_dir + "/cgroup.kill";
+  int fd = open(kill_path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    if (write(fd, "1", 1) < 0) {
+      DIE("write(%s)", kill_path.c_str());
+    }
+    close(fd);
+  }
+
+  // Killed processes leave the cgroup asynchronously, and rmdir fails with
+  // EBUSY until all of them are gone.
+  for (int attempt = 0; rmdir(cgroup_dir.c_str()) < 0; attempt++) {
+    if (errno != EBUSY || attempt == 1000) {
+      PRINT_DEBUG("rmdir(%s) failed: %s", cgroup_dir.c_str(), strerror(errno));
+      return;
+    }
+    if (fd < 0) {
+      KillCgroupProcs(cgroup_dir);
+    }
+    usleep(1000);
+  }
+}
@@ -0,0 +1,57 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_MAIN_TOOLS_CGROUPS_H_
+#define SRC_MAIN_TOOLS_CGROUPS_H_
+
+#include <stdint.h>
+#include <string>
+
+namespace tools {
+namespace protos {
+class CgroupUsage;
+}  // namespace protos
+}  // namespace tools
+
+// Creates a new cgroup v2 leaf below parent_dir and returns its path. The
+// memory limit (in bytes) and the CPU quota (in CPUs) are applied if positive,
+// which requires the memory and cpu controllers to be enabled in the
+// cgroup.subtree_control of parent_dir. The parent must be delegated to us.
+std::string CreateCgroup(const std::string &parent_dir,
+                         int64_t memory_limit_bytes, double cpu_quota);
+
+// Opens the cgroup.procs file of the cgroup at cgroup_dir for writing.
+int OpenCgroupProcs(const std::string &cgroup_dir);
+
+// Moves the calling process into the cgroup whose cgroup.procs is open as
+// procs_fd and closes procs_fd. Because the permissions are checked against
+// whoever opened the file, this also works from inside a user namespace or
+// after the cgroup filesystem was made read-only.
+void JoinCgroup(int procs_fd);
+
+// Reads the resource usage of all processes that ran in the cgroup.
+void ReadCgroupUsage(const std::string &cgroup_dir,
+                     tools::protos::CgroupUsage *usage);
+
+// Reads the current memory usage and the CPU time consumed so far by the
+// cgroup, which is cheap enough to do periodically. memory_bytes is left
+// alone if the memory controller is not enabled.
+void ReadCgroupSample(const std::string &cgroup_dir, int64_t *memory_bytes,
+                      int64_t *cpu_usec);
+
+// Kills all processes left in the cgroup, including those that escaped their
+// process group, and removes it.
+void DestroyCgroup(const std::string &cgroup_dir);
+
+#endif  // SRC_MAIN_TOOLS_CGROUPS_H_
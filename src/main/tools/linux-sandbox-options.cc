@@ -15,6 +15,8 @@
 #include "src/main/tools/linux-sandbox-options.h"
 
 #include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include <sched.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -38,6 +40,18 @@ using std::vector;
 
 struct Options opt;
 
+// Codes of the options that have no short form.
+enum {
+  kCgroupParent = 256,
+  kMemoryLimit,
+  kCpuQuota,
+  kOverlayLower,
+  kOverlayScratch,
+  kInputsManifest,
+  kSampleInterval,
+  kNetnsPool,
+};
+
 // Print out a usage error. argc and argv are the argument counter and vector,
 // fmt is a format, string for the error message to print.
 static void Usage(char *program_name, const char *fmt, ...) {
@@ -55,6 +69,7 @@ static void Usage(char *program_name, const char *fmt, ...) {
           "terminated with SIGTERM\n"
           "  -t <timeout>  in case timeout occurs, how long to wait before "
           "killing the child with SIGKILL\n"
+          "    Both timeouts are in seconds and may be fractional.\n"
           "  -l <file>  redirect stdout to a file\n"
           "  -L <file>  redirect stderr to a file\n"
           "  -w <file>  make a file or directory writable for the sandboxed "
@@ -66,11 +81,42 @@ static void Usage(char *program_name, const char *fmt, ...) {
           "    The -M option specifies which directory to mount, the -m option "
           "specifies where to\n"
           "  -S <file>  if set, write stats in protobuf format to a file\n"
+          "  --sample_interval <secs>  add the memory, CPU and I/O usage of "
+          "the command to\n"
+          "    the stats every secs seconds (requires -S)\n"
           "  -H  if set, make hostname in the sandbox equal to 'localhost'\n"
           "  -N  if set, a new network namespace will be created\n"
           "  -R  if set, make the uid/gid be root\n"
           "  -U  if set, make the uid/gid be nobody\n"
           "  -D  if set, debug info will be printed\n"
+          "  --cgroup_parent <dir>  run the command in a new cgroup v2 leaf "
+          "below dir and\n"
+          "    add the resource usage of the cgroup to the stats\n"
+          "  --memory_limit <bytes>  limit the memory of the command "
+          "(requires --cgroup_parent)\n"
+          "  --cpu_quota <cpus>  limit the command to this many CPUs "
+          "(requires --cgroup_parent)\n"
+          "  --overlay_lower <dir>  mount an overlayfs on the working "
+          "directory whose lower\n"
+          "    layer is a read-only view of dir (requires --overlay_scratch)\n"
+          "  --overlay_scratch <dir>  directory that receives the upper layer "
+          "of the overlayfs\n"
+          "    in dir/upper, i.e. everything the command writes to its working "
+          "directory\n"
+          "  --inputs_manifest <file>  manifest of 'path target' lines; each "
+          "path that is not\n"
+          "    lower/path already becomes a symlink to target in the overlay "
+          "(requires\n"
+          "    --overlay_lower)\n"
+          "  -Z <socket>  serve sandboxing requests on a Unix socket instead "
+          "of running a command\n"
+          "    The namespaces and read-only root are set up once and shared "
+          "by all requests.\n"
+          "  --netns_pool <n>  keep n network namespaces with loopback ready "
+          "for requests\n"
+          "    with -N, instead of creating one per request (requires -Z)\n"
+          "  -z <socket>  run the command through the sandbox server listening "
+          "on a Unix socket\n"
           "  @FILE  read newline-separated arguments from FILE\n"
           "  --  command to run inside sandbox, followed by arguments\n");
   exit(EXIT_FAILURE);
@@ -86,13 +132,24 @@ static void ValidateIsAbsolutePath(char *path, char *program_name, char flag) {
 // Parses command line flags from an argv array and puts the results into an
 // Options structure passed in as an argument.
 static void ParseCommandLine(unique_ptr<vector<char *>> args) {
+  static struct option long_options[] = {
+      {"cgroup_parent", required_argument, 0, kCgroupParent},
+      {"memory_limit", required_argument, 0, kMemoryLimit},
+      {"cpu_quota", required_argument, 0, kCpuQuota},
+      {"overlay_lower", required_argument, 0, kOverlayLower},
+      {"overlay_scratch", required_argument, 0, kOverlayScratch},
+      {"inputs_manifest", required_argument, 0, kInputsManifest},
+      {"sample_interval", required_argument, 0, kSampleInterval},
+      {"netns_pool", required_argument, 0, kNetnsPool},
+      {0, 0, 0, 0}};
   extern char *optarg;
   extern int optind, optopt;
   int c;
   bool source_specified = false;
 
-  while ((c = getopt(args->size(), args->data(),
-                     ":W:T:t:l:L:w:e:M:m:S:HNRUD")) != -1) {
+  while ((c = getopt_long(args->size(), args->data(),
+                          ":W:T:t:l:L:w:e:M:m:S:HNRUDZ:z:", long_options,
+                          nullptr)) != -1) {
     if (c != 'M' && c != 'm') source_specified = false;
     switch (c) {
       case 'W':
@@ -105,13 +162,13 @@ static void ParseCommandLine(unique_ptr<vector<char *>> args) {
         }
         break;
       case 'T':
-        if (sscanf(optarg, "%d", &opt.timeout_secs) != 1 ||
+        if (sscanf(optarg, "%lf", &opt.timeout_secs) != 1 ||
             opt.timeout_secs < 0) {
           Usage(args->front(), "Invalid timeout (-T) value: %s", optarg);
         }
         break;
       case 't':
-        if (sscanf(optarg, "%d", &opt.kill_delay_secs) != 1 ||
+        if (sscanf(optarg, "%lf", &opt.kill_delay_secs) != 1 ||
             opt.kill_delay_secs < 0) {
           Usage(args->front(), "Invalid kill delay (-t) value: %s", optarg);
         }
@@ -190,6 +247,72 @@ static void ParseCommandLine(unique_ptr<vector<char *>> args) {
       case 'D':
         opt.debug = true;
         break;
+      case kCgroupParent:
+        if (optarg[0] != '/') {
+          Usage(args->front(),
+                "The --cgroup_parent option must be an absolute path.");
+        }
+        opt.cgroup_parent.assign(optarg);
+        break;
+      case kMemoryLimit:
+        if (sscanf(optarg, "%" SCNd64, &opt.memory_limit_bytes) != 1 ||
+            opt.memory_limit_bytes <= 0) {
+          Usage(args->front(),
+                "Invalid memory limit (--memory_limit) value: %s", optarg);
+        }
+        break;
+      case kCpuQuota:
+        if (sscanf(optarg, "%lf", &opt.cpu_quota) != 1 || opt.cpu_quota <= 0) {
+          Usage(args->front(), "Invalid CPU quota (--cpu_quota) value: %s",
+                optarg);
+        }
+        break;
+      case kOverlayLower:
+        if (optarg[0] != '/') {
+          Usage(args->front(),
+                "The --overlay_lower option must be an absolute path.");
+        }
+        opt.overlay_lower.assign(optarg);
+        break;
+      case kOverlayScratch:
+        if (optarg[0] != '/') {
+          Usage(args->front(),
+                "The --overlay_scratch option must be an absolute path.");
+        }
+        opt.overlay_scratch.assign(optarg);
+        break;
+      case kInputsManifest:
+        opt.inputs_manifest.assign(optarg);
+        break;
+      case kSampleInterval:
+        if (sscanf(optarg, "%lf", &opt.sample_interval_secs) != 1 ||
+            opt.sample_interval_secs <= 0) {
+          Usage(args->front(),
+                "Invalid sample interval (--sample_interval) value: %s",
+                optarg);
+        }
+        break;
+      case 'Z':
+        if (opt.listen_socket.empty()) {
+          opt.listen_socket.assign(optarg);
+        } else {
+          Usage(args->front(), "Cannot listen on more than one socket.");
+        }
+        break;
+      case kNetnsPool:
+        if (sscanf(optarg, "%d", &opt.netns_pool_size) != 1 ||
+            opt.netns_pool_size <= 0) {
+          Usage(args->front(), "Invalid pool size (--netns_pool) value: %s",
+                optarg);
+        }
+        break;
+      case 'z':
+        if (opt.server_socket.empty()) {
+          opt.server_socket.assign(optarg);
+        } else {
+          Usage(args->front(), "Cannot use more than one sandbox server.");
+        }
+        break;
       case '?':
         Usage(args->front(), "Unrecognized argument: -%c (%d)", optopt, optind);
         break;
@@ -257,10 +380,48 @@ void ParseOptions(int argc, char *argv[]) {
   vector<char *> args(argv, argv + argc);
   ParseCommandLine(ExpandArguments(args));
 
+  if (opt.netns_pool_size > 0 && opt.listen_socket.empty()) {
+    Usage(args.front(), "--netns_pool requires -Z.");
+  }
+
+  if (!opt.listen_socket.empty()) {
+    if (!opt.server_socket.empty()) {
+      Usage(args.front(), "The -Z and -z options are mutually exclusive.");
+    }
+    if (!opt.args.empty()) {
+      Usage(args.front(), "No command can be specified with -Z.");
+    }
+    if (!opt.working_dir.empty() || !opt.writable_files.empty() ||
+        !opt.tmpfs_dirs.empty() || !opt.bind_mount_sources.empty() ||
+        !opt.overlay_lower.empty()) {
+      Usage(args.front(),
+            "The -W, -w, -e, -M and --overlay_* options must be passed with "
+            "each request to the sandbox server, not to the server itself.");
+    }
+    return;
+  }
+
   if (opt.args.empty()) {
     Usage(args.front(), "No command specified.");
   }
 
+  if ((opt.memory_limit_bytes > 0 || opt.cpu_quota > 0) &&
+      opt.cgroup_parent.empty()) {
+    Usage(args.front(),
+          "--memory_limit and --cpu_quota require --cgroup_parent.");
+  }
+  if (opt.sample_interval_secs > 0 && opt.stats_path.empty()) {
+    Usage(args.front(), "--sample_interval requires -S.");
+  }
+
+  if (opt.overlay_lower.empty() != opt.overlay_scratch.empty()) {
+    Usage(args.front(),
+          "--overlay_lower and --overlay_scratch must be used together.");
+  }
+  if (!opt.inputs_manifest.empty() && opt.overlay_lower.empty()) {
+    Usage(args.front(), "--inputs_manifest requires --overlay_lower.");
+  }
+
   if (opt.working_dir.empty()) {
     opt.working_dir = getcwd(nullptr, 0);
   }
@@ -17,6 +17,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -25,9 +26,9 @@ struct Options {
   // Working directory (-W)
   std::string working_dir;
   // How long to wait before killing the child (-T)
-  int timeout_secs;
+  double timeout_secs;
   // How long to wait before sending SIGKILL in case of timeout (-t)
-  int kill_delay_secs;
+  double kill_delay_secs;
   // Where to redirect stdout (-l)
   std::string stdout_path;
   // Where to redirect stderr (-L)
@@ -42,6 +43,25 @@ struct Options {
   std::vector<std::string> bind_mount_targets;
   // Where to write stats, in protobuf format (-S)
   std::string stats_path;
+  // Add a sample of the resource usage to the stats every this many seconds,
+  // if positive (--sample_interval)
+  double sample_interval_secs;
+  // Create a cgroup v2 leaf below this directory for the command
+  // (--cgroup_parent)
+  std::string cgroup_parent;
+  // Maximum memory of the command in bytes, if positive (--memory_limit)
+  int64_t memory_limit_bytes;
+  // Maximum number of CPUs the command may use, if positive (--cpu_quota)
+  double cpu_quota;
+  // Read-only lower layer of an overlayfs mounted on the working directory
+  // (--overlay_lower)
+  std::string overlay_lower;
+  // Directory for the upper and work directories of the overlayfs
+  // (--overlay_scratch)
+  std::string overlay_scratch;
+  // Inputs to add to the overlayfs as symlinks, one "path target" line each
+  // (--inputs_manifest)
+  std::string inputs_manifest;
   // Set the hostname inside the sandbox to 'localhost' (-H)
   bool fake_hostname;
   // Create a new network namespace (-N)
@@ -52,6 +72,13 @@ struct Options {
   bool fake_username;
   // Print debugging messages (-D)
   bool debug;
+  // Serve sandboxing requests on this Unix socket (-Z)
+  std::string listen_socket;
+  // Run the command through the sandbox server on this Unix socket (-z)
+  std::string server_socket;
+  // Number of network namespaces the sandbox server keeps ready for requests
+  // with -N (--netns_pool)
+  int netns_pool_size;
   // Command to run (--)
   std::vector<char *> args;
 };
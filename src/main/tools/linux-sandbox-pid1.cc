@@ -29,6 +29,7 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,11 +37,14 @@
 #include <sys/mount.h>
 #include <sys/prctl.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <fstream>
 #include <string>
+#include <unordered_set>
 
 #ifndef MS_REC
 // Some systems do not define MS_REC in sys/mount.h. We might be able to grab it
@@ -48,11 +52,31 @@
 #include <linux/fs.h>
 #endif
 
+#include "src/main/tools/cgroups.h"
 #include "src/main/tools/linux-sandbox-options.h"
 #include "src/main/tools/linux-sandbox.h"
 #include "src/main/tools/logging.h"
 #include "src/main/tools/process-tools.h"
 
+// mount_setattr(2) appeared in Linux 5.12; older headers lack its definitions.
+#ifndef __NR_mount_setattr
+#define __NR_mount_setattr 442
+#endif
+#ifndef AT_RECURSIVE
+#define AT_RECURSIVE 0x8000
+#endif
+#ifndef MOUNT_ATTR_RDONLY
+#define MOUNT_ATTR_RDONLY 0x00000001
+#endif
+
+// Same layout as struct mount_attr in linux/mount.h.
+struct MountAttr {
+  uint64_t attr_set;
+  uint64_t attr_clr;
+  uint64_t propagation;
+  uint64_t userns_fd;
+};
+
 static int global_child_pid;
 
 static void SetupSelfDestruction(int *sync_pipe) {
@@ -160,6 +184,140 @@ static void SetupUtsNamespace() {
   }
 }
 
+static void MakeDirectory(const std::string &path) {
+  if (mkdir(path.c_str(), 0755) < 0 && errno != EEXIST) {
+    DIE("mkdir(%s)", path.c_str());
+  }
+}
+
+// Creates the directories leading up to the relative path below root, except
+// for those that are in created already.
+static void CreateParentDirectories(const std::string &root,
+                                    const std::string &path,
+                                    std::unordered_set<std::string> *created) {
+  for (size_t slash = path.find('/'); slash != std::string::npos;
+       slash = path.find('/', slash + 1)) {
+    std::string dir = path.substr(0, slash);
+    if (created->insert(dir).second) {
+      MakeDirectory(root + "/" + dir);
+    }
+  }
+}
+
+// Returns whether the relative path has a ".." component, with which it could
+// point outside of the directory it is relative to.
+static bool HasParentReference(const std::string &path) {
+  size_t start = 0;
+  while (start <= path.size()) {
+    size_t end = path.find('/', start);
+    if (end == std::string::npos) {
+      end = path.size();
+    }
+    if (path.compare(start, end - start, "..") == 0) {
+      return true;
+    }
+    start = end + 1;
+  }
+  return false;
+}
+
+// Adds the entries of the inputs manifest to the upper layer of the overlay,
+// before it is mounted. An entry whose target is the same path in the lower
+// layer is visible through the overlay already, so in the common case of an
+// input that lives in the execroot nothing has to be done at all. Empty
+// targets become empty files, just like in runfiles manifests.
+static void AddManifestInputs(const std::string &upper) {
+  std::ifstream manifest(opt.inputs_manifest);
+  if (!manifest.is_open()) {
+    DIE("opening inputs manifest %s failed", opt.inputs_manifest.c_str());
+  }
+
+  const std::string lower_prefix = opt.overlay_lower + "/";
+  std::unordered_set<std::string> created;
+  int lineno = 0;
+  for (std::string line; std::getline(manifest, line);) {
+    ++lineno;
+    if (line.empty()) {
+      continue;
+    }
+    size_t space = line.find(' ');
+    std::string path = line.substr(0, space);
+    std::string target =
+        space == std::string::npos ? "" : line.substr(space + 1);
+    const char *error = nullptr;
+    if (path[0] == '/') {
+      error = "paths must not be absolute";
+    } else if (HasParentReference(path)) {
+      error = "paths must not contain '..'";
+    }
+    if (error != nullptr) {
+      errno = EINVAL;
+      DIE("%s in inputs manifest %s at line %d: '%s'", error,
+          opt.inputs_manifest.c_str(), lineno, line.c_str());
+    }
+    if (target.size() == lower_prefix.size() + path.size() &&
+        target.compare(0, lower_prefix.size(), lower_prefix) == 0 &&
+        target.compare(lower_prefix.size(), path.size(), path) == 0) {
+      continue;
+    }
+
+    CreateParentDirectories(upper, path, &created);
+    std::string link = upper + "/" + path;
+    if (target.empty()) {
+      int fd = open(link.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+      if (fd < 0) {
+        DIE("open(%s)", link.c_str());
+      }
+      close(fd);
+    } else if (symlink(target.c_str(), link.c_str()) < 0) {
+      DIE("symlink(%s, %s)", target.c_str(), link.c_str());
+    }
+  }
+  if (manifest.bad()) {
+    DIE("error while reading from inputs manifest %s",
+        opt.inputs_manifest.c_str());
+  }
+}
+
+// Escapes the characters that separate overlayfs mount options and layers.
+static std::string EscapeOverlayPath(const std::string &path) {
+  std::string escaped;
+  for (char c : path) {
+    if (c == '\\' || c == ',' || c == ':') {
+      escaped.push_back('\\');
+    }
+    escaped.push_back(c);
+  }
+  return escaped;
+}
+
+// Mounts an overlayfs on the working directory instead of bind-mounting it
+// upon itself. The action sees the lower layer (usually the real execroot)
+// without having to go through a symlink forest, and everything it writes ends
+// up in the upper layer in the scratch directory, where it survives the
+// sandbox.
+static void MountOverlayExecroot() {
+  std::string upper = opt.overlay_scratch + "/upper";
+  std::string work = opt.overlay_scratch + "/work";
+  MakeDirectory(upper);
+  MakeDirectory(work);
+  if (!opt.inputs_manifest.empty()) {
+    AddManifestInputs(upper);
+  }
+
+  // We are not in the initial user namespace, where overlayfs only accepts
+  // the user.* namespace for its extended attributes.
+  std::string options = "lowerdir=" + EscapeOverlayPath(opt.overlay_lower) +
+                        ",upperdir=" + EscapeOverlayPath(upper) +
+                        ",workdir=" + EscapeOverlayPath(work) + ",userxattr";
+  PRINT_DEBUG("overlay: %s on %s", options.c_str(), opt.working_dir.c_str());
+  if (mount("overlay", opt.working_dir.c_str(), "overlay", MS_NOSUID | MS_NODEV,
+            options.c_str()) < 0) {
+    DIE("mount(overlay, %s, overlay, MS_NOSUID | MS_NODEV, %s)",
+        opt.working_dir.c_str(), options.c_str());
+  }
+}
+
 static void MountFilesystems() {
   for (const std::string &tmpfs_dir : opt.tmpfs_dirs) {
     PRINT_DEBUG("tmpfs: %s", tmpfs_dir.c_str());
@@ -174,8 +332,10 @@ static void MountFilesystems() {
   // do this is by bind-mounting it upon itself.
   PRINT_DEBUG("working dir: %s", opt.working_dir.c_str());
 
-  if (mount(opt.working_dir.c_str(), opt.working_dir.c_str(), nullptr, MS_BIND,
-            nullptr) < 0) {
+  if (!opt.overlay_lower.empty()) {
+    MountOverlayExecroot();
+  } else if (mount(opt.working_dir.c_str(), opt.working_dir.c_str(), nullptr,
+                   MS_BIND, nullptr) < 0) {
     DIE("mount(%s, %s, nullptr, MS_BIND, nullptr)", opt.working_dir.c_str(),
         opt.working_dir.c_str());
   }
@@ -200,31 +360,57 @@ static void MountFilesystems() {
   }
 }
 
-// We later remount everything read-only, except the paths for which this method
-// returns true.
-static bool ShouldBeWritable(const std::string &mnt_dir) {
-  if (mnt_dir == opt.working_dir) {
-    return true;
+// We later remount everything read-only, except the mount points returned by
+// this method.
+static std::unordered_set<std::string> GetWritableMounts() {
+  std::unordered_set<std::string> writable(opt.writable_files.begin(),
+                                           opt.writable_files.end());
+  writable.insert(opt.tmpfs_dirs.begin(), opt.tmpfs_dirs.end());
+  if (!opt.working_dir.empty()) {
+    writable.insert(opt.working_dir);
   }
+  return writable;
+}
 
-  for (const std::string &writable_file : opt.writable_files) {
-    if (mnt_dir == writable_file) {
-      return true;
-    }
-  }
+static int MountSetattr(const char *path, unsigned int flags,
+                        uint64_t attr_set, uint64_t attr_clr) {
+  struct MountAttr attr = {attr_set, attr_clr, 0, 0};
+  return syscall(__NR_mount_setattr, AT_FDCWD, path, flags, &attr,
+                 sizeof(attr));
+}
 
-  for (const std::string &tmpfs_dir : opt.tmpfs_dirs) {
-    if (mnt_dir == tmpfs_dir) {
-      return true;
+// Makes every mount read-only with a single call, then makes the writable
+// mounts writable again, so that the cost does not depend on how many mounts
+// the host has. Returns false if the kernel cannot do this.
+static bool MakeFilesystemMostlyReadOnlyAtOnce(
+    const std::unordered_set<std::string> &writable) {
+  if (MountSetattr("/", AT_RECURSIVE, MOUNT_ATTR_RDONLY, 0) < 0) {
+    PRINT_DEBUG("mount_setattr(/, AT_RECURSIVE, MOUNT_ATTR_RDONLY) failed: %s",
+                strerror(errno));
+    return false;
+  }
+
+  for (const std::string &mnt_dir : writable) {
+    PRINT_DEBUG("remount rw: %s", mnt_dir.c_str());
+    if (MountSetattr(mnt_dir.c_str(), 0, 0, MOUNT_ATTR_RDONLY) < 0) {
+      // EPERM means the host made the mount read-only, in which case it stays
+      // read-only, see below.
+      if (errno != EPERM) {
+        DIE("mount_setattr(%s, 0, 0, MOUNT_ATTR_RDONLY)", mnt_dir.c_str());
+      }
     }
   }
-
-  return false;
+  return true;
 }
 
-// Makes the whole filesystem read-only, except for the paths for which
-// ShouldBeWritable returns true.
+// Makes the whole filesystem read-only, except for the mount points returned
+// by GetWritableMounts.
 static void MakeFilesystemMostlyReadOnly() {
+  std::unordered_set<std::string> writable = GetWritableMounts();
+  if (MakeFilesystemMostlyReadOnlyAtOnce(writable)) {
+    return;
+  }
+
   FILE *mounts = setmntent("/proc/self/mounts", "r");
   if (mounts == nullptr) {
     DIE("setmntent");
@@ -257,7 +443,7 @@ static void MakeFilesystemMostlyReadOnly() {
       mountFlags |= MS_RELATIME;
     }
 
-    if (!ShouldBeWritable(ent->mnt_dir)) {
+    if (writable.count(ent->mnt_dir) == 0) {
       mountFlags |= MS_RDONLY;
     }
 
@@ -286,6 +472,65 @@ static void MakeFilesystemMostlyReadOnly() {
   endmntent(mounts);
 }
 
+// Remounts the bind mount at path read-only or read-write. The flags we cannot
+// change (e.g. nodev on a mount inherited from the host) are passed back in.
+static void RemountBind(const std::string &path, bool read_only) {
+  struct statvfs sv;
+  if (statvfs(path.c_str(), &sv) < 0) {
+    DIE("statvfs(%s)", path.c_str());
+  }
+
+  int mountFlags = MS_BIND | MS_REMOUNT;
+  if (sv.f_flag & ST_NODEV) {
+    mountFlags |= MS_NODEV;
+  }
+  if (sv.f_flag & ST_NOEXEC) {
+    mountFlags |= MS_NOEXEC;
+  }
+  if (sv.f_flag & ST_NOSUID) {
+    mountFlags |= MS_NOSUID;
+  }
+  if (sv.f_flag & ST_NOATIME) {
+    mountFlags |= MS_NOATIME;
+  }
+  if (sv.f_flag & ST_NODIRATIME) {
+    mountFlags |= MS_NODIRATIME;
+  }
+  if (sv.f_flag & ST_RELATIME) {
+    mountFlags |= MS_RELATIME;
+  }
+  if (read_only) {
+    mountFlags |= MS_RDONLY;
+  }
+
+  PRINT_DEBUG("remount %s: %s", read_only ? "ro" : "rw", path.c_str());
+  if (mount(nullptr, path.c_str(), nullptr, mountFlags, nullptr) < 0) {
+    // A mount that the host made read-only stays read-only, just like it does
+    // in MakeFilesystemMostlyReadOnly.
+    if (read_only || errno != EPERM) {
+      DIE("remount(nullptr, %s, nullptr, %d, nullptr)", path.c_str(),
+          mountFlags);
+    }
+  }
+}
+
+// When running from the template namespace, everything is read-only already,
+// and MountFilesystems' bind mounts inherited the flags of their sources.
+// Gives them the flags MakeFilesystemMostlyReadOnly would have given them.
+static void RemountActionMounts() {
+  std::unordered_set<std::string> writable = GetWritableMounts();
+  for (const std::string &target : opt.bind_mount_targets) {
+    if (writable.count(target) == 0) {
+      RemountBind(target, true);
+    }
+  }
+
+  RemountBind(opt.working_dir, false);
+  for (const std::string &writable_file : opt.writable_files) {
+    RemountBind(writable_file, false);
+  }
+}
+
 static void MountProc() {
   // Mount a new proc on top of the old one, because the old one still refers to
   // our parent PID namespace.
@@ -295,33 +540,37 @@ static void MountProc() {
   }
 }
 
-static void SetupNetworking() {
-  // When running in a separate network namespace, enable the loopback interface
-  // because some application may want to use it.
-  if (opt.create_netns) {
-    int fd;
-    fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0) {
-      DIE("socket");
-    }
+void EnableLoopback() {
+  int fd;
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    DIE("socket");
+  }
 
-    struct ifreq ifr = {};
-    strncpy(ifr.ifr_name, "lo", IF_NAMESIZE);
+  struct ifreq ifr = {};
+  strncpy(ifr.ifr_name, "lo", IF_NAMESIZE);
 
-    // Verify that name is valid.
-    if (if_nametoindex(ifr.ifr_name) == 0) {
-      DIE("if_nametoindex");
-    }
+  // Verify that name is valid.
+  if (if_nametoindex(ifr.ifr_name) == 0) {
+    DIE("if_nametoindex");
+  }
 
-    // Enable the interface.
-    ifr.ifr_flags |= IFF_UP;
-    if (ioctl(fd, SIOCSIFFLAGS, &ifr) < 0) {
-      DIE("ioctl");
-    }
+  // Enable the interface.
+  ifr.ifr_flags |= IFF_UP;
+  if (ioctl(fd, SIOCSIFFLAGS, &ifr) < 0) {
+    DIE("ioctl");
+  }
 
-    if (close(fd) < 0) {
-      DIE("close");
-    }
+  if (close(fd) < 0) {
+    DIE("close");
+  }
+}
+
+static void SetupNetworking() {
+  // When running in a separate network namespace, enable the loopback interface
+  // because some application may want to use it.
+  if (opt.create_netns) {
+    EnableLoopback();
   }
 }
 
@@ -468,6 +717,9 @@ int Pid1Main(void *sync_pipe_param) {
   }
 
   SetupSelfDestruction(reinterpret_cast<int *>(sync_pipe_param));
+  if (global_cgroup_procs_fd >= 0) {
+    JoinCgroup(global_cgroup_procs_fd);
+  }
   SetupMountNamespace();
   SetupUserNamespace();
   if (opt.fake_hostname) {
@@ -483,3 +735,32 @@ int Pid1Main(void *sync_pipe_param) {
   WaitForChild();
   _exit(EXIT_FAILURE);
 }
+
+void SetupTemplateNamespace() {
+  SetupMountNamespace();
+  SetupUserNamespace();
+  MakeFilesystemMostlyReadOnly();
+}
+
+int TemplatePid1Main(void *sync_pipe_param) {
+  if (getpid() != 1) {
+    DIE("Using PID namespaces, but we are not PID 1");
+  }
+
+  SetupSelfDestruction(reinterpret_cast<int *>(sync_pipe_param));
+  if (global_cgroup_procs_fd >= 0) {
+    JoinCgroup(global_cgroup_procs_fd);
+  }
+  if (opt.fake_hostname) {
+    SetupUtsNamespace();
+  }
+  MountFilesystems();
+  RemountActionMounts();
+  MountProc();
+  SetupNetworking();
+  EnterSandbox();
+  SetupSignalHandlers();
+  SpawnChild();
+  WaitForChild();
+  _exit(EXIT_FAILURE);
+}
@@ -17,4 +17,16 @@
 
 int Pid1Main(void *sync_pipe_param);
 
+// Sets up the user and mount namespace, with a read-only root, that the sandbox
+// server (-Z) shares between all requests. Must be called right after entering
+// new user, mount and IPC namespaces.
+void SetupTemplateNamespace();
+
+// Like Pid1Main, but for a process cloned from the template namespace, which
+// only needs the mounts specific to its action.
+int TemplatePid1Main(void *sync_pipe_param);
+
+// Brings up the loopback interface of our network namespace.
+void EnableLoopback();
+
 #endif
@@ -0,0 +1,638 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/**
+ * The sandbox server (-Z) enters a new user, mount and IPC namespace once,
+ * writes the uid/gid maps and makes the whole filesystem read-only. For each
+ * client (-z) that connects, it forks a handler that takes over the client's
+ * stdio, working directory and environment, parses the client's arguments and
+ * runs the command in the same way linux-sandbox would, except that PID 1 is
+ * cloned from the template namespace and only sets up the action's mounts.
+ * With --netns_pool, a helper process also creates network namespaces ahead of
+ * time, which the handlers enter before they clone PID 1.
+ *
+ * Connections are accepted by a gatekeeper process that stays in the initial
+ * user namespace, where it can tell which user a client runs as. The client
+ * opens the -l, -L and -S files itself, since the handler cannot write to them
+ * in the read-only template namespace, and forwards the signals it receives to
+ * the handler.
+ */
+
+#include "src/main/tools/linux-sandbox-server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "src/main/tools/linux-sandbox-options.h"
+#include "src/main/tools/linux-sandbox-pid1.h"
+#include "src/main/tools/linux-sandbox.h"
+#include "src/main/tools/logging.h"
+#include "src/main/tools/process-tools.h"
+
+extern char **environ;
+
+// Sent by the client together with its stdin, stdout and stderr, and the
+// statistics file if -S was given. It is followed by the working directory, the
+// arguments and the environment, each terminated by a NUL byte. Afterwards, the
+// client sends the number of every signal it receives as an int32_t. The server
+// replies with the exit code as an int32_t.
+struct RequestHeader {
+  uint32_t argc;
+  uint32_t envc;
+  uint32_t payload_size;
+};
+
+static const int kNumStdioFds = 3;
+static const int kMaxForwardedFds = kNumStdioFds + 1;
+
+// The connection to the client, in both the handler and the client.
+static int global_connection_fd = -1;
+
+// Connection to the helper that creates network namespaces ahead of time
+// (--netns_pool), or -1.
+static int global_netns_pool_fd = -1;
+
+static void FillAddress(const std::string &path, struct sockaddr_un *addr) {
+  if (path.size() >= sizeof(addr->sun_path)) {
+    errno = ENAMETOOLONG;
+    DIE("socket path %s", path.c_str());
+  }
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path.c_str(), path.size());
+}
+
+static void WriteFully(int fd, const void *data, size_t size) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      DIE("write");
+    }
+    p += n;
+    size -= n;
+  }
+}
+
+// Returns false if the peer closed the connection before size bytes were read.
+static bool ReadFully(int fd, void *data, size_t size) {
+  char *p = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      DIE("read");
+    }
+    if (n == 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+std::vector<int> GetForwardedSignals() {
+  return {SIGHUP, SIGINT, SIGQUIT, SIGTERM};
+}
+
+static void BlockForwardedSignals(int how) {
+  sigset_t set;
+  if (sigemptyset(&set) < 0) {
+    DIE("sigemptyset");
+  }
+  for (int signum : GetForwardedSignals()) {
+    if (sigaddset(&set, signum) < 0) {
+      DIE("sigaddset(%d)", signum);
+    }
+  }
+  if (sigprocmask(how, &set, nullptr) < 0) {
+    DIE("sigprocmask");
+  }
+}
+
+// Raises the signals that the client forwarded, which the supervisor picks up
+// from its signalfd. If the client is gone instead, exiting kills the sandbox
+// (see SetupSelfDestruction), just like killing a standalone linux-sandbox
+// does.
+static void OnConnectionEvent(int sig) {
+  int saved_errno = errno;
+  while (1) {
+    int32_t signum;
+    ssize_t n = recv(global_connection_fd, &signum, sizeof(signum),
+                     MSG_DONTWAIT);
+    if (n == sizeof(signum)) {
+      kill(getpid(), signum);
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      _exit(EXIT_FAILURE);
+    }
+  }
+  errno = saved_errno;
+}
+
+static void WatchConnection(int fd) {
+  global_connection_fd = fd;
+  InstallSignalHandler(SIGIO, OnConnectionEvent);
+  if (fcntl(fd, F_SETOWN, getpid()) < 0) {
+    DIE("fcntl(F_SETOWN)");
+  }
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0) {
+    DIE("fcntl(F_GETFL)");
+  }
+  if (fcntl(fd, F_SETFL, flags | O_ASYNC) < 0) {
+    DIE("fcntl(F_SETFL)");
+  }
+  // The client may have gone away before we asked for SIGIO.
+  OnConnectionEvent(SIGIO);
+}
+
+// Returns the number of descriptors that came with the header.
+static int ReceiveHeader(int fd, RequestHeader *header, int *fds) {
+  struct iovec iov = {header, sizeof(*header)};
+  char control[CMSG_SPACE(sizeof(int) * kMaxForwardedFds)];
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do {
+    n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    DIE("recvmsg");
+  }
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len < CMSG_LEN(sizeof(int) * kNumStdioFds)) {
+    errno = EPROTO;
+    DIE("request without stdin, stdout and stderr");
+  }
+  int num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * num_fds);
+
+  // Stream sockets may deliver the rest of the header separately.
+  if (!ReadFully(fd, reinterpret_cast<char *>(header) + n,
+                 sizeof(*header) - n)) {
+    errno = EPROTO;
+    DIE("truncated request header");
+  }
+  return num_fds;
+}
+
+// Sends fd over the socket as SCM_RIGHTS, along with a single byte.
+static void SendFd(int sock, int fd) {
+  char byte = 0;
+  struct iovec iov = {&byte, 1};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+  ssize_t n;
+  do {
+    n = sendmsg(sock, &msg, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    DIE("sendmsg");
+  }
+}
+
+// Returns the fd sent with SendFd, or -1 if the peer is gone.
+static int ReceiveFd(int sock) {
+  char byte;
+  struct iovec iov = {&byte, 1};
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do {
+    n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    DIE("recvmsg");
+  }
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (n == 0 || cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+  return fd;
+}
+
+// Creates a network namespace with the loopback interface up and sends it to
+// the server. The helper enters each namespace only to configure it; it stays
+// alive through the descriptor alone.
+static void SendNetworkNamespace(int sock) {
+  if (unshare(CLONE_NEWNET) < 0) {
+    DIE("unshare(CLONE_NEWNET)");
+  }
+  EnableLoopback();
+  int fd = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    DIE("open(/proc/self/ns/net)");
+  }
+  SendFd(sock, fd);
+  if (close(fd) < 0) {
+    DIE("close");
+  }
+}
+
+// Keeps size network namespaces queued on sock. Every handler that takes one
+// writes a byte back, upon which we create its replacement while the action
+// runs. Namespaces are never reused: sockets lingering in TIME_WAIT, or any
+// changes that the action made as root of the user namespace, would leak into
+// the next action.
+static void RunNetnsPool(int sock, int size) {
+  for (int i = 0; i < size; i++) {
+    SendNetworkNamespace(sock);
+  }
+  char byte;
+  while (ReadFully(sock, &byte, sizeof(byte))) {
+    SendNetworkNamespace(sock);
+  }
+  _exit(EXIT_SUCCESS);
+}
+
+static void StartNetnsPool(int gatekeeper_fd) {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) < 0) {
+    DIE("socketpair");
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    DIE("fork");
+  } else if (pid == 0) {
+    if (prctl(PR_SET_PDEATHSIG, SIGKILL) < 0) {
+      DIE("prctl");
+    }
+    if (close(gatekeeper_fd) < 0 || close(sockets[0]) < 0) {
+      DIE("close");
+    }
+    RunNetnsPool(sockets[1], opt.netns_pool_size);
+  }
+  if (close(sockets[1]) < 0) {
+    DIE("close");
+  }
+  global_netns_pool_fd = sockets[0];
+}
+
+// Moves us into a network namespace from the pool, which PID 1 then inherits.
+// Returns false if the pool is gone, in which case PID 1 has to create its own.
+static bool EnterPooledNetworkNamespace() {
+  int fd = ReceiveFd(global_netns_pool_fd);
+  if (fd < 0) {
+    PRINT_DEBUG("network namespace pool is gone");
+    return false;
+  }
+  char byte = 0;
+  WriteFully(global_netns_pool_fd, &byte, sizeof(byte));
+  if (setns(fd, CLONE_NEWNET) < 0) {
+    DIE("setns(CLONE_NEWNET)");
+  }
+  if (close(fd) < 0) {
+    DIE("close");
+  }
+  return true;
+}
+
+static void HandleRequest(int fd) {
+  if (prctl(PR_SET_PDEATHSIG, SIGKILL) < 0) {
+    DIE("prctl");
+  }
+  InstallDefaultSignalHandler(SIGCHLD);
+  // The supervisor reads these from its signalfd once the sandbox runs.
+  BlockForwardedSignals(SIG_BLOCK);
+
+  RequestHeader header;
+  int fds[kMaxForwardedFds];
+  int num_fds = ReceiveHeader(fd, &header, fds);
+
+  std::vector<char> payload(header.payload_size);
+  if (!ReadFully(fd, payload.data(), payload.size())) {
+    errno = EPROTO;
+    DIE("truncated request");
+  }
+  // Without the trailing NUL, splitting the payload would run past its end.
+  if (payload.empty() || payload.back() != '\0') {
+    errno = EPROTO;
+    DIE("malformed request");
+  }
+  std::vector<char *> strings;
+  for (size_t i = 0; i < payload.size(); i += strlen(&payload[i]) + 1) {
+    strings.push_back(&payload[i]);
+  }
+  if (strings.size() != 1 + header.argc + header.envc) {
+    errno = EPROTO;
+    DIE("malformed request");
+  }
+
+  for (int i = 0; i < kNumStdioFds; i++) {
+    if (dup2(fds[i], i) < 0) {
+      DIE("dup2");
+    }
+    if (close(fds[i]) < 0) {
+      DIE("close");
+    }
+  }
+
+  if (chdir(strings[0]) < 0) {
+    DIE("chdir(%s)", strings[0]);
+  }
+  std::vector<char *> args(strings.begin() + 1,
+                           strings.begin() + 1 + header.argc);
+  std::vector<char *> env(strings.begin() + 1 + header.argc, strings.end());
+  env.push_back(nullptr);
+  environ = env.data();
+
+  // The uid/gid maps are part of the template, so the request cannot change
+  // them.
+  bool fake_root = opt.fake_root;
+  bool fake_username = opt.fake_username;
+  bool debug = opt.debug;
+  opt = Options();
+  // Reset getopt, which already parsed the server's own arguments.
+  optind = 0;
+  ParseOptions(args.size(), args.data());
+  if (opt.fake_root != fake_root || opt.fake_username != fake_username) {
+    errno = EINVAL;
+    DIE("-R and -U must match the options of the sandbox server");
+  }
+  opt.server_socket.clear();
+  // The handler sees the read-only filesystem of the template.
+  if (!opt.cgroup_parent.empty() || !opt.overlay_lower.empty()) {
+    errno = EINVAL;
+    DIE("--cgroup_parent and --overlay_lower are not supported by the sandbox "
+        "server");
+  }
+  global_debug = debug || opt.debug;
+  if (num_fds != kNumStdioFds + (opt.stats_path.empty() ? 0 : 1)) {
+    errno = EPROTO;
+    DIE("request without the statistics file");
+  }
+  if (!opt.stats_path.empty()) {
+    global_stats_fd = fds[kNumStdioFds];
+  }
+
+  if (opt.create_netns && global_netns_pool_fd >= 0 &&
+      EnterPooledNetworkNamespace()) {
+    opt.create_netns = false;
+  }
+
+  // The client redirected stdout and stderr before it sent them to us.
+  WatchConnection(fd);
+  int32_t exit_code = RunSandbox(true);
+  WriteFully(fd, &exit_code, sizeof(exit_code));
+  _exit(EXIT_SUCCESS);
+}
+
+// Accepts connections on listen_fd and passes those of our own user on to the
+// server. This has to happen outside of the template namespace, where the
+// credentials of all other users map to the overflow uid, which with -U is the
+// uid of the sandbox user as well.
+static void RunGatekeeper(int listen_fd, int sock) {
+  uid_t uid = getuid();
+  while (1) {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      DIE("accept4");
+    }
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+      DIE("getsockopt(SO_PEERCRED)");
+    }
+    if (cred.uid == uid) {
+      SendFd(sock, fd);
+    } else {
+      PRINT_DEBUG("rejected connection from uid %d", cred.uid);
+    }
+    if (close(fd) < 0) {
+      DIE("close");
+    }
+  }
+}
+
+// Returns the socket on which the gatekeeper sends us the connections.
+static int StartGatekeeper(int listen_fd) {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) < 0) {
+    DIE("socketpair");
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    DIE("fork");
+  } else if (pid == 0) {
+    if (prctl(PR_SET_PDEATHSIG, SIGKILL) < 0) {
+      DIE("prctl");
+    }
+    if (close(sockets[0]) < 0) {
+      DIE("close");
+    }
+    RunGatekeeper(listen_fd, sockets[1]);
+  }
+  if (close(listen_fd) < 0 || close(sockets[1]) < 0) {
+    DIE("close");
+  }
+  return sockets[0];
+}
+
+int RunSandboxServer() {
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    DIE("socket");
+  }
+  struct sockaddr_un addr;
+  FillAddress(opt.listen_socket, &addr);
+  if (unlink(opt.listen_socket.c_str()) < 0 && errno != ENOENT) {
+    DIE("unlink(%s)", opt.listen_socket.c_str());
+  }
+  if (bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr),
+           sizeof(addr)) < 0) {
+    DIE("bind(%s)", opt.listen_socket.c_str());
+  }
+  // Whoever can connect can run commands as us, so do not leave the mode of
+  // the socket to the umask. Nobody can connect before we listen.
+  if (chmod(opt.listen_socket.c_str(), 0600) < 0) {
+    DIE("chmod(%s)", opt.listen_socket.c_str());
+  }
+  if (listen(listen_fd, SOMAXCONN) < 0) {
+    DIE("listen");
+  }
+  int gatekeeper_fd = StartGatekeeper(listen_fd);
+
+  // This runs once per server, not once per action, so unlike SpawnPid1 we can
+  // simply enter the namespaces ourselves; the handlers we fork inherit them.
+  if (unshare(CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWIPC) < 0) {
+    DIE("unshare");
+  }
+  SetupTemplateNamespace();
+  if (opt.netns_pool_size > 0) {
+    StartNetnsPool(gatekeeper_fd);
+  }
+
+  // Let the kernel reap the handlers.
+  IgnoreSignal(SIGCHLD);
+
+  printf("ready\n");
+  fflush(stdout);
+
+  while (1) {
+    int fd = ReceiveFd(gatekeeper_fd);
+    if (fd < 0) {
+      errno = ECONNRESET;
+      DIE("the gatekeeper is gone");
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      DIE("fork");
+    } else if (pid == 0) {
+      if (close(gatekeeper_fd) < 0) {
+        DIE("close");
+      }
+      HandleRequest(fd);
+    }
+
+    if (close(fd) < 0) {
+      DIE("close");
+    }
+  }
+}
+
+// Passes signals on to the handler, which gives the command a grace period.
+static void ForwardSignal(int signum) {
+  int saved_errno = errno;
+  int32_t value = signum;
+  if (write(global_connection_fd, &value, sizeof(value)) < 0) {
+    // The handler is gone already, and the exit code is lost with it.
+  }
+  errno = saved_errno;
+}
+
+int RunSandboxClient(int argc, char *argv[]) {
+  std::string payload;
+  char *cwd = getcwd(nullptr, 0);
+  if (cwd == nullptr) {
+    DIE("getcwd");
+  }
+  payload.append(cwd, strlen(cwd) + 1);
+  free(cwd);
+  for (int i = 0; i < argc; i++) {
+    payload.append(argv[i], strlen(argv[i]) + 1);
+  }
+  uint32_t envc = 0;
+  for (char **var = environ; *var != nullptr; var++, envc++) {
+    payload.append(*var, strlen(*var) + 1);
+  }
+
+  int fds[kMaxForwardedFds] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  int num_fds = kNumStdioFds;
+  if (!opt.stats_path.empty()) {
+    fds[num_fds++] = OpenStatsFile(opt.stats_path);
+  }
+
+  // Signals are forwarded once the request is sent; until then, they are held.
+  BlockForwardedSignals(SIG_BLOCK);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    DIE("socket");
+  }
+  struct sockaddr_un addr;
+  FillAddress(opt.server_socket, &addr);
+  if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+      0) {
+    DIE("connect(%s)", opt.server_socket.c_str());
+  }
+
+  RequestHeader header = {static_cast<uint32_t>(argc), envc,
+                          static_cast<uint32_t>(payload.size())};
+  struct iovec iov = {&header, sizeof(header)};
+  char control[CMSG_SPACE(sizeof(int) * kMaxForwardedFds)] = {};
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+
+  ssize_t n;
+  do {
+    n = sendmsg(fd, &msg, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    DIE("sendmsg");
+  }
+  WriteFully(fd, reinterpret_cast<char *>(&header) + n, sizeof(header) - n);
+  WriteFully(fd, payload.data(), payload.size());
+
+  global_connection_fd = fd;
+  for (int signum : GetForwardedSignals()) {
+    InstallSignalHandler(signum, ForwardSignal);
+  }
+  BlockForwardedSignals(SIG_UNBLOCK);
+
+  int32_t exit_code;
+  if (!ReadFully(fd, &exit_code, sizeof(exit_code))) {
+    errno = ECONNRESET;
+    DIE("sandbox server at %s did not report an exit code",
+        opt.server_socket.c_str());
+  }
+  return exit_code;
+}
@@ -0,0 +1,32 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_MAIN_TOOLS_LINUX_SANDBOX_SERVER_H_
+#define SRC_MAIN_TOOLS_LINUX_SANDBOX_SERVER_H_
+
+#include <vector>
+
+// Serves sandboxing requests on opt.listen_socket until killed. Prints "ready"
+// to stdout once the template namespace is set up and requests are accepted.
+int RunSandboxServer();
+
+// Sends this invocation, along with our stdin, stdout, stderr, working
+// directory and environment, to the server listening on opt.server_socket and
+// returns the exit code of the sandboxed command.
+int RunSandboxClient(int argc, char *argv[]);
+
+// The signals that a client forwards to the handler of its request.
+std::vector<int> GetForwardedSignals();
+
+#endif
@@ -35,6 +35,11 @@
  *  - The hostname and domainname will be set to "sandbox".
  *  - The process runs in its own PID namespace, so other processes on the
  *    system are invisible.
+ *
+ * With -Z, linux-sandbox instead becomes a server that sets up the user
+ * namespace and the read-only root once, and then runs the commands of
+ * "linux-sandbox -z" clients in per-action mount, PID and IPC namespaces cloned
+ * from that template.
  */
 
 #include "src/main/tools/linux-sandbox.h"
@@ -60,21 +65,27 @@
 #include <string>
 #include <vector>
 
+#include "src/main/protobuf/execution_statistics.pb.h"
+#include "src/main/tools/cgroups.h"
 #include "src/main/tools/linux-sandbox-options.h"
 #include "src/main/tools/linux-sandbox-pid1.h"
+#include "src/main/tools/linux-sandbox-server.h"
 #include "src/main/tools/logging.h"
+#include "src/main/tools/process-supervisor.h"
 #include "src/main/tools/process-tools.h"
+#include "src/main/tools/resource-sampler.h"
 
 int global_outer_uid;
 int global_outer_gid;
+int global_cgroup_procs_fd = -1;
+int global_stats_fd = -1;
 
 static int global_child_pid;
 
-// The signal that will be sent to the child when a timeout occurs.
-static volatile sig_atomic_t global_next_timeout_signal = SIGTERM;
-
-// The signal that caused us to kill the child (e.g. on timeout).
-static volatile sig_atomic_t global_signal;
+// The statistics written to -S, which collect the samples while pid1 runs.
+static tools::protos::ExecutionStatistics global_stats;
+static int64_t global_start_millis;
+static std::string global_cgroup_dir;
 
 // Make sure the child process does not inherit any accidentally left open file
 // handles from our parent.
@@ -115,16 +126,16 @@ static void CloseFds() {
   }
 }
 
-static void OnTimeout(int sig) {
-  global_signal = sig;
-  kill(global_child_pid, global_next_timeout_signal);
-  if (global_next_timeout_signal == SIGTERM && opt.kill_delay_secs > 0) {
-    global_next_timeout_signal = SIGKILL;
-    alarm(opt.kill_delay_secs);
-  }
+// PID 1 forwards signals to the process group of the command, and everything
+// else in the sandbox dies with PID 1.
+static void SignalPid1(int signum) { kill(global_child_pid, signum); }
+
+static void SampleSandbox() {
+  SampleResources(global_start_millis, global_cgroup_dir,
+                  global_stats.mutable_resource_samples());
 }
 
-static void SpawnPid1() {
+static void SpawnPid1(bool from_template) {
   const int kStackSize = 1024 * 1024;
   std::vector<char> child_stack(kStackSize);
 
@@ -133,8 +144,10 @@ static void SpawnPid1() {
     DIE("pipe");
   }
 
-  int clone_flags =
-      CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWIPC | CLONE_NEWPID | SIGCHLD;
+  int clone_flags = CLONE_NEWNS | CLONE_NEWIPC | CLONE_NEWPID | SIGCHLD;
+  if (!from_template) {
+    clone_flags |= CLONE_NEWUSER;
+  }
   if (opt.create_netns) {
     clone_flags |= CLONE_NEWNET;
   }
@@ -146,7 +159,8 @@ static void SpawnPid1() {
   // EINVAL due to a race condition in the Linux kernel (see
   // https://lkml.org/lkml/2015/7/28/833).
   global_child_pid =
-      clone(Pid1Main, child_stack.data() + kStackSize, clone_flags, sync_pipe);
+      clone(from_template ? TemplatePid1Main : Pid1Main,
+            child_stack.data() + kStackSize, clone_flags, sync_pipe);
   if (global_child_pid < 0) {
     DIE("clone");
   }
@@ -169,33 +183,32 @@ static void SpawnPid1() {
   }
 }
 
-static int WaitForPid1() {
-  int err, status;
-  if (!opt.stats_path.empty()) {
-    struct rusage child_rusage;
-    do {
-      err = wait4(global_child_pid, &status, 0, &child_rusage);
-    } while (err < 0 && errno == EINTR);
-    if (err < 0) {
-      DIE("wait4");
-    }
-    WriteStatsToFile(&child_rusage, opt.stats_path);
-  } else {
-    do {
-      err = waitpid(global_child_pid, &status, 0);
-    } while (err < 0 && errno == EINTR);
-    if (err < 0) {
-      DIE("waitpid");
-    }
+static int WaitForPid1(const Supervision &supervision) {
+  struct rusage child_rusage;
+  int caught_signal;
+  int status = SuperviseChild(global_child_pid, supervision, &child_rusage,
+                              &caught_signal);
+  global_stats.set_end_time_usec(GetWallTimeUsec());
+
+  // The PID namespace is gone with PID 1, so the cgroup can only contain
+  // processes that are still being torn down.
+  if (!global_cgroup_dir.empty()) {
+    ReadCgroupUsage(global_cgroup_dir, global_stats.mutable_cgroup_usage());
+    DestroyCgroup(global_cgroup_dir);
+  }
+  if (global_stats_fd >= 0) {
+    WriteStatsToFd(&child_rusage, &global_stats, global_stats_fd);
+  } else if (!opt.stats_path.empty()) {
+    WriteStatsToFile(&child_rusage, &global_stats, opt.stats_path);
   }
 
-  if (global_signal > 0) {
+  if (caught_signal > 0) {
     // The child exited because we killed it due to receiving a signal
     // ourselves. Do not trust the exitcode in this case, just calculate it from
     // the signal.
     PRINT_DEBUG("child exited due to us catching signal: %s",
-                strsignal(global_signal));
-    return 128 + global_signal;
+                strsignal(caught_signal));
+    return 128 + caught_signal;
   } else if (WIFSIGNALED(status)) {
     PRINT_DEBUG("child exited due to receiving signal: %s",
                 strsignal(WTERMSIG(status)));
@@ -206,6 +219,38 @@ static int WaitForPid1() {
   }
 }
 
+int RunSandbox(bool from_template) {
+  if (!opt.cgroup_parent.empty()) {
+    global_cgroup_dir = CreateCgroup(opt.cgroup_parent, opt.memory_limit_bytes,
+                                     opt.cpu_quota);
+    global_cgroup_procs_fd = OpenCgroupProcs(global_cgroup_dir);
+  }
+
+  // A standalone linux-sandbox simply dies on these signals, and PID 1 with
+  // it. A handler of the sandbox server gets them from its client instead,
+  // and gives the command the same grace period as on a timeout.
+  std::vector<int> signals;
+  if (from_template) {
+    signals = GetForwardedSignals();
+  }
+  Supervision supervision = {opt.timeout_secs,         opt.kill_delay_secs,
+                             signals,                  SignalPid1,
+                             opt.sample_interval_secs, SampleSandbox,
+                             from_template};
+  BlockSupervisedSignals(supervision);
+
+  global_stats.set_start_time_usec(GetWallTimeUsec());
+  global_start_millis = GetMonotonicTimeMillis();
+  SpawnPid1(from_template);
+  if (global_cgroup_procs_fd >= 0) {
+    if (close(global_cgroup_procs_fd) < 0) {
+      DIE("close");
+    }
+    global_cgroup_procs_fd = -1;
+  }
+  return WaitForPid1(supervision);
+}
+
 int main(int argc, char *argv[]) {
   // Ask the kernel to kill us with SIGKILL if our parent dies.
   if (prctl(PR_SET_PDEATHSIG, SIGKILL) < 0) {
@@ -215,19 +260,23 @@ int main(int argc, char *argv[]) {
   ParseOptions(argc, argv);
   global_debug = opt.debug;
 
+  // A sandbox client opens the output files for the handler, which cannot
+  // write to them in the read-only template namespace.
   Redirect(opt.stdout_path, STDOUT_FILENO);
   Redirect(opt.stderr_path, STDERR_FILENO);
 
+  if (!opt.server_socket.empty()) {
+    return RunSandboxClient(argc, argv);
+  }
+
   global_outer_uid = getuid();
   global_outer_gid = getgid();
 
   CloseFds();
 
-  if (opt.timeout_secs > 0) {
-    InstallSignalHandler(SIGALRM, OnTimeout);
-    SetTimeout(opt.timeout_secs);
+  if (!opt.listen_socket.empty()) {
+    return RunSandboxServer();
   }
 
-  SpawnPid1();
-  return WaitForPid1();
+  return RunSandbox(false);
 }
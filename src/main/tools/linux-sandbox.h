@@ -18,4 +18,17 @@
 extern int global_outer_uid;
 extern int global_outer_gid;
 
+// The cgroup.procs file of the cgroup for the action if --cgroup_parent was
+// given, or -1. PID 1 joins the cgroup before it spawns anything.
+extern int global_cgroup_procs_fd;
+
+// The file the statistics go to if it was opened for us by a sandbox client,
+// or -1, in which case they are written to opt.stats_path if set.
+extern int global_stats_fd;
+
+// Runs opt.args in a new sandbox and returns its exit code. If from_template is
+// true, we are in the namespace prepared by the sandbox server already, and
+// only the namespaces and mounts specific to the action are set up.
+int RunSandbox(bool from_template);
+
 #endif
@@ -0,0 +1,306 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/tools/process-supervisor.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "src/main/tools/logging.h"
+
+// pidfd_open(2) appeared in Linux 5.3; older headers lack its number.
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+// What an epoll event of SuperviseChild refers to.
+enum { kChildExited, kSignalReceived, kTimerExpired, kSampleDue };
+
+static void GetSupervisedSignals(const Supervision &supervision,
+                                 sigset_t *set) {
+  if (sigemptyset(set) < 0) {
+    DIE("sigemptyset");
+  }
+  for (int signum : supervision.signals) {
+    if (sigaddset(set, signum) < 0) {
+      DIE("sigaddset(%d)", signum);
+    }
+  }
+  if (sigaddset(set, SIGCHLD) < 0) {
+    DIE("sigaddset(SIGCHLD)");
+  }
+}
+
+void BlockSupervisedSignals(const Supervision &supervision) {
+  sigset_t set;
+  GetSupervisedSignals(supervision, &set);
+  if (sigprocmask(SIG_BLOCK, &set, nullptr) < 0) {
+    DIE("sigprocmask");
+  }
+}
+
+static struct timespec ToTimespec(double secs) {
+  double int_val;
+  double fraction_val = modf(secs, &int_val);
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(int_val);
+  ts.tv_nsec = static_cast<long>(fraction_val * 1e9);
+  if (ts.tv_sec == 0 && ts.tv_nsec == 0) {
+    // A zero value would disarm the timer instead.
+    ts.tv_nsec = 1;
+  }
+  return ts;
+}
+
+// Arms timerfd to expire once after secs, or every secs if periodic.
+static void ArmTimer(int timerfd, double secs, bool periodic = false) {
+  struct itimerspec spec = {};
+  spec.it_value = ToTimespec(secs);
+  if (periodic) {
+    spec.it_interval = spec.it_value;
+  }
+  if (timerfd_settime(timerfd, 0, &spec, nullptr) < 0) {
+    DIE("timerfd_settime");
+  }
+}
+
+static int CreateTimer() {
+  int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    DIE("timerfd_create");
+  }
+  return timer_fd;
+}
+
+static void DrainTimer(int timer_fd) {
+  uint64_t expirations;
+  if (read(timer_fd, &expirations, sizeof(expirations)) < 0 &&
+      errno != EAGAIN) {
+    DIE("read(timerfd)");
+  }
+}
+
+static void AddToEpoll(int epoll_fd, int fd, uint32_t what) {
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u32 = what;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    DIE("epoll_ctl");
+  }
+}
+
+int SuperviseChild(pid_t pid, const Supervision &supervision,
+                   struct rusage *rusage, int *caught_signal) {
+  *caught_signal = 0;
+
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    DIE("epoll_create1");
+  }
+
+  // SIGCHLD tells us when to look for the child if there is no pidfd, e.g.
+  // before Linux 5.3 or when seccomp forbids pidfd_open, and when to reap the
+  // orphans we inherit as a subreaper.
+  int pidfd = syscall(__NR_pidfd_open, pid, 0);
+  if (pidfd >= 0) {
+    AddToEpoll(epoll_fd, pidfd, kChildExited);
+  } else {
+    PRINT_DEBUG("pidfd_open(%d): %s", pid, strerror(errno));
+  }
+
+  sigset_t signals;
+  GetSupervisedSignals(supervision, &signals);
+  int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signal_fd < 0) {
+    DIE("signalfd");
+  }
+  AddToEpoll(epoll_fd, signal_fd, kSignalReceived);
+
+  int timer_fd = -1;
+  if (supervision.timeout_secs > 0 || supervision.graceful_signals) {
+    timer_fd = CreateTimer();
+    if (supervision.timeout_secs > 0) {
+      ArmTimer(timer_fd, supervision.timeout_secs);
+    }
+    AddToEpoll(epoll_fd, timer_fd, kTimerExpired);
+  }
+
+  int sample_fd = -1;
+  if (supervision.sample_interval_secs > 0) {
+    sample_fd = CreateTimer();
+    ArmTimer(sample_fd, supervision.sample_interval_secs, true);
+    AddToEpoll(epoll_fd, sample_fd, kSampleDue);
+  }
+
+  // Set once the child got SIGTERM; from then on, the timer kills it.
+  bool terminating = false;
+  auto terminate = [&]() {
+    if (terminating) {
+      supervision.signal_child(SIGKILL);
+      return;
+    }
+    terminating = true;
+    supervision.signal_child(SIGTERM);
+    if (supervision.kill_delay_secs > 0) {
+      ArmTimer(timer_fd, supervision.kill_delay_secs);
+    } else {
+      supervision.signal_child(SIGKILL);
+    }
+  };
+
+  while (1) {
+    struct epoll_event events[4];
+    int num_events = epoll_wait(epoll_fd, events, 4, -1);
+    if (num_events < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      DIE("epoll_wait");
+    }
+
+    for (int i = 0; i < num_events; i++) {
+      switch (events[i].data.u32) {
+        case kChildExited:
+          break;
+        case kSignalReceived: {
+          struct signalfd_siginfo info;
+          while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            if (info.ssi_signo == SIGCHLD) {
+              continue;
+            }
+            PRINT_DEBUG("received signal %d", info.ssi_signo);
+            if (*caught_signal == 0) {
+              *caught_signal = info.ssi_signo;
+            }
+            if (supervision.graceful_signals) {
+              terminate();
+            } else {
+              supervision.signal_child(SIGKILL);
+            }
+          }
+          break;
+        }
+        case kTimerExpired:
+          DrainTimer(timer_fd);
+          if (!terminating) {
+            PRINT_DEBUG("timeout of %g seconds expired",
+                        supervision.timeout_secs);
+            if (*caught_signal == 0) {
+              *caught_signal = SIGALRM;
+            }
+          }
+          terminate();
+          break;
+        case kSampleDue:
+          DrainTimer(sample_fd);
+          supervision.sample();
+          break;
+      }
+    }
+
+    int status;
+    struct rusage child_rusage;
+    pid_t waited;
+    while ((waited = wait4(-1, &status, WNOHANG, &child_rusage)) > 0 &&
+           waited != pid) {
+      PRINT_DEBUG("reaped orphan %d", waited);
+    }
+    if (waited < 0 && errno != EINTR) {
+      DIE("wait4");
+    } else if (waited == pid) {
+      *rusage = child_rusage;
+      close(epoll_fd);
+      close(signal_fd);
+      if (pidfd >= 0) {
+        close(pidfd);
+      }
+      if (timer_fd >= 0) {
+        close(timer_fd);
+      }
+      if (sample_fd >= 0) {
+        close(sample_fd);
+      }
+      return status;
+    }
+  }
+}
+
+void BecomeSubreaper() {
+  if (prctl(PR_SET_CHILD_SUBREAPER, 1) < 0) {
+    DIE("prctl(PR_SET_CHILD_SUBREAPER)");
+  }
+}
+
+void AppendChildProcesses(pid_t pid, std::vector<pid_t> *pids) {
+  std::string task_dir = "/proc/" + std::to_string(pid) + "/task";
+  DIR *tasks = opendir(task_dir.c_str());
+  if (tasks == nullptr) {
+    return;
+  }
+  while (struct dirent *dent = readdir(tasks)) {
+    if (dent->d_name[0] == '.') {
+      continue;
+    }
+    std::ifstream children(task_dir + "/" + dent->d_name + "/children");
+    for (pid_t child; children >> child;) {
+      pids->push_back(child);
+    }
+  }
+  closedir(tasks);
+}
+
+void SignalDescendants(pid_t pgrp, int signum) {
+  kill(-pgrp, signum);
+
+  std::vector<pid_t> pids;
+  AppendChildProcesses(getpid(), &pids);
+  // Look up the children of each process before signaling it. If it dies, its
+  // children are handed to us (see BecomeSubreaper) and would be missing from
+  // its list.
+  for (size_t i = 0; i < pids.size(); i++) {
+    AppendChildProcesses(pids[i], &pids);
+    kill(pids[i], signum);
+  }
+}
+
+void KillAndReapDescendants(pid_t pgrp) {
+  while (1) {
+    SignalDescendants(pgrp, SIGKILL);
+    if (waitpid(-1, nullptr, 0) < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == ECHILD) {
+        return;
+      }
+      DIE("waitpid");
+    }
+    // Reap whatever died in the meantime before we look for survivors again.
+    while (waitpid(-1, nullptr, WNOHANG) > 0) {
+    }
+  }
+}
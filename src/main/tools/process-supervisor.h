@@ -0,0 +1,75 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_MAIN_TOOLS_PROCESS_SUPERVISOR_H_
+#define SRC_MAIN_TOOLS_PROCESS_SUPERVISOR_H_
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <vector>
+
+// Supervises a child process from a single epoll loop over a pidfd, a
+// signalfd and a timerfd, instead of with SIGALRM and asynchronous signal
+// handlers. Timeouts have the precision of the timerfd rather than whole
+// seconds, and no system call of ours is ever interrupted. Linux only.
+struct Supervision {
+  // Kill the child after this many seconds, if positive.
+  double timeout_secs;
+  // How long to wait between SIGTERM and SIGKILL on timeout.
+  double kill_delay_secs;
+  // Signals upon which the child is killed right away, unless
+  // graceful_signals is set.
+  std::vector<int> signals;
+  // Sends signum to the child and everything it spawned.
+  void (*signal_child)(int signum);
+  // Called every sample_interval_secs while the child runs, if positive.
+  double sample_interval_secs;
+  void (*sample)();
+  // If true, signals end the child like a timeout does instead: it gets
+  // SIGTERM, and SIGKILL after kill_delay_secs or upon the next signal.
+  bool graceful_signals;
+};
+
+// Blocks the signals that SuperviseChild reads from its signalfd, including
+// SIGCHLD, which it needs when it cannot get a pidfd and to reap orphans. Must
+// be called before spawning the child so that no signal gets lost in between.
+// The child has to unblock them again, e.g. with ClearSignalMask.
+void BlockSupervisedSignals(const Supervision &supervision);
+
+// Waits for the child pid to exit, while enforcing the timeout and reacting to
+// signals, and returns its wait status. The resource usage of the child is
+// returned in rusage. caught_signal receives the signal that made us kill the
+// child, which is SIGALRM for a timeout, or 0 if it exited on its own. Other
+// children that exit meanwhile, such as orphans inherited as a subreaper, are
+// reaped, so the caller must not have children of its own to wait for.
+int SuperviseChild(pid_t pid, const Supervision &supervision,
+                   struct rusage *rusage, int *caught_signal);
+
+// Makes us the reaper of all orphaned descendants, so that processes that
+// daemonize or call setsid() still show up in SignalDescendants.
+void BecomeSubreaper();
+
+// Appends the children of all threads of pid to pids. Fails silently if pid is
+// gone already, or if the kernel does not provide the children lists.
+void AppendChildProcesses(pid_t pid, std::vector<pid_t> *pids);
+
+// Sends signum to all of our descendants, as found through the children lists
+// in /proc, and to the process group pgrp.
+void SignalDescendants(pid_t pgrp, int signum);
+
+// Kills all of our remaining descendants and waits until they are reaped, so
+// that nothing the child spawned outlives us.
+void KillAndReapDescendants(pid_t pgrp);
+
+#endif  // SRC_MAIN_TOOLS_PROCESS_SUPERVISOR_H_
@@ -28,8 +28,6 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
-#include <memory>
-
 #include "src/main/protobuf/execution_statistics.pb.h"
 #include "src/main/tools/logging.h"
 
@@ -174,6 +172,14 @@ void SetTimeout(double timeout_secs) {
   }
 }
 
+int64_t GetWallTimeUsec() {
+  struct timeval now;
+  if (gettimeofday(&now, nullptr) < 0) {
+    DIE("gettimeofday");
+  }
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_usec;
+}
+
 int WaitChild(pid_t pid) {
   int err, status;
 
@@ -202,14 +208,8 @@ int WaitChildWithRusage(pid_t pid, struct rusage *rusage) {
   return status;
 }
 
-static std::unique_ptr<tools::protos::ExecutionStatistics>
-CreateExecutionStatisticsProto(struct rusage *rusage) {
-  std::unique_ptr<tools::protos::ExecutionStatistics> execution_statistics(
-      new tools::protos::ExecutionStatistics);
-
-  tools::protos::ResourceUsage *resource_usage =
-      execution_statistics->mutable_resource_usage();
-
+static void FillResourceUsage(struct rusage *rusage,
+                              tools::protos::ResourceUsage *resource_usage) {
   resource_usage->set_utime_sec(rusage->ru_utime.tv_sec);
   resource_usage->set_utime_usec(rusage->ru_utime.tv_usec);
   resource_usage->set_stime_sec(rusage->ru_stime.tv_sec);
@@ -228,24 +228,32 @@ CreateExecutionStatisticsProto(struct rusage *rusage) {
   resource_usage->set_nsignals(rusage->ru_nsignals);
   resource_usage->set_nvcsw(rusage->ru_nvcsw);
   resource_usage->set_nivcsw(rusage->ru_nivcsw);
-
-  return execution_statistics;
 }
 
-// Write execution statistics (e.g. resource usage) to a file.
-void WriteStatsToFile(struct rusage *rusage, const std::string &stats_path) {
-  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_APPEND;
+int OpenStatsFile(const std::string &stats_path) {
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC;
   int fd_out = open(stats_path.c_str(), flags, 0666);
   if (fd_out < 0) {
     DIE("open(%s)", stats_path.c_str());
   }
+  return fd_out;
+}
 
-  std::unique_ptr<tools::protos::ExecutionStatistics> execution_statistics =
-      CreateExecutionStatisticsProto(rusage);
+void WriteStatsToFd(struct rusage *rusage,
+                    tools::protos::ExecutionStatistics *execution_statistics,
+                    int fd_out) {
+  FillResourceUsage(rusage, execution_statistics->mutable_resource_usage());
 
   if (!execution_statistics->SerializeToFileDescriptor(fd_out)) {
-    DIE("could not write resource usage to file: %s", stats_path.c_str());
+    DIE("could not write resource usage to file descriptor %d", fd_out);
   }
+}
 
+// Write execution statistics (e.g. resource usage) to a file.
+void WriteStatsToFile(struct rusage *rusage,
+                      tools::protos::ExecutionStatistics *execution_statistics,
+                      const std::string &stats_path) {
+  int fd_out = OpenStatsFile(stats_path);
+  WriteStatsToFd(rusage, execution_statistics, fd_out);
   close(fd_out);
 }
@@ -16,9 +16,16 @@
 #define SRC_MAIN_TOOLS_PROCESS_TOOLS_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <string>
 
+namespace tools {
+namespace protos {
+class ExecutionStatistics;
+}  // namespace protos
+}  // namespace tools
+
 // Switch completely to the effective uid.
 // Some programs (notably, bash) ignore the euid and just use the uid. This
 // limits the ability for us to use process-wrapper as a setuid binary for
@@ -62,7 +69,22 @@ int WaitChild(pid_t pid);
 // child process.
 int WaitChildWithRusage(pid_t pid, struct rusage *rusage);
 
-// Write execution statistics to a file.
-void WriteStatsToFile(struct rusage *rusage, const std::string &stats_path);
+// Returns the wall clock time in microseconds since the epoch.
+int64_t GetWallTimeUsec();
+
+// Opens stats_path for WriteStatsToFd, truncating it.
+int OpenStatsFile(const std::string &stats_path);
+
+// Writes execution statistics to fd_out, like WriteStatsToFile.
+void WriteStatsToFd(struct rusage *rusage,
+                    tools::protos::ExecutionStatistics *execution_statistics,
+                    int fd_out);
+
+// Write execution statistics to a file. The resource usage is taken from
+// rusage, everything else (e.g. the cgroup usage) has to be filled in by the
+// caller.
+void WriteStatsToFile(struct rusage *rusage,
+                      tools::protos::ExecutionStatistics *execution_statistics,
+                      const std::string &stats_path);
 
 #endif  // PROCESS_TOOLS_H__
@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <vector>
 
+#include "src/main/protobuf/execution_statistics.pb.h"
 #include "src/main/tools/logging.h"
 #include "src/main/tools/process-tools.h"
 #include "src/main/tools/process-wrapper-options.h"
@@ -32,8 +33,10 @@
 
 pid_t LegacyProcessWrapper::child_pid = 0;
 volatile sig_atomic_t LegacyProcessWrapper::last_signal = 0;
+int64_t LegacyProcessWrapper::start_time_usec = 0;
 
 void LegacyProcessWrapper::RunCommand() {
+  start_time_usec = GetWallTimeUsec();
   SpawnChild();
   WaitForChild();
 }
@@ -74,7 +77,10 @@ void LegacyProcessWrapper::WaitForChild() {
   if (!opt.stats_path.empty()) {
     struct rusage child_rusage;
     status = WaitChildWithRusage(child_pid, &child_rusage);
-    WriteStatsToFile(&child_rusage, opt.stats_path);
+    tools::protos::ExecutionStatistics stats;
+    stats.set_start_time_usec(start_time_usec);
+    stats.set_end_time_usec(GetWallTimeUsec());
+    WriteStatsToFile(&child_rusage, &stats, opt.stats_path);
   } else {
     status = WaitChild(child_pid);
   }
@@ -16,12 +16,13 @@
 #define SRC_MAIN_TOOLS_PROCESS_WRAPPER_LEGACY_H_
 
 #include <signal.h>
+#include <stdint.h>
 #include <vector>
 
 // The process-wrapper implementation that was used until and including Bazel
 // 0.4.5. Waits for the wrapped process to exit and then kills its process
 // group. Works on all POSIX operating systems (tested on Linux, macOS,
-// FreeBSD).
+// FreeBSD), and is still used on those other than Linux.
 //
 // Caveats:
 // - Killing just the process group of the spawned child means that daemons or
@@ -44,6 +45,7 @@ class LegacyProcessWrapper {
 
   static pid_t child_pid;
   static volatile sig_atomic_t last_signal;
+  static int64_t start_time_usec;
 };
 
 #endif
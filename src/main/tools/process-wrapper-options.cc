@@ -15,6 +15,7 @@
 #include "src/main/tools/process-wrapper-options.h"
 
 #include <getopt.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,6 +28,14 @@
 
 struct Options opt;
 
+// Codes of the options that have no short form.
+enum {
+  kCgroupParent = 256,
+  kMemoryLimit,
+  kCpuQuota,
+  kSampleInterval,
+};
+
 // Print out a usage error. argc and argv are the argument counter and vector,
 // fmt is a format, string for the error message to print.
 static void Usage(char *program_name, const char *fmt, ...) {
@@ -46,7 +55,17 @@ static void Usage(char *program_name, const char *fmt, ...) {
       "  -o/--stdout <file>  redirect stdout to a file\n"
       "  -e/--stderr <file>  redirect stderr to a file\n"
       "  -s/--stats <file>  if set, write stats in protobuf format to a file\n"
+      "  --sample_interval <secs>  add the memory, CPU and I/O usage of the "
+      "command to the\n"
+      "    stats every secs seconds (requires -s)\n"
       "  -d/--debug  if set, debug info will be printed\n"
+      "  --cgroup_parent <dir>  run the command in a new cgroup v2 leaf below "
+      "dir and\n"
+      "    add the resource usage of the cgroup to the stats\n"
+      "  --memory_limit <bytes>  limit the memory of the command (requires "
+      "--cgroup_parent)\n"
+      "  --cpu_quota <cpus>  limit the command to this many CPUs (requires "
+      "--cgroup_parent)\n"
       "  --  command to run inside sandbox, followed by arguments\n");
   exit(EXIT_FAILURE);
 }
@@ -61,6 +80,10 @@ static void ParseCommandLine(const std::vector<char *> &args) {
       {"stderr", required_argument, 0, 'e'},
       {"stats", required_argument, 0, 's'},
       {"debug", no_argument, 0, 'd'},
+      {"cgroup_parent", required_argument, 0, kCgroupParent},
+      {"memory_limit", required_argument, 0, kMemoryLimit},
+      {"cpu_quota", required_argument, 0, kCpuQuota},
+      {"sample_interval", required_argument, 0, kSampleInterval},
       {0, 0, 0, 0}};
   extern char *optarg;
   extern int optind, optopt;
@@ -106,6 +129,30 @@ static void ParseCommandLine(const std::vector<char *> &args) {
       case 'd':
         opt.debug = true;
         break;
+      case kCgroupParent:
+        opt.cgroup_parent.assign(optarg);
+        break;
+      case kMemoryLimit:
+        if (sscanf(optarg, "%" SCNd64, &opt.memory_limit_bytes) != 1 ||
+            opt.memory_limit_bytes <= 0) {
+          Usage(args.front(), "Invalid memory limit (--memory_limit) value: %s",
+                optarg);
+        }
+        break;
+      case kCpuQuota:
+        if (sscanf(optarg, "%lf", &opt.cpu_quota) != 1 || opt.cpu_quota <= 0) {
+          Usage(args.front(), "Invalid CPU quota (--cpu_quota) value: %s",
+                optarg);
+        }
+        break;
+      case kSampleInterval:
+        if (sscanf(optarg, "%lf", &opt.sample_interval_secs) != 1 ||
+            opt.sample_interval_secs <= 0) {
+          Usage(args.front(),
+                "Invalid sample interval (--sample_interval) value: %s",
+                optarg);
+        }
+        break;
       case '?':
         Usage(args.front(), "Unrecognized argument: -%c (%d)", optopt, optind);
         break;
@@ -129,6 +176,24 @@ void ParseOptions(int argc, char *argv[]) {
     Usage(args.front(), "No command specified.");
   }
 
+  if ((opt.memory_limit_bytes > 0 || opt.cpu_quota > 0) &&
+      opt.cgroup_parent.empty()) {
+    Usage(args.front(),
+          "--memory_limit and --cpu_quota require --cgroup_parent.");
+  }
+  if (opt.sample_interval_secs > 0 && opt.stats_path.empty()) {
+    Usage(args.front(), "--sample_interval requires -s.");
+  }
+
+#ifndef __linux__
+  if (!opt.cgroup_parent.empty()) {
+    Usage(args.front(), "--cgroup_parent is only supported on Linux.");
+  }
+  if (opt.sample_interval_secs > 0) {
+    Usage(args.front(), "--sample_interval is only supported on Linux.");
+  }
+#endif
+
   // argv[] passed to execve() must be a null-terminated array.
   opt.args.push_back(nullptr);
 }
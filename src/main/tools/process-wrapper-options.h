@@ -15,6 +15,7 @@
 #ifndef SRC_MAIN_TOOLS_PROCESS_WRAPPER_OPTIONS_H_
 #define SRC_MAIN_TOOLS_PROCESS_WRAPPER_OPTIONS_H_
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -32,6 +33,16 @@ struct Options {
   bool debug;
   // Where to write stats, in protobuf format (-s)
   std::string stats_path;
+  // Add a sample of the resource usage to the stats every this many seconds,
+  // if positive (--sample_interval)
+  double sample_interval_secs;
+  // Create a cgroup v2 leaf below this directory for the command
+  // (--cgroup_parent)
+  std::string cgroup_parent;
+  // Maximum memory of the command in bytes, if positive (--memory_limit)
+  int64_t memory_limit_bytes;
+  // Maximum number of CPUs the command may use, if positive (--cpu_quota)
+  double cpu_quota;
   // Command to run (--)
   std::vector<char *> args;
 };
@@ -0,0 +1,126 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/tools/process-wrapper-supervised.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+
+#include "src/main/protobuf/execution_statistics.pb.h"
+#include "src/main/tools/cgroups.h"
+#include "src/main/tools/logging.h"
+#include "src/main/tools/process-tools.h"
+#include "src/main/tools/process-wrapper-options.h"
+#include "src/main/tools/resource-sampler.h"
+
+pid_t SupervisedProcessWrapper::child_pid = 0;
+std::string SupervisedProcessWrapper::cgroup_dir;
+int SupervisedProcessWrapper::cgroup_procs_fd = -1;
+tools::protos::ExecutionStatistics SupervisedProcessWrapper::stats;
+int64_t SupervisedProcessWrapper::start_millis = 0;
+
+void SupervisedProcessWrapper::RunCommand() {
+  BecomeSubreaper();
+
+  if (!opt.cgroup_parent.empty()) {
+    cgroup_dir = CreateCgroup(opt.cgroup_parent, opt.memory_limit_bytes,
+                              opt.cpu_quota);
+    cgroup_procs_fd = OpenCgroupProcs(cgroup_dir);
+  }
+
+  Supervision supervision = {opt.timeout_secs, opt.kill_delay_secs,
+                             {SIGTERM, SIGINT}, SignalChild,
+                             opt.sample_interval_secs, SampleChild};
+  BlockSupervisedSignals(supervision);
+
+  stats.set_start_time_usec(GetWallTimeUsec());
+  start_millis = GetMonotonicTimeMillis();
+  SpawnChild();
+  if (cgroup_procs_fd >= 0) {
+    if (close(cgroup_procs_fd) < 0) {
+      DIE("close");
+    }
+    cgroup_procs_fd = -1;
+  }
+  WaitForChild(supervision);
+}
+
+void SupervisedProcessWrapper::SpawnChild() {
+  child_pid = fork();
+  if (child_pid < 0) {
+    DIE("fork");
+  } else if (child_pid == 0) {
+    // In child.
+    if (setsid() < 0) {
+      DIE("setsid");
+    }
+    ClearSignalMask();
+    if (cgroup_procs_fd >= 0) {
+      JoinCgroup(cgroup_procs_fd);
+    }
+
+    // Force umask to include read and execute for everyone, to make output
+    // permissions predictable.
+    umask(022);
+
+    // Does not return unless something went wrong.
+    if (execvp(opt.args[0], opt.args.data()) < 0) {
+      DIE("execvp(%s, ...)", opt.args[0]);
+    }
+  }
+}
+
+void SupervisedProcessWrapper::WaitForChild(const Supervision &supervision) {
+  struct rusage child_rusage;
+  int caught_signal;
+  int status =
+      SuperviseChild(child_pid, supervision, &child_rusage, &caught_signal);
+  stats.set_end_time_usec(GetWallTimeUsec());
+
+  // The child is done for, but may have left descendants behind.
+  KillAndReapDescendants(child_pid);
+
+  if (!cgroup_dir.empty()) {
+    ReadCgroupUsage(cgroup_dir, stats.mutable_cgroup_usage());
+    DestroyCgroup(cgroup_dir);
+  }
+  if (!opt.stats_path.empty()) {
+    WriteStatsToFile(&child_rusage, &stats, opt.stats_path);
+  }
+
+  // The signals we supervised are still blocked, which raise() needs undone.
+  ClearSignalMask();
+  if (caught_signal > 0) {
+    // Don't trust the exit code if we got a timeout or signal.
+    raise(caught_signal);
+  } else if (WIFEXITED(status)) {
+    exit(WEXITSTATUS(status));
+  } else {
+    raise(WTERMSIG(status));
+  }
+}
+
+void SupervisedProcessWrapper::SignalChild(int signum) {
+  SignalDescendants(child_pid, signum);
+}
+
+void SupervisedProcessWrapper::SampleChild() {
+  SampleResources(start_millis, cgroup_dir, stats.mutable_resource_samples());
+}
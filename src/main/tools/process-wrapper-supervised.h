@@ -0,0 +1,60 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_MAIN_TOOLS_PROCESS_WRAPPER_SUPERVISED_H_
+#define SRC_MAIN_TOOLS_PROCESS_WRAPPER_SUPERVISED_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+
+#include "src/main/protobuf/execution_statistics.pb.h"
+#include "src/main/tools/process-supervisor.h"
+
+// The process-wrapper implementation used on Linux. Compared to
+// LegacyProcessWrapper:
+// - Timeouts and signals are handled by an epoll loop (see
+//   process-supervisor.h), so timeouts are not limited to whole seconds.
+// - We are the subreaper of everything the child spawns. Once the child exits,
+//   all its descendants are killed, including those that left its process
+//   group, and we wait for them to be gone.
+// - The child can run in its own cgroup (--cgroup_parent).
+// - The resource usage of the child can be sampled while it runs
+//   (--sample_interval).
+class SupervisedProcessWrapper {
+ public:
+  // Run the command specified in the `opt.args` array and kill it after
+  // `opt.timeout_secs` seconds.
+  static void RunCommand();
+
+ private:
+  static void SpawnChild();
+  static void WaitForChild(const Supervision &supervision);
+  static void SignalChild(int signum);
+  static void SampleChild();
+
+  static pid_t child_pid;
+
+  // The cgroup of the child if --cgroup_parent was given, and its cgroup.procs
+  // file until the child has joined it.
+  static std::string cgroup_dir;
+  static int cgroup_procs_fd;
+
+  // The statistics written to --stats, which collect the samples while the
+  // child runs.
+  static tools::protos::ExecutionStatistics stats;
+  static int64_t start_millis;
+};
+
+#endif  // SRC_MAIN_TOOLS_PROCESS_WRAPPER_SUPERVISED_H_
@@ -42,6 +42,9 @@
 #include "src/main/tools/process-tools.h"
 #include "src/main/tools/process-wrapper-legacy.h"
 #include "src/main/tools/process-wrapper-options.h"
+#ifdef __linux__
+#include "src/main/tools/process-wrapper-supervised.h"
+#endif
 
 int main(int argc, char *argv[]) {
   ParseOptions(argc, argv);
@@ -52,7 +55,11 @@ int main(int argc, char *argv[]) {
   Redirect(opt.stdout_path, STDOUT_FILENO);
   Redirect(opt.stderr_path, STDERR_FILENO);
 
+#ifdef __linux__
+  SupervisedProcessWrapper::RunCommand();
+#else
   LegacyProcessWrapper::RunCommand();
+#endif
 
   return 0;
 }
@@ -0,0 +1,119 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/tools/resource-sampler.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "src/main/protobuf/execution_statistics.pb.h"
+#include "src/main/tools/cgroups.h"
+#include "src/main/tools/logging.h"
+#include "src/main/tools/process-supervisor.h"
+
+int64_t GetMonotonicTimeMillis() {
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+    DIE("clock_gettime");
+  }
+  return static_cast<int64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+// Usage of a single process, or the sum over several.
+struct ProcessUsage {
+  int64_t cpu_ticks = 0;  // including that of children it has waited for
+  int64_t rss_pages = 0;
+  int64_t num_threads = 0;
+  int64_t io_read_bytes = 0;
+  int64_t io_write_bytes = 0;
+};
+
+// Adds the fields of /proc/<pid>/stat that we need to usage. Returns false if
+// the process is gone.
+static bool AddStat(pid_t pid, ProcessUsage *usage) {
+  std::ifstream f("/proc/" + std::to_string(pid) + "/stat");
+  std::string line;
+  if (!std::getline(f, line)) {
+    return false;
+  }
+  // The command name in the second field may contain spaces and parentheses,
+  // so we start after the last closing parenthesis, with the third field.
+  size_t paren = line.rfind(')');
+  if (paren == std::string::npos) {
+    return false;
+  }
+  std::istringstream rest(line.substr(paren + 1));
+  std::vector<int64_t> fields;
+  std::string field;
+  while (rest >> field) {
+    fields.push_back(strtoll(field.c_str(), nullptr, 10));
+  }
+  // See proc(5): utime, stime, cutime and cstime are fields 14 to 17,
+  // num_threads is field 20 and rss is field 24.
+  if (fields.size() < 22) {
+    return false;
+  }
+  usage->cpu_ticks += fields[11] + fields[12] + fields[13] + fields[14];
+  usage->num_threads += fields[17];
+  usage->rss_pages += fields[21];
+  return true;
+}
+
+// Adds the bytes that the process caused to be read from and written to
+// storage to usage. Fails silently if /proc/<pid>/io is not accessible.
+static void AddIo(pid_t pid, ProcessUsage *usage) {
+  std::ifstream f("/proc/" + std::to_string(pid) + "/io");
+  std::string key;
+  int64_t value;
+  while (f >> key >> value) {
+    if (key == "read_bytes:") {
+      usage->io_read_bytes += value;
+    } else if (key == "write_bytes:") {
+      usage->io_write_bytes += value;
+    }
+  }
+}
+
+void SampleResources(int64_t start_millis, const std::string &cgroup_dir,
+                     tools::protos::ResourceSamples *samples) {
+  std::vector<pid_t> pids;
+  AppendChildProcesses(getpid(), &pids);
+  ProcessUsage usage;
+  for (size_t i = 0; i < pids.size(); i++) {
+    AppendChildProcesses(pids[i], &pids);
+    if (AddStat(pids[i], &usage)) {
+      AddIo(pids[i], &usage);
+    }
+  }
+
+  static const int64_t ticks_per_sec = sysconf(_SC_CLK_TCK);
+  static const int64_t page_size = sysconf(_SC_PAGESIZE);
+  int64_t memory_bytes = usage.rss_pages * page_size;
+  int64_t cpu_usec = usage.cpu_ticks * 1000000 / ticks_per_sec;
+  if (!cgroup_dir.empty()) {
+    ReadCgroupSample(cgroup_dir, &memory_bytes, &cpu_usec);
+  }
+
+  samples->add_offset_millis(GetMonotonicTimeMillis() - start_millis);
+  samples->add_memory_bytes(memory_bytes);
+  samples->add_cpu_usec(cpu_usec);
+  samples->add_num_threads(usage.num_threads);
+  samples->add_io_read_bytes(usage.io_read_bytes);
+  samples->add_io_write_bytes(usage.io_write_bytes);
+}
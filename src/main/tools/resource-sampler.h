@@ -0,0 +1,40 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_MAIN_TOOLS_RESOURCE_SAMPLER_H_
+#define SRC_MAIN_TOOLS_RESOURCE_SAMPLER_H_
+
+#include <stdint.h>
+#include <string>
+
+namespace tools {
+namespace protos {
+class ResourceSamples;
+}  // namespace protos
+}  // namespace tools
+
+// Returns the time of CLOCK_MONOTONIC in milliseconds, which is what the
+// offsets of the samples are relative to.
+int64_t GetMonotonicTimeMillis();
+
+// Appends a sample of the resource usage of all our descendants to samples,
+// taken by walking /proc. start_millis is the time at which the command was
+// started, as returned by GetMonotonicTimeMillis. If cgroup_dir is not empty,
+// the memory and CPU usage are read from the cgroup where possible, which also
+// accounts for the page cache and for processes that were reaped already.
+// Linux only.
+void SampleResources(int64_t start_millis, const std::string &cgroup_dir,
+                     tools::protos::ResourceSamples *samples);
+
+#endif  // SRC_MAIN_TOOLS_RESOURCE_SAMPLER_H_
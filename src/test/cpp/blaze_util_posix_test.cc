@@ -24,9 +24,11 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
+#include <string>
 
 #include "src/main/cpp/blaze_util.h"
 #include "src/main/cpp/blaze_util_platform.h"
+#include "src/main/cpp/util/file.h"
 #include "googletest/include/gtest/gtest.h"
 
 namespace blaze {
@@ -179,4 +181,60 @@ TEST_F(UnlimitResourcesTest, SuccessWithPossiblyInfiniteLimits) {
   }
 }
 
+// Forks a client that takes the lock of ``output_base``, reports ``name`` on
+// ``report_fd`` once it owns the lock, keeps it for ``hold_ms`` and exits.
+static pid_t ForkLockHolder(const std::string& output_base, char name,
+                            int report_fd, unsigned int hold_ms) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    BlazeLock blaze_lock;
+    AcquireLock(output_base, false, true, &blaze_lock);
+    if (write(report_fd, &name, 1) != 1) {
+      _exit(EXIT_FAILURE);
+    }
+    TrySleep(hold_ms);
+    ReleaseLock(&blaze_lock);
+    _exit(EXIT_SUCCESS);
+  }
+  return pid;
+}
+
+TEST(AcquireLockTest, WaitersAreServedInArrivalOrder) {
+  const std::string output_base =
+      blaze_util::JoinPath(getenv("TEST_TMPDIR"), "lock_order");
+  ASSERT_TRUE(blaze_util::MakeDirectories(output_base, 0755));
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+
+  pid_t holder = ForkLockHolder(output_base, 'h', fds[1], 500);
+  char name;
+  ASSERT_EQ(1, read(fds[0], &name, 1));
+  ASSERT_EQ('h', name);
+  pid_t first = ForkLockHolder(output_base, '1', fds[1], 0);
+  TrySleep(100);
+  pid_t second = ForkLockHolder(output_base, '2', fds[1], 0);
+
+  // The waiters must be woken up once the holder exits, and in order.
+  std::string order;
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(1, read(fds[0], &name, 1));
+    order += name;
+  }
+  EXPECT_EQ("12", order);
+
+  for (pid_t pid : {holder, first, second}) {
+    int status;
+    EXPECT_EQ(pid, waitpid(pid, &status, 0));
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(EXIT_SUCCESS, WEXITSTATUS(status));
+  }
+
+  // The lock is free now, so taking it must not count as waiting.
+  BlazeLock blaze_lock;
+  EXPECT_EQ(0, AcquireLock(output_base, false, true, &blaze_lock));
+  ReleaseLock(&blaze_lock);
+  close(fds[0]);
+  close(fds[1]);
+}
+
 }  // namespace blaze
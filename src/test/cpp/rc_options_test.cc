@@ -462,5 +462,75 @@ TEST_F(RcOptionsTest, BadStartupLineContinuation_InterpretsNextLineAsNewline) {
       {{"startup", {"foo", " "}}, {"bar", {"baz"}}});
 }
 
-}  // namespace blaze
+// Serialization tests
+
+TEST_F(RcOptionsTest, SerializedFileRoundTrips) {
+  WriteRc("imported.bazelrc",
+          "build --copt=-O2");
+  WriteRc("serialized.bazelrc",
+          "startup --foo\n"
+          "import %workspace%/imported.bazelrc\n"
+          "build --bar");
+  RcFile::ParseError error;
+  string error_text;
+  std::unique_ptr<RcFile> rc = Parse("serialized.bazelrc", &error, &error_text);
+  ASSERT_EQ(error, RcFile::ParseError::NONE);
+  string data;
+  ASSERT_TRUE(rc->Serialize(&data));
+
+  std::unique_ptr<RcFile> cached = RcFile::Deserialize(
+      data, blaze_util::JoinPath(test_file_dir_, "serialized.bazelrc"),
+      &workspace_layout_, test_file_dir_);
+  ASSERT_NE(cached, nullptr);
+  EXPECT_EQ(rc->sources(), cached->sources());
+  ASSERT_EQ(rc->options().size(), cached->options().size());
+  for (const auto& command_options : rc->options()) {
+    const auto cached_options = cached->options().find(command_options.first);
+    ASSERT_NE(cached_options, cached->options().end());
+    ASSERT_EQ(command_options.second.size(), cached_options->second.size());
+    for (size_t i = 0; i < command_options.second.size(); ++i) {
+      EXPECT_EQ(command_options.second[i].option,
+                cached_options->second[i].option);
+      EXPECT_EQ(*command_options.second[i].source_path,
+                *cached_options->second[i].source_path);
+    }
+  }
 
+  // Data produced for another file or workspace must not be used.
+  EXPECT_EQ(RcFile::Deserialize(
+                data, blaze_util::JoinPath(test_file_dir_, "other.bazelrc"),
+                &workspace_layout_, test_file_dir_),
+            nullptr);
+  EXPECT_EQ(RcFile::Deserialize(
+                data, blaze_util::JoinPath(test_file_dir_, "serialized.bazelrc"),
+                &workspace_layout_, "/other/workspace"),
+            nullptr);
+  // Neither must truncated data.
+  EXPECT_EQ(RcFile::Deserialize(
+                data.substr(0, data.size() - 1),
+                blaze_util::JoinPath(test_file_dir_, "serialized.bazelrc"),
+                &workspace_layout_, test_file_dir_),
+            nullptr);
+}
+
+TEST_F(RcOptionsTest, SerializedFileIsInvalidatedByChangedImport) {
+  WriteRc("changing_import.bazelrc",
+          "build --copt=-O2");
+  WriteRc("importing.bazelrc",
+          "import %workspace%/changing_import.bazelrc");
+  RcFile::ParseError error;
+  string error_text;
+  std::unique_ptr<RcFile> rc = Parse("importing.bazelrc", &error, &error_text);
+  ASSERT_EQ(error, RcFile::ParseError::NONE);
+  string data;
+  ASSERT_TRUE(rc->Serialize(&data));
+
+  WriteRc("changing_import.bazelrc",
+          "build --copt=-O3 --copt=-g");
+  EXPECT_EQ(RcFile::Deserialize(
+                data, blaze_util::JoinPath(test_file_dir_, "importing.bazelrc"),
+                &workspace_layout_, test_file_dir_),
+            nullptr);
+}
+
+}  // namespace blaze
@@ -133,6 +133,8 @@ TEST_F(StartupOptionsTest, ValidStartupFlagsTest) {
   SuccessfulIsNullaryTest("client_debug");
   SuccessfulIsNullaryTest("deep_execroot");
   SuccessfulIsNullaryTest("experimental_oom_more_eagerly");
+  SuccessfulIsNullaryTest("experimental_rc_file_cache");
+  SuccessfulIsNullaryTest("experimental_standby_server");
   SuccessfulIsNullaryTest("fatal_event_bus_exceptions");
   SuccessfulIsNullaryTest("host_jvm_debug");
   SuccessfulIsNullaryTest("master_bazelrc");
@@ -143,6 +145,7 @@ TEST_F(StartupOptionsTest, ValidStartupFlagsTest) {
   SuccessfulIsUnaryTest("blazerc");
   SuccessfulIsUnaryTest("command_port");
   SuccessfulIsUnaryTest("connect_timeout_secs");
+  SuccessfulIsUnaryTest("experimental_client_trace_file");
   SuccessfulIsUnaryTest("experimental_oom_more_eagerly_threshold");
   SuccessfulIsUnaryTest("host_javabase");
   SuccessfulIsUnaryTest("host_jvm_args");
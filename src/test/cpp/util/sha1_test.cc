@@ -0,0 +1,73 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "src/main/cpp/util/sha1.h"
+#include "src/main/cpp/util/port.h"
+#include "googletest/include/gtest/gtest.h"
+
+namespace blaze_util {
+
+TEST(Sha1DigestTest, Basic) {
+  const char *strs[] = {
+    "",
+    "a",
+    "abc",
+    "message digest",
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "1234567890123456789012345678901234567890"
+    "1234567890123456789012345678901234567890",
+  };
+  const char *digests[] = {
+    "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+    "86f7e437faa5a7fce15d1ddcb9eaeaea377667b8",
+    "a9993e364706816aba3e25717850c26c9cd0d89d",
+    "c12252ceda8be8994d5fa0290a47231c1d16aae3",
+    "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+    "50abf5706a150990a08b2c5ea40fa0e585554732",
+  };
+  unsigned int n = arraysize(strs);
+  ASSERT_EQ(n, arraysize(digests));
+
+  unsigned char buf[20];
+  Sha1Digest digest;
+  for (unsigned int i = 0; i < n; i++) {
+    digest.Reset();
+    digest.Update(strs[i], strlen(strs[i]));
+    digest.Finish(buf);
+    ASSERT_EQ(digests[i], digest.String());
+  }
+}
+
+TEST(Sha1DigestTest, MillionAs) {
+  // Feed the input in uneven pieces to exercise the partial block buffer.
+  std::string as(1000000, 'a');
+  unsigned char buf[20];
+  Sha1Digest digest;
+  size_t offset = 0;
+  for (unsigned int piece = 1; offset < as.size(); piece = piece * 7 % 997) {
+    unsigned int len = std::min<size_t>(piece, as.size() - offset);
+    digest.Update(as.data() + offset, len);
+    offset += len;
+  }
+  digest.Finish(buf);
+  ASSERT_EQ("34aa973cd4c4daa4f61eeb2bdbad2731"
+            "6534016f",
+            digest.String());
+}
+
+}  // namespace blaze_util
@@ -0,0 +1,79 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "src/main/cpp/util/sha256.h"
+#include "src/main/cpp/util/port.h"
+#include "googletest/include/gtest/gtest.h"
+
+namespace blaze_util {
+
+TEST(Sha256DigestTest, Basic) {
+  const char *strs[] = {
+    "",
+    "a",
+    "abc",
+    "message digest",
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "1234567890123456789012345678901234567890"
+    "1234567890123456789012345678901234567890",
+  };
+  const char *digests[] = {
+    "e3b0c44298fc1c149afbf4c8996fb924"
+    "27ae41e4649b934ca495991b7852b855",
+    "ca978112ca1bbdcafac231b39a23dc4d"
+    "a786eff8147c4e72b9807785afee48bb",
+    "ba7816bf8f01cfea414140de5dae2223"
+    "b00361a396177a9cb410ff61f20015ad",
+    "f7846f55cf23e14eebeab5b4e1550cad"
+    "5b509e3348fbc4efa3a1413d393cb650",
+    "248d6a61d20638b8e5c026930c3e6039"
+    "a33ce45964ff2167f6ecedd419db06c1",
+    "f371bc4a311f2b009eef952dd83ca80e"
+    "2b60026c8e935592d0f9c308453c813e",
+  };
+  unsigned int n = arraysize(strs);
+  ASSERT_EQ(n, arraysize(digests));
+
+  unsigned char buf[32];
+  Sha256Digest digest;
+  for (unsigned int i = 0; i < n; i++) {
+    digest.Reset();
+    digest.Update(strs[i], strlen(strs[i]));
+    digest.Finish(buf);
+    ASSERT_EQ(digests[i], digest.String());
+  }
+}
+
+TEST(Sha256DigestTest, MillionAs) {
+  // Feed the input in uneven pieces to exercise the partial block buffer.
+  std::string as(1000000, 'a');
+  unsigned char buf[32];
+  Sha256Digest digest;
+  size_t offset = 0;
+  for (unsigned int piece = 1; offset < as.size(); piece = piece * 7 % 997) {
+    unsigned int len = std::min<size_t>(piece, as.size() - offset);
+    digest.Update(as.data() + offset, len);
+    offset += len;
+  }
+  digest.Finish(buf);
+  ASSERT_EQ("cdc76e5c9914fb9281a1c7e284d73e67"
+            "f1809a48a497200e046d39ccc7112cd0",
+            digest.String());
+}
+
+}  // namespace blaze_util
@@ -0,0 +1,84 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/cpp/util/trace.h"
+
+#include <string>
+#include <thread>  // NOLINT
+
+#include "googletest/include/gtest/gtest.h"
+
+namespace blaze_util {
+
+using std::string;
+
+class TraceTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ClearTrace(); }
+  void TearDown() override { ClearTrace(); }
+};
+
+TEST_F(TraceTest, EmptyTraceHasOnlyProcessName) {
+  EXPECT_EQ(
+      "{\"traceEvents\":[\n"
+      "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":42,\"tid\":0,"
+      "\"args\":{\"name\":\"Bazel client\"}}\n"
+      "]}\n",
+      GetTraceJson(42, "Bazel client"));
+}
+
+TEST_F(TraceTest, RecordsSpansAndInstants) {
+  RecordTraceSpan("outer", 1000, 3500);
+  RecordTraceInstant("now");
+  string json = GetTraceJson(7, "client");
+  EXPECT_NE(string::npos,
+            json.find("{\"name\":\"outer\",\"cat\":\"client\",\"ph\":\"X\","
+                      "\"ts\":1000,\"dur\":2500,\"pid\":7,\"tid\":1}"));
+  EXPECT_NE(string::npos,
+            json.find("{\"name\":\"now\",\"cat\":\"client\",\"ph\":\"i\","));
+  EXPECT_NE(string::npos, json.find("\"s\":\"t\",\"pid\":7,\"tid\":1}"));
+}
+
+TEST_F(TraceTest, ScopedSpansNest) {
+  {
+    ScopedTraceSpan outer("outer");
+    ScopedTraceSpan inner("inner");
+  }
+  string json = GetTraceJson(1, "client");
+  // The inner span ends first, so it is recorded first.
+  size_t inner = json.find("\"name\":\"inner\"");
+  size_t outer = json.find("\"name\":\"outer\"");
+  ASSERT_NE(string::npos, inner);
+  ASSERT_NE(string::npos, outer);
+  EXPECT_LT(inner, outer);
+}
+
+TEST_F(TraceTest, ThreadsGetTheirOwnIds) {
+  RecordTraceInstant("main");
+  std::thread other([] { RecordTraceInstant("other"); });
+  other.join();
+  string json = GetTraceJson(1, "client");
+  size_t other_event = json.find("\"name\":\"other\"");
+  ASSERT_NE(string::npos, other_event);
+  EXPECT_NE(string::npos, json.find("\"tid\":2}", other_event));
+}
+
+TEST_F(TraceTest, EscapesNames) {
+  RecordTraceSpan("Parse rc file C:\\\"quoted\"\n", 0, 0);
+  EXPECT_NE(string::npos,
+            GetTraceJson(1, "client")
+                .find("\"name\":\"Parse rc file C:\\\\\\\"quoted\\\"\\u000a\""));
+}
+
+}  // namespace blaze_util
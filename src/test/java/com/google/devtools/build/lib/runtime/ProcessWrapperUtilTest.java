@@ -86,4 +86,22 @@ public final class ProcessWrapperUtilTest {
 
     assertThat(commandLine).containsExactlyElementsIn(expectedCommandLine).inOrder();
   }
+
+  @Test
+  public void testProcessWrapperCommandLineBuilder_KeepsMillisecondsOfTimeouts() {
+    String processWrapperPath = "process-wrapper";
+
+    ImmutableList<String> commandArguments = ImmutableList.of("echo", "hello, world");
+
+    List<String> commandLine =
+        ProcessWrapperUtil.commandLineBuilder(processWrapperPath, commandArguments)
+            .setTimeout(Duration.ofMillis(2500))
+            .setKillDelay(Duration.ofMillis(10))
+            .build();
+
+    assertThat(commandLine)
+        .containsExactly(
+            processWrapperPath, "--timeout=2.5", "--kill_delay=0.01", "echo", "hello, world")
+        .inOrder();
+  }
 }
@@ -0,0 +1,65 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.google.devtools.build.lib.sandbox;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import com.google.devtools.build.lib.vfs.FileSystemUtils;
+import com.google.devtools.build.lib.vfs.Path;
+import com.google.devtools.build.lib.vfs.Symlinks;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+import org.junit.runners.JUnit4;
+
+/** Tests for {@link AsynchronousTreeDeleter}. */
+@RunWith(JUnit4.class)
+public class AsynchronousTreeDeleterTest extends SandboxTestCase {
+
+  @Test
+  public void deleteTree() throws Exception {
+    Path trashBase = testRoot.getRelative("trash");
+    trashBase.createDirectory();
+    Path sandbox = testRoot.getRelative("sandbox");
+    FileSystemUtils.createDirectoryAndParents(sandbox.getRelative("execroot/a"));
+    FileSystemUtils.createEmptyFile(sandbox.getRelative("execroot/a/file"));
+    sandbox.getRelative("execroot/a").setWritable(false);
+
+    AsynchronousTreeDeleter deleter = new AsynchronousTreeDeleter(trashBase);
+    deleter.deleteTree(sandbox);
+    assertThat(sandbox.exists(Symlinks.NOFOLLOW)).isFalse();
+    // Deleting a tree that does not exist is not an error.
+    deleter.deleteTree(sandbox);
+
+    deleter.shutdown();
+    assertThat(trashBase.getDirectoryEntries()).isEmpty();
+  }
+
+  @Test
+  public void deleteTreeWithLeftoverTrash() throws Exception {
+    // What a deleter of an earlier server that was killed could have left behind.
+    Path trashBase = testRoot.getRelative("trash");
+    FileSystemUtils.createDirectoryAndParents(trashBase.getRelative("0/execroot"));
+    FileSystemUtils.createEmptyFile(trashBase.getRelative("0/execroot/file"));
+    Path sandbox = testRoot.getRelative("sandbox");
+    FileSystemUtils.createDirectoryAndParents(sandbox.getRelative("execroot"));
+
+    AsynchronousTreeDeleter deleter = new AsynchronousTreeDeleter(trashBase);
+    deleter.deleteTree(sandbox);
+    assertThat(sandbox.exists(Symlinks.NOFOLLOW)).isFalse();
+
+    deleter.shutdown();
+    assertThat(trashBase.getDirectoryEntries()).isEmpty();
+  }
+}
@@ -75,6 +75,60 @@ public final class LinuxSandboxUtilTest {
     assertThat(commandLine).containsExactlyElementsIn(expectedCommandLine).inOrder();
   }
 
+  @Test
+  public void testLinuxSandboxCommandLineBuilder_BuildsWithServerSocket() {
+    Path linuxSandboxPath = testFS.getPath("/linux-sandbox");
+    Path serverSocketPath = testFS.getPath("/linux-sandbox.sock");
+
+    ImmutableList<String> commandArguments = ImmutableList.of("echo", "hello, zoe");
+
+    ImmutableList<String> expectedCommandLine =
+        ImmutableList.<String>builder()
+            .add(linuxSandboxPath.getPathString())
+            .add("-z", serverSocketPath.getPathString())
+            .add("--")
+            .addAll(commandArguments)
+            .build();
+
+    List<String> commandLine =
+        LinuxSandboxUtil.commandLineBuilder(linuxSandboxPath, commandArguments)
+            .setServerSocketPath(serverSocketPath)
+            .build();
+
+    assertThat(commandLine).containsExactlyElementsIn(expectedCommandLine).inOrder();
+  }
+
+  @Test
+  public void testLinuxSandboxCommandLineBuilder_BuildsWithOverlay() {
+    Path linuxSandboxPath = testFS.getPath("/linux-sandbox");
+    Path workingDirectory = testFS.getPath("/sandbox/execroot");
+    Path lowerDirectory = testFS.getPath("/execroot");
+    Path scratchDirectory = testFS.getPath("/sandbox/scratch");
+    Path inputsManifestPath = testFS.getPath("/sandbox/inputs_manifest");
+
+    ImmutableList<String> commandArguments = ImmutableList.of("echo", "hello, ann");
+
+    ImmutableList<String> expectedCommandLine =
+        ImmutableList.<String>builder()
+            .add(linuxSandboxPath.getPathString())
+            .add("-W", workingDirectory.getPathString())
+            .add("--overlay_lower", lowerDirectory.getPathString())
+            .add("--overlay_scratch", scratchDirectory.getPathString())
+            .add("--inputs_manifest", inputsManifestPath.getPathString())
+            .add("--")
+            .addAll(commandArguments)
+            .build();
+
+    List<String> commandLine =
+        LinuxSandboxUtil.commandLineBuilder(linuxSandboxPath, commandArguments)
+            .setWorkingDirectory(workingDirectory)
+            .setOverlay(lowerDirectory, scratchDirectory)
+            .setInputsManifestPath(inputsManifestPath)
+            .build();
+
+    assertThat(commandLine).containsExactlyElementsIn(expectedCommandLine).inOrder();
+  }
+
   @Test
   public void testLinuxSandboxCommandLineBuilder_BuildsWithOptionalArguments() {
     Path linuxSandboxPath = testFS.getPath("/linux-sandbox");
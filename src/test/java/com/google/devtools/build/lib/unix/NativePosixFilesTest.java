@@ -15,22 +15,30 @@ package com.google.devtools.build.lib.unix;
 
 import static com.google.common.truth.Truth.assertThat;
 import static com.google.devtools.build.lib.testutil.MoreAsserts.assertThrows;
+import static java.nio.charset.StandardCharsets.ISO_8859_1;
 import static java.nio.charset.StandardCharsets.UTF_8;
 import static org.junit.Assert.fail;
 import static org.junit.Assume.assumeTrue;
 
 import com.google.common.collect.ImmutableMap;
 import com.google.common.hash.HashCode;
+import com.google.common.hash.Hashing;
 import com.google.devtools.build.lib.testutil.TestUtils;
 import com.google.devtools.build.lib.util.OS;
 import com.google.devtools.build.lib.vfs.FileAccessException;
 import com.google.devtools.build.lib.vfs.FileSystem;
 import com.google.devtools.build.lib.vfs.FileSystemUtils;
 import com.google.devtools.build.lib.vfs.Path;
+import com.google.devtools.build.lib.vfs.Symlinks;
 import java.io.File;
 import java.io.FileNotFoundException;
 import java.io.IOException;
 import java.nio.file.Files;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.Random;
 import org.junit.Before;
 import org.junit.Test;
 import org.junit.runner.RunWith;
@@ -155,4 +163,281 @@ public class NativePosixFilesTest {
     assertThrows(
         FileNotFoundException.class, () -> NativePosixFiles.lgetxattr(nonexistentFile, "foo"));
   }
+
+  @Test
+  public void testBatchStat() throws Exception {
+    FileSystemUtils.writeContentAsLatin1(testFile, "hello");
+    Path link = workingDir.getRelative("link");
+    link.createSymbolicLink(testFile);
+    String[] paths = {
+      testFile.getPathString(), link.getPathString(), workingDir.getRelative("missing").toString()
+    };
+
+    NativePosixFiles.StatBatch lstats =
+        NativePosixFiles.batchStat(paths, /*followSymlinks=*/ false, /*parallelism=*/ 4);
+    assertThat(lstats.size()).isEqualTo(3);
+    FileStatus expected = NativePosixFiles.stat(testFile.getPathString());
+    assertThat(lstats.getErrno(0)).isEqualTo(0);
+    assertThat(lstats.getMode(0) & FileStatus.S_IFMT).isEqualTo(FileStatus.S_IFREG);
+    assertThat(lstats.getSize(0)).isEqualTo(5);
+    assertThat(lstats.getInodeNumber(0)).isEqualTo(expected.getInodeNumber());
+    assertThat(lstats.getLastModifiedTimeNanos(0))
+        .isEqualTo(
+            expected.getLastModifiedTime() * 1000000000L
+                + expected.getFractionalLastModifiedTime());
+    assertThat(lstats.getMode(1) & FileStatus.S_IFMT).isEqualTo(FileStatus.S_IFLNK);
+    assertThat(lstats.getErrno(2)).isEqualTo(ErrnoFileStatus.ENOENT);
+
+    NativePosixFiles.StatBatch stats =
+        NativePosixFiles.batchStat(paths, /*followSymlinks=*/ true, /*parallelism=*/ 1);
+    assertThat(stats.getMode(1) & FileStatus.S_IFMT).isEqualTo(FileStatus.S_IFREG);
+    assertThat(stats.getInodeNumber(1)).isEqualTo(expected.getInodeNumber());
+  }
+
+  @Test
+  public void testDigest() throws Exception {
+    // Larger than one read, and not a multiple of the block size.
+    byte[] large = new byte[3 * 1024 * 1024 + 7];
+    new Random(42).nextBytes(large);
+    Path largeFile = workingDir.getRelative("large");
+    FileSystemUtils.writeContent(largeFile, large);
+    FileSystemUtils.writeContentAsLatin1(testFile, "abc");
+    String[] paths = {
+      testFile.getPathString(),
+      largeFile.getPathString(),
+      workingDir.getRelative("missing").toString()
+    };
+
+    for (FileSystem.HashFunction hashFunction : FileSystem.HashFunction.values()) {
+      int algorithm = UnixFileSystem.toNativeDigest(hashFunction);
+      HashCode expectedSmall = hashFunction.getHash().hashString("abc", UTF_8);
+      HashCode expectedLarge = hashFunction.getHash().hashBytes(large);
+      assertThat(NativePosixFiles.digest(paths[0], algorithm)).isEqualTo(expectedSmall);
+      assertThat(NativePosixFiles.digest(paths[1], algorithm)).isEqualTo(expectedLarge);
+      assertThrows(
+          FileNotFoundException.class, () -> NativePosixFiles.digest(paths[2], algorithm));
+
+      byte[][] digests = NativePosixFiles.batchDigest(
+              paths, algorithm, /*useXattrCache=*/ false, /*parallelism=*/ 4);
+      assertThat(digests).hasLength(3);
+      assertThat(HashCode.fromBytes(digests[0])).isEqualTo(expectedSmall);
+      assertThat(HashCode.fromBytes(digests[1])).isEqualTo(expectedLarge);
+      assertThat(digests[2]).isNull();
+    }
+  }
+
+  @Test
+  public void testGetOrComputeDigest() throws Exception {
+    FileSystemUtils.writeContentAsLatin1(testFile, "abc");
+    // Files modified just now are hashed but not cached, to avoid racing with the next write.
+    testFile.setLastModifiedTime(testFile.getLastModifiedTime() - 60000);
+    String path = testFile.getPathString();
+    int algorithm = NativePosixFiles.DIGEST_SHA256;
+    HashCode expected = Hashing.sha256().hashString("abc", UTF_8);
+
+    assertThat(HashCode.fromBytes(NativePosixFiles.getOrComputeDigest(path, algorithm)))
+        .isEqualTo(expected);
+    assertThat(HashCode.fromBytes(NativePosixFiles.getOrComputeDigest(path, algorithm)))
+        .isEqualTo(expected);
+
+    // A change to the contents also changes the modification time, and so invalidates the cache.
+    FileSystemUtils.writeContentAsLatin1(testFile, "abd");
+    assertThat(HashCode.fromBytes(NativePosixFiles.getOrComputeDigest(path, algorithm)))
+        .isEqualTo(Hashing.sha256().hashString("abd", UTF_8));
+    String missing = workingDir.getChild("missing").toString();
+    assertThrows(
+        FileNotFoundException.class, () -> NativePosixFiles.getOrComputeDigest(missing, algorithm));
+  }
+
+  @Test
+  public void testDigestCachedInXattrIsNotRecomputed() throws Exception {
+    FileSystem fs = new UnixFileSystem(FileSystem.HashFunction.SHA256, true);
+    Path file = fs.getPath(testFile.getPathString());
+    FileSystemUtils.writeContentAsLatin1(file, "abc");
+    long mtime = file.getLastModifiedTime() - 60000;
+    file.setLastModifiedTime(mtime);
+    HashCode expected = Hashing.sha256().hashString("abc", UTF_8);
+
+    assertThat(file.getFastDigest()).isNull();
+    assertThat(HashCode.fromBytes(file.getDigest())).isEqualTo(expected);
+    byte[] cached = file.getFastDigest();
+    assumeTrue("extended attributes are not supported", cached != null);
+    assertThat(HashCode.fromBytes(cached)).isEqualTo(expected);
+
+    // Contents that change behind our back without a new size or modification time go unnoticed,
+    // which shows that the next build takes the digest from the cache instead of hashing again.
+    FileSystemUtils.writeContentAsLatin1(file, "xyz");
+    file.setLastModifiedTime(mtime);
+    assertThat(HashCode.fromBytes(file.getFastDigest())).isEqualTo(expected);
+    assertThat(HashCode.fromBytes(file.getDigest())).isEqualTo(expected);
+  }
+
+  @Test
+  public void testDigestOfReadOnlyFileIsNotCached() throws Exception {
+    FileSystemUtils.writeContentAsLatin1(testFile, "abc");
+    testFile.setLastModifiedTime(testFile.getLastModifiedTime() - 60000);
+    testFile.setWritable(false);
+    long ctime = testFile.stat().getLastChangeTime();
+    String path = testFile.getPathString();
+    int algorithm = NativePosixFiles.DIGEST_SHA256;
+
+    assertThat(HashCode.fromBytes(NativePosixFiles.getOrComputeDigest(path, algorithm)))
+        .isEqualTo(Hashing.sha256().hashString("abc", UTF_8));
+    // Bazel records the change time of outputs after making them read-only, so it must not move.
+    assertThat(NativePosixFiles.getCachedDigest(path, algorithm)).isNull();
+    assertThat(testFile.stat().getLastChangeTime()).isEqualTo(ctime);
+  }
+
+  @Test
+  public void testDeleteTreesBatch() throws Exception {
+    Path tree = workingDir.getRelative("tree");
+    FileSystemUtils.createDirectoryAndParents(tree.getRelative("a/b"));
+    FileSystemUtils.createEmptyFile(tree.getRelative("a/b/file"));
+    tree.getRelative("a/b").setWritable(false);
+    tree.getRelative("a").setExecutable(false);
+    Path outside = workingDir.getRelative("outside");
+    FileSystemUtils.createEmptyFile(outside);
+    tree.getRelative("link").createSymbolicLink(outside);
+    Path file = workingDir.getRelative("file");
+    FileSystemUtils.createEmptyFile(file);
+
+    String[] errors =
+        NativePosixFiles.deleteTreesBatch(
+            new String[] {
+              tree.getPathString(), file.getPathString(), workingDir.getChild("missing").toString()
+            },
+            4);
+
+    assertThat(errors).asList().containsExactly(null, null, null);
+    assertThat(tree.exists()).isFalse();
+    assertThat(file.exists()).isFalse();
+    // Symlinks are deleted, not followed.
+    assertThat(outside.exists()).isTrue();
+  }
+
+  @Test
+  public void testBytePathMethods() throws Exception {
+    FileSystemUtils.createEmptyFile(testFile);
+    Path link = workingDir.getChild("link");
+    link.createSymbolicLink(testFile);
+    byte[] linkBytes = link.getPathString().getBytes(ISO_8859_1);
+
+    assertThat(new String(NativePosixFiles.readlinkBytes(linkBytes), ISO_8859_1))
+        .isEqualTo(testFile.getPathString());
+    assertThat(NativePosixFiles.statBytes(linkBytes).isRegularFile()).isTrue();
+    assertThat(NativePosixFiles.lstatBytes(linkBytes).isSymbolicLink()).isTrue();
+    assertThat(NativePosixFiles.errnoLstatBytes(linkBytes).hasError()).isFalse();
+    byte[] missing = workingDir.getChild("missing").getPathString().getBytes(ISO_8859_1);
+    assertThat(NativePosixFiles.errnoStatBytes(missing).getErrno())
+        .isEqualTo(ErrnoFileStatus.ENOENT);
+    assertThrows(FileNotFoundException.class, () -> NativePosixFiles.statBytes(missing));
+
+    NativePosixFiles.PackedDirents dirents =
+        NativePosixFiles.readdirBytes(
+            workingDir.getPathString().getBytes(ISO_8859_1),
+            NativePosixFiles.ReadTypes.NOFOLLOW);
+    Map<String, NativePosixFiles.Dirents.Type> entries = new HashMap<>();
+    for (int i = 0; i < dirents.size(); i++) {
+      entries.put(dirents.getName(i), dirents.getType(i));
+    }
+    assertThat(entries).containsEntry(testFile.getBaseName(), NativePosixFiles.Dirents.Type.FILE);
+    assertThat(entries).containsEntry("link", NativePosixFiles.Dirents.Type.SYMLINK);
+  }
+
+  @Test
+  public void testCopyFile() throws Exception {
+    byte[] contents = new byte[3 * 1024 * 1024 + 17];
+    new Random(42).nextBytes(contents);
+    FileSystemUtils.writeContent(testFile, contents);
+    Path copy = workingDir.getChild("copy");
+    FileSystemUtils.writeContentAsLatin1(copy, "to be overwritten, and longer than nothing");
+
+    int strategy = NativePosixFiles.copyFile(testFile.getPathString(), copy.getPathString(), 0644);
+
+    assertThat(strategy).isAtLeast(NativePosixFiles.COPY_CLONE);
+    assertThat(strategy).isAtMost(NativePosixFiles.COPY_READ_WRITE);
+    assertThat(FileSystemUtils.readContent(copy)).isEqualTo(contents);
+    String missing = workingDir.getChild("missing").getPathString();
+    assertThrows(
+        FileNotFoundException.class,
+        () -> NativePosixFiles.copyFile(missing, copy.getPathString(), 0644));
+  }
+
+  @Test
+  public void testCreateSymlinkForest() throws Exception {
+    Path root = workingDir.getRelative("forest");
+    root.createDirectory();
+    FileSystemUtils.createDirectoryAndParents(root.getRelative("a"));
+    root.getRelative("a/stale").createSymbolicLink(testFile);
+    FileSystemUtils.createEmptyFile(root.getRelative("a/kept"));
+
+    NativePosixFiles.createSymlinkForest(
+        root.getPathString(),
+        "a/b/c/link\0a/stale\0a/kept\0empty\0".getBytes(UTF_8),
+        "/x\0/y\0/z\0\0".getBytes(UTF_8),
+        4);
+
+    assertThat(root.getRelative("a/b/c/link").readSymbolicLink().getPathString()).isEqualTo("/x");
+    assertThat(root.getRelative("a/stale").readSymbolicLink().getPathString()).isEqualTo("/y");
+    assertThat(root.getRelative("a/kept").readSymbolicLink().getPathString()).isEqualTo("/z");
+    assertThat(root.getRelative("empty").isFile(Symlinks.NOFOLLOW)).isTrue();
+    assertThrows(
+        IOException.class,
+        () ->
+            NativePosixFiles.createSymlinkForest(
+                root.getPathString(), "a\0".getBytes(UTF_8), new byte[0], 1));
+  }
+
+  @Test
+  public void testWalkTree() throws Exception {
+    Path root = workingDir.getRelative("walk");
+    FileSystemUtils.createDirectoryAndParents(root.getRelative("a/b"));
+    FileSystemUtils.createDirectoryAndParents(root.getRelative("sub/c"));
+    FileSystemUtils.createEmptyFile(root.getRelative("a/Foo.java"));
+    FileSystemUtils.createEmptyFile(root.getRelative("a/b/Bar.java"));
+    FileSystemUtils.createEmptyFile(root.getRelative("a/b/.Hidden.java"));
+    FileSystemUtils.createEmptyFile(root.getRelative("a/b/Test.java"));
+    FileSystemUtils.createEmptyFile(root.getRelative("sub/BUILD"));
+    FileSystemUtils.createEmptyFile(root.getRelative("sub/c/Baz.java"));
+
+    NativePosixFiles.TreeWalk walk =
+        NativePosixFiles.walkTree(
+            root.getPathString(),
+            new String[] {"**/*.java", "a"},
+            new String[] {"**/Test.java"},
+            new String[] {"BUILD"},
+            /*excludeDirectories=*/ false,
+            /*followSymlinks=*/ true,
+            /*parallelism=*/ 4);
+
+    NativePosixFiles.StatDirents matches = walk.getMatches();
+    ImmutableMap.Builder<String, Integer> matchModes = ImmutableMap.builder();
+    for (int i = 0; i < matches.size(); i++) {
+      matchModes.put(matches.getName(i), matches.getStats().getMode(i) & FileStatus.S_IFMT);
+    }
+    assertThat(matchModes.build())
+        .containsExactly(
+            "a", FileStatus.S_IFDIR,
+            "a/Foo.java", FileStatus.S_IFREG,
+            "a/b/Bar.java", FileStatus.S_IFREG);
+    List<String> visited = new ArrayList<>();
+    for (int i = 0; i < walk.getVisitedDirectoryCount(); i++) {
+      visited.add(walk.getVisitedDirectory(i));
+    }
+    assertThat(visited).containsExactly("a", "a/b");
+    assertThat(walk.getPrunedDirectoryCount()).isEqualTo(1);
+    assertThat(walk.getPrunedDirectory(0)).isEqualTo("sub");
+
+    assertThrows(
+        FileNotFoundException.class,
+        () ->
+            NativePosixFiles.walkTree(
+                root.getRelative("missing").getPathString(),
+                new String[] {"*"},
+                new String[0],
+                new String[0],
+                false,
+                true,
+                1));
+  }
 }
@@ -16,12 +16,24 @@ package com.google.devtools.build.lib.unix;
 import static com.google.common.truth.Truth.assertThat;
 import static org.junit.Assert.fail;
 
+import com.google.common.base.Predicate;
+import com.google.common.collect.ImmutableList;
+import com.google.devtools.build.lib.vfs.Dirent;
+import com.google.devtools.build.lib.vfs.FileStatus;
 import com.google.devtools.build.lib.vfs.FileSystem;
 import com.google.devtools.build.lib.vfs.FileSystemUtils;
 import com.google.devtools.build.lib.vfs.Path;
 import com.google.devtools.build.lib.vfs.SymlinkAwareFileSystemTest;
 import com.google.devtools.build.lib.vfs.Symlinks;
+import com.google.devtools.build.lib.vfs.UnixGlob;
+import java.io.FileNotFoundException;
 import java.io.IOException;
+import java.util.ArrayList;
+import java.util.Collection;
+import java.util.List;
+import java.util.Map;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.atomic.AtomicReference;
 import org.junit.Test;
 import org.junit.runner.RunWith;
 import org.junit.runners.JUnit4;
@@ -77,4 +89,100 @@ public class UnixFileSystemTest extends SymlinkAwareFileSystemTest {
     assertThat(fifo.stat().isFile()).isTrue();
     assertThat(fifo.stat().isSpecialFile()).isTrue();
   }
+
+  @Test
+  public void testGetDigestsMatchesGetDigest() throws Exception {
+    List<Path> files = new ArrayList<>();
+    for (int i = 0; i < 20; i++) {
+      Path file = absolutize("file" + i);
+      FileSystemUtils.writeContentAsLatin1(file, "content " + i);
+      files.add(file);
+    }
+    List<byte[]> digests = FileSystemUtils.getDigests(files);
+    assertThat(digests).hasSize(files.size());
+    for (int i = 0; i < files.size(); i++) {
+      assertThat(digests.get(i)).isEqualTo(files.get(i).getDigest());
+    }
+
+    files.add(absolutize("missing"));
+    try {
+      FileSystemUtils.getDigests(files);
+      fail();
+    } catch (FileNotFoundException expected) {
+      // Expected.
+    }
+  }
+
+  /** Counts the calls of {@link UnixGlob.FilesystemCalls} while passing them on. */
+  private static class CountingSyscalls implements UnixGlob.FilesystemCalls {
+    final AtomicInteger readdirs = new AtomicInteger();
+    final AtomicInteger bulkGlobs = new AtomicInteger();
+    final boolean allowBulkGlobs;
+
+    CountingSyscalls(boolean allowBulkGlobs) {
+      this.allowBulkGlobs = allowBulkGlobs;
+    }
+
+    @Override
+    public Collection<Dirent> readdir(Path path, Symlinks symlinks) throws IOException {
+      readdirs.incrementAndGet();
+      return UnixGlob.DEFAULT_SYSCALLS.readdir(path, symlinks);
+    }
+
+    @Override
+    public FileStatus statIfFound(Path path, Symlinks symlinks) throws IOException {
+      return UnixGlob.DEFAULT_SYSCALLS.statIfFound(path, symlinks);
+    }
+
+    @Override
+    public Map<Path, FileStatus> globTree(
+        Path base,
+        Collection<String> patterns,
+        boolean excludeDirectories,
+        Predicate<Path> dirPred,
+        Collection<String> dirPredHint)
+        throws IOException {
+      if (!allowBulkGlobs) {
+        return null;
+      }
+      bulkGlobs.incrementAndGet();
+      return UnixGlob.DEFAULT_SYSCALLS.globTree(
+          base, patterns, excludeDirectories, dirPred, dirPredHint);
+    }
+  }
+
+  private static List<Path> globWithSyscalls(Path base, UnixGlob.FilesystemCalls syscalls)
+      throws IOException {
+    return new UnixGlob.Builder(base)
+        .addPattern("**/*.txt")
+        .setDirectoryFilter(directory -> !directory.getChild("BUILD").exists())
+        .allowBulkTraversal(ImmutableList.of("BUILD"))
+        .setFilesystemCalls(new AtomicReference<>(syscalls))
+        .glob();
+  }
+
+  @Test
+  public void testBulkGlobGoesThroughFilesystemCalls() throws Exception {
+    // Everything is below a single subdirectory of the root, which the native walk has to share
+    // between its threads all the same.
+    Path base = absolutize("glob");
+    for (int i = 0; i < 50; i++) {
+      Path directory = base.getRelative("only/dir" + i);
+      FileSystemUtils.createDirectoryAndParents(directory);
+      FileSystemUtils.createEmptyFile(directory.getChild("file.txt"));
+    }
+    FileSystemUtils.createEmptyFile(base.getRelative("only/dir7/BUILD"));
+
+    CountingSyscalls bulk = new CountingSyscalls(true);
+    List<Path> matches = globWithSyscalls(base, bulk);
+    assertThat(matches).hasSize(49);
+    assertThat(matches).doesNotContain(base.getRelative("only/dir7/file.txt"));
+    assertThat(bulk.bulkGlobs.get()).isEqualTo(1);
+    assertThat(bulk.readdirs.get()).isEqualTo(0);
+
+    // Calls that do not offer bulk globs are not bypassed.
+    CountingSyscalls perDirectory = new CountingSyscalls(false);
+    assertThat(globWithSyscalls(base, perDirectory)).containsExactlyElementsIn(matches);
+    assertThat(perDirectory.readdirs.get()).isGreaterThan(0);
+  }
 }
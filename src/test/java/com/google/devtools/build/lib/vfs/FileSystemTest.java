@@ -30,6 +30,7 @@ import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
 import java.nio.file.FileAlreadyExistsException;
+import java.util.Map;
 import java.util.regex.Matcher;
 import java.util.regex.Pattern;
 import org.junit.After;
@@ -474,6 +475,21 @@ public abstract class FileSystemTest {
     assertThat(newPath.getParentDirectory().getDirectoryEntries()).containsExactly(newPath);
   }
 
+  @Test
+  public void testReaddirWithStats() throws Exception {
+    Path dir = xEmptyDirectory.getChild("dir");
+    dir.createDirectory();
+    FileSystemUtils.writeContentAsLatin1(dir.getChild("file"), "hello");
+    dir.getChild("subdir").createDirectory();
+
+    Map<String, FileStatus> entries = dir.readdirWithStats(Symlinks.NOFOLLOW);
+
+    assertThat(entries.keySet()).containsExactly("file", "subdir");
+    assertThat(entries.get("file").isFile()).isTrue();
+    assertThat(entries.get("file").getSize()).isEqualTo(5);
+    assertThat(entries.get("subdir").isDirectory()).isTrue();
+  }
+
   @Test
   public void testCreateDirectoryAndParents() throws Exception {
     Path newPath = absolutize("new-dir/sub/directory");
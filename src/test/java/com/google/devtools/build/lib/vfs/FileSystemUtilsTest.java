@@ -39,6 +39,8 @@ import java.io.IOException;
 import java.nio.charset.StandardCharsets;
 import java.util.Arrays;
 import java.util.Collection;
+import java.util.HashMap;
+import java.util.Map;
 import org.junit.Before;
 import org.junit.Test;
 import org.junit.runner.RunWith;
@@ -661,6 +663,26 @@ public class FileSystemUtilsTest {
     assertThat(file3.exists()).isFalse();
   }
 
+  @Test
+  public void testCreateSymlinkForest() throws IOException {
+    createTestDirectoryTree();
+    Path root = fileSystem.getPath("/forest");
+    root.createDirectory();
+    FileSystemUtils.createDirectoryAndParents(root.getRelative("a"));
+    root.getRelative("a/stale").createSymbolicLink(file2);
+    Map<PathFragment, Path> links = new HashMap<>();
+    links.put(PathFragment.create("a/b/link"), file1);
+    links.put(PathFragment.create("a/stale"), file3);
+    links.put(PathFragment.create("empty"), null);
+
+    FileSystemUtils.createSymlinkForest(root, links);
+
+    assertThat(root.getRelative("a/b/link").readSymbolicLink()).isEqualTo(file1.asFragment());
+    assertThat(root.getRelative("a/stale").readSymbolicLink()).isEqualTo(file3.asFragment());
+    assertThat(root.getRelative("empty").isFile(Symlinks.NOFOLLOW)).isTrue();
+    assertThat(root.getRelative("empty").getFileSize()).isEqualTo(0);
+  }
+
   @Test
   public void testWriteIsoLatin1() throws Exception {
     Path file = fileSystem.getPath("/does/not/exist/yet.txt");
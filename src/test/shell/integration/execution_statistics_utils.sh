@@ -23,6 +23,31 @@ readonly CURRENT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
 readonly STATS_PROTO_PATH="${CURRENT_DIR}/../../../main/protobuf/execution_statistics.proto"
 readonly STATS_PROTO_DIR="$(cd "$(dirname "${STATS_PROTO_PATH}")" && pwd)"
 
+# Creates a cgroup v2 directory below the cgroup of this test, with the memory
+# and cpu controllers enabled for its children, for use as --cgroup_parent, and
+# prints its path. Returns 1 if cgroup v2 is not mounted or not delegated to
+# us, in which case the caller should skip its test.
+function make_cgroup_parent() {
+  [[ "$(stat -f -c %T /sys/fs/cgroup 2> /dev/null)" == "cgroup2fs" ]] \
+    || return 1
+  local own_cgroup="/sys/fs/cgroup$(sed -n 's/^0:://p' /proc/self/cgroup)"
+  local cgroup_parent="${own_cgroup}/bazel-test-$$"
+  mkdir "${cgroup_parent}" 2> /dev/null || return 1
+  if ! echo "+memory +cpu" > "${cgroup_parent}/cgroup.subtree_control" \
+      2> /dev/null; then
+    rmdir "${cgroup_parent}"
+    return 1
+  fi
+  echo "${cgroup_parent}"
+}
+
+# Decodes the execution statistics proto file $1 into $2.
+function decode_execution_statistics() {
+  "${protoc_compiler}" --proto_path="${STATS_PROTO_DIR}" \
+      --decode tools.protos.ExecutionStatistics execution_statistics.proto \
+      < "$1" > "$2"
+}
+
 # Checks that user CPU time and system CPU time, as read from an execution
 # statistics proto file, are within expected bounds.
 #
@@ -37,6 +37,7 @@ readonly SANDBOX_DIR="${OUT_DIR}/sandbox"
 readonly MOUNT_TARGET_ROOT="${TEST_TMPDIR}/targets"
 
 readonly CPU_TIME_SPENDER="${CURRENT_DIR}/../../../test/shell/integration/spend_cpu_time"
+readonly SPAWN_BENCHMARK="${CURRENT_DIR}/../../../test/shell/integration/spawn_benchmark"
 
 SANDBOX_DEFAULT_OPTS="-W $SANDBOX_DIR"
 
@@ -223,6 +224,167 @@ function test_dev_shm_is_writable() {
     &> $TEST_log || fail
 }
 
+function test_server_mode() {
+  local socket="${TEST_TMPDIR}/linux-sandbox.sock"
+  local writable="${TEST_TMPDIR}/writable"
+  mkdir -p "$writable"
+
+  $linux_sandbox -Z "$socket" > "${TEST_TMPDIR}/server.out" \
+    2> "${TEST_TMPDIR}/server.err" &
+  local server_pid=$!
+  for i in $(seq 50); do
+    [[ "$(cat "${TEST_TMPDIR}/server.out")" == "ready" ]] && break
+    sleep 0.1
+  done
+
+  $linux_sandbox -z "$socket" $SANDBOX_DEFAULT_OPTS -w "$writable" -- \
+    /bin/bash -c "touch $writable/file && echo hi there && exit 71" \
+    &> $TEST_log || code=$?
+  assert_equals 71 "$code"
+  expect_log "hi there"
+  test -f "$writable/file" || fail "writable path was not writable"
+
+  $linux_sandbox -z "$socket" $SANDBOX_DEFAULT_OPTS -- \
+    /bin/bash -c "touch $writable/other" &> $TEST_log && fail "expected failure"
+  expect_log "Read-only file system"
+
+  $linux_sandbox -z "$socket" $SANDBOX_DEFAULT_OPTS -R -- /bin/true \
+    &> $TEST_log && fail "expected failure"
+  expect_log "must match the options of the sandbox server"
+
+  kill $server_pid
+}
+
+function test_server_mode_output_and_stats() {
+  local socket="${TEST_TMPDIR}/linux-sandbox-stats.sock"
+  local stats="${OUT_DIR}/stats"
+
+  (umask 002 && exec $linux_sandbox -Z "$socket") \
+    > "${TEST_TMPDIR}/server.out" 2> "${TEST_TMPDIR}/server.err" &
+  local server_pid=$!
+  for i in $(seq 50); do
+    [[ "$(cat "${TEST_TMPDIR}/server.out")" == "ready" ]] && break
+    sleep 0.1
+  done
+  # Only our own user may run commands through the server.
+  assert_equals "srw-------" "$(stat -c %A "$socket")"
+
+  $linux_sandbox -z "$socket" $SANDBOX_DEFAULT_OPTS -l $OUT -L $ERR \
+    -S "$stats" -- /bin/bash -c "echo out; echo err >&2" &> $TEST_log \
+    || fail "sandboxed command failed"
+  assert_equals "out" "$(cat $OUT)"
+  assert_equals "err" "$(cat $ERR)"
+  "${protoc_compiler}" --proto_path="${STATS_PROTO_DIR}" \
+      --decode tools.protos.ExecutionStatistics execution_statistics.proto \
+      < "$stats" > "${stats}.decoded" || fail "malformed statistics"
+  grep -q "resource_usage" "${stats}.decoded" || fail "no resource usage"
+
+  # Signals to the client give the command the grace period of -t.
+  $linux_sandbox -z "$socket" $SANDBOX_DEFAULT_OPTS -t 10 -- /bin/bash -c \
+    'trap "echo terminated; exit 0" TERM; echo started; sleep 60 & wait' \
+    &> $TEST_log &
+  local client_pid=$!
+  for i in $(seq 50); do
+    grep -q started $TEST_log && break
+    sleep 0.1
+  done
+  kill -TERM $client_pid
+  wait $client_pid || code=$?
+  assert_equals 143 "$code"
+  expect_log "terminated"
+
+  kill $server_pid
+}
+
+function test_server_netns_pool() {
+  local socket="${TEST_TMPDIR}/linux-sandbox-pool.sock"
+
+  $linux_sandbox -Z "$socket" --netns_pool 2 > "${TEST_TMPDIR}/server.out" \
+    2> "${TEST_TMPDIR}/server.err" &
+  local server_pid=$!
+  for i in $(seq 50); do
+    [[ "$(cat "${TEST_TMPDIR}/server.out")" == "ready" ]] && break
+    sleep 0.1
+  done
+
+  # Namespace inodes are reused once a namespace is gone, so comparing them
+  # across requests says nothing. Instead, check that every request, including
+  # those beyond the size of the pool, gets a namespace of its own with a
+  # working loopback interface: connecting to a closed port on it is refused
+  # rather than unreachable.
+  local host_netns="$(readlink /proc/self/ns/net)"
+  for i in $(seq 4); do
+    $linux_sandbox -z "$socket" $SANDBOX_DEFAULT_OPTS -N -- \
+      /bin/bash -c "readlink /proc/self/ns/net; cat /proc/net/dev;
+                    (exec 3<> /dev/tcp/127.0.0.1/1)" \
+      &> $TEST_log && fail "connected to a closed port"
+    expect_log "lo:"
+    expect_not_log "eth0"
+    expect_log "Connection refused"
+    local netns="$(head -n 1 $TEST_log)"
+    [[ "$netns" != "$host_netns" ]] || fail "ran in the host's namespace"
+  done
+
+  kill $server_pid
+
+  $linux_sandbox $SANDBOX_DEFAULT_OPTS --netns_pool 2 -- /bin/true \
+    &> $TEST_log && fail "expected failure"
+  expect_log "--netns_pool requires -Z"
+}
+
+function test_spawn_benchmark() {
+  "$SPAWN_BENCHMARK" --linux_sandbox="$linux_sandbox" \
+    --process_wrapper="$process_wrapper" --runs=4 --jobs=1,2 --mounts=2 \
+    &> $TEST_log || fail "benchmark failed"
+  for scenario in direct process-wrapper_stats linux-sandbox_all \
+      linux-sandbox_server_netns_pool; do
+    expect_log "^$scenario  *2  *4  *0 "
+  done
+}
+
+function test_overlay_execroot() {
+  local execroot="${TEST_TMPDIR}/overlay/execroot"
+  local scratch="${TEST_TMPDIR}/overlay/scratch"
+  local external="${TEST_TMPDIR}/overlay/external"
+  local manifest="${TEST_TMPDIR}/overlay/manifest"
+  mkdir -p "$execroot/pkg" "$scratch" "$external"
+  echo "source" > "$execroot/pkg/in.txt"
+  echo "external" > "$external/ext.txt"
+  echo "pkg/in.txt $execroot/pkg/in.txt" > "$manifest"
+  echo "ext/ext.txt $external/ext.txt" >> "$manifest"
+
+  $linux_sandbox $SANDBOX_DEFAULT_OPTS \
+    --overlay_lower "$execroot" --overlay_scratch "$scratch" \
+    --inputs_manifest "$manifest" -- \
+    /bin/bash -c "cat pkg/in.txt ext/ext.txt && realpath pkg/in.txt &&
+                  echo out > out.txt && echo changed > pkg/in.txt" \
+    &> $TEST_log || fail "overlay execroot failed"
+  expect_log "^source$"
+  expect_log "^external$"
+  expect_log "^$SANDBOX_DIR/pkg/in.txt$"
+  assert_equals "out" "$(cat "$scratch/upper/out.txt")"
+  assert_equals "changed" "$(cat "$scratch/upper/pkg/in.txt")"
+  assert_equals "source" "$(cat "$execroot/pkg/in.txt")"
+}
+
+function test_overlay_execroot_rejects_paths_outside() {
+  local execroot="${TEST_TMPDIR}/overlay/execroot"
+  local scratch="${TEST_TMPDIR}/overlay/scratch"
+  local manifest="${TEST_TMPDIR}/overlay/manifest"
+  mkdir -p "$execroot" "$scratch"
+
+  for path in "../x" "a/../../x" "a/.." "/x"; do
+    printf "ok\n%s\n" "$path" > "$manifest"
+    $linux_sandbox $SANDBOX_DEFAULT_OPTS \
+      --overlay_lower "$execroot" --overlay_scratch "$scratch" \
+      --inputs_manifest "$manifest" -- /bin/true \
+      &> $TEST_log && fail "accepted $path"
+    expect_log "inputs manifest $manifest at line 2: '$path'"
+    [[ ! -e "${TEST_TMPDIR}/overlay/x" && ! -e "${scratch}/x" ]] \
+      || fail "created a file outside of the upper layer for $path"
+  done
+}
+
 function assert_linux_sandbox_exec_time() {
   local user_time_low="$1"; shift
   local user_time_high="$1"; shift
@@ -272,6 +434,35 @@ function test_stats_high_user_time_and_high_system_time() {
   assert_linux_sandbox_exec_time 10 12 10 12
 }
 
+# Tests that the sandboxed command runs in a cgroup of its own below
+# --cgroup_parent, whose resource usage ends up in the stats, and that
+# exceeding --memory_limit gets it killed.
+function test_cgroup_limits_and_usage() {
+  local cgroup_parent
+  cgroup_parent="$(make_cgroup_parent)" || return 0
+
+  local stats="${OUT_DIR}/stats"
+  $linux_sandbox $SANDBOX_DEFAULT_OPTS -S "${stats}" \
+    --cgroup_parent="${cgroup_parent}" --memory_limit=$((256 << 20)) \
+    --cpu_quota=0.5 -- /bin/true &> $TEST_log || fail "linux-sandbox failed"
+  decode_execution_statistics "${stats}" "${stats}.decoded"
+  assert_contains "cgroup_usage" "${stats}.decoded"
+  assert_contains "cpu_usage_usec: [1-9]" "${stats}.decoded"
+
+  local code=0
+  # tail has to keep the whole input in memory, as it has no newline.
+  $linux_sandbox $SANDBOX_DEFAULT_OPTS -S "${stats}" \
+    --cgroup_parent="${cgroup_parent}" --memory_limit=$((32 << 20)) -- \
+    /bin/sh -c 'head -c $((256 << 20)) /dev/zero | tail -n 1 > /dev/null' \
+    &> $TEST_log || code=$?
+  assert_not_equals 0 "$code"
+  decode_execution_statistics "${stats}" "${stats}.decoded"
+  assert_contains "memory_oom_kills: [1-9]" "${stats}.decoded"
+
+  # The cgroups of the commands are gone, so the parent can be removed.
+  rmdir "${cgroup_parent}" || fail "cgroup of the command was left behind"
+}
+
 # The test shouldn't fail if the environment doesn't support running it.
 check_supported_platform || exit 0
 check_sandbox_allowed || exit 0
@@ -110,6 +110,39 @@ function test_timeout_kill() {
   assert_stdout "before"
 }
 
+function test_subsecond_timeout() {
+  local code=0
+  $process_wrapper --timeout=0.2 --kill_delay=0.1 --stdout=$OUT --stderr=$ERR \
+    /bin/sh -c "echo before; sleep 10; echo after" &> $TEST_log || code=$?
+  assert_equals "${EXIT_STATUS_SIGALRM}" "$code"
+  assert_stdout "before"
+}
+
+# Tests that processes that left the process group of the child are killed too
+# once the child exits.
+function test_kills_descendants_outside_process_group() {
+  [[ "${PLATFORM}" == "linux" ]] || return 0
+
+  local pid_file="${TEST_TMPDIR}/daemon.pid"
+  $process_wrapper --stdout=$OUT --stderr=$ERR /bin/sh -c \
+    "setsid /bin/sh -c 'echo \$\$ > $pid_file; sleep 100' & sleep 1" \
+    &> $TEST_log || fail "process-wrapper failed"
+  local pid="$(cat "$pid_file")"
+  kill -0 "$pid" 2> /dev/null && fail "process $pid outlived process-wrapper"
+  true
+}
+
+# Tests that orphans handed to process-wrapper as a subreaper are reaped while
+# the child still runs, instead of piling up as zombies.
+function test_reaps_orphans() {
+  [[ "${PLATFORM}" == "linux" ]] || return 0
+
+  $process_wrapper --stdout=$OUT --stderr=$ERR /bin/sh -c \
+    'for i in 1 2 3; do (sleep 0.1 &); done; sleep 1; ps -o stat= --ppid $PPID' \
+    &> $TEST_log || fail "process-wrapper failed"
+  assert_not_contains "Z" "$OUT"
+}
+
 function test_execvp_error_message() {
   local code=0
   $process_wrapper --stdout=$OUT --stderr=$ERR /bin/notexisting &> $TEST_log || code=$?
@@ -161,4 +194,72 @@ function test_stats_high_user_time_and_high_system_time() {
   assert_process_wrapper_exec_time 10 12 10 12
 }
 
+# Tests that the resource usage of the child is sampled while it runs.
+function test_stats_resource_samples() {
+  [[ "${PLATFORM}" == "linux" ]] || return 0
+
+  local stats_out_path="${OUT_DIR}/statsfile"
+  local stats_out_decoded_path="${OUT_DIR}/statsfile.decoded"
+  $process_wrapper --stdout=$OUT --stderr=$ERR --stats="${stats_out_path}" \
+    --sample_interval=0.1 "${CPU_TIME_SPENDER}" 1 0 &> $TEST_log \
+    || fail "process-wrapper failed"
+
+  "${protoc_compiler}" --proto_path="${STATS_PROTO_DIR}" \
+      --decode tools.protos.ExecutionStatistics execution_statistics.proto \
+      < "${stats_out_path}" > "${stats_out_decoded_path}"
+  local num_samples="$(grep -c offset_millis "${stats_out_decoded_path}")"
+  [[ ${num_samples} -ge 5 ]] || fail "expected at least 5 samples, got ${num_samples}"
+  assert_contains "cpu_usec: [1-9]" "${stats_out_decoded_path}"
+  assert_contains "start_time_usec: [1-9]" "${stats_out_decoded_path}"
+  assert_contains "end_time_usec: [1-9]" "${stats_out_decoded_path}"
+}
+
+# Tests that the command runs in a cgroup of its own below --cgroup_parent,
+# with the limits applied, and that its resource usage ends up in the stats.
+function test_cgroup_limits_and_usage() {
+  [[ "${PLATFORM}" == "linux" ]] || return 0
+  local cgroup_parent
+  cgroup_parent="$(make_cgroup_parent)" || return 0
+
+  local stats_out_path="${OUT_DIR}/statsfile"
+  local stats_out_decoded_path="${OUT_DIR}/statsfile.decoded"
+  $process_wrapper --stdout=$OUT --stderr=$ERR --stats="${stats_out_path}" \
+    --cgroup_parent="${cgroup_parent}" --memory_limit=$((256 << 20)) \
+    --cpu_quota=0.5 /bin/sh -c \
+    'cgroup="/sys/fs/cgroup$(sed -n "s/^0:://p" /proc/self/cgroup)";
+     echo "${cgroup}"; cat "${cgroup}/memory.max" "${cgroup}/cpu.max"' \
+    &> $TEST_log || fail "process-wrapper failed"
+
+  assert_contains "^${cgroup_parent}/action-[0-9]" "$OUT"
+  assert_contains "^268435456$" "$OUT"
+  assert_contains "^50000 100000$" "$OUT"
+  decode_execution_statistics "${stats_out_path}" "${stats_out_decoded_path}"
+  assert_contains "cgroup_usage" "${stats_out_decoded_path}"
+  assert_contains "cpu_usage_usec: [1-9]" "${stats_out_decoded_path}"
+  # The cgroup of the command is gone, so the parent can be removed.
+  rmdir "${cgroup_parent}" || fail "cgroup of the command was left behind"
+}
+
+# Tests that a command exceeding --memory_limit is killed, and that the kill is
+# counted in the stats.
+function test_cgroup_memory_limit_oom_kill() {
+  [[ "${PLATFORM}" == "linux" ]] || return 0
+  local cgroup_parent
+  cgroup_parent="$(make_cgroup_parent)" || return 0
+
+  local stats_out_path="${OUT_DIR}/statsfile"
+  local stats_out_decoded_path="${OUT_DIR}/statsfile.decoded"
+  local code=0
+  # tail has to keep the whole input in memory, as it has no newline.
+  $process_wrapper --stdout=$OUT --stderr=$ERR --stats="${stats_out_path}" \
+    --cgroup_parent="${cgroup_parent}" --memory_limit=$((32 << 20)) \
+    /bin/sh -c 'head -c $((256 << 20)) /dev/zero | tail -n 1 > /dev/null' \
+    &> $TEST_log || code=$?
+  rmdir "${cgroup_parent}"
+
+  assert_not_equals 0 "$code"
+  decode_execution_statistics "${stats_out_path}" "${stats_out_decoded_path}"
+  assert_contains "memory_oom_kills: [1-9]" "${stats_out_decoded_path}"
+}
+
 run_suite "process-wrapper"
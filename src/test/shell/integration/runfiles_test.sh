@@ -178,5 +178,53 @@ EOF
     || fail "Old foo still found"
 }
 
+function test_runfiles_tree_is_updated() {
+  mkdir -p pkg/data
+  touch pkg/data/a pkg/data/b pkg/data/c
+  cat > pkg/BUILD << EOF
+sh_binary(name = "foo",
+          srcs = [ "x/y/z.sh" ],
+          data = [ "data/a", "data/c" ])
+EOF
+  bazel build pkg:foo >&$TEST_log || fail "build failed"
+  local runfiles="${PRODUCT_NAME}-bin/pkg/foo.runfiles"
+  [[ -L "${runfiles}/${WORKSPACE_NAME}/pkg/data/a" ]] || fail "data/a not found"
+  [[ -f "${runfiles}/MANIFEST.built" ]] || fail "MANIFEST.built not found"
+  # Only a full scan of the tree would remove this file.
+  touch "${runfiles}/extraneous"
+
+  # Replace a file by a directory and add and remove files.
+  rm pkg/data/c
+  mkdir pkg/data/c
+  touch pkg/data/c/inner
+  cat > pkg/BUILD << EOF
+sh_binary(name = "foo",
+          srcs = [ "x/y/z.sh" ],
+          data = [ "data/b", "data/c/inner" ])
+EOF
+  bazel build pkg:foo >&$TEST_log || fail "build failed"
+  [[ ! -e "${runfiles}/${WORKSPACE_NAME}/pkg/data/a" ]] \
+    || fail "data/a still found"
+  [[ -L "${runfiles}/${WORKSPACE_NAME}/pkg/data/b" ]] || fail "data/b not found"
+  [[ -d "${runfiles}/${WORKSPACE_NAME}/pkg/data/c" ]] \
+    || fail "data/c is not a directory"
+  [[ -L "${runfiles}/${WORKSPACE_NAME}/pkg/data/c/inner" ]] \
+    || fail "data/c/inner not found"
+  diff "${PRODUCT_NAME}-bin/pkg/foo.runfiles_manifest" "${runfiles}/MANIFEST" \
+    || fail "MANIFEST is not a copy of the input manifest"
+  [[ -f "${runfiles}/extraneous" ]] || fail "the tree was scanned"
+
+  # Without MANIFEST.built, the tree is scanned and cleaned up.
+  rm "${runfiles}/MANIFEST.built"
+  touch pkg/data/d
+  cat > pkg/BUILD << EOF
+sh_binary(name = "foo",
+          srcs = [ "x/y/z.sh" ],
+          data = [ "data/b", "data/d" ])
+EOF
+  bazel build pkg:foo >&$TEST_log || fail "build failed"
+  [[ ! -e "${runfiles}/extraneous" ]] || fail "the tree was not scanned"
+  [[ -L "${runfiles}/${WORKSPACE_NAME}/pkg/data/d" ]] || fail "data/d not found"
+}
 
 run_suite "runfiles"
@@ -0,0 +1,773 @@
+// Copyright 2018 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures what linux-sandbox and process-wrapper cost per spawn. Each
+// scenario runs /bin/true many times through one of the tools with a given set
+// of options, from a varying number of threads at once, and reports the
+// latency percentiles, the throughput and the CPU time of the spawns. As the
+// number of threads grows, the latencies also show how much concurrent
+// sandboxes contend on locks in the kernel (e.g. for mounts or namespaces).
+// With --syscalls, one spawn of each scenario additionally runs under ptrace
+// to count the system calls of all processes involved. Linux only.
+//
+//   bazel run //src/test/shell/integration:spawn_benchmark -- --runs=500
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+extern char **environ;
+
+// PTRACE_GET_SYSCALL_INFO appeared in Linux 5.3 and glibc 2.31.
+#ifndef PTRACE_GET_SYSCALL_INFO
+#define PTRACE_GET_SYSCALL_INFO 0x420e
+#endif
+
+// The beginning of struct ptrace_syscall_info, which is all we need of it.
+struct SyscallInfo {
+  uint8_t op;
+  uint32_t arch __attribute__((aligned(4)));
+  uint64_t instruction_pointer;
+  uint64_t stack_pointer;
+  uint64_t nr;
+  uint64_t args[6];
+};
+
+// The op of SyscallInfo for a stop at system call entry.
+static const uint8_t kSyscallEntry = 1;
+
+static const char kCommand[] = "/bin/true";
+
+struct BenchmarkOptions {
+  std::string linux_sandbox;
+  std::string process_wrapper;
+  int runs = 200;
+  int mounts = 8;
+  std::vector<int> jobs;
+  std::set<std::string> scenarios;
+  bool syscalls = false;
+  bool list = false;
+};
+
+// One way of running kCommand that we measure.
+struct Scenario {
+  std::string name;
+  // Arguments of the sandbox server that the scenario sends its spawns to, if
+  // any. The server is started before the scenario and stopped after it.
+  std::vector<std::string> server_args;
+  // Returns the command line of a spawn on the given thread.
+  std::function<std::vector<std::string>(int thread)> argv;
+};
+
+struct Sample {
+  int64_t latency_nsec;
+  int64_t user_usec;
+  int64_t sys_usec;
+};
+
+static void Usage(const char *program_name) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "\n"
+          "Possible arguments:\n"
+          "  --linux_sandbox <path>  benchmark the linux-sandbox binary at "
+          "path\n"
+          "  --process_wrapper <path>  benchmark the process-wrapper binary at "
+          "path\n"
+          "  --runs <n>  spawns per scenario and number of threads (default "
+          "200)\n"
+          "  --jobs <n,...>  numbers of threads that spawn concurrently "
+          "(default: powers of\n"
+          "    two up to the number of CPUs)\n"
+          "  --mounts <n>  tmpfs, bind mounts and writable paths in the "
+          "scenarios that\n"
+          "    use them (default 8)\n"
+          "  --scenario <name>  only run this scenario; may be repeated\n"
+          "  --syscalls  also count the system calls of one spawn of each "
+          "scenario\n"
+          "  --list  print the names of the scenarios and exit\n",
+          program_name);
+  exit(EXIT_FAILURE);
+}
+
+static int ParsePositive(const char *program_name, const char *value) {
+  char *end;
+  long n = strtol(value, &end, 10);
+  if (*end != '\0' || n <= 0 || n > 1 << 20) {
+    fprintf(stderr, "Invalid value: %s\n", value);
+    Usage(program_name);
+  }
+  return static_cast<int>(n);
+}
+
+static BenchmarkOptions ParseOptions(int argc, char *argv[]) {
+  enum {
+    kLinuxSandbox = 256,
+    kProcessWrapper,
+    kRuns,
+    kJobs,
+    kMounts,
+    kScenario,
+    kSyscalls,
+    kList,
+  };
+  static struct option long_options[] = {
+      {"linux_sandbox", required_argument, 0, kLinuxSandbox},
+      {"process_wrapper", required_argument, 0, kProcessWrapper},
+      {"runs", required_argument, 0, kRuns},
+      {"jobs", required_argument, 0, kJobs},
+      {"mounts", required_argument, 0, kMounts},
+      {"scenario", required_argument, 0, kScenario},
+      {"syscalls", no_argument, 0, kSyscalls},
+      {"list", no_argument, 0, kList},
+      {0, 0, 0, 0}};
+
+  BenchmarkOptions options;
+  int c;
+  while ((c = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+    switch (c) {
+      case kLinuxSandbox:
+        options.linux_sandbox = optarg;
+        break;
+      case kProcessWrapper:
+        options.process_wrapper = optarg;
+        break;
+      case kRuns:
+        options.runs = ParsePositive(argv[0], optarg);
+        break;
+      case kJobs:
+        for (char *job = strtok(optarg, ","); job != nullptr;
+             job = strtok(nullptr, ",")) {
+          options.jobs.push_back(ParsePositive(argv[0], job));
+        }
+        break;
+      case kMounts:
+        options.mounts = ParsePositive(argv[0], optarg);
+        break;
+      case kScenario:
+        options.scenarios.insert(optarg);
+        break;
+      case kSyscalls:
+        options.syscalls = true;
+        break;
+      case kList:
+        options.list = true;
+        break;
+      default:
+        Usage(argv[0]);
+    }
+  }
+  if (optind != argc) {
+    Usage(argv[0]);
+  }
+
+  if (options.jobs.empty()) {
+    int cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    for (int jobs = 1; jobs < cpus; jobs *= 2) {
+      options.jobs.push_back(jobs);
+    }
+    options.jobs.push_back(cpus > 0 ? cpus : 1);
+  }
+  return options;
+}
+
+static std::string MakeDir(const std::string &path) {
+  if (mkdir(path.c_str(), 0755) < 0) {
+    err(EXIT_FAILURE, "mkdir(%s)", path.c_str());
+  }
+  return path;
+}
+
+static std::vector<std::string> Concat(std::vector<std::string> a,
+                                       const std::vector<std::string> &b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+// Returns all scenarios for the tools in options, with the directories they
+// need created below work_dir.
+static std::vector<Scenario> CreateScenarios(const BenchmarkOptions &options,
+                                             const std::string &work_dir) {
+  std::vector<Scenario> scenarios;
+  scenarios.push_back({"direct", {}, [](int) {
+                         return std::vector<std::string>{kCommand};
+                       }});
+
+  std::string stats_prefix = work_dir + "/stats-";
+
+  if (!options.process_wrapper.empty()) {
+    std::string tool = options.process_wrapper;
+    auto with = [tool](std::vector<std::string> args) {
+      return Concat(Concat({tool}, args), {"--", kCommand});
+    };
+    scenarios.push_back({"process-wrapper", {}, [with](int) {
+                           return with({});
+                         }});
+    scenarios.push_back(
+        {"process-wrapper_stats", {}, [with, stats_prefix](int thread) {
+           return with({"-s", stats_prefix + std::to_string(thread)});
+         }});
+  }
+
+  if (!options.linux_sandbox.empty()) {
+    std::string tool = options.linux_sandbox;
+    std::string sandbox_dir = MakeDir(work_dir + "/sandbox");
+    std::vector<std::string> tmpfs_args, bind_args, writable_args;
+    for (int i = 0; i < options.mounts; i++) {
+      std::string suffix = "-" + std::to_string(i);
+      tmpfs_args.push_back("-e");
+      tmpfs_args.push_back(MakeDir(work_dir + "/tmpfs" + suffix));
+      bind_args.push_back("-M");
+      bind_args.push_back(MakeDir(work_dir + "/bind" + suffix));
+      writable_args.push_back("-w");
+      writable_args.push_back(MakeDir(work_dir + "/writable" + suffix));
+    }
+
+    auto with = [tool, sandbox_dir](std::vector<std::string> args) {
+      return Concat(Concat({tool, "-W", sandbox_dir}, args), {"--", kCommand});
+    };
+    scenarios.push_back({"linux-sandbox", {}, [with](int) {
+                           return with({});
+                         }});
+    scenarios.push_back({"linux-sandbox_tmpfs", {}, [with, tmpfs_args](int) {
+                           return with(tmpfs_args);
+                         }});
+    scenarios.push_back({"linux-sandbox_bind", {}, [with, bind_args](int) {
+                           return with(bind_args);
+                         }});
+    scenarios.push_back(
+        {"linux-sandbox_writable", {}, [with, writable_args](int) {
+           return with(writable_args);
+         }});
+    scenarios.push_back({"linux-sandbox_netns", {}, [with](int) {
+                           return with({"-N"});
+                         }});
+    scenarios.push_back(
+        {"linux-sandbox_stats", {}, [with, stats_prefix](int thread) {
+           return with({"-S", stats_prefix + std::to_string(thread)});
+         }});
+    std::vector<std::string> all_args =
+        Concat(Concat(Concat(tmpfs_args, bind_args), writable_args), {"-N"});
+    scenarios.push_back(
+        {"linux-sandbox_all", {}, [with, all_args, stats_prefix](int thread) {
+           return with(Concat(
+               all_args, {"-S", stats_prefix + std::to_string(thread)}));
+         }});
+
+    // The server handles each request in a process of its own, whose CPU time
+    // does not show up in the rusage of the client that we measure.
+    std::string socket = work_dir + "/server.sock";
+    auto with_server = [with, socket](std::vector<std::string> args) {
+      return with(Concat({"-z", socket}, args));
+    };
+    scenarios.push_back(
+        {"linux-sandbox_server", {"-Z", socket}, [with_server](int) {
+           return with_server({});
+         }});
+    scenarios.push_back(
+        {"linux-sandbox_server_netns", {"-Z", socket}, [with_server](int) {
+           return with_server({"-N"});
+         }});
+    int max_jobs = *std::max_element(options.jobs.begin(), options.jobs.end());
+    scenarios.push_back({"linux-sandbox_server_netns_pool",
+                         {"-Z", socket, "--netns_pool",
+                          std::to_string(2 * max_jobs)},
+                         [with_server](int) { return with_server({"-N"}); }});
+  }
+  return scenarios;
+}
+
+static std::vector<char *> ToArgv(const std::vector<std::string> &args) {
+  std::vector<char *> argv;
+  for (const std::string &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  return argv;
+}
+
+static std::string Join(const std::vector<std::string> &args) {
+  std::string joined;
+  for (const std::string &arg : args) {
+    joined += (joined.empty() ? "" : " ") + arg;
+  }
+  return joined;
+}
+
+static int64_t GetMonotonicTimeNsec() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+    err(EXIT_FAILURE, "clock_gettime");
+  }
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t ToUsec(const struct timeval &tv) {
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+// Starts args with stdin, stdout (unless stdout_fd is given) and stderr on
+// /dev/null and returns its pid. posix_spawn is safe to call from several
+// threads at once.
+static pid_t Start(const std::vector<std::string> &args, int stdout_fd = -1) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                   O_RDONLY, 0);
+  if (stdout_fd >= 0) {
+    posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+  }
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+
+  std::vector<char *> argv = ToArgv(args);
+  pid_t pid;
+  int error =
+      posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (error != 0) {
+    errno = error;
+    err(EXIT_FAILURE, "posix_spawn(%s)", argv[0]);
+  }
+  return pid;
+}
+
+// Waits for pid and returns its wait status.
+static int Wait(pid_t pid, struct rusage *rusage) {
+  int status;
+  while (wait4(pid, &status, 0, rusage) < 0) {
+    if (errno != EINTR) {
+      err(EXIT_FAILURE, "wait4(%d)", pid);
+    }
+  }
+  return status;
+}
+
+// Starts a sandbox server and waits until it accepts requests.
+static pid_t StartServer(const std::string &linux_sandbox,
+                         const std::vector<std::string> &server_args) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) < 0) {
+    err(EXIT_FAILURE, "pipe2");
+  }
+  pid_t pid = Start(Concat({linux_sandbox}, server_args), fds[1]);
+  close(fds[1]);
+  char ready[6] = {};
+  ssize_t n = read(fds[0], ready, sizeof(ready) - 1);
+  close(fds[0]);
+  if (n < 0 || strcmp(ready, "ready") != 0) {
+    errx(EXIT_FAILURE, "sandbox server failed to start: %s",
+         Join(Concat({linux_sandbox}, server_args)).c_str());
+  }
+  return pid;
+}
+
+static void StopServer(pid_t pid) {
+  kill(pid, SIGTERM);
+  struct rusage rusage;
+  Wait(pid, &rusage);
+}
+
+// Spawns the scenario runs times from the given number of threads and returns
+// the samples of all spawns. failures receives the number of spawns that did
+// not exit with 0.
+static std::vector<Sample> RunScenario(const Scenario &scenario, int runs,
+                                       int jobs, int *failures) {
+  std::atomic<int> next(0);
+  std::atomic<int> failed(0);
+  std::vector<std::vector<Sample>> samples(jobs);
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < jobs; thread++) {
+    threads.emplace_back([&, thread] {
+      std::vector<std::string> args = scenario.argv(thread);
+      while (next++ < runs) {
+        struct rusage rusage;
+        int64_t start = GetMonotonicTimeNsec();
+        int status = Wait(Start(args), &rusage);
+        int64_t end = GetMonotonicTimeNsec();
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+          failed++;
+        }
+        samples[thread].push_back({end - start, ToUsec(rusage.ru_utime),
+                                   ToUsec(rusage.ru_stime)});
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  *failures = failed;
+  std::vector<Sample> all;
+  for (const std::vector<Sample> &thread_samples : samples) {
+    all.insert(all.end(), thread_samples.begin(), thread_samples.end());
+  }
+  return all;
+}
+
+static double Percentile(const std::vector<int64_t> &sorted, double p) {
+  size_t index = static_cast<size_t>(p * sorted.size());
+  return sorted[std::min(index, sorted.size() - 1)] / 1e6;
+}
+
+static void PrintHeader() {
+  printf("%-32s %4s %6s %4s %9s %8s %8s %8s %8s %8s %8s\n", "scenario", "jobs",
+         "runs", "fail", "spawns/s", "p50 ms", "p90 ms", "p99 ms", "max ms",
+         "user ms", "sys ms");
+}
+
+static void PrintResult(const std::string &name, int jobs,
+                        const std::vector<Sample> &samples, int failures,
+                        int64_t wall_nsec) {
+  std::vector<int64_t> latencies;
+  int64_t user_usec = 0;
+  int64_t sys_usec = 0;
+  for (const Sample &sample : samples) {
+    latencies.push_back(sample.latency_nsec);
+    user_usec += sample.user_usec;
+    sys_usec += sample.sys_usec;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  double n = samples.size();
+  printf("%-32s %4d %6zu %4d %9.1f %8.2f %8.2f %8.2f %8.2f %8.3f %8.3f\n",
+         name.c_str(), jobs, samples.size(), failures, n * 1e9 / wall_nsec,
+         Percentile(latencies, 0.5), Percentile(latencies, 0.9),
+         Percentile(latencies, 0.99), Percentile(latencies, 1.0),
+         user_usec / n / 1e3, sys_usec / n / 1e3);
+  fflush(stdout);
+}
+
+// Resumes a stopped tracee until its next system call entry or exit, and
+// delivers signum to it unless it is 0.
+static void Resume(pid_t pid, int signum) {
+  if (ptrace(PTRACE_SYSCALL, pid, nullptr,
+             reinterpret_cast<void *>(static_cast<intptr_t>(signum))) < 0 &&
+      errno != ESRCH) {
+    err(EXIT_FAILURE, "ptrace(PTRACE_SYSCALL, %d)", pid);
+  }
+}
+
+// Runs args once under ptrace, following every process and thread it creates,
+// and adds the number of calls to each system call to counts. tasks receives
+// the number of processes and threads. Returns false if we cannot trace, e.g.
+// because ptrace is forbidden or the kernel is older than Linux 5.3.
+static bool CountSyscalls(const std::vector<std::string> &args,
+                          std::map<uint64_t, int64_t> *counts, int *tasks) {
+  std::vector<char *> argv = ToArgv(args);
+  pid_t pid = fork();
+  if (pid < 0) {
+    err(EXIT_FAILURE, "fork");
+  } else if (pid == 0) {
+    int null_fd = open("/dev/null", O_RDWR);
+    if (null_fd < 0 || dup2(null_fd, STDIN_FILENO) < 0 ||
+        dup2(null_fd, STDOUT_FILENO) < 0 || dup2(null_fd, STDERR_FILENO) < 0) {
+      _exit(EXIT_FAILURE);
+    }
+    if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) < 0) {
+      _exit(EXIT_FAILURE);
+    }
+    raise(SIGSTOP);
+    execv(argv[0], argv.data());
+    _exit(EXIT_FAILURE);
+  }
+
+  int status;
+  if (waitpid(pid, &status, 0) < 0) {
+    err(EXIT_FAILURE, "waitpid(%d)", pid);
+  }
+  if (!WIFSTOPPED(status)) {
+    return false;
+  }
+  if (ptrace(PTRACE_SETOPTIONS, pid, nullptr,
+             PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE |
+                 PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK |
+                 PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL) < 0) {
+    err(EXIT_FAILURE, "ptrace(PTRACE_SETOPTIONS, %d)", pid);
+  }
+  Resume(pid, 0);
+
+  // We only wait for tracees, and not for other children such as a sandbox
+  // server, even though waitpid(-1) reports all of them.
+  bool traced = true;
+  std::set<pid_t> live = {pid};
+  std::set<pid_t> started = {pid};
+  while (!live.empty()) {
+    pid_t tracee = waitpid(-1, &status, __WALL);
+    if (tracee < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      err(EXIT_FAILURE, "waitpid");
+    }
+    if (WIFEXITED(status) || WIFSIGNALED(status)) {
+      live.erase(tracee);
+      continue;
+    } else if (!WIFSTOPPED(status)) {
+      continue;
+    }
+
+    int signum = WSTOPSIG(status);
+    int event = status >> 16;
+    if (signum == (SIGTRAP | 0x80)) {
+      SyscallInfo info;
+      if (ptrace(static_cast<__ptrace_request>(PTRACE_GET_SYSCALL_INFO),
+                 tracee, reinterpret_cast<void *>(sizeof(info)), &info) < 0) {
+        // Kill the command; all tracees still report their exit.
+        traced = false;
+        for (pid_t task : live) {
+          kill(task, SIGKILL);
+        }
+      } else if (info.op == kSyscallEntry) {
+        (*counts)[info.nr]++;
+      }
+      signum = 0;
+    } else if (signum == SIGTRAP && event != 0) {
+      if (event == PTRACE_EVENT_CLONE || event == PTRACE_EVENT_FORK ||
+          event == PTRACE_EVENT_VFORK) {
+        unsigned long new_task;
+        if (ptrace(PTRACE_GETEVENTMSG, tracee, nullptr, &new_task) == 0) {
+          live.insert(static_cast<pid_t>(new_task));
+        }
+      }
+      signum = 0;
+    } else if (signum == SIGSTOP && started.insert(tracee).second) {
+      // The initial stop of a new task, which may come before the event.
+      live.insert(tracee);
+      signum = 0;
+    }
+    Resume(tracee, signum);
+  }
+  *tasks = started.size();
+  return traced;
+}
+
+static std::string SyscallName(uint64_t nr) {
+  static const std::map<uint64_t, const char *> names = {
+#define SYSCALL_NAME(name) {SYS_##name, #name}
+      SYSCALL_NAME(brk),
+      SYSCALL_NAME(chdir),
+      SYSCALL_NAME(chroot),
+      SYSCALL_NAME(clone),
+      SYSCALL_NAME(close),
+      SYSCALL_NAME(dup3),
+      SYSCALL_NAME(epoll_create1),
+      SYSCALL_NAME(epoll_ctl),
+      SYSCALL_NAME(epoll_pwait),
+      SYSCALL_NAME(execve),
+      SYSCALL_NAME(exit_group),
+      SYSCALL_NAME(faccessat),
+      SYSCALL_NAME(fchdir),
+      SYSCALL_NAME(fcntl),
+      SYSCALL_NAME(fstat),
+      SYSCALL_NAME(futex),
+      SYSCALL_NAME(getdents64),
+      SYSCALL_NAME(getgid),
+      SYSCALL_NAME(getpid),
+      SYSCALL_NAME(getuid),
+      SYSCALL_NAME(ioctl),
+      SYSCALL_NAME(kill),
+      SYSCALL_NAME(mkdirat),
+      SYSCALL_NAME(mmap),
+      SYSCALL_NAME(mount),
+      SYSCALL_NAME(mprotect),
+      SYSCALL_NAME(munmap),
+      SYSCALL_NAME(newfstatat),
+      SYSCALL_NAME(openat),
+      SYSCALL_NAME(pipe2),
+      SYSCALL_NAME(pivot_root),
+      SYSCALL_NAME(prctl),
+      SYSCALL_NAME(pread64),
+      SYSCALL_NAME(prlimit64),
+      SYSCALL_NAME(read),
+      SYSCALL_NAME(readlinkat),
+      SYSCALL_NAME(recvmsg),
+      SYSCALL_NAME(rt_sigaction),
+      SYSCALL_NAME(rt_sigprocmask),
+      SYSCALL_NAME(sendmsg),
+      SYSCALL_NAME(set_robust_list),
+      SYSCALL_NAME(set_tid_address),
+      SYSCALL_NAME(sethostname),
+      SYSCALL_NAME(setns),
+      SYSCALL_NAME(setpgid),
+      SYSCALL_NAME(setsid),
+      SYSCALL_NAME(signalfd4),
+      SYSCALL_NAME(socket),
+      SYSCALL_NAME(symlinkat),
+      SYSCALL_NAME(timerfd_create),
+      SYSCALL_NAME(timerfd_settime),
+      SYSCALL_NAME(umask),
+      SYSCALL_NAME(umount2),
+      SYSCALL_NAME(unlinkat),
+      SYSCALL_NAME(unshare),
+      SYSCALL_NAME(wait4),
+      SYSCALL_NAME(write),
+// Only some architectures still have the old system calls.
+#ifdef SYS_access
+      SYSCALL_NAME(access),
+      SYSCALL_NAME(dup2),
+      SYSCALL_NAME(epoll_wait),
+      SYSCALL_NAME(getpgrp),
+      SYSCALL_NAME(lstat),
+      SYSCALL_NAME(mkdir),
+      SYSCALL_NAME(open),
+      SYSCALL_NAME(readlink),
+      SYSCALL_NAME(stat),
+#endif
+#ifdef SYS_arch_prctl
+      SYSCALL_NAME(arch_prctl),
+#endif
+// Newer system calls that old headers lack.
+#ifdef SYS_getrandom
+      SYSCALL_NAME(getrandom),
+#endif
+#ifdef SYS_statx
+      SYSCALL_NAME(statx),
+#endif
+#ifdef SYS_rseq
+      SYSCALL_NAME(rseq),
+#endif
+#ifdef SYS_pidfd_open
+      SYSCALL_NAME(pidfd_open),
+#endif
+#ifdef SYS_clone3
+      SYSCALL_NAME(clone3),
+#endif
+#ifdef SYS_mount_setattr
+      SYSCALL_NAME(mount_setattr),
+#endif
+#undef SYSCALL_NAME
+  };
+  auto it = names.find(nr);
+  return it != names.end() ? it->second : "#" + std::to_string(nr);
+}
+
+static void PrintSyscalls(const Scenario &scenario) {
+  std::map<uint64_t, int64_t> counts;
+  int tasks = 0;
+  if (!CountSyscalls(scenario.argv(0), &counts, &tasks)) {
+    printf("  syscalls: cannot trace (requires ptrace and Linux 5.3)\n");
+    return;
+  }
+
+  std::vector<std::pair<int64_t, uint64_t>> by_count;
+  int64_t total = 0;
+  for (const auto &count : counts) {
+    by_count.push_back({count.second, count.first});
+    total += count.second;
+  }
+  std::sort(by_count.rbegin(), by_count.rend());
+  printf("  syscalls of one spawn (%d tasks%s): %lld total;", tasks,
+         scenario.server_args.empty() ? "" : ", client only",
+         static_cast<long long>(total));
+  for (size_t i = 0; i < by_count.size() && i < 12; i++) {
+    printf(" %s %lld", SyscallName(by_count[i].second).c_str(),
+           static_cast<long long>(by_count[i].first));
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+static int RemoveEntry(const char *path, const struct stat *, int,
+                       struct FTW *) {
+  remove(path);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  BenchmarkOptions options = ParseOptions(argc, argv);
+
+  const char *tmpdir = getenv("TEST_TMPDIR");
+  std::string work_dir = std::string(tmpdir != nullptr ? tmpdir : "/tmp") +
+                         "/spawn_benchmark.XXXXXX";
+  if (mkdtemp(&work_dir[0]) == nullptr) {
+    err(EXIT_FAILURE, "mkdtemp(%s)", work_dir.c_str());
+  }
+
+  std::vector<Scenario> scenarios = CreateScenarios(options, work_dir);
+  if (options.list) {
+    for (const Scenario &scenario : scenarios) {
+      printf("%s\n", scenario.name.c_str());
+    }
+    nftw(work_dir.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+    return EXIT_SUCCESS;
+  }
+
+  int total_failures = 0;
+  PrintHeader();
+  for (const Scenario &scenario : scenarios) {
+    if (!options.scenarios.empty() && !options.scenarios.count(scenario.name)) {
+      continue;
+    }
+    pid_t server_pid = -1;
+    if (!scenario.server_args.empty()) {
+      server_pid = StartServer(options.linux_sandbox, scenario.server_args);
+    }
+
+    int warmup_failures;
+    RunScenario(scenario, 5, 1, &warmup_failures);
+    for (int jobs : options.jobs) {
+      int failures;
+      int64_t start = GetMonotonicTimeNsec();
+      std::vector<Sample> samples =
+          RunScenario(scenario, options.runs, jobs, &failures);
+      PrintResult(scenario.name, jobs, samples, failures,
+                  GetMonotonicTimeNsec() - start);
+      total_failures += failures;
+    }
+    if (warmup_failures > 0) {
+      fprintf(stderr, "%s: spawns fail; try running: %s\n",
+              scenario.name.c_str(), Join(scenario.argv(0)).c_str());
+      total_failures += warmup_failures;
+    }
+    if (options.syscalls) {
+      PrintSyscalls(scenario);
+    }
+
+    if (server_pid >= 0) {
+      StopServer(server_pid);
+    }
+  }
+
+  nftw(work_dir.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+  return total_failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
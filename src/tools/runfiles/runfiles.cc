@@ -16,26 +16,27 @@
 #ifdef COMPILER_MSVC
 #include <windows.h>
 #else  // not COMPILER_MSVC
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #endif  // COMPILER_MSVC
 
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
 #include <fstream>
-#include <map>
+#include <memory>
 #include <sstream>
 #include <vector>
 
-#ifdef COMPILER_MSVC
-#include <memory>
-#endif  // COMPILER_MSVC
-
 namespace bazel {
 namespace runfiles {
 
 using std::function;
-using std::map;
 using std::pair;
 using std::string;
 using std::vector;
@@ -61,11 +62,41 @@ class RunfilesImpl : public Runfiles {
   virtual ~RunfilesImpl() {}
 };
 
-// Runfiles implementation that parses a runfiles-manifest to look up runfiles.
+// The contents of a file, which are memory-mapped where possible so that only
+// the pages that are actually looked at are read.
+class FileContents {
+ public:
+  FileContents() : data_(""), size_(0), mapped_(false) {}
+  ~FileContents();
+
+  // Reads the file at `path`. Returns false if it cannot be opened.
+  bool Read(const string& path);
+
+  const char* Data() const { return data_; }
+  size_t Size() const { return size_; }
+
+ private:
+  FileContents(const FileContents&) = delete;
+  FileContents(FileContents&&) = delete;
+  FileContents& operator=(const FileContents&) = delete;
+  FileContents& operator=(FileContents&&) = delete;
+
+  const char* data_;
+  size_t size_;
+  bool mapped_;
+  string buffer_;  // holds the contents if they are not mapped
+};
+
+// Runfiles implementation that looks up runfiles in a runfiles-manifest.
+//
+// The manifest is not parsed into a map. Its lines are binary-searched in
+// place, which needs no memory per entry if the manifest is sorted by runfiles
+// path, as the manifests written by Bazel are. Otherwise the lookups go
+// through a sorted index of line offsets.
 class ManifestBased : public RunfilesImpl {
  public:
   // Returns a new `ManifestBased` instance.
-  // Reads the file at `manifest_path` to build a map of the runfiles.
+  // Maps the file at `manifest_path` into memory and validates it.
   // Returns nullptr upon failure.
   static ManifestBased* Create(const string& manifest_path, string* error);
 
@@ -73,8 +104,16 @@ class ManifestBased : public RunfilesImpl {
   string RlocationChecked(const string& path) const override;
 
  private:
-  ManifestBased(const string& manifest_path, map<string, string>&& runfiles_map)
-      : manifest_path_(manifest_path), runfiles_map_(runfiles_map) {}
+  // A line of the manifest, split at the first space.
+  struct Entry {
+    const char* key;
+    size_t key_size;
+    const char* value;
+    size_t value_size;
+    size_t next;  // offset of the next line
+  };
+
+  ManifestBased(const string& manifest_path) : manifest_path_(manifest_path) {}
 
   ManifestBased(const ManifestBased&) = delete;
   ManifestBased(ManifestBased&&) = delete;
@@ -82,11 +121,22 @@ class ManifestBased : public RunfilesImpl {
   ManifestBased& operator=(ManifestBased&&) = delete;
 
   string RunfilesDir() const;
-  static bool ParseManifest(const string& path, map<string, string>* result,
-                            string* error);
+  bool ParseManifest(string* error);
+
+  // Returns the line that starts at `offset`. Assumes that it has a space.
+  Entry EntryAt(size_t offset) const;
+  static bool KeyLess(const Entry& a, const Entry& b);
+  // Returns the index of the first line in `index_` whose key is greater than
+  // `path`.
+  size_t UpperBound(const string& path) const;
 
   const string manifest_path_;
-  const map<string, string> runfiles_map_;
+  FileContents manifest_;
+  // The entries are the lines in [0, end_); an empty line ends the manifest.
+  size_t end_;
+  // Offsets of all lines, sorted by key, if the manifest is not sorted itself.
+  // Lines with equal keys stay in their order, so the last one wins.
+  vector<uint32_t> index_;
 };
 
 // Runfiles implementation that appends runfiles paths to the runfiles root.
@@ -193,17 +243,142 @@ string RunfilesImpl::Rlocation(const string& path) const {
   return RlocationChecked(path);
 }
 
+// Compares two byte strings like std::string::compare.
+static int Compare(const char* a, size_t a_size, const char* b,
+                   size_t b_size) {
+  int result = memcmp(a, b, std::min(a_size, b_size));
+  if (result != 0) {
+    return result;
+  }
+  return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
+}
+
+static int CompareKey(const char* key, size_t key_size, const string& path) {
+  return Compare(key, key_size, path.data(), path.size());
+}
+
+FileContents::~FileContents() {
+#ifndef COMPILER_MSVC
+  if (mapped_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif  // not COMPILER_MSVC
+}
+
+bool FileContents::Read(const string& path) {
+#ifndef COMPILER_MSVC
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      close(fd);
+      data_ = static_cast<const char*>(data);
+      size_ = st.st_size;
+      mapped_ = true;
+      return true;
+    }
+  }
+  close(fd);
+#endif  // not COMPILER_MSVC
+  // Fall back to reading the file, e.g. if it is empty or a pipe. Text mode
+  // drops the '\r' of CRLF line endings on Windows, which has no mmap path.
+  std::ifstream stm(path);
+  if (!stm.is_open()) {
+    return false;
+  }
+  std::ostringstream contents;
+  contents << stm.rdbuf();
+  buffer_ = contents.str();
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+  return true;
+}
+
 ManifestBased* ManifestBased::Create(const string& manifest_path,
                                      string* error) {
-  map<string, string> runfiles;
-  return ParseManifest(manifest_path, &runfiles, error)
-             ? new ManifestBased(manifest_path, std::move(runfiles))
-             : nullptr;
+  std::unique_ptr<ManifestBased> result(new ManifestBased(manifest_path));
+  return result->ParseManifest(error) ? result.release() : nullptr;
+}
+
+ManifestBased::Entry ManifestBased::EntryAt(size_t offset) const {
+  const char* line = manifest_.Data() + offset;
+  const char* line_end = static_cast<const char*>(
+      memchr(line, '\n', manifest_.Size() - offset));
+  if (line_end == nullptr) {
+    line_end = manifest_.Data() + manifest_.Size();
+  }
+  const char* space =
+      static_cast<const char*>(memchr(line, ' ', line_end - line));
+  Entry entry;
+  entry.key = line;
+  entry.key_size = space - line;
+  entry.value = space + 1;
+  entry.value_size = line_end - (space + 1);
+  entry.next = line_end - manifest_.Data() + 1;
+  return entry;
+}
+
+bool ManifestBased::KeyLess(const Entry& a, const Entry& b) {
+  return Compare(a.key, a.key_size, b.key, b.key_size) < 0;
+}
+
+size_t ManifestBased::UpperBound(const string& path) const {
+  size_t lo = 0;
+  size_t hi = index_.size();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    Entry entry = EntryAt(index_[mid]);
+    if (CompareKey(entry.key, entry.key_size, path) <= 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
 }
 
 string ManifestBased::RlocationChecked(const string& path) const {
-  const auto value = runfiles_map_.find(path);
-  return std::move(value == runfiles_map_.end() ? string() : value->second);
+  if (!index_.empty()) {
+    size_t i = UpperBound(path);
+    if (i > 0) {
+      Entry entry = EntryAt(index_[i - 1]);
+      if (CompareKey(entry.key, entry.key_size, path) == 0) {
+        return std::move(string(entry.value, entry.value_size));
+      }
+    }
+    return std::move(string());
+  }
+
+  // The manifest is sorted, so search its lines directly. Both `lo` and `hi`
+  // are always at the start of a line; all lines before `lo` have keys that
+  // are not greater than `path`, and all lines from `hi` on have greater keys.
+  const char* data = manifest_.Data();
+  size_t lo = 0;
+  size_t hi = end_;
+  bool found = false;
+  Entry match = {nullptr, 0, nullptr, 0, 0};
+  while (lo < hi) {
+    size_t start = lo + (hi - lo) / 2;
+    while (start > lo && data[start - 1] != '\n') {
+      --start;
+    }
+    Entry entry = EntryAt(start);
+    int cmp = CompareKey(entry.key, entry.key_size, path);
+    if (cmp <= 0) {
+      if (cmp == 0) {
+        found = true;
+        match = entry;
+      }
+      lo = entry.next;
+    } else {
+      hi = start;
+    }
+  }
+  return std::move(found ? string(match.value, match.value_size) : string());
 }
 
 vector<pair<string, string> > ManifestBased::EnvVars() const {
@@ -226,10 +401,9 @@ string ManifestBased::RunfilesDir() const {
   }
 }
 
-bool ManifestBased::ParseManifest(const string& path,
-                                  map<string, string>* result, string* error) {
-  std::ifstream stm(path);
-  if (!stm.is_open()) {
+bool ManifestBased::ParseManifest(string* error) {
+  const string& path = manifest_path_;
+  if (!manifest_.Read(path)) {
     if (error) {
       std::ostringstream err;
       err << "ERROR: " << __FILE__ << "(" << __LINE__
@@ -238,24 +412,58 @@ bool ManifestBased::ParseManifest(const string& path,
     }
     return false;
   }
-  string line;
-  std::getline(stm, line);
-  size_t line_count = 1;
-  while (!line.empty()) {
-    string::size_type idx = line.find_first_of(' ');
-    if (idx == string::npos) {
+  if (manifest_.Size() > UINT32_MAX) {
+    if (error) {
+      std::ostringstream err;
+      err << "ERROR: " << __FILE__ << "(" << __LINE__
+          << "): runfiles manifest \"" << path << "\" is too large";
+      *error = err.str();
+    }
+    return false;
+  }
+
+  // Validate the lines and check whether they are sorted already.
+  const char* data = manifest_.Data();
+  const size_t size = manifest_.Size();
+  bool sorted = true;
+  Entry previous = {"", 0, nullptr, 0, 0};
+  size_t line_count = 0;
+  size_t offset = 0;
+  while (offset < size && data[offset] != '\n') {
+    ++line_count;
+    const char* line = data + offset;
+    const char* line_end =
+        static_cast<const char*>(memchr(line, '\n', size - offset));
+    if (line_end == nullptr) {
+      line_end = data + size;
+    }
+    if (memchr(line, ' ', line_end - line) == nullptr) {
       if (error) {
         std::ostringstream err;
         err << "ERROR: " << __FILE__ << "(" << __LINE__
             << "): bad runfiles manifest entry in \"" << path << "\" line #"
-            << line_count << ": \"" << line << "\"";
+            << line_count << ": \"" << string(line, line_end - line) << "\"";
         *error = err.str();
       }
       return false;
     }
-    (*result)[line.substr(0, idx)] = line.substr(idx + 1);
-    std::getline(stm, line);
-    ++line_count;
+    Entry entry = EntryAt(offset);
+    if (sorted && KeyLess(entry, previous)) {
+      sorted = false;
+    }
+    previous = entry;
+    offset = std::min(entry.next, size);
+  }
+  end_ = offset;
+
+  if (!sorted) {
+    for (offset = 0; offset < end_; offset = EntryAt(offset).next) {
+      index_.push_back(static_cast<uint32_t>(offset));
+    }
+    std::stable_sort(index_.begin(), index_.end(),
+                     [this](uint32_t a, uint32_t b) {
+                       return KeyLess(EntryAt(a), EntryAt(b));
+                     });
   }
   return true;
 }
@@ -93,9 +93,10 @@ class Runfiles {
   //    returns a manifest- or directory-based Runfiles object; otherwise
   // 3. returns nullptr.
   //
-  // The manifest-based Runfiles object eagerly reads and caches the whole
-  // manifest file upon instantiation; this may be relevant for performance
-  // consideration.
+  // The manifest-based Runfiles object maps the manifest file into memory and
+  // validates it upon instantiation, and binary-searches it for lookups. This
+  // needs no memory per entry if the manifest is sorted (Bazel writes sorted
+  // manifests); otherwise it builds an index of the lines.
   //
   // Returns nullptr on error. If `error` is provided, the method prints an
   // error message into it.
@@ -232,6 +232,66 @@ TEST_F(RunfilesTest, ManifestBasedRunfilesRlocation) {
   EXPECT_EQ(r->Rlocation("c:\\Foo"), "c:\\Foo");
 }
 
+TEST_F(RunfilesTest, ManifestBasedRunfilesRlocationInSortedManifest) {
+  vector<string> lines;
+  for (int i = 0; i < 1000; ++i) {
+    lines.push_back("pkg/f" + std::to_string(100000 + i) + " /a/" +
+                    std::to_string(i));
+  }
+  unique_ptr<MockFile> mf(
+      MockFile::Create("foo" LINE() ".runfiles_manifest", lines));
+  EXPECT_TRUE(mf != nullptr);
+
+  string error;
+  unique_ptr<Runfiles> r(Runfiles::CreateManifestBased(mf->Path(), &error));
+  ASSERT_NE(r, nullptr);
+  EXPECT_TRUE(error.empty());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(r->Rlocation("pkg/f" + std::to_string(100000 + i)),
+              "/a/" + std::to_string(i));
+  }
+  EXPECT_EQ(r->Rlocation("pkg"), "");
+  EXPECT_EQ(r->Rlocation("pkg/f"), "");
+  EXPECT_EQ(r->Rlocation("pkg/f1000000"), "");
+  EXPECT_EQ(r->Rlocation("pkg/f101000"), "");
+  EXPECT_EQ(r->Rlocation("a"), "");
+  EXPECT_EQ(r->Rlocation("z"), "");
+}
+
+TEST_F(RunfilesTest, ManifestBasedRunfilesRlocationInUnsortedManifest) {
+  unique_ptr<MockFile> mf(MockFile::Create(
+      "foo" LINE() ".runfiles_manifest",
+      {"c/d e", "a/b c/d", "a x", "a/b/c y", "a/b z", "a-b w"}));
+  EXPECT_TRUE(mf != nullptr);
+
+  string error;
+  unique_ptr<Runfiles> r(Runfiles::CreateManifestBased(mf->Path(), &error));
+  ASSERT_NE(r, nullptr);
+  EXPECT_TRUE(error.empty());
+  EXPECT_EQ(r->Rlocation("a"), "x");
+  EXPECT_EQ(r->Rlocation("a-b"), "w");
+  // The last of several lines for the same path wins.
+  EXPECT_EQ(r->Rlocation("a/b"), "z");
+  EXPECT_EQ(r->Rlocation("a/b/c"), "y");
+  EXPECT_EQ(r->Rlocation("c/d"), "e");
+  EXPECT_EQ(r->Rlocation("b"), "");
+  EXPECT_EQ(r->Rlocation("c"), "");
+  EXPECT_EQ(r->Rlocation("c/d/e"), "");
+}
+
+TEST_F(RunfilesTest, ManifestBasedRunfilesStopsAtEmptyLine) {
+  unique_ptr<MockFile> mf(MockFile::Create("foo" LINE() ".runfiles_manifest",
+                                           {"a b", "", "c d", "nospace"}));
+  EXPECT_TRUE(mf != nullptr);
+
+  string error;
+  unique_ptr<Runfiles> r(Runfiles::CreateManifestBased(mf->Path(), &error));
+  ASSERT_NE(r, nullptr);
+  EXPECT_TRUE(error.empty());
+  EXPECT_EQ(r->Rlocation("a"), "b");
+  EXPECT_EQ(r->Rlocation("c"), "");
+}
+
 TEST_F(RunfilesTest, DirectoryBasedRunfilesRlocation) {
   string error;
   unique_ptr<Runfiles> r(Runfiles::CreateDirectoryBased("whatever", &error));